@@ -31,6 +31,9 @@ String OpenMetrics::getPayload(void) {
   const auto add_metric_point = [&](const String &labels, const String &value) {
     response += current_metric_name + "{" + labels + "} " + value + "\n";
   };
+  const auto add_counter_point = [&](const String &value) {
+    response += current_metric_name + "_total " + value + "\n";
+  };
 
   add_metric("info", "AirGradient device information", "info");
   add_metric_point("airgradient_serial_number=\"" + ag->deviceId() +
@@ -51,6 +54,17 @@ String OpenMetrics::getPayload(void) {
       "gauge");
   add_metric_point("", apiClient.isPostToServerFailed() ? "0" : "1");
 
+  add_metric("server_connections",
+             "Requests to the AirGradient server that opened a new connection",
+             "counter");
+  add_counter_point(String(apiClient.getConnections()));
+
+  add_metric("server_connection_reuses",
+             "Requests to the AirGradient server sent on the connection kept "
+             "open by a previous request",
+             "counter");
+  add_counter_point(String(apiClient.getConnectionReuses()));
+
   add_metric(
       "wifi_rssi",
       "WiFi signal strength from the AirGradient device perspective, in dBm",
@@ -58,124 +72,54 @@ String OpenMetrics::getPayload(void) {
   add_metric_point("", String(wifiConnector.RSSI()));
 
   // Initialize default invalid value for each measurements
-  float _temp = utils::getInvalidTemperature();
-  float _hum = utils::getInvalidHumidity();
-  int pm01 = utils::getInvalidPmValue();
-  int pm25 = utils::getInvalidPmValue();
-  int pm10 = utils::getInvalidPmValue();
-  int pm03PCount = utils::getInvalidPmValue();
-  int co2 = utils::getInvalidCO2();
+  float values[Measurements::_MEASUREMENT_TYPE_MAX];
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    values[i] = Measurements::descriptor((Measurements::MeasurementType)i).invalidValue;
+  }
   int atmpCompensated = utils::getInvalidTemperature();
   int rhumCompensated = utils::getInvalidHumidity();
-  int tvoc = utils::getInvalidVOC();
-  int tvocRaw = utils::getInvalidVOC();
-  int nox = utils::getInvalidNOx();
-  int noxRaw = utils::getInvalidNOx();
 
   if (config.hasSensorSHT) {
-    _temp = measure.getFloat(Measurements::Temperature);
-    _hum = measure.getFloat(Measurements::Humidity);
-    atmpCompensated = _temp;
-    rhumCompensated = _hum;
+    values[Measurements::Temperature] = measure.getFloat(Measurements::Temperature);
+    values[Measurements::Humidity] = measure.getFloat(Measurements::Humidity);
+    atmpCompensated = values[Measurements::Temperature];
+    rhumCompensated = values[Measurements::Humidity];
   }
 
   if (config.hasSensorPMS1) {
-    pm01 = measure.get(Measurements::PM01);
+    values[Measurements::PM01] = measure.get(Measurements::PM01);
     float correctedPm = measure.getCorrectedPM25(false, 1);
-    pm25 = round(correctedPm);
-    pm10 = measure.get(Measurements::PM10);
-    pm03PCount = measure.get(Measurements::PM03_PC);
+    values[Measurements::PM25] = round(correctedPm);
+    values[Measurements::PM10] = measure.get(Measurements::PM10);
+    values[Measurements::PM03_PC] = measure.get(Measurements::PM03_PC);
   }
 
   if (config.hasSensorSGP) {
-    tvoc = measure.get(Measurements::TVOC);
-    tvocRaw = measure.get(Measurements::TVOCRaw);
-    nox = measure.get(Measurements::NOx);
-    noxRaw = measure.get(Measurements::NOxRaw);
+    values[Measurements::TVOC] = measure.get(Measurements::TVOC);
+    values[Measurements::TVOCRaw] = measure.get(Measurements::TVOCRaw);
+    values[Measurements::NOx] = measure.get(Measurements::NOx);
+    values[Measurements::NOxRaw] = measure.get(Measurements::NOxRaw);
   }
 
   if (config.hasSensorS8) {
-    co2 = measure.get(Measurements::CO2);
-  }
-
-  if (config.hasSensorPMS1) {
-    if (utils::isValidPm(pm01)) {
-      add_metric("pm1",
-                 "PM1.0 concentration as measured by the AirGradient PMS "
-                 "sensor, in micrograms per cubic meter",
-                 "gauge", "ugm3");
-      add_metric_point("", String(pm01));
-    }
-    if (utils::isValidPm(pm25)) {
-      add_metric("pm2d5",
-                 "PM2.5 concentration as measured by the AirGradient PMS "
-                 "sensor, in micrograms per cubic meter",
-                 "gauge", "ugm3");
-      add_metric_point("", String(pm25));
-    }
-    if (utils::isValidPm(pm10)) {
-      add_metric("pm10",
-                 "PM10 concentration as measured by the AirGradient PMS "
-                 "sensor, in micrograms per cubic meter",
-                 "gauge", "ugm3");
-      add_metric_point("", String(pm10));
-    }
-    if (utils::isValidPm03Count(pm03PCount)) {
-      add_metric("pm0d3",
-                 "PM0.3 concentration as measured by the AirGradient PMS "
-                 "sensor, in number of particules per 100 milliliters",
-                 "gauge", "p100ml");
-      add_metric_point("", String(pm03PCount));
-    }
+    values[Measurements::CO2] = measure.get(Measurements::CO2);
   }
 
-  if (config.hasSensorSGP) {
-    if (utils::isValidVOC(tvoc)) {
-      add_metric("tvoc_index",
-                 "The processed Total Volatile Organic Compounds (TVOC) index "
-                 "as measured by the AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(tvoc));
-    }
-    if (utils::isValidVOC(tvocRaw)) {
-      add_metric("tvoc_raw",
-                 "The raw input value to the Total Volatile Organic Compounds "
-                 "(TVOC) index as measured by the AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(tvocRaw));
-    }
-    if (utils::isValidNOx(nox)) {
-      add_metric("nox_index",
-                 "The processed Nitrous Oxide (NOx) index as measured by the "
-                 "AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(nox));
+  // Add measurements that valid to the metrics
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    const Measurements::MeasurementDescriptor &desc =
+        Measurements::descriptor((Measurements::MeasurementType)i);
+    if (desc.metricName == nullptr) {
+      continue;
     }
-    if (utils::isValidNOx(noxRaw)) {
-      add_metric("nox_raw",
-                 "The raw input value to the Nitrous Oxide (NOx) index as "
-                 "measured by the AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(noxRaw));
+    // Integer measurements are reported without decimal
+    float value = desc.isFloat ? values[i] : (int)values[i];
+    if (desc.isValid(value)) {
+      add_metric(desc.metricName, desc.metricHelp, "gauge", desc.metricUnit);
+      add_metric_point("", desc.isFloat ? String(value) : String((int)value));
     }
   }
 
-  if (utils::isValidCO2(co2)) {
-    add_metric("co2",
-               "Carbon dioxide concentration as measured by the AirGradient S8 "
-               "sensor, in parts per million",
-               "gauge", "ppm");
-    add_metric_point("", String(co2));
-  }
-
-  if (utils::isValidTemperature(_temp)) {
-    add_metric(
-        "temperature",
-        "The ambient temperature as measured by the AirGradient SHT / PMS "
-        "sensor, in degrees Celsius",
-        "gauge", "celsius");
-    add_metric_point("", String(_temp));
-  }
   if (utils::isValidTemperature(atmpCompensated)) {
     add_metric("temperature_compensated",
                "The compensated ambient temperature as measured by the "
@@ -184,13 +128,6 @@ String OpenMetrics::getPayload(void) {
                "gauge", "celsius");
     add_metric_point("", String(atmpCompensated));
   }
-  if (utils::isValidHumidity(_hum)) {
-    add_metric(
-        "humidity",
-        "The relative humidity as measured by the AirGradient SHT sensor",
-        "gauge", "percent");
-    add_metric_point("", String(_hum));
-  }
   if (utils::isValidHumidity(rhumCompensated)) {
     add_metric("humidity_compensated",
                "The compensated relative humidity as measured by the "
@@ -199,6 +136,52 @@ String OpenMetrics::getPayload(void) {
     add_metric_point("", String(rhumCompensated));
   }
 
+  // Statistics of the samples of every measurement moving average window, from the same
+  // snapshot
+  Measurements::Snapshot snapshot;
+  measure.snapshot(snapshot);
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    const Measurements::MeasurementDescriptor &desc =
+        Measurements::descriptor((Measurements::MeasurementType)i);
+    if (desc.metricName == nullptr) {
+      continue;
+    }
+    bool hasSamples = false;
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      hasSamples |= Measurements::statisticsOf(snapshot, desc.type, ch).count > 0;
+    }
+    if (!hasSamples) {
+      continue;
+    }
+
+    add_metric(String(desc.metricName) + "_window",
+               "Mean, standard deviation, minimum and maximum of the " + String(desc.name) +
+                   " samples in the moving average window",
+               "gauge", desc.metricUnit);
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      const Measurements::Statistics &statistics =
+          Measurements::statisticsOf(snapshot, desc.type, ch);
+      if (statistics.count > 0) {
+        String channel = "channel=\"" + String(ch) + "\",statistic=";
+        add_metric_point(channel + "\"mean\"", String(statistics.mean));
+        add_metric_point(channel + "\"stddev\"", String(statistics.stddev));
+        add_metric_point(channel + "\"min\"", String(statistics.min));
+        add_metric_point(channel + "\"max\"", String(statistics.max));
+      }
+    }
+
+    add_metric(String(desc.metricName) + "_window_samples",
+               "Number of " + String(desc.name) + " samples in the moving average window",
+               "gauge");
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      const Measurements::Statistics &statistics =
+          Measurements::statisticsOf(snapshot, desc.type, ch);
+      if (statistics.count > 0) {
+        add_metric_point("channel=\"" + String(ch) + "\"", String(statistics.count));
+      }
+    }
+  }
+
   response += "# EOF\n";
   return response;
 }
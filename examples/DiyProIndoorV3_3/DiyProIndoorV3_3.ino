@@ -86,8 +86,7 @@ static void wdgFeedUpdate(void);
 static bool sgp41Init(void);
 static void wifiFactoryConfigure(void);
 static void mqttHandle(void);
-static int calculateMaxPeriod(int updateInterval);
-static void setMeasurementMaxPeriod();
+static void setMeasurementAveragingWindow();
 
 AgSchedule dispLedSchedule(DISP_UPDATE_INTERVAL, oledDisplaySchedule);
 AgSchedule configSchedule(SERVER_CONFIG_SYNC_INTERVAL,
@@ -129,7 +128,7 @@ void setup() {
 
   /** Init sensor */
   boardInit();
-  setMeasurementMaxPeriod();
+  setMeasurementAveragingWindow();
 
   // Uncomment below line to print every measurements reading update
   // measurements.setDebug(true);
@@ -210,6 +209,9 @@ void loop() {
     tvocSchedule.run();
   }
 
+  // Make the sensor updates above visible to the local server and MQTT payload
+  measurements.publish();
+
   watchdogFeedSchedule.run();
 
   /** Check for handle WiFi reconnect */
@@ -221,6 +223,9 @@ void loop() {
   /** check that local configura changed then do some action */
   configUpdateHandle();
 
+  /** Save configuration changes once they stopped */
+  configuration.handle();
+
   localServer._handle();
 
   if (configuration.hasSensorSGP) {
@@ -375,9 +380,17 @@ static void mqttHandle(void) {
   }
 
   if (mqttClient.isConnected()) {
-    String payload = measurements.toString(true, fwMode, wifiConnector.RSSI());
+    // Broker accept a payload with only the changed measurements
+    static Measurements::ReportState report;
+    if (measurements.prepareReport(report, true) == Measurements::ReportSkip) {
+      Serial.println("MQTT sync skipped, no measurement changed");
+      return;
+    }
+
+    String payload = measurements.toString(true, fwMode, wifiConnector.RSSI(), &report);
     String topic = "airgradient/readings/" + ag.deviceId();
     if (mqttClient.publish(topic.c_str(), payload.c_str(), payload.length())) {
+      measurements.commitReport(report);
       Serial.println("MQTT sync success");
     } else {
       Serial.println("MQTT sync failure");
@@ -594,8 +607,16 @@ static void sendDataToServer(void) {
     return;
   }
 
-  String syncData = measurements.toString(false, fwMode, wifiConnector.RSSI());
+  // AirGradient server always expect every measurement
+  static Measurements::ReportState report;
+  if (measurements.prepareReport(report, false) == Measurements::ReportSkip) {
+    Serial.println("No measurement changed, skipping data transmission to AG server");
+    return;
+  }
+
+  String syncData = measurements.toString(false, fwMode, wifiConnector.RSSI(), &report);
   if (apiClient.postToServer(syncData)) {
+    measurements.commitReport(report);
     Serial.println();
     Serial.println("Online mode and isPostToAirGradient = true");
     Serial.println();
@@ -621,36 +642,22 @@ static void tempHumUpdate(void) {
   }
 }
 
-/* Set max period for each measurement type based on sensor update interval*/
-void setMeasurementMaxPeriod() {
-  /// Max period for S8 sensors measurements
-  measurements.maxPeriod(Measurements::CO2, calculateMaxPeriod(SENSOR_CO2_UPDATE_INTERVAL));
-  /// Max period for SGP sensors measurements
-  measurements.maxPeriod(Measurements::TVOC, calculateMaxPeriod(SENSOR_TVOC_UPDATE_INTERVAL));
-  measurements.maxPeriod(Measurements::TVOCRaw, calculateMaxPeriod(SENSOR_TVOC_UPDATE_INTERVAL));
-  measurements.maxPeriod(Measurements::NOx, calculateMaxPeriod(SENSOR_TVOC_UPDATE_INTERVAL));
-  measurements.maxPeriod(Measurements::NOxRaw, calculateMaxPeriod(SENSOR_TVOC_UPDATE_INTERVAL));
-  /// Max period for PMS sensors measurements
-  measurements.maxPeriod(Measurements::PM25, calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
-  measurements.maxPeriod(Measurements::PM01, calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
-  measurements.maxPeriod(Measurements::PM10, calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
-  measurements.maxPeriod(Measurements::PM03_PC, calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
-  // Temperature and Humidity
-  if (configuration.hasSensorSHT) {
-    /// Max period for SHT sensors measurements
-    measurements.maxPeriod(Measurements::Temperature,
-                           calculateMaxPeriod(SENSOR_TEMP_HUM_UPDATE_INTERVAL));
-    measurements.maxPeriod(Measurements::Humidity,
-                           calculateMaxPeriod(SENSOR_TEMP_HUM_UPDATE_INTERVAL));
-  } else {
-    /// Temp and hum data retrieved from PMS5003T sensor
-    measurements.maxPeriod(Measurements::Temperature,
-                           calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
-    measurements.maxPeriod(Measurements::Humidity, calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
-  }
+/* Set moving average time window of each measurement type, half of the server sync interval */
+void setMeasurementAveragingWindow() {
+  uint32_t window = SERVER_SYNC_INTERVAL / 2;
+  /// S8 sensors measurements
+  measurements.averagingWindow(Measurements::CO2, window, SENSOR_CO2_UPDATE_INTERVAL);
+  /// SGP sensors measurements
+  measurements.averagingWindow(Measurements::TVOC, window, SENSOR_TVOC_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::TVOCRaw, window, SENSOR_TVOC_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::NOx, window, SENSOR_TVOC_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::NOxRaw, window, SENSOR_TVOC_UPDATE_INTERVAL);
+  /// PMS sensors measurements
+  measurements.averagingWindow(Measurements::PM25, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM01, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM10, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM03_PC, window, SENSOR_PM_UPDATE_INTERVAL);
+  /// SHT or PMS5003T sensors measurements
+  measurements.averagingWindow(Measurements::Temperature, window, SENSOR_TEMP_HUM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::Humidity, window, SENSOR_TEMP_HUM_UPDATE_INTERVAL);
 }
-
-int calculateMaxPeriod(int updateInterval) {
-  // 0.5 is 50% reduced interval for max period
-  return (SERVER_SYNC_INTERVAL - (SERVER_SYNC_INTERVAL * 0.5)) / updateInterval;
-}
\ No newline at end of file
@@ -1,15 +1,18 @@
 #include "LocalServer.h"
+#include <time.h>
 
 LocalServer::LocalServer(Stream &log, OpenMetrics &openMetrics,
                          Measurements &measure, Configuration &config,
-                         WifiConnector &wifiConnector)
+                         WifiConnector &wifiConnector,
+                         MeasurementHistory &history)
     : PrintLog(log, "LocalServer"), openMetrics(openMetrics), measure(measure),
-      config(config), wifiConnector(wifiConnector) {}
+      config(config), wifiConnector(wifiConnector), history(history) {}
 
 LocalServer::~LocalServer() {}
 
 bool LocalServer::begin(void) {
   server.on("/measures/current", HTTP_GET, [this]() { _GET_measure(); });
+  server.on("/measures/history", HTTP_GET, [this]() { _GET_history(); });
   server.on(openMetrics.getApi(), HTTP_GET, [this]() { _GET_metrics(); });
   server.on("/config", HTTP_GET, [this]() { _GET_config(); });
   server.on("/config", HTTP_PUT, [this]() { _PUT_config(); });
@@ -68,4 +71,76 @@ void LocalServer::_GET_measure(void) {
   server.send(200, "application/json", toSend);
 }
 
+/** Flush history response to client when chunk reach this size */
+#define HISTORY_RESPONSE_CHUNK_SIZE 1024
+
+struct HistoryResponse {
+  WebServer *server;
+  String chunk;
+  bool first;
+};
+
+static void historyRecordToResponse(const MeasurementHistory::Record &record, void *arg) {
+  HistoryResponse *response = (HistoryResponse *)arg;
+  if (!response->first) {
+    response->chunk += ",";
+  }
+  response->first = false;
+  MeasurementHistory::appendJson(record, response->chunk);
+  if (response->chunk.length() >= HISTORY_RESPONSE_CHUNK_SIZE) {
+    response->server->sendContent(response->chunk);
+    response->chunk = "";
+  }
+}
+
+void LocalServer::_GET_history(void) {
+  uint32_t now = time(nullptr);
+  if (now < HISTORY_MIN_VALID_EPOCH) {
+    server.send(503, "text/plain", "Time not synced");
+    return;
+  }
+
+  // Default to the last 24 hours
+  uint32_t to = now;
+  if (server.hasArg("to")) {
+    to = strtoul(server.arg("to").c_str(), NULL, 10);
+  }
+  uint32_t from = to - 24 * 3600;
+  if (server.hasArg("from")) {
+    from = strtoul(server.arg("from").c_str(), NULL, 10);
+  }
+  if (from > to) {
+    server.send(400, "text/plain", "Invalid range, from is after to");
+    return;
+  }
+
+  // Without res, use the finest resolution that is still kept for the requested range
+  MeasurementHistory::Resolution res = MeasurementHistory::Hour;
+  if (server.hasArg("res")) {
+    if (!MeasurementHistory::parseResolution(server.arg("res"), res)) {
+      server.send(400, "text/plain", "Invalid res, expected 1m, 15m or 1h");
+      return;
+    }
+  } else if ((now - from) <= 24 * 3600) {
+    res = MeasurementHistory::Minute;
+  } else if ((now - from) <= 7 * 24 * 3600) {
+    res = MeasurementHistory::QuarterHour;
+  }
+
+  // Response is streamed as chunks, history can be bigger than available heap
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, "application/json", "");
+
+  HistoryResponse response;
+  response.server = &server;
+  response.first = true;
+  response.chunk = "{\"res\":" + String(MeasurementHistory::period(res)) +
+                   ",\"from\":" + String(from) + ",\"to\":" + String(to) +
+                   ",\"fields\":" + MeasurementHistory::fieldsJson() + ",\"data\":[";
+  history.query(res, from, to, historyRecordToResponse, &response);
+  response.chunk += "]}";
+  server.sendContent(response.chunk);
+  server.sendContent("");
+}
+
 void LocalServer::setFwMode(AgFirmwareMode fwMode) { this->fwMode = fwMode; }
@@ -4,6 +4,7 @@
 #include "AgConfigure.h"
 #include "AgValue.h"
 #include "AirGradient.h"
+#include "MeasurementHistory.h"
 #include "OpenMetrics.h"
 #include "AgWiFiConnector.h"
 #include <Arduino.h>
@@ -16,12 +17,14 @@ private:
   Measurements &measure;
   Configuration &config;
   WifiConnector &wifiConnector;
+  MeasurementHistory &history;
   WebServer server;
   AgFirmwareMode fwMode;
 
 public:
   LocalServer(Stream &log, OpenMetrics &openMetrics, Measurements &measure,
-              Configuration &config, WifiConnector& wifiConnector);
+              Configuration &config, WifiConnector& wifiConnector,
+              MeasurementHistory &history);
   ~LocalServer();
 
   bool begin(void);
@@ -33,6 +36,7 @@ public:
   void _PUT_config(void);
   void _GET_metrics(void);
   void _GET_measure(void);
+  void _GET_history(void);
 };
 
 #endif /** _LOCAL_SERVER_H_ */
@@ -0,0 +1,519 @@
+#include "MeasurementHistory.h"
+#include "SPIFFS.h"
+#include <time.h>
+
+/** Fixed-point scale of each history field, value stored is round(value * scale) */
+static const struct {
+  Measurements::MeasurementType type;
+  float scale;
+} HISTORY_FIELD_DEFS[HISTORY_FIELDS] = {
+    {Measurements::Temperature, 100}, {Measurements::Humidity, 100}, {Measurements::CO2, 1},
+    {Measurements::TVOC, 1},          {Measurements::NOx, 1},        {Measurements::PM01, 10},
+    {Measurements::PM25, 10},         {Measurements::PM10, 10},      {Measurements::PM03_PC, 1},
+};
+
+/**
+ * Segment ring of each resolution. The oldest segment is dropped as a whole when the ring
+ * wraps, so (segments - 1) * records is the guaranteed retention
+ */
+static constexpr struct {
+  uint32_t period; // seconds
+  uint8_t segments;
+  uint16_t records; // per segment
+} HISTORY_TIER_DEFS[HISTORY_TIERS] = {
+    {60, 7, 240},   // 1 minute, at least 24 hours
+    {900, 8, 96},   // 15 minutes, at least 7 days
+    {3600, 6, 144}, // 1 hour, at least 30 days
+};
+
+static constexpr bool tierSegmentsFit(int i) {
+  return i == HISTORY_TIERS ||
+         (HISTORY_TIER_DEFS[i].segments <= HISTORY_SEGMENTS_MAX && tierSegmentsFit(i + 1));
+}
+static_assert(tierSegmentsFit(0), "HISTORY_SEGMENTS_MAX is less than a resolution segments");
+
+/** Maximum encoded record size, one 5 bytes varint for timestamp and every field */
+#define HISTORY_RECORD_MAX_SIZE (5 * (HISTORY_FIELDS + 1))
+
+static uint32_t zigzagEncode(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t zigzagDecode(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static int32_t delta(int32_t value, int32_t reference) {
+  return (int32_t)((uint32_t)value - (uint32_t)reference);
+}
+
+static size_t writeVarint(uint32_t value, uint8_t *buf) {
+  size_t len = 0;
+  while (value >= 0x80) {
+    buf[len++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buf[len++] = (uint8_t)value;
+  return len;
+}
+
+static bool readVarint(File &file, uint32_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    int c = file.read();
+    if (c < 0) {
+      return false;
+    }
+    value |= (uint32_t)(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static size_t encodeRecord(const MeasurementHistory::Record &record,
+                           const MeasurementHistory::Record &reference, uint8_t *buf) {
+  size_t len = writeVarint(zigzagEncode(delta(record.timestamp, reference.timestamp)), buf);
+  for (int i = 0; i < HISTORY_FIELDS; i++) {
+    len += writeVarint(zigzagEncode(delta(record.values[i], reference.values[i])), buf + len);
+  }
+  return len;
+}
+
+static bool decodeRecord(File &file, MeasurementHistory::Record &record) {
+  uint32_t value;
+  if (!readVarint(file, value)) {
+    return false;
+  }
+  record.timestamp += zigzagDecode(value);
+  for (int i = 0; i < HISTORY_FIELDS; i++) {
+    if (!readVarint(file, value)) {
+      return false;
+    }
+    record.values[i] = (int32_t)((uint32_t)record.values[i] + (uint32_t)zigzagDecode(value));
+  }
+  return true;
+}
+
+MeasurementHistory::MeasurementHistory(Stream &log) : PrintLog(log, "History") {}
+
+MeasurementHistory::~MeasurementHistory() {}
+
+/**
+ * @brief Initialize history, recover the segment rings from SPIFFS
+ *
+ * SPIFFS must be mounted before, see Configuration::begin
+ *
+ * @return true Success
+ * @return false Failure
+ */
+bool MeasurementHistory::begin(void) {
+  _mutex = xSemaphoreCreateMutex();
+  if (_mutex == NULL) {
+    logError("Create mutex failed");
+    return false;
+  }
+
+  for (int i = 0; i < HISTORY_TIERS; i++) {
+    memset(&_tiers[i].acc, 0, sizeof(Accumulator));
+    _tiers[i].pending.clear();
+    recover(_tiers[i], (Resolution)i);
+  }
+  _ready = true;
+
+  return true;
+}
+
+/**
+ * @brief Aggregate a measures snapshot into every resolution
+ *
+ * Sample is dropped until the system clock is synced
+ *
+ * @param mc measures snapshot, see Measurements::getMeasures
+ */
+void MeasurementHistory::add(const Measurements::Measures &mc) {
+  if (!_ready) {
+    return;
+  }
+
+  time_t now = time(nullptr);
+  if (now < (time_t)HISTORY_MIN_VALID_EPOCH) {
+    return;
+  }
+
+  // Use average of valid channels for measurements that have 2 channels
+  const float *sources[HISTORY_FIELDS] = {mc.temperature, mc.humidity, &mc.co2,
+                                          &mc.tvoc,       &mc.nox,      mc.pm_01,
+                                          mc.pm_25,       mc.pm_10,     mc.pm_03_pc};
+  float values[HISTORY_FIELDS];
+  for (int i = 0; i < HISTORY_FIELDS; i++) {
+    const Measurements::MeasurementDescriptor &desc =
+        Measurements::descriptor(HISTORY_FIELD_DEFS[i].type);
+    float sum = 0;
+    int count = 0;
+    for (int ch = 0; ch < desc.channels; ch++) {
+      if (desc.isValid(sources[i][ch])) {
+        sum += sources[i][ch];
+        count++;
+      }
+    }
+    values[i] = count ? sum / count : desc.invalidValue;
+  }
+
+  if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+    for (int i = 0; i < HISTORY_TIERS; i++) {
+      accumulate(_tiers[i], (Resolution)i, (uint32_t)now, values);
+    }
+
+    // Finest resolution fill the RAM buffer first, write every resolution together
+    if (_tiers[Minute].pending.full()) {
+      flush();
+    }
+    xSemaphoreGive(_mutex);
+  }
+}
+
+/**
+ * @brief Get history records of a resolution, oldest first
+ *
+ * Lock is only held to copy the records not yet written to flash and the segments position, so
+ * a slow reader doesn't block add(). Segment files are read after, records flushed meanwhile
+ * are skipped as they are given from the copy
+ *
+ * @param res resolution
+ * @param from unix time, inclusive
+ * @param to unix time, inclusive
+ * @param callback called for each record in range, without the history lock held
+ * @param arg passed to callback
+ */
+void MeasurementHistory::query(Resolution res, uint32_t from, uint32_t to,
+                               RecordCallback callback, void *arg) {
+  if (!_ready || from > to) {
+    return;
+  }
+
+  Record pending[HISTORY_FLUSH_RECORDS];
+  int pendingCount = 0;
+  uint32_t first[HISTORY_SEGMENTS_MAX];
+  uint32_t last[HISTORY_SEGMENTS_MAX];
+  uint8_t current;
+  if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) {
+    return;
+  }
+  Tier &tier = _tiers[res];
+  for (size_t i = 0; i < tier.pending.size(); i++) {
+    pending[pendingCount++] = tier.pending[i];
+  }
+  memcpy(first, tier.spanFirst, sizeof(first));
+  memcpy(last, tier.spanLast, sizeof(last));
+  current = tier.segment;
+  xSemaphoreGive(_mutex);
+
+  // Newest record in flash, newer ones are in the pending copy
+  int segments = HISTORY_TIER_DEFS[res].segments;
+  uint32_t flushed = 0;
+  for (int i = 0; i < segments; i++) {
+    if (last[i] > flushed) {
+      flushed = last[i];
+    }
+  }
+  uint32_t limit = to < flushed ? to : flushed;
+
+  // Start from the segment after current one, which is the oldest
+  for (int i = 1; i <= segments; i++) {
+    int segment = (current + i) % segments;
+    if (last[segment] == 0 || last[segment] < from || first[segment] > limit) {
+      continue;
+    }
+    uint32_t segmentFirst;
+    Record segmentLast;
+    uint16_t count;
+    readSegment(res, segment, from, limit, callback, arg, &segmentFirst, &segmentLast, &count);
+  }
+
+  // Records not yet written to flash when the query started
+  for (int i = 0; i < pendingCount; i++) {
+    if (pending[i].timestamp >= from && pending[i].timestamp <= to) {
+      callback(pending[i], arg);
+    }
+  }
+}
+
+void MeasurementHistory::accumulate(Tier &tier, Resolution res, uint32_t timestamp,
+                                    const float values[HISTORY_FIELDS]) {
+  uint32_t period = HISTORY_TIER_DEFS[res].period;
+  uint32_t window = timestamp / period;
+
+  if (window < tier.acc.window) {
+    // Clock moved backward, drop the current window
+    memset(&tier.acc, 0, sizeof(Accumulator));
+  }
+
+  if (window != tier.acc.window) {
+    bool hasSample = false;
+    for (int i = 0; i < HISTORY_FIELDS; i++) {
+      if (tier.acc.count[i]) {
+        hasSample = true;
+        break;
+      }
+    }
+
+    if (hasSample) {
+      Record record;
+      record.timestamp = tier.acc.window * period;
+      for (int i = 0; i < HISTORY_FIELDS; i++) {
+        float value = Measurements::descriptor(HISTORY_FIELD_DEFS[i].type).invalidValue;
+        if (tier.acc.count[i]) {
+          value = tier.acc.sum[i] / tier.acc.count[i];
+        }
+        record.values[i] = lroundf(value * HISTORY_FIELD_DEFS[i].scale);
+      }
+
+      // Should not happen as coarser resolution always flushed together with finest
+      if (tier.pending.full()) {
+        flushTier(tier, res);
+      }
+      tier.pending.push(record);
+    }
+
+    memset(&tier.acc, 0, sizeof(Accumulator));
+    tier.acc.window = window;
+  }
+
+  for (int i = 0; i < HISTORY_FIELDS; i++) {
+    if (Measurements::descriptor(HISTORY_FIELD_DEFS[i].type).isValid(values[i])) {
+      tier.acc.sum[i] += values[i];
+      tier.acc.count[i]++;
+    }
+  }
+}
+
+void MeasurementHistory::flush(void) {
+  for (int i = 0; i < HISTORY_TIERS; i++) {
+    flushTier(_tiers[i], (Resolution)i);
+  }
+}
+
+void MeasurementHistory::flushTier(Tier &tier, Resolution res) {
+  if (tier.pending.empty()) {
+    return;
+  }
+
+  char path[32];
+  uint8_t buf[HISTORY_RECORD_MAX_SIZE];
+  File file;
+  for (size_t i = 0; i < tier.pending.size(); i++) {
+    if (tier.written >= HISTORY_TIER_DEFS[res].records) {
+      // Segment full, overwrite the oldest segment. New segment start from a zero reference
+      if (file) {
+        file.close();
+      }
+      tier.segment = (tier.segment + 1) % HISTORY_TIER_DEFS[res].segments;
+      tier.written = 0;
+      tier.spanFirst[tier.segment] = 0;
+      tier.spanLast[tier.segment] = 0;
+      memset(&tier.last, 0, sizeof(Record));
+      segmentPath(res, tier.segment, path, sizeof(path));
+      file = SPIFFS.open(path, "w", true);
+    } else if (!file) {
+      segmentPath(res, tier.segment, path, sizeof(path));
+      file = SPIFFS.open(path, "a", true);
+    }
+
+    if (!file) {
+      logError("Open history segment failed");
+      break;
+    }
+
+    const Record &record = tier.pending[i];
+    size_t len = encodeRecord(record, tier.last, buf);
+    if (file.write(buf, len) != len) {
+      logError("Write history segment failed");
+      // Partial record, make next flush start from a new segment
+      tier.written = HISTORY_TIER_DEFS[res].records;
+      break;
+    }
+    tier.last = record;
+    if (tier.spanLast[tier.segment] == 0) {
+      tier.spanFirst[tier.segment] = record.timestamp;
+    }
+    tier.spanLast[tier.segment] = record.timestamp;
+    tier.written++;
+  }
+
+  if (file) {
+    file.close();
+  }
+  tier.pending.clear();
+}
+
+void MeasurementHistory::recover(Tier &tier, Resolution res) {
+  tier.segment = 0;
+  tier.written = 0;
+  memset(&tier.last, 0, sizeof(Record));
+  memset(tier.spanFirst, 0, sizeof(tier.spanFirst));
+  memset(tier.spanLast, 0, sizeof(tier.spanLast));
+
+  bool found = false;
+  for (int i = 0; i < HISTORY_TIER_DEFS[res].segments; i++) {
+    uint32_t first;
+    Record last;
+    uint16_t count;
+    bool complete = readSegment(res, i, 1, 0, NULL, NULL, &first, &last, &count);
+    if (count == 0) {
+      continue;
+    }
+    tier.spanFirst[i] = first;
+    tier.spanLast[i] = last.timestamp;
+
+    if (!found || last.timestamp > tier.last.timestamp) {
+      found = true;
+      tier.segment = i;
+      tier.last = last;
+      // Segment ending with a partial record can't be appended, start a new one on next flush
+      tier.written = complete ? count : HISTORY_TIER_DEFS[res].records;
+    }
+  }
+
+  logInfo(String(HISTORY_TIER_DEFS[res].period) + "s history: segment " +
+          String(tier.segment) + ", " + String(tier.written) + " records");
+}
+
+void MeasurementHistory::segmentPath(Resolution res, int segment, char *path, size_t size) {
+  snprintf(path, size, "/history_%u_%d.bin", (unsigned int)HISTORY_TIER_DEFS[res].period,
+           segment);
+}
+
+/**
+ * @brief Decode a segment file, reading stops after the records up to time "to" when a callback
+ * is given
+ *
+ * @return true Segment fully decoded
+ * @return false Segment ends with a partial record
+ */
+bool MeasurementHistory::readSegment(Resolution res, int segment, uint32_t from, uint32_t to,
+                                     RecordCallback callback, void *arg, uint32_t *first,
+                                     Record *last, uint16_t *count) {
+  memset(last, 0, sizeof(Record));
+  *first = 0;
+  *count = 0;
+
+  char path[32];
+  segmentPath(res, segment, path, sizeof(path));
+  if (!SPIFFS.exists(path)) {
+    return true;
+  }
+
+  File file = SPIFFS.open(path, "r");
+  if (!file) {
+    return true;
+  }
+
+  bool complete = true;
+  Record record = *last;
+  while (file.available() > 0) {
+    if (!decodeRecord(file, record)) {
+      complete = false;
+      break;
+    }
+    if (*count == 0) {
+      *first = record.timestamp;
+    }
+    *last = record;
+    (*count)++;
+
+    if (callback) {
+      // Records of a segment are in time order
+      if (record.timestamp > to) {
+        break;
+      }
+      if (record.timestamp >= from) {
+        callback(record, arg);
+      }
+    }
+  }
+  file.close();
+
+  return complete;
+}
+
+/**
+ * @brief Aggregation period of a resolution
+ *
+ * @param res resolution
+ * @return uint32_t period in seconds
+ */
+uint32_t MeasurementHistory::period(Resolution res) { return HISTORY_TIER_DEFS[res].period; }
+
+/**
+ * @brief Measurement stored at field index of Record::values
+ */
+Measurements::MeasurementType MeasurementHistory::fieldType(int field) {
+  return HISTORY_FIELD_DEFS[field].type;
+}
+
+/**
+ * @brief Convert fixed-point record value back to measurement value
+ */
+float MeasurementHistory::fieldValue(int field, int32_t value) {
+  return value / HISTORY_FIELD_DEFS[field].scale;
+}
+
+/**
+ * @brief JSON array of the field names, in Record::values order
+ */
+String MeasurementHistory::fieldsJson(void) {
+  String json = "[";
+  for (int i = 0; i < HISTORY_FIELDS; i++) {
+    if (i) {
+      json += ",";
+    }
+    json += "\"" + String(Measurements::descriptor(HISTORY_FIELD_DEFS[i].type).jsonKey) + "\"";
+  }
+  json += "]";
+  return json;
+}
+
+/**
+ * @brief Append record as JSON array [timestamp, values...], invalid value is null
+ *
+ * @param record history record
+ * @param out string to append to
+ */
+void MeasurementHistory::appendJson(const Record &record, String &out) {
+  out += "[" + String(record.timestamp);
+  for (int i = 0; i < HISTORY_FIELDS; i++) {
+    float value = fieldValue(i, record.values[i]);
+    out += ",";
+    if (!Measurements::descriptor(HISTORY_FIELD_DEFS[i].type).isValid(value)) {
+      out += "null";
+    } else if (HISTORY_FIELD_DEFS[i].scale == 1) {
+      out += String(record.values[i]);
+    } else {
+      out += String(value, HISTORY_FIELD_DEFS[i].scale == 100 ? 2 : 1);
+    }
+  }
+  out += "]";
+}
+
+/**
+ * @brief Parse resolution query parameter, accept "1m", "15m", "1h" or period in seconds
+ *
+ * @param str query value
+ * @param res parsed resolution
+ * @return true Valid resolution
+ * @return false Unknown resolution
+ */
+bool MeasurementHistory::parseResolution(const String &str, Resolution &res) {
+  if (str == "1m" || str == "60") {
+    res = Minute;
+  } else if (str == "15m" || str == "900") {
+    res = QuarterHour;
+  } else if (str == "1h" || str == "3600") {
+    res = Hour;
+  } else {
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+#ifndef _MEASUREMENT_HISTORY_H_
+#define _MEASUREMENT_HISTORY_H_
+
+#include "AgValue.h"
+#include "Main/PrintLog.h"
+#include "Main/RingBuffer.h"
+#include <Arduino.h>
+
+/** Number of measurements kept per history record */
+#define HISTORY_FIELDS 9
+/** Number of aggregation resolution (1 minute, 15 minutes, 1 hour) */
+#define HISTORY_TIERS 3
+/** Number of records buffered in RAM before they are written to flash */
+#define HISTORY_FLUSH_RECORDS 15
+/** Maximum number of segment files of a resolution ring */
+#define HISTORY_SEGMENTS_MAX 8
+/** Unix time below this value means clock is not synced yet (2023-11-14) */
+#define HISTORY_MIN_VALID_EPOCH 1700000000UL
+
+/**
+ * @brief Multi-resolution history of the measurements
+ *
+ * Every sample is aggregated into 1 minute, 15 minutes and 1 hour averages. Completed
+ * aggregates are buffered in RAM and periodically appended to a ring of SPIFFS segment files,
+ * one ring per resolution, sized to keep at least 24 hours of 1 minute, 7 days of 15 minutes
+ * and 30 days of 1 hour aggregates. Values are stored as fixed-point integers and each record
+ * is encoded as zigzag varint deltas against the previous record of the same segment.
+ */
+class MeasurementHistory : public PrintLog {
+public:
+  enum Resolution { Minute, QuarterHour, Hour };
+
+  struct Record {
+    uint32_t timestamp; // Unix time of the aggregation window start
+    int32_t values[HISTORY_FIELDS];
+  };
+
+  /**
+   * @brief Called for every record matching a query
+   *
+   * @param record history record, fixed-point values
+   * @param arg user argument given to query()
+   */
+  typedef void (*RecordCallback)(const Record &record, void *arg);
+
+private:
+  struct Accumulator {
+    uint32_t window; // Index of the aggregation window, timestamp / period
+    float sum[HISTORY_FIELDS];
+    uint16_t count[HISTORY_FIELDS];
+  };
+
+  struct Tier {
+    Accumulator acc;
+    RingBuffer<Record, HISTORY_FLUSH_RECORDS> pending; // Not yet written to flash
+    Record last;       // Last record written to the current segment, delta reference
+    uint8_t segment;   // Current segment file index
+    uint16_t written;  // Number of records in the current segment
+    // Time span of the records of each segment file, 0 if empty, so a query skips the segments
+    // out of its range without reading them
+    uint32_t spanFirst[HISTORY_SEGMENTS_MAX];
+    uint32_t spanLast[HISTORY_SEGMENTS_MAX];
+  };
+
+  Tier _tiers[HISTORY_TIERS];
+  SemaphoreHandle_t _mutex = NULL;
+  bool _ready = false;
+
+  void accumulate(Tier &tier, Resolution res, uint32_t timestamp,
+                  const float values[HISTORY_FIELDS]);
+  void flush(void);
+  void flushTier(Tier &tier, Resolution res);
+  void recover(Tier &tier, Resolution res);
+  void segmentPath(Resolution res, int segment, char *path, size_t size);
+  bool readSegment(Resolution res, int segment, uint32_t from, uint32_t to,
+                   RecordCallback callback, void *arg, uint32_t *first, Record *last,
+                   uint16_t *count);
+
+public:
+  MeasurementHistory(Stream &log);
+  ~MeasurementHistory();
+
+  bool begin(void);
+  void add(const Measurements::Measures &mc);
+  void query(Resolution res, uint32_t from, uint32_t to, RecordCallback callback, void *arg);
+
+  static uint32_t period(Resolution res);
+  static Measurements::MeasurementType fieldType(int field);
+  static float fieldValue(int field, int32_t value);
+  static String fieldsJson(void);
+  static void appendJson(const Record &record, String &out);
+  static bool parseResolution(const String &str, Resolution &res);
+};
+
+#endif /** _MEASUREMENT_HISTORY_H_ */
@@ -0,0 +1,525 @@
+#include "MeasuresOutbox.h"
+#include "Main/utils.h"
+#include "SPIFFS.h"
+
+#define MEASURES_OUTBOX_MAGIC 0x424F4741 // "AGOB"
+// Cursor is written to both files in turn, a torn write leaves the previous position
+#define MEASURES_OUTBOX_CURSOR_FILES {"/outbox_cursor_a.bin", "/outbox_cursor_b.bin"}
+
+static const char *const CURSOR_FILES[2] = MEASURES_OUTBOX_CURSOR_FILES;
+
+// First bytes of every segment file
+struct OutboxSegmentHeader {
+  uint32_t magic;
+  uint32_t sequence; // Incremented for each new segment, oldest segment has the lowest
+};
+
+// Followed by length bytes of payload
+struct OutboxRecordHeader {
+  uint16_t length;
+  uint16_t shape; // MeasuresOutbox::Shape
+  uint32_t crc;   // CRC32 of length, shape and payload
+};
+
+// Position of the oldest record not removed
+struct OutboxCursor {
+  uint32_t magic;
+  uint32_t sequence; // Of the read segment
+  uint16_t record;
+  uint16_t offset;
+  uint32_t crc; // CRC32 of the fields above
+};
+
+#define MEASURES_OUTBOX_RECORD_MAX                                                              \
+  (MEASURES_OUTBOX_SEGMENT_SIZE - sizeof(OutboxSegmentHeader) - sizeof(OutboxRecordHeader))
+static_assert(MEASURES_OUTBOX_RECORD_MAX <= UINT16_MAX, "Record length is saved on 16 bits");
+
+/** CRC32 of the header fields before crc, the payload is added to it */
+static uint32_t headerCrc(const OutboxRecordHeader &header) {
+  return utils::crc32(&header, offsetof(OutboxRecordHeader, crc));
+}
+
+static bool readCursor(int slot, OutboxCursor &cursor) {
+  File file = SPIFFS.open(CURSOR_FILES[slot], "r");
+  if (!file) {
+    return false;
+  }
+  bool valid = file.read((uint8_t *)&cursor, sizeof(cursor)) == sizeof(cursor) &&
+               cursor.magic == MEASURES_OUTBOX_MAGIC &&
+               cursor.crc == utils::crc32(&cursor, offsetof(OutboxCursor, crc));
+  file.close();
+  return valid;
+}
+
+MeasuresOutbox::MeasuresOutbox(Stream &log) : PrintLog(log, "MeasuresOutbox") {}
+
+/**
+ * @brief Recover the records left by a previous boot
+ *
+ * SPIFFS must be mounted before, see Configuration::begin
+ *
+ * @return true Success
+ * @return false Failure
+ */
+bool MeasuresOutbox::begin(void) {
+  int oldest = -1;
+  int newest = -1;
+  bool complete[MEASURES_OUTBOX_SEGMENTS];
+  for (int i = 0; i < MEASURES_OUTBOX_SEGMENTS; i++) {
+    complete[i] = scanSegment(i);
+  }
+
+  // Most advanced of the valid cursors
+  OutboxCursor cursor;
+  bool hasCursor = false;
+  for (int slot = 0; slot < 2; slot++) {
+    OutboxCursor other;
+    if (readCursor(slot, other) &&
+        (!hasCursor || other.sequence > cursor.sequence ||
+         (other.sequence == cursor.sequence && other.record > cursor.record))) {
+      cursor = other;
+      hasCursor = true;
+      _cursorSlot = (slot + 1) % 2;
+    }
+  }
+
+  for (int i = 0; i < MEASURES_OUTBOX_SEGMENTS; i++) {
+    if (_sequence[i] == 0) {
+      continue;
+    }
+    // Every record of the segments older than the cursor was removed
+    if (hasCursor && _sequence[i] < cursor.sequence) {
+      removeSegment(i);
+      continue;
+    }
+    if (oldest < 0 || _sequence[i] < _sequence[oldest]) {
+      oldest = i;
+    }
+    if (newest < 0 || _sequence[i] > _sequence[newest]) {
+      newest = i;
+    }
+  }
+
+  if (oldest < 0) {
+    clear();
+  } else {
+    _readSegment = oldest;
+    _readRecord = 0;
+    _readOffset = sizeof(OutboxSegmentHeader);
+    if (hasCursor && cursor.sequence == _sequence[oldest] &&
+        cursor.record <= _records[oldest] && cursor.offset <= _length[oldest]) {
+      _readRecord = cursor.record;
+      _readOffset = cursor.offset;
+    }
+    _writeSegment = newest;
+    _writable = complete[newest];
+
+    _count = 0;
+    for (int i = 0; i < MEASURES_OUTBOX_SEGMENTS; i++) {
+      _count += _records[i];
+    }
+    _count -= _readRecord;
+    if (_count == 0) {
+      clear();
+    }
+  }
+
+  _ready = true;
+  logInfo(String(_count) + " payloads recovered");
+  return true;
+}
+
+/**
+ * @brief Add a payload as the newest record
+ *
+ * @param shape how the payload is posted, given back by peek()
+ * @return true Payload saved
+ * @return false Payload too large or flash failure
+ */
+bool MeasuresOutbox::push(const char *payload, size_t length, Shape shape) {
+  if (!_ready) {
+    return false;
+  }
+  if (length > MEASURES_OUTBOX_RECORD_MAX) {
+    logError("Payload too large, " + String(length) + " bytes");
+    return false;
+  }
+
+  OutboxRecordHeader header;
+  header.length = length;
+  header.shape = shape;
+  header.crc = utils::crc32(payload, length, headerCrc(header));
+  size_t recordSize = sizeof(header) + length;
+
+  // A failed write leaves a partial record, try once more on a new segment
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (!_writable || _sequence[_writeSegment] == 0 ||
+        _length[_writeSegment] + recordSize > MEASURES_OUTBOX_SEGMENT_SIZE) {
+      if (!newSegment()) {
+        return false;
+      }
+    }
+
+    char path[32];
+    segmentPath(_writeSegment, path, sizeof(path));
+    File file = SPIFFS.open(path, "a", true);
+    if (!file) {
+      logError("Open outbox segment failed");
+      _writable = false;
+      continue;
+    }
+    bool written = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                   file.write((const uint8_t *)payload, length) == length;
+    file.close();
+    if (!written) {
+      logError("Write outbox segment failed");
+      _writable = false;
+      continue;
+    }
+
+    _length[_writeSegment] += recordSize;
+    _records[_writeSegment]++;
+    _count++;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Read the oldest records posted together: one object, or the samples up to the next
+ * object. Segment that can't be read is dropped when it's the oldest, so a broken file doesn't
+ * block the outbox
+ *
+ * @param out payloads appended, comma separated
+ * @param max maximum number of records to read
+ * @param shape set to the shape of the records read
+ * @return int number of records read, pop() the same number once they are sent
+ */
+int MeasuresOutbox::peek(String &out, int max, Shape &shape) {
+  int count = 0;
+  int segment = _readSegment;
+  uint16_t record = _readRecord;
+  uint32_t offset = _readOffset;
+  uint32_t left = _count;
+  char path[32];
+  char buf[65];
+  while (count < max && left > 0) {
+    // Segment fully read, or without record as its creation failed
+    if (record >= _records[segment] && segment != _writeSegment) {
+      do {
+        segment = (segment + 1) % MEASURES_OUTBOX_SEGMENTS;
+      } while (_sequence[segment] == 0 && segment != _writeSegment);
+      record = 0;
+      offset = sizeof(OutboxSegmentHeader);
+      continue;
+    }
+
+    segmentPath(segment, path, sizeof(path));
+    File file = SPIFFS.open(path, "r");
+    bool ok = file && file.seek(offset);
+    while (ok && count < max && record < _records[segment]) {
+      OutboxRecordHeader header;
+      ok = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+           header.length <= MEASURES_OUTBOX_RECORD_MAX;
+      if (ok && count > 0 && (header.shape != shape || shape == Object)) {
+        // Record is posted on its own request
+        file.close();
+        return count;
+      }
+      shape = (Shape)header.shape;
+      unsigned int start = out.length();
+      if (ok && count > 0) {
+        out += ',';
+      }
+
+      uint32_t crc = headerCrc(header);
+      size_t remaining = ok ? header.length : 0;
+      while (remaining > 0) {
+        size_t chunk = remaining < sizeof(buf) - 1 ? remaining : sizeof(buf) - 1;
+        if (file.read((uint8_t *)buf, chunk) != chunk) {
+          break;
+        }
+        crc = utils::crc32(buf, chunk, crc);
+        buf[chunk] = '\0';
+        out += buf;
+        remaining -= chunk;
+      }
+      ok = ok && remaining == 0 && crc == header.crc;
+      if (!ok) {
+        out.remove(start);
+        break;
+      }
+      offset += sizeof(header) + header.length;
+      count++;
+      record++;
+      left--;
+    }
+    if (file) {
+      file.close();
+    }
+
+    if (!ok) {
+      logError("Read outbox segment failed");
+      if (count > 0) {
+        // Return what was read, segment is dropped on the next peek if it's still broken
+        return count;
+      }
+      dropSegment();
+      segment = _readSegment;
+      record = _readRecord;
+      offset = _readOffset;
+      left = _count;
+    }
+  }
+  return count;
+}
+
+/**
+ * @brief Remove the oldest records
+ *
+ * @param count number of records to remove, at most the number of the last peek()
+ */
+void MeasuresOutbox::pop(int count) {
+  char path[32];
+  File file;
+  while (count > 0 && _count > 0) {
+    if (_readRecord >= _records[_readSegment] && _readSegment != _writeSegment) {
+      if (file) {
+        file.close();
+      }
+      removeSegment(_readSegment);
+      nextReadSegment();
+      continue;
+    }
+
+    if (!file) {
+      segmentPath(_readSegment, path, sizeof(path));
+      file = SPIFFS.open(path, "r");
+      if (!file) {
+        dropSegment();
+        continue;
+      }
+    }
+    // Only the header of each record is read, seek over the payload of the previous one
+    OutboxRecordHeader header;
+    if (!file.seek(_readOffset) ||
+        file.read((uint8_t *)&header, sizeof(header)) != sizeof(header)) {
+      file.close();
+      dropSegment();
+      continue;
+    }
+    _readOffset += sizeof(header) + header.length;
+    _readRecord++;
+    _count--;
+    count--;
+  }
+  if (file) {
+    file.close();
+  }
+
+  if (_count == 0) {
+    clear();
+    return;
+  }
+  if (_readRecord >= _records[_readSegment] && _readSegment != _writeSegment) {
+    removeSegment(_readSegment);
+    nextReadSegment();
+  }
+  saveCursor();
+}
+
+/**
+ * @brief Read a segment file, count the records up to the first one that is cut or damaged
+ *
+ * @return true Segment can be appended
+ * @return false Segment ends with a partial record
+ */
+bool MeasuresOutbox::scanSegment(int segment) {
+  _sequence[segment] = 0;
+  _records[segment] = 0;
+  _length[segment] = 0;
+
+  char path[32];
+  segmentPath(segment, path, sizeof(path));
+  if (!SPIFFS.exists(path)) {
+    return true;
+  }
+  File file = SPIFFS.open(path, "r");
+  if (!file) {
+    return true;
+  }
+
+  OutboxSegmentHeader segmentHeader;
+  if (file.read((uint8_t *)&segmentHeader, sizeof(segmentHeader)) != sizeof(segmentHeader) ||
+      segmentHeader.magic != MEASURES_OUTBOX_MAGIC || segmentHeader.sequence == 0) {
+    file.close();
+    SPIFFS.remove(path);
+    return true;
+  }
+
+  size_t size = file.size();
+  size_t offset = sizeof(segmentHeader);
+  bool complete = true;
+  uint8_t buf[64];
+  while (offset < size) {
+    OutboxRecordHeader header;
+    if (offset + sizeof(header) > size ||
+        file.read((uint8_t *)&header, sizeof(header)) != sizeof(header) ||
+        header.length > MEASURES_OUTBOX_RECORD_MAX ||
+        offset + sizeof(header) + header.length > size) {
+      complete = false;
+      break;
+    }
+
+    uint32_t crc = headerCrc(header);
+    size_t left = header.length;
+    while (left > 0) {
+      size_t chunk = left < sizeof(buf) ? left : sizeof(buf);
+      if (file.read(buf, chunk) != chunk) {
+        break;
+      }
+      crc = utils::crc32(buf, chunk, crc);
+      left -= chunk;
+    }
+    if (left > 0 || crc != header.crc) {
+      complete = false;
+      break;
+    }
+    offset += sizeof(header) + header.length;
+    _records[segment]++;
+  }
+  file.close();
+
+  _sequence[segment] = segmentHeader.sequence;
+  _length[segment] = offset;
+  if (!complete) {
+    logWarning("Segment " + String(segment) + " ends with a partial record");
+  }
+  return complete;
+}
+
+/**
+ * @brief Start a new write segment, the oldest segment is dropped if the ring is full
+ */
+bool MeasuresOutbox::newSegment(void) {
+  uint32_t sequence = _sequence[_writeSegment] + 1;
+  int next = _writeSegment;
+  if (_sequence[_writeSegment] != 0) {
+    next = (_writeSegment + 1) % MEASURES_OUTBOX_SEGMENTS;
+  }
+  if (_count > 0 && next == _readSegment) {
+    dropSegment();
+  }
+
+  char path[32];
+  segmentPath(next, path, sizeof(path));
+  OutboxSegmentHeader header = {MEASURES_OUTBOX_MAGIC, sequence};
+  File file = SPIFFS.open(path, "w", true);
+  bool written = file && file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header);
+  if (file) {
+    file.close();
+  }
+
+  _writeSegment = next;
+  _sequence[next] = sequence;
+  _records[next] = 0;
+  _length[next] = sizeof(header);
+  _writable = written;
+  if (_count == 0) {
+    // Read position follows the write segment while the outbox is empty
+    _readSegment = next;
+    _readRecord = 0;
+    _readOffset = sizeof(header);
+  }
+  if (!written) {
+    logError("Create outbox segment failed");
+  }
+  return written;
+}
+
+/**
+ * @brief Drop the oldest segment, when the ring is full or the segment can't be read
+ */
+void MeasuresOutbox::dropSegment(void) {
+  uint32_t dropped = _records[_readSegment] - _readRecord;
+  _dropped += dropped;
+  _count -= dropped;
+  logWarning(String(dropped) + " oldest payloads dropped");
+  if (_readSegment == _writeSegment || _count == 0) {
+    clear();
+    return;
+  }
+
+  removeSegment(_readSegment);
+  nextReadSegment();
+  saveCursor();
+}
+
+/**
+ * @brief Move the read position to the first record of the next segment in use
+ */
+void MeasuresOutbox::nextReadSegment(void) {
+  do {
+    _readSegment = (_readSegment + 1) % MEASURES_OUTBOX_SEGMENTS;
+  } while (_sequence[_readSegment] == 0 && _readSegment != _writeSegment);
+  _readRecord = 0;
+  _readOffset = sizeof(OutboxSegmentHeader);
+}
+
+void MeasuresOutbox::removeSegment(int segment) {
+  char path[32];
+  segmentPath(segment, path, sizeof(path));
+  SPIFFS.remove(path);
+  _sequence[segment] = 0;
+  _records[segment] = 0;
+  _length[segment] = 0;
+}
+
+/**
+ * @brief Remove every record, next push starts from the first segment
+ */
+void MeasuresOutbox::clear(void) {
+  // Cursors first, new segments restart from sequence 1 and must not look removed
+  for (int slot = 0; slot < 2; slot++) {
+    if (SPIFFS.exists(CURSOR_FILES[slot])) {
+      SPIFFS.remove(CURSOR_FILES[slot]);
+    }
+  }
+  for (int i = 0; i < MEASURES_OUTBOX_SEGMENTS; i++) {
+    if (_sequence[i] != 0) {
+      removeSegment(i);
+    }
+  }
+  _readSegment = 0;
+  _readRecord = 0;
+  _readOffset = sizeof(OutboxSegmentHeader);
+  _writeSegment = 0;
+  _writable = false;
+  _count = 0;
+}
+
+/**
+ * @brief Save the read position, over the older of the two cursors. If both are lost, records
+ * of the read segment are sent again
+ */
+void MeasuresOutbox::saveCursor(void) {
+  OutboxCursor cursor;
+  cursor.magic = MEASURES_OUTBOX_MAGIC;
+  cursor.sequence = _sequence[_readSegment];
+  cursor.record = _readRecord;
+  cursor.offset = _readOffset;
+  cursor.crc = utils::crc32(&cursor, offsetof(OutboxCursor, crc));
+
+  File file = SPIFFS.open(CURSOR_FILES[_cursorSlot], "w", true);
+  if (!file || file.write((const uint8_t *)&cursor, sizeof(cursor)) != sizeof(cursor)) {
+    logError("Save outbox cursor failed");
+  }
+  if (file) {
+    file.close();
+  }
+  _cursorSlot = (_cursorSlot + 1) % 2;
+}
+
+void MeasuresOutbox::segmentPath(int segment, char *path, size_t size) {
+  snprintf(path, size, "/outbox_%d.bin", segment);
+}
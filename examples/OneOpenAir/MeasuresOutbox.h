@@ -0,0 +1,69 @@
+#ifndef _MEASURES_OUTBOX_H_
+#define _MEASURES_OUTBOX_H_
+
+#include "Main/PrintLog.h"
+#include <Arduino.h>
+
+/** Segment files of the outbox ring */
+#define MEASURES_OUTBOX_SEGMENTS 6
+/** Maximum size of a segment file, 4KB */
+#define MEASURES_OUTBOX_SEGMENT_SIZE 4096
+
+/**
+ * @brief Persistent FIFO of the measures payloads waiting to be posted over WiFi
+ *
+ * Payloads are appended to a ring of SPIFFS segment files, each record framed by its length,
+ * shape and CRC32. Shape is how the payload is posted, saved with it so it doesn't depend on the
+ * configuration when it's sent. Position of the oldest record is saved in one of two cursor files
+ * in turn when it's removed, so the outbox survives reboots. A record cut by a power loss fails
+ * its CRC and ends its segment, next records go to a new segment. A payload removed while power is
+ * lost might be sent again after boot.
+ *
+ * The oldest segment is dropped as a whole when the ring wraps, (segments - 1) * 4KB of payloads
+ * is the guaranteed retention. Not thread safe, caller serializes access.
+ */
+class MeasuresOutbox : public PrintLog {
+public:
+  /** How a payload is posted */
+  enum Shape {
+    Object, // JSON object posted alone
+    Sample, // Timestamped JSON object posted in a JSON array with the next samples
+  };
+
+private:
+  uint32_t _sequence[MEASURES_OUTBOX_SEGMENTS] = {}; // Order of each segment file, 0 if unused
+  uint16_t _records[MEASURES_OUTBOX_SEGMENTS] = {};  // Records in each segment, removed ones too
+  uint16_t _length[MEASURES_OUTBOX_SEGMENTS] = {};   // Bytes of valid records in each segment
+  uint8_t _readSegment = 0;  // Segment of the oldest record
+  uint16_t _readRecord = 0;  // Index of the oldest record in the read segment
+  uint16_t _readOffset = 0;  // Offset of the oldest record in the read segment
+  uint8_t _writeSegment = 0; // Segment new records are appended to
+  bool _writable = false;    // False if write segment can't be appended, new records start one
+  uint32_t _count = 0;       // Records not removed
+  uint32_t _dropped = 0;     // Records dropped as outbox was full or flash failed, wraps around
+  uint8_t _cursorSlot = 0;   // Cursor file written next
+  bool _ready = false;
+
+  bool scanSegment(int segment);
+  bool newSegment(void);
+  void dropSegment(void);
+  void nextReadSegment(void);
+  void removeSegment(int segment);
+  void clear(void);
+  void saveCursor(void);
+  void segmentPath(int segment, char *path, size_t size);
+
+public:
+  MeasuresOutbox(Stream &log);
+  ~MeasuresOutbox() {}
+
+  bool begin(void);
+  bool push(const char *payload, size_t length, Shape shape = Object);
+  int peek(String &out, int max, Shape &shape);
+  void pop(int count);
+  uint32_t size(void) const { return _count; }
+  /** Oldest records dropped since begin */
+  uint32_t dropped(void) const { return _dropped; }
+};
+
+#endif /** _MEASURES_OUTBOX_H_ */
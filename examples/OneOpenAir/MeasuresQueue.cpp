@@ -0,0 +1,339 @@
+#include "MeasuresQueue.h"
+#include "SPIFFS.h"
+
+#define MEASURES_QUEUE_RECORD_SIZE sizeof(Measurements::PackedMeasures)
+
+MeasuresQueue::MeasuresQueue(Stream &log) : PrintLog(log, "MeasuresQueue") {}
+
+MeasuresQueue::~MeasuresQueue() { free(_records); }
+
+/**
+ * @brief Allocate the RAM ring and remove the segment files left by a previous boot. Call before
+ * the producer and consumer tasks start, the ring is not allocated again
+ *
+ * SPIFFS must be mounted before, see Configuration::begin
+ *
+ * @param capacity RAM records, halved until the allocation succeeds
+ * @return true Success
+ * @return false Failure
+ */
+bool MeasuresQueue::begin(uint16_t capacity) {
+  while (capacity >= 2 * MEASURES_QUEUE_SPILL_RECORDS) {
+    _records =
+        (Measurements::PackedMeasures *)malloc((capacity + 1) * MEASURES_QUEUE_RECORD_SIZE);
+    if (_records) {
+      break;
+    }
+    capacity /= 2;
+  }
+  if (_records == NULL) {
+    logError("Allocate RAM records failed");
+    return false;
+  }
+  _slots = capacity + 1;
+  _head = 0;
+  _tail = 0;
+
+  char path[32];
+  for (int i = 0; i < MEASURES_QUEUE_FLASH_SEGMENTS; i++) {
+    segmentPath(i, path, sizeof(path));
+    if (SPIFFS.exists(path)) {
+      SPIFFS.remove(path);
+    }
+  }
+  resetFlash();
+
+  logInfo(String(capacity) + " RAM records, " +
+          String(MEASURES_QUEUE_FLASH_SEGMENTS * MEASURES_QUEUE_SEGMENT_RECORDS) +
+          " flash records");
+  return true;
+}
+
+/**
+ * @brief Add a measures cycle as the newest record, packed straight into its RAM slot. Producer
+ * side, doesn't wait on the consumer
+ *
+ * @param mc measures cycle, see Measurements::getMeasures
+ * @return false RAM is full, consumer didn't spill() in time, record is dropped
+ */
+bool MeasuresQueue::push(const Measurements::Measures &mc) {
+  if (_records == NULL) {
+    return false;
+  }
+
+  uint16_t head = _head;
+  uint16_t next = (head + 1) % _slots;
+  if (next == _tail) {
+    _rejected++;
+    logWarning("RAM full, newest record dropped");
+    return false;
+  }
+  // Tail read before the slot it frees is written
+  __sync_synchronize();
+
+  if (!Measurements::packMeasures(mc, _records[head])) {
+    logWarning("Value out of packed range, saturated");
+  }
+
+  // Slot written before the consumer can see it
+  __sync_synchronize();
+  _head = next;
+  return true;
+}
+
+/**
+ * @brief Move the oldest RAM records to the flash ring once RAM is nearly full, so push() keeps
+ * room for the newest. Consumer side, call it regularly, RAM has room for
+ * MEASURES_QUEUE_SPILL_RECORDS records when it is called. If flash can't be written, the oldest
+ * RAM records are dropped instead
+ */
+void MeasuresQueue::spill(void) {
+  if (_records == NULL) {
+    return;
+  }
+  int count = ramCount();
+  int excess = count - (_slots - 1 - MEASURES_QUEUE_SPILL_RECORDS);
+  if (excess < 0) {
+    return;
+  }
+
+  char path[32];
+  File file;
+  int moved = 0;
+  while (moved < MEASURES_QUEUE_SPILL_RECORDS && moved < count) {
+    if (!_writable || _segmentRecords[_writeSegment] >= MEASURES_QUEUE_SEGMENT_RECORDS) {
+      if (file) {
+        file.close();
+      }
+      int next = (_writeSegment + 1) % MEASURES_QUEUE_FLASH_SEGMENTS;
+      if (_flashCount > 0 && next == _readSegment) {
+        dropSegment();
+      }
+      _writeSegment = next;
+      _segmentRecords[_writeSegment] = 0;
+      _writable = true;
+      segmentPath(_writeSegment, path, sizeof(path));
+      file = SPIFFS.open(path, "w", true);
+    } else if (!file) {
+      segmentPath(_writeSegment, path, sizeof(path));
+      file = SPIFFS.open(path, _segmentRecords[_writeSegment] ? "a" : "w", true);
+    }
+
+    if (!file) {
+      logError("Open queue segment failed");
+      break;
+    }
+
+    if (file.write((const uint8_t *)&ramRecord(moved), MEASURES_QUEUE_RECORD_SIZE) !=
+        MEASURES_QUEUE_RECORD_SIZE) {
+      logError("Write queue segment failed");
+      // Partial record, make next spill start from a new segment
+      _writable = false;
+      break;
+    }
+    _segmentRecords[_writeSegment]++;
+    _flashCount++;
+    moved++;
+  }
+
+  if (file) {
+    file.close();
+  }
+
+  if (moved == 0) {
+    moved = excess + 1;
+    _dropped += moved;
+    logWarning("Flash not available, " + String(moved) + " oldest records dropped");
+  }
+  releaseRam(moved);
+}
+
+/**
+ * @brief Give the oldest records, without removing them. Consumer side
+ *
+ * RAM records are given from their slots when they don't cross the end of the ring, other
+ * records are copied to buf. They stay valid until pop() or spill(), push() doesn't write a slot
+ * before it's popped
+ *
+ * @param buf buffer of max records, for records read from flash or across the ring end
+ * @param max maximum number of records to give
+ * @param out set to the records, oldest first, either buf or the RAM slots
+ * @return int number of records given, pop() the same number once they are sent
+ */
+int MeasuresQueue::peek(Measurements::PackedMeasures *buf, int max,
+                        const Measurements::PackedMeasures **out) {
+  *out = buf;
+  int count = 0;
+  if (_flashCount > 0) {
+    count = readFlash(buf, max);
+    // Flash records left, RAM records are not the next ones
+    if ((uint32_t)count < _flashCount) {
+      return count;
+    }
+  }
+
+  int ram = ramCount();
+  if (count == 0) {
+    int take = ram < max ? ram : max;
+    if (_tail + take <= _slots) {
+      *out = &_records[_tail];
+      return take;
+    }
+  }
+  for (int i = 0; i < ram && count < max; i++) {
+    buf[count++] = ramRecord(i);
+  }
+  return count;
+}
+
+/**
+ * @brief Remove the oldest records. Consumer side, RAM slots removed can be pushed again
+ *
+ * @param count number of records to remove
+ */
+void MeasuresQueue::pop(int count) {
+  while (count > 0 && _flashCount > 0) {
+    int left = _segmentRecords[_readSegment] - _readRecord;
+    int take = count < left ? count : left;
+    _readRecord += take;
+    _flashCount -= take;
+    count -= take;
+
+    if (_flashCount == 0) {
+      resetFlash();
+    } else if (_readRecord >= _segmentRecords[_readSegment]) {
+      // Segment fully read, write segment always has the newest records so it's not this one
+      char path[32];
+      segmentPath(_readSegment, path, sizeof(path));
+      SPIFFS.remove(path);
+      _segmentRecords[_readSegment] = 0;
+      _readSegment = (_readSegment + 1) % MEASURES_QUEUE_FLASH_SEGMENTS;
+      _readRecord = 0;
+    }
+  }
+
+  int ram = ramCount();
+  releaseRam(count < ram ? count : ram);
+}
+
+/**
+ * @brief Number of RAM records, consumer side. Slots up to the head it reads are readable
+ */
+int MeasuresQueue::ramCount(void) const {
+  if (_records == NULL) {
+    return 0;
+  }
+  uint16_t head = _head;
+  // Head read before the slots it publishes
+  __sync_synchronize();
+  return (head + _slots - _tail) % _slots;
+}
+
+const Measurements::PackedMeasures &MeasuresQueue::ramRecord(int index) const {
+  return _records[(_tail + index) % _slots];
+}
+
+/**
+ * @brief Give the oldest RAM slots back to push(), consumer side
+ */
+void MeasuresQueue::releaseRam(int count) {
+  if (count <= 0) {
+    return;
+  }
+  // Slots read before push() can write them
+  __sync_synchronize();
+  _tail = (_tail + count) % _slots;
+}
+
+/**
+ * @brief Drop the oldest segment, when the flash ring is full or can't be read
+ */
+void MeasuresQueue::dropSegment(void) {
+  int dropped = _segmentRecords[_readSegment] - _readRecord;
+  _dropped += dropped;
+  if (_readSegment == _writeSegment) {
+    logWarning(String(dropped) + " oldest records dropped");
+    resetFlash();
+    return;
+  }
+
+  char path[32];
+  segmentPath(_readSegment, path, sizeof(path));
+  SPIFFS.remove(path);
+  _segmentRecords[_readSegment] = 0;
+  _readSegment = (_readSegment + 1) % MEASURES_QUEUE_FLASH_SEGMENTS;
+  _readRecord = 0;
+  _flashCount -= dropped;
+  logWarning(String(dropped) + " oldest records dropped");
+}
+
+/**
+ * @brief Forget every flash record, next spill starts from the first segment
+ */
+void MeasuresQueue::resetFlash(void) {
+  if (_flashCount > 0 || _segmentRecords[_writeSegment] > 0) {
+    char path[32];
+    segmentPath(_writeSegment, path, sizeof(path));
+    SPIFFS.remove(path);
+  }
+  memset(_segmentRecords, 0, sizeof(_segmentRecords));
+  _readSegment = 0;
+  _readRecord = 0;
+  _writeSegment = 0;
+  _writable = true;
+  _flashCount = 0;
+}
+
+/**
+ * @brief Read the oldest flash records. Segment that can't be read is dropped when it's the
+ * oldest, so a broken file doesn't block the queue
+ *
+ * @return int number of records read
+ */
+int MeasuresQueue::readFlash(Measurements::PackedMeasures *out, int max) {
+  int count = 0;
+  int segment = _readSegment;
+  int record = _readRecord;
+  uint32_t left = _flashCount;
+  char path[32];
+  while (count < max && left > 0) {
+    segmentPath(segment, path, sizeof(path));
+    File file = SPIFFS.open(path, "r");
+    bool ok = file && file.seek(record * MEASURES_QUEUE_RECORD_SIZE);
+    while (ok && count < max && record < _segmentRecords[segment]) {
+      ok = file.read((uint8_t *)&out[count], MEASURES_QUEUE_RECORD_SIZE) ==
+           MEASURES_QUEUE_RECORD_SIZE;
+      if (ok) {
+        count++;
+        record++;
+        left--;
+      }
+    }
+    if (file) {
+      file.close();
+    }
+
+    if (!ok) {
+      logError("Read queue segment failed");
+      if (count > 0) {
+        // Return what was read, segment is dropped on the next read if it's still broken
+        return count;
+      }
+      dropSegment();
+      segment = _readSegment;
+      record = _readRecord;
+      left = _flashCount;
+      continue;
+    }
+
+    if (record >= _segmentRecords[segment]) {
+      segment = (segment + 1) % MEASURES_QUEUE_FLASH_SEGMENTS;
+      record = 0;
+    }
+  }
+  return count;
+}
+
+void MeasuresQueue::segmentPath(int segment, char *path, size_t size) {
+  snprintf(path, size, "/queue_%d.bin", segment);
+}
@@ -0,0 +1,75 @@
+#ifndef _MEASURES_QUEUE_H_
+#define _MEASURES_QUEUE_H_
+
+#include "AgValue.h"
+#include "Main/PrintLog.h"
+#include <Arduino.h>
+
+/** Records kept in RAM, 2 days at the 3 minutes cellular measurement interval */
+#define MEASURES_QUEUE_RAM_RECORDS 960
+/** Oldest records moved to flash at once when RAM is full */
+#define MEASURES_QUEUE_SPILL_RECORDS 30
+/** Segment files of the flash ring */
+#define MEASURES_QUEUE_FLASH_SEGMENTS 5
+/** Records per segment file, 4KB */
+#define MEASURES_QUEUE_SEGMENT_RECORDS 120
+
+/**
+ * @brief FIFO of the measures cycles waiting to be sent on the cellular payload
+ *
+ * Cycles are kept as Measurements::PackedMeasures, about a fifth of Measures. Newest cycles are
+ * in a RAM ring, when it is nearly full the oldest ones are moved to a ring of SPIFFS segment
+ * files. The oldest segment is dropped as a whole when the flash ring wraps, so RAM records plus
+ * (segments - 1) * records is the guaranteed retention, 3 days at the cellular interval.
+ *
+ * The RAM ring is single producer single consumer without lock: one task calls push(), another
+ * one calls every other method. Producer only writes the head index and consumer only writes the
+ * tail index, a slot is written before the head moves past it and stays untouched until the
+ * consumer moves the tail past it. Flash ring belongs to the consumer only.
+ *
+ * Queue is not persisted across reboot, like the RAM queue it replaces.
+ */
+class MeasuresQueue : public PrintLog {
+private:
+  Measurements::PackedMeasures *_records = NULL; // RAM ring slots, newest records
+  uint16_t _slots = 0;             // RAM records plus one, a full ring keeps one slot free
+  volatile uint16_t _head = 0;     // Slot the next record is written to, only push() writes it
+  volatile uint16_t _tail = 0;     // Slot of the oldest RAM record, only consumer writes it
+  volatile uint32_t _rejected = 0; // Newest records dropped as RAM was full, only push() writes it
+
+  // Flash ring of segment files, records older than every RAM record
+  uint16_t _segmentRecords[MEASURES_QUEUE_FLASH_SEGMENTS] = {}; // Records in each segment file
+  uint8_t _readSegment = 0;  // Segment of the oldest record
+  uint16_t _readRecord = 0;  // Index of the oldest record in the read segment
+  uint8_t _writeSegment = 0; // Segment new records are appended to
+  bool _writable = true;     // False once a write failed, next records go to a new segment
+  uint32_t _flashCount = 0;  // Records in flash
+  uint32_t _dropped = 0;     // Oldest records dropped as flash was full or failed, wraps around
+
+  int ramCount(void) const;
+  const Measurements::PackedMeasures &ramRecord(int index) const;
+  void releaseRam(int count);
+  void dropSegment(void);
+  void resetFlash(void);
+  int readFlash(Measurements::PackedMeasures *out, int max);
+  void segmentPath(int segment, char *path, size_t size);
+
+public:
+  MeasuresQueue(Stream &log);
+  ~MeasuresQueue();
+
+  bool begin(uint16_t capacity = MEASURES_QUEUE_RAM_RECORDS);
+
+  // Producer
+  bool push(const Measurements::Measures &mc);
+
+  // Consumer
+  void spill(void);
+  int peek(Measurements::PackedMeasures *buf, int max, const Measurements::PackedMeasures **out);
+  void pop(int count);
+  int size(void) const { return _flashCount + ramCount(); }
+  /** Records dropped since begin, oldest ones when flash was full and newest ones when RAM was */
+  uint32_t dropped(void) const { return _dropped + _rejected; }
+};
+
+#endif /** _MEASURES_QUEUE_H_ */
@@ -43,6 +43,9 @@ CC BY-SA 4.0 Attribution-ShareAlike 4.0 International License
 #include "ESPmDNS.h"
 #include "Libraries/airgradient-client/src/common.h"
 #include "LocalServer.h"
+#include "MeasurementHistory.h"
+#include "MeasuresOutbox.h"
+#include "MeasuresQueue.h"
 #include "MqttClient.h"
 #include "OpenMetrics.h"
 #include "WebServer.h"
@@ -73,6 +76,8 @@ CC BY-SA 4.0 Attribution-ShareAlike 4.0 International License
 #define CELLULAR_MEASUREMENT_INTERVAL 3 * 60000            /** ms */
 #define CELLULAR_TRANSMISSION_INTERVAL 3 * 60000           /** ms */
 #define MQTT_SYNC_INTERVAL 60000                           /** ms */
+#define MQTT_PAYLOAD_MAX_SIZE 2048                         /** bytes */
+#define HISTORY_SAMPLE_INTERVAL 15000                      /** ms */
 #define SENSOR_CO2_CALIB_COUNTDOWN_MAX 5                   /** sec */
 #define SENSOR_TVOC_UPDATE_INTERVAL 1000                   /** ms */
 #define SENSOR_CO2_UPDATE_INTERVAL 4000                    /** ms */
@@ -84,8 +89,9 @@ CC BY-SA 4.0 Attribution-ShareAlike 4.0 International License
 #define TIMEOUT_WAIT_FOR_CELLULAR_MODULE_READY (2 * 60)    /** minutes */
 
 #define MEASUREMENT_TRANSMIT_CYCLE 3
-#define MAXIMUM_MEASUREMENT_CYCLE_QUEUE 80
-#define RESERVED_MEASUREMENT_CYCLE_CAPACITY 10
+#define MEASUREMENT_CYCLE_POST_MAX 80
+/** Outbox requests posted per WiFi transmission, a backlog doesn't hold the networking task */
+#define WIFI_OUTBOX_DRAIN_MAX 5
 
 /** I2C define */
 #define I2C_SDA_PIN 7
@@ -109,7 +115,9 @@ static OledDisplay oledDisplay(configuration, measurements, Serial);
 static StateMachine stateMachine(oledDisplay, Serial, measurements, configuration);
 static WifiConnector wifiConnector(oledDisplay, Serial, stateMachine, configuration);
 static OpenMetrics openMetrics(measurements, configuration, wifiConnector);
-static LocalServer localServer(Serial, openMetrics, measurements, configuration, wifiConnector);
+static MeasurementHistory measurementHistory(Serial);
+static LocalServer localServer(Serial, openMetrics, measurements, configuration, wifiConnector,
+                               measurementHistory);
 static AgSerial *agSerial;
 static CellularModule *cellularCard;
 static AirgradientClient *agClient;
@@ -129,8 +137,21 @@ static int lastCellSignalQuality = 99; // CSQ
 // In minutes
 uint32_t agCeClientProblemDetectedTime = 0;
 
-SemaphoreHandle_t mutexMeasurementCycleQueue;
-static std::vector<Measurements::Measures> measurementCycleQueue;
+// Cycles are pushed by loop() and sent by the networking task, see MeasuresQueue
+static MeasuresQueue measurementCycleQueue(Serial);
+// Set by the networking task to have loop() push the first measures cycle, so loop() stays the
+// only producer of the queue
+static volatile bool bootMeasurementCycleRequested = false;
+// Cycles of the post in progress read from flash or across the end of the RAM ring, other ones
+// are sent from their queue slots
+static Measurements::PackedMeasures measurementCyclePost[MEASUREMENT_CYCLE_POST_MAX];
+// WiFi payloads not posted yet, only used by the networking task
+static MeasuresOutbox wifiOutbox(Serial);
+// Averages when the last WiFi batch was posted, a batch is sent early if they changed
+static Measurements::Measures wifiBatchReference;
+static bool wifiBatchReferenceValid = false;
+// Payloads lost because the outbox couldn't save them, since boot
+static uint32_t wifiOutboxWriteFailures = 0;
 
 static void boardInit(void);
 static void initializeNetwork();
@@ -142,6 +163,7 @@ static void updateTvoc(void);
 static void updatePm(void);
 static void updateSPS30(void);
 static void sendDataToServer(void);
+static void postWifiOutbox(bool flush);
 static void tempHumUpdate(void);
 static void co2Update(void);
 static void printMeasurements();
@@ -155,9 +177,9 @@ static bool sgp41Init(void);
 static void checkForFirmwareUpdate(void);
 static void otaHandlerCallback(AirgradientOTA::OtaResult result, const char *msg);
 static void displayExecuteOta(AirgradientOTA::OtaResult result, String msg, int processing);
-static int calculateMaxPeriod(int updateInterval);
-static void setMeasurementMaxPeriod();
+static void setMeasurementAveragingWindow();
 static void newMeasurementCycle();
+static void updateHistory();
 static void restartIfCeClientIssueOverTwoHours();
 static void networkSignalCheck();
 static void networkingTask(void *args);
@@ -169,6 +191,7 @@ AgSchedule dispLedSchedule(DISP_UPDATE_INTERVAL, updateDisplayAndLedBar);
 AgSchedule configSchedule(WIFI_SERVER_CONFIG_SYNC_INTERVAL, configurationUpdateSchedule);
 AgSchedule transmissionSchedule(WIFI_TRANSMISSION_INTERVAL, sendDataToServer);
 AgSchedule measurementSchedule(WIFI_MEASUREMENT_INTERVAL, newMeasurementCycle);
+AgSchedule historySchedule(HISTORY_SAMPLE_INTERVAL, updateHistory);
 AgSchedule co2Schedule(SENSOR_CO2_UPDATE_INTERVAL, co2Update);
 AgSchedule pmsSchedule(SENSOR_PM_UPDATE_INTERVAL, updatePm);
 AgSchedule tempHumSchedule(SENSOR_TEMP_HUM_UPDATE_INTERVAL, tempHumUpdate);
@@ -228,7 +251,10 @@ void setup() {
 
   /** Init sensor */
   boardInit();
-  setMeasurementMaxPeriod();
+  setMeasurementAveragingWindow();
+
+  // Configuration already mounted SPIFFS
+  measurementHistory.begin();
 
   bool connectToNetwork = true;
   if (ag->isOne()) { // Offline mode only available for indoor monitor
@@ -283,10 +309,11 @@ void setup() {
     measurementSchedule.setPeriod(CELLULAR_MEASUREMENT_INTERVAL);
     measurementSchedule.update();
     // Queue now only applied for cellular
-    // Allocate queue memory to avoid always reallocation
-    measurementCycleQueue.reserve(RESERVED_MEASUREMENT_CYCLE_CAPACITY);
-    // Initialize mutex to access mesurementCycleQueue
-    mutexMeasurementCycleQueue = xSemaphoreCreateMutex();
+    // Allocate queue memory once, it spills to flash when full
+    measurementCycleQueue.begin();
+  } else {
+    // Payloads that failed to post before reboot are sent first
+    wifiOutbox.begin();
   }
 
   // Only run network task if monitor is not in offline mode
@@ -324,14 +351,24 @@ void loop() {
     return;
   }
 
+  // Save configuration changes once they stopped
+  configuration.handle();
+
   // Schedule to update display and led
   dispLedSchedule.run();
 
   if (networkOption == UseCellular) {
     // Queue now only applied for cellular
+    if (bootMeasurementCycleRequested) {
+      newMeasurementCycle();
+      measurementSchedule.update();
+      bootMeasurementCycleRequested = false;
+    }
     measurementSchedule.run();
   }
 
+  historySchedule.run();
+
   if (configuration.hasSensorS8) {
     co2Schedule.run();
   }
@@ -347,6 +384,9 @@ void loop() {
   if (configuration.hasSensorSGP) {
     tvocSchedule.run();
   }
+  // Make the sensor updates above visible to the other tasks at once
+  measurements.publish();
+
   if (ag->isOne()) {
     if (configuration.hasSensorPMS1) {
       ag->pms5003.handle();
@@ -427,10 +467,20 @@ static void createMqttTask(void) {
 
           /** Send data */
           if (mqttClient.isConnected()) {
-            String payload = measurements.toString(true, fwMode, wifiConnector.RSSI());
+            // Payload buffer only used by this task, keep it out of the task stack
+            static char payload[MQTT_PAYLOAD_MAX_SIZE];
+            // Broker accept a payload with only the changed measurements
+            static Measurements::ReportState report;
+            if (measurements.prepareReport(report, true) == Measurements::ReportSkip) {
+              Serial.println("MQTT sync skipped, no measurement changed");
+              continue;
+            }
+            int len = measurements.toJson(payload, sizeof(payload), true, fwMode,
+                                          wifiConnector.RSSI(), &report);
             String topic = "airgradient/readings/" + ag->deviceId();
 
-            if (mqttClient.publish(topic.c_str(), payload.c_str(), payload.length())) {
+            if (len > 0 && mqttClient.publish(topic.c_str(), payload, len)) {
+              measurements.commitReport(report);
               Serial.println("MQTT sync success");
             } else {
               Serial.println("MQTT sync failure");
@@ -629,6 +679,11 @@ void otaHandlerCallback(AirgradientOTA::OtaResult result, const char *msg) {
     break;
   case AirgradientOTA::Success:
     displayExecuteOta(result, "", 0);
+    configuration.flush();
+    if (networkOption == UseWifi) {
+      // Samples waiting for a full batch are kept in flash, send them now anyway
+      postWifiOutbox(true);
+    }
     esp_restart();
     break;
   default:
@@ -1074,6 +1129,9 @@ void initializeNetwork() {
       ESP.restart();
     }
 
+    // Sync clock for measurement history timestamps, runs in background
+    configTime(0, 0, "pool.ntp.org", "time.google.com");
+
     // Initiate local network configuration
     mdnsInit();
     localServer.begin();
@@ -1431,6 +1489,11 @@ static void updatePm(void) {
     }
   }
 
+  if (configuration.hasSensorPMS1 && configuration.hasSensorPMS2) {
+    // Arbitrate both channels with the samples of this cycle
+    measurements.fusePMS();
+  }
+
   if (configuration.hasSensorSGP) {
     float temp, hum;
     if (newPMS1Value && newPMS2Value) {
@@ -1456,16 +1519,103 @@ static void updatePm(void) {
   }
 }
 
+/**
+ * Number of samples sent on one request. Samples of a batch are timestamped, so they are sent
+ * one by one until the clock is synced
+ */
+static int wifiBatchSize() {
+  if (time(nullptr) < (time_t)HISTORY_MIN_VALID_EPOCH) {
+    return 1;
+  }
+  return configuration.getPostBatchSize();
+}
+
+/**
+ * Post the oldest outbox payloads, stop at the first failure. Request is built from the shape the
+ * payloads were saved with: an object alone, samples as JSON array of up to the batch size, only
+ * once the batch is full unless flush is set
+ */
+static void postWifiOutbox(bool flush) {
+  int batchSize = wifiBatchSize();
+  String payload;
+  for (int i = 0; i < WIFI_OUTBOX_DRAIN_MAX && wifiOutbox.size() > 0; i++) {
+    MeasuresOutbox::Shape shape;
+    payload = "[";
+    int count = wifiOutbox.peek(payload, batchSize, shape);
+    if (count == 0) {
+      break;
+    }
+    if (shape == MeasuresOutbox::Sample) {
+      if (!flush && count < batchSize) {
+        break;
+      }
+      payload += "]";
+    } else {
+      payload.remove(0, 1);
+    }
+    if (agClient->httpPostMeasures(payload.c_str()) == false) {
+      Serial.printf("Post outbox failed, %u payloads left\n", wifiOutbox.size());
+      return;
+    }
+    wifiOutbox.pop(count);
+    wifiBatchReference = measurements.getMeasures();
+    wifiBatchReferenceValid = true;
+  }
+  if (wifiOutbox.size() > 0) {
+    Serial.printf("%u outbox payloads left\n", wifiOutbox.size());
+  }
+}
+
 void postUsingWifi() {
   // Increment bootcount when send measurements data is scheduled
   int bootCount = measurements.bootCount() + 1;
   measurements.setBootCount(bootCount);
 
-  String payload = measurements.toString(false, fwMode, wifiConnector.RSSI());
-  if (agClient->httpPostMeasures(payload.c_str()) == false) {
-    Serial.println();
-    Serial.println("Online mode and isPostToAirGradient = true");
-    Serial.println();
+  // Batch is sent without waiting for more samples once a measurement moved beyond its deadband
+  int batchSize = wifiBatchSize();
+  bool flush = batchSize == 1 || !wifiBatchReferenceValid ||
+               measurements.hasChangedSince(wifiBatchReference);
+
+  // AirGradient server always expect every measurement
+  static Measurements::ReportState report;
+  if (measurements.prepareReport(report, false) == Measurements::ReportSkip) {
+    Serial.println("No measurement changed, skipping data transmission to AG server");
+    postWifiOutbox(flush);
+    return;
+  }
+
+  // Measures are posted in order, a new payload waits behind the ones still in the outbox
+  String payload = measurements.toString(false, fwMode, wifiConnector.RSSI(), &report);
+  bool postFailed = false;
+  if (batchSize == 1 && wifiOutbox.size() == 0) {
+    if (agClient->httpPostMeasures(payload.c_str())) {
+      measurements.commitReport(report);
+      payload = "";
+    } else {
+      postFailed = true;
+    }
+  }
+  if (payload.length() > 0) {
+    // Payload waits in the outbox for the next batch or retry, it keeps the time it was measured
+    // once the clock is synced. Batches are only used with a synced clock, see wifiBatchSize
+    time_t now = time(nullptr);
+    if (now >= (time_t)HISTORY_MIN_VALID_EPOCH) {
+      payload = "{\"timestamp\":" + String((uint32_t)now) + "," + payload.substring(1);
+    }
+    // Outbox owns the payload once it is saved, it's sent like it was posted
+    MeasuresOutbox::Shape shape = batchSize > 1 ? MeasuresOutbox::Sample : MeasuresOutbox::Object;
+    if (wifiOutbox.push(payload.c_str(), payload.length(), shape)) {
+      measurements.commitReport(report);
+    } else {
+      wifiOutboxWriteFailures++;
+      Serial.printf("Outbox write failed, payload dropped (%u since boot)\n",
+                    wifiOutboxWriteFailures);
+    }
+  }
+
+  // Retry on the next transmission if server is not reachable now
+  if (!postFailed) {
+    postWifiOutbox(flush);
   }
 
   // Log current free heap size
@@ -1476,37 +1626,35 @@ void postUsingWifi() {
  * forcePost to force post without checking transmit cycle
  */
 void postUsingCellular(bool forcePost) {
-  // Aquire queue mutex to get queue size
-  xSemaphoreTake(mutexMeasurementCycleQueue, portMAX_DELAY);
-
   // Make sure measurement cycle available
   int queueSize = measurementCycleQueue.size();
   if (queueSize == 0) {
     Serial.println("Skipping transmission, measurementCycle empty");
-    xSemaphoreGive(mutexMeasurementCycleQueue);
     return;
   }
 
   // Check queue size if its ready to transmit
-  // It is ready if size is divisible by 3
-  if (!forcePost && (queueSize % MEASUREMENT_TRANSMIT_CYCLE) > 0) {
+  // It is ready if size is divisible by 3, or if there is a backlog of more than one post
+  if (!forcePost && queueSize <= MEASUREMENT_CYCLE_POST_MAX &&
+      (queueSize % MEASUREMENT_TRANSMIT_CYCLE) > 0) {
     Serial.printf("Not ready to transmit, queue size are %d\n", queueSize);
-    xSemaphoreGive(mutexMeasurementCycleQueue);
     return;
   }
 
-  // Build payload include all measurements from queue
-  std::string payload;
-  bool extendPmMeasures = configuration.isExtendedPmMeasuresEnabled();
-  payload += std::to_string(CELLULAR_MEASUREMENT_INTERVAL / 1000); // Convert to seconds
-  for (int i = 0; i < queueSize; i++) {
-    auto mc = measurementCycleQueue.at(i);
-    payload += ",";
-    payload += measurements.buildMeasuresPayload(mc, extendPmMeasures);
-  }
+  // Oldest measurements first, a backlog is sent over the next transmissions. Cycles stay in the
+  // queue while posting, loop() only pushes to the free slots
+  const Measurements::PackedMeasures *cycles;
+  int postSize =
+      measurementCycleQueue.peek(measurementCyclePost, MEASUREMENT_CYCLE_POST_MAX, &cycles);
 
-  // Release before actually post measures that might takes too long
-  xSemaphoreGive(mutexMeasurementCycleQueue);
+  // Build payload, sized first so it's allocated once
+  bool extendPmMeasures = configuration.isExtendedPmMeasuresEnabled();
+  uint32_t interval = CELLULAR_MEASUREMENT_INTERVAL / 1000; // Convert to seconds
+  size_t payloadLen = Measurements::encodeMeasuresPayload(interval, cycles, postSize,
+                                                          extendPmMeasures, NULL, 0);
+  std::string payload(payloadLen, '\0');
+  Measurements::encodeMeasuresPayload(interval, cycles, postSize, extendPmMeasures, &payload[0],
+                                      payloadLen + 1);
 
   // Attempt to send
   if (agClient->httpPostMeasures(payload) == false) {
@@ -1515,20 +1663,8 @@ void postUsingCellular(bool forcePost) {
     return;
   }
 
-  // Post success, remove the data that previously sent from queue
-  xSemaphoreTake(mutexMeasurementCycleQueue, portMAX_DELAY);
-
-  if (measurementCycleQueue.capacity() > RESERVED_MEASUREMENT_CYCLE_CAPACITY) {
-    Serial.println("measurementCycleQueue capacity more than reserved space, resizing..");
-    std::vector<Measurements::Measures> tmp;
-    tmp.reserve(RESERVED_MEASUREMENT_CYCLE_CAPACITY);
-    measurementCycleQueue.swap(tmp);
-  } else {
-    // If not more than the capacity, then just clear all the values
-    measurementCycleQueue.clear();
-  }
-
-  xSemaphoreGive(mutexMeasurementCycleQueue);
+  // Post success, remove the cycles sent from queue
+  measurementCycleQueue.pop(postSize);
 }
 
 void sendDataToServer(void) {
@@ -1565,56 +1701,47 @@ static void tempHumUpdate(void) {
   }
 }
 
-/* Set max period for each measurement type based on sensor update interval*/
-void setMeasurementMaxPeriod() {
-  int max;
-
-  /// Max period for S8 sensors measurements
-  measurements.maxPeriod(Measurements::CO2, calculateMaxPeriod(SENSOR_CO2_UPDATE_INTERVAL));
-
-  /// Max period for SGP sensors measurements
-  max = calculateMaxPeriod(SENSOR_TVOC_UPDATE_INTERVAL);
-  measurements.maxPeriod(Measurements::TVOC, max);
-  measurements.maxPeriod(Measurements::TVOCRaw, max);
-  measurements.maxPeriod(Measurements::NOx, max);
-  measurements.maxPeriod(Measurements::NOxRaw, max);
-
-  /// Max period for PMS sensors measurements
-  max = calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL);
-  measurements.maxPeriod(Measurements::PM25, max);
-  measurements.maxPeriod(Measurements::PM01, max);
-  measurements.maxPeriod(Measurements::PM10, max);
-  measurements.maxPeriod(Measurements::PM25_SP, max);
-  measurements.maxPeriod(Measurements::PM01_SP, max);
-  measurements.maxPeriod(Measurements::PM10_SP, max);
-  measurements.maxPeriod(Measurements::PM03_PC, max);
-  measurements.maxPeriod(Measurements::PM05_PC, max);
-  measurements.maxPeriod(Measurements::PM01_PC, max);
-  measurements.maxPeriod(Measurements::PM25_PC, max);
-  measurements.maxPeriod(Measurements::PM5_PC, max);
-  measurements.maxPeriod(Measurements::PM10_PC, max);
+/* Set moving average time window of each measurement type, 20% of the measurement interval */
+void setMeasurementAveragingWindow() {
+  // NOTE: Both network option use the same measurement interval
+  uint32_t window = WIFI_MEASUREMENT_INTERVAL / 5;
+
+  /// S8 sensors measurements
+  measurements.averagingWindow(Measurements::CO2, window, SENSOR_CO2_UPDATE_INTERVAL);
+
+  /// SGP sensors measurements
+  measurements.averagingWindow(Measurements::TVOC, window, SENSOR_TVOC_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::TVOCRaw, window, SENSOR_TVOC_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::NOx, window, SENSOR_TVOC_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::NOxRaw, window, SENSOR_TVOC_UPDATE_INTERVAL);
+
+  /// PMS sensors measurements
+  measurements.averagingWindow(Measurements::PM25, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM01, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM10, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM25_SP, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM01_SP, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM10_SP, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM03_PC, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM05_PC, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM01_PC, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM25_PC, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM5_PC, window, SENSOR_PM_UPDATE_INTERVAL);
+  measurements.averagingWindow(Measurements::PM10_PC, window, SENSOR_PM_UPDATE_INTERVAL);
 
   // Temperature and Humidity
   if (configuration.hasSensorSHT) {
-    /// Max period for SHT sensors measurements
-    measurements.maxPeriod(Measurements::Temperature,
-                           calculateMaxPeriod(SENSOR_TEMP_HUM_UPDATE_INTERVAL));
-    measurements.maxPeriod(Measurements::Humidity,
-                           calculateMaxPeriod(SENSOR_TEMP_HUM_UPDATE_INTERVAL));
+    /// SHT sensors measurements
+    measurements.averagingWindow(Measurements::Temperature, window,
+                                 SENSOR_TEMP_HUM_UPDATE_INTERVAL);
+    measurements.averagingWindow(Measurements::Humidity, window, SENSOR_TEMP_HUM_UPDATE_INTERVAL);
   } else {
     /// Temp and hum data retrieved from PMS5003T sensor
-    measurements.maxPeriod(Measurements::Temperature,
-                           calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
-    measurements.maxPeriod(Measurements::Humidity, calculateMaxPeriod(SENSOR_PM_UPDATE_INTERVAL));
+    measurements.averagingWindow(Measurements::Temperature, window, SENSOR_PM_UPDATE_INTERVAL);
+    measurements.averagingWindow(Measurements::Humidity, window, SENSOR_PM_UPDATE_INTERVAL);
   }
 }
 
-int calculateMaxPeriod(int updateInterval) {
-  // 0.8 is 80% reduced interval for max period
-  // NOTE: Both network option use the same measurement interval
-  return (WIFI_MEASUREMENT_INTERVAL - (WIFI_MEASUREMENT_INTERVAL * 0.8)) / updateInterval;
-}
-
 void networkSignalCheck() {
   if (networkOption == UseWifi) {
     Serial.printf("WiFi RSSI %d\n", wifiConnector.RSSI());
@@ -1678,9 +1805,11 @@ void networkingTask(void *args) {
       Serial.println("Prepare first measures cycle to send on boot for 20s");
       delay(20000);
       networkSignalCheck();
-      newMeasurementCycle();
+      bootMeasurementCycleRequested = true;
+      for (int i = 0; i < 100 && bootMeasurementCycleRequested; i++) {
+        delay(100);
+      }
       postUsingCellular(true);
-      measurementSchedule.update();
     }
     // Reset scheduler
     configSchedule.update();
@@ -1696,6 +1825,9 @@ void networkingTask(void *args) {
         continue;
       }
     } else if (networkOption == UseCellular) {
+      // Keep room in the queue RAM for the cycles loop() pushes, also while offline
+      measurementCycleQueue.spill();
+
       if (agClient->isClientReady() == false) {
         // Start time if value still default
         if (agCeClientProblemDetectedTime == 0) {
@@ -1756,23 +1888,20 @@ void networkingTask(void *args) {
   vTaskDelete(handleNetworkTask);
 }
 
-void newMeasurementCycle() {
-  if (xSemaphoreTake(mutexMeasurementCycleQueue, portMAX_DELAY) == pdTRUE) {
-    // Make sure queue not overflow
-    if (measurementCycleQueue.size() >= MAXIMUM_MEASUREMENT_CYCLE_QUEUE) {
-      // Remove the oldest data from queue if queue reach max
-      measurementCycleQueue.erase(measurementCycleQueue.begin());
-    }
+void updateHistory() {
+  // Same snapshot as measurement cycle, history aggregate it to each resolution
+  measurementHistory.add(measurements.getMeasures());
+}
 
-    // Get current measures
-    auto mc = measurements.getMeasures();
-    mc.signal = cellularCard->csqToDbm(lastCellSignalQuality); // convert to RSSI
+void newMeasurementCycle() {
+  // Get current measures
+  auto mc = measurements.getMeasures();
+  mc.signal = cellularCard->csqToDbm(lastCellSignalQuality); // convert to RSSI
 
-    measurementCycleQueue.push_back(mc);
+  // Networking task moves the oldest data to flash and drops it once flash is full
+  if (measurementCycleQueue.push(mc)) {
     Serial.println("New measurement cycle added to queue");
-    // Release mutex
-    xSemaphoreGive(mutexMeasurementCycleQueue);
-    // Log current free heap size
-    Serial.printf("Free heap: %u\n", ESP.getFreeHeap());
   }
+  // Log current free heap size
+  Serial.printf("Free heap: %u\n", ESP.getFreeHeap());
 }
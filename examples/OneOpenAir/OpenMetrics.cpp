@@ -63,174 +63,120 @@ String OpenMetrics::getPayload(void) {
   add_metric_point("", String(wifiConnector.RSSI()));
 
   // Initialize default invalid value for each measurements
-  float _temp = utils::getInvalidTemperature();
-  float _hum = utils::getInvalidHumidity();
-  int pm01 = utils::getInvalidPmValue();
-  int pm25 = utils::getInvalidPmValue();
-  int pm10 = utils::getInvalidPmValue();
-  int pm03PCount = utils::getInvalidPmValue();
-  int co2 = utils::getInvalidCO2();
+  float values[Measurements::_MEASUREMENT_TYPE_MAX];
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    values[i] = Measurements::descriptor((Measurements::MeasurementType)i).invalidValue;
+  }
   int atmpCompensated = utils::getInvalidTemperature();
   int rhumCompensated = utils::getInvalidHumidity();
-  int tvoc = utils::getInvalidVOC();
-  int tvocRaw = utils::getInvalidVOC();
-  int nox = utils::getInvalidNOx();
-  int noxRaw = utils::getInvalidNOx();
 
-  // Get values
+  // Get values, all from the same snapshot as the sensors are updated by another task
+  Measurements::Snapshot snapshot;
+  measure.snapshot(snapshot);
+  const Measurements::Measures &latest = snapshot.latest;
   if (config.hasSensorPMS1 && config.hasSensorPMS2) {
-    _temp = (measure.getFloat(Measurements::Temperature, 1) +
-             measure.getFloat(Measurements::Temperature, 2)) /
-            2.0f;
-    _hum = (measure.getFloat(Measurements::Humidity, 1) +
-            measure.getFloat(Measurements::Humidity, 2)) /
-           2.0f;
-    pm01 = (measure.get(Measurements::PM01, 1) + measure.get(Measurements::PM01, 2)) / 2.0f;
-    float correctedPm25_1 = measure.getCorrectedPM25(false, 1);
-    float correctedPm25_2 = measure.getCorrectedPM25(false, 2);
-    float correctedPm25 = (correctedPm25_1 + correctedPm25_2) / 2.0f;
-    pm25 = round(correctedPm25);
-    pm10 = (measure.get(Measurements::PM10, 1) + measure.get(Measurements::PM10, 2)) / 2.0f;
-    pm03PCount =
-        (measure.get(Measurements::PM03_PC, 1) + measure.get(Measurements::PM03_PC, 2)) / 2.0f;
+    values[Measurements::Temperature] =
+        (Measurements::valueOf(latest, Measurements::Temperature, 1) +
+         Measurements::valueOf(latest, Measurements::Temperature, 2)) /
+        2.0f;
+    values[Measurements::Humidity] = (Measurements::valueOf(latest, Measurements::Humidity, 1) +
+                                      Measurements::valueOf(latest, Measurements::Humidity, 2)) /
+                                     2.0f;
+    // PM channels weighted by their health, a faulty channel is left out
+    const Measurements::Fusion::Status &fusion = snapshot.pmsFusion;
+    const auto fused = [&](Measurements::MeasurementType type, bool corrected) {
+      const Measurements::MeasurementDescriptor &desc = Measurements::descriptor(type);
+      float channels[MEASUREMENT_CHANNELS];
+      bool valid[MEASUREMENT_CHANNELS];
+      for (int i = 0; i < MEASUREMENT_CHANNELS; i++) {
+        channels[i] = corrected ? measure.getCorrectedPM25(snapshot, false, i + 1)
+                                : Measurements::valueOf(latest, type, i + 1);
+        valid[i] = desc.isValid(channels[i]);
+      }
+      return fusion.combine(channels, valid);
+    };
+    values[Measurements::PM01] = fused(Measurements::PM01, false);
+    values[Measurements::PM25] = round(fused(Measurements::PM25, true));
+    values[Measurements::PM10] = fused(Measurements::PM10, false);
+    values[Measurements::PM03_PC] = fused(Measurements::PM03_PC, false);
   } else {
     if (ag->isOne()) {
       if (config.hasSensorSHT) {
-        _temp = measure.getFloat(Measurements::Temperature);
-        _hum = measure.getFloat(Measurements::Humidity);
+        values[Measurements::Temperature] =
+            Measurements::valueOf(latest, Measurements::Temperature);
+        values[Measurements::Humidity] = Measurements::valueOf(latest, Measurements::Humidity);
       }
 
       if (config.hasSensorPMS1) {
-        pm01 = measure.get(Measurements::PM01);
-        float correctedPm = measure.getCorrectedPM25(false, 1);
-        pm25 = round(correctedPm);
-        pm10 = measure.get(Measurements::PM10);
-        pm03PCount = measure.get(Measurements::PM03_PC);
+        values[Measurements::PM01] = Measurements::valueOf(latest, Measurements::PM01);
+        float correctedPm = measure.getCorrectedPM25(snapshot, false, 1);
+        values[Measurements::PM25] = round(correctedPm);
+        values[Measurements::PM10] = Measurements::valueOf(latest, Measurements::PM10);
+        values[Measurements::PM03_PC] = Measurements::valueOf(latest, Measurements::PM03_PC);
       }
     } else {
       if (config.hasSensorPMS1) {
-        _temp = measure.getFloat(Measurements::Temperature, 1);
-        _hum = measure.getFloat(Measurements::Humidity, 1);
-        pm01 = measure.get(Measurements::PM01, 1);
-        float correctedPm = measure.getCorrectedPM25(false, 1);
-        pm25 = round(correctedPm);
-        pm10 = measure.get(Measurements::PM10, 1);
-        pm03PCount = measure.get(Measurements::PM03_PC, 1);
+        values[Measurements::Temperature] =
+            Measurements::valueOf(latest, Measurements::Temperature, 1);
+        values[Measurements::Humidity] = Measurements::valueOf(latest, Measurements::Humidity, 1);
+        values[Measurements::PM01] = Measurements::valueOf(latest, Measurements::PM01, 1);
+        float correctedPm = measure.getCorrectedPM25(snapshot, false, 1);
+        values[Measurements::PM25] = round(correctedPm);
+        values[Measurements::PM10] = Measurements::valueOf(latest, Measurements::PM10, 1);
+        values[Measurements::PM03_PC] = Measurements::valueOf(latest, Measurements::PM03_PC, 1);
       }
       if (config.hasSensorPMS2) {
-        _temp = measure.getFloat(Measurements::Temperature, 2);
-        _hum = measure.getFloat(Measurements::Humidity, 2);
-        pm01 = measure.get(Measurements::PM01, 2);
-        float correctedPm = measure.getCorrectedPM25(false, 2);
-        pm25 = round(correctedPm);
-        pm10 = measure.get(Measurements::PM10, 2);
-        pm03PCount = measure.get(Measurements::PM03_PC, 2);
+        values[Measurements::Temperature] =
+            Measurements::valueOf(latest, Measurements::Temperature, 2);
+        values[Measurements::Humidity] = Measurements::valueOf(latest, Measurements::Humidity, 2);
+        values[Measurements::PM01] = Measurements::valueOf(latest, Measurements::PM01, 2);
+        float correctedPm = measure.getCorrectedPM25(snapshot, false, 2);
+        values[Measurements::PM25] = round(correctedPm);
+        values[Measurements::PM10] = Measurements::valueOf(latest, Measurements::PM10, 2);
+        values[Measurements::PM03_PC] = Measurements::valueOf(latest, Measurements::PM03_PC, 2);
       }
     }
   }
 
   if (config.hasSensorSGP) {
-    tvoc = measure.get(Measurements::TVOC);
-    tvocRaw = measure.get(Measurements::TVOCRaw);
-    nox = measure.get(Measurements::NOx);
-    noxRaw = measure.get(Measurements::NOxRaw);
+    values[Measurements::TVOC] = Measurements::valueOf(latest, Measurements::TVOC);
+    values[Measurements::TVOCRaw] = Measurements::valueOf(latest, Measurements::TVOCRaw);
+    values[Measurements::NOx] = Measurements::valueOf(latest, Measurements::NOx);
+    values[Measurements::NOxRaw] = Measurements::valueOf(latest, Measurements::NOxRaw);
   }
 
   if (config.hasSensorS8) {
-    co2 = measure.get(Measurements::CO2);
+    values[Measurements::CO2] = Measurements::valueOf(latest, Measurements::CO2);
   }
 
-  /** Get temperature and humidity compensated */
+  /** Get temperature and humidity compensated, of the snapshot average */
   if (ag->isOne()) {
-    atmpCompensated = round(measure.getCorrectedTempHum(Measurements::Temperature));
-    rhumCompensated = round(measure.getCorrectedTempHum(Measurements::Humidity));
+    atmpCompensated = round(measure.getCorrectedTempHum(snapshot, Measurements::Temperature));
+    rhumCompensated = round(measure.getCorrectedTempHum(snapshot, Measurements::Humidity));
   } else {
-    atmpCompensated = round((measure.getCorrectedTempHum(Measurements::Temperature, 1) +
-                             measure.getCorrectedTempHum(Measurements::Temperature, 2)) /
+    atmpCompensated = round((measure.getCorrectedTempHum(snapshot, Measurements::Temperature, 1) +
+                             measure.getCorrectedTempHum(snapshot, Measurements::Temperature, 2)) /
                             2.0f);
-    rhumCompensated = round((measure.getCorrectedTempHum(Measurements::Humidity, 1) +
-                             measure.getCorrectedTempHum(Measurements::Humidity, 2)) /
+    rhumCompensated = round((measure.getCorrectedTempHum(snapshot, Measurements::Humidity, 1) +
+                             measure.getCorrectedTempHum(snapshot, Measurements::Humidity, 2)) /
                             2.0f);
   }
 
   // Add measurements that valid to the metrics
-  if (config.hasSensorPMS1 || config.hasSensorPMS2) {
-    if (utils::isValidPm(pm01)) {
-      add_metric("pm1",
-                 "PM1.0 concentration as measured by the AirGradient PMS "
-                 "sensor, in micrograms per cubic meter",
-                 "gauge", "ugm3");
-      add_metric_point("", String(pm01));
-    }
-    if (utils::isValidPm(pm25)) {
-      add_metric("pm2d5",
-                 "PM2.5 concentration as measured by the AirGradient PMS "
-                 "sensor, in micrograms per cubic meter",
-                 "gauge", "ugm3");
-      add_metric_point("", String(pm25));
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    const Measurements::MeasurementDescriptor &desc =
+        Measurements::descriptor((Measurements::MeasurementType)i);
+    if (desc.metricName == nullptr) {
+      continue;
     }
-    if (utils::isValidPm(pm10)) {
-      add_metric("pm10",
-                 "PM10 concentration as measured by the AirGradient PMS "
-                 "sensor, in micrograms per cubic meter",
-                 "gauge", "ugm3");
-      add_metric_point("", String(pm10));
-    }
-    if (utils::isValidPm03Count(pm03PCount)) {
-      add_metric("pm0d3",
-                 "PM0.3 concentration as measured by the AirGradient PMS "
-                 "sensor, in number of particules per 100 milliliters",
-                 "gauge", "p100ml");
-      add_metric_point("", String(pm03PCount));
+    // Integer measurements are reported without decimal
+    float value = desc.isFloat ? values[i] : (int)values[i];
+    if (desc.isValid(value)) {
+      add_metric(desc.metricName, desc.metricHelp, "gauge", desc.metricUnit);
+      add_metric_point("", desc.isFloat ? String(value) : String((int)value));
     }
   }
 
-  if (config.hasSensorSGP) {
-    if (utils::isValidVOC(tvoc)) {
-      add_metric("tvoc_index",
-                 "The processed Total Volatile Organic Compounds (TVOC) index "
-                 "as measured by the AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(tvoc));
-    }
-    if (utils::isValidVOC(tvocRaw)) {
-      add_metric("tvoc_raw",
-                 "The raw input value to the Total Volatile Organic Compounds "
-                 "(TVOC) index as measured by the AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(tvocRaw));
-    }
-    if (utils::isValidNOx(nox)) {
-      add_metric("nox_index",
-                 "The processed Nitrogen Oxide (NOx) index as measured by the "
-                 "AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(nox));
-    }
-    if (utils::isValidNOx(noxRaw)) {
-      add_metric("nox_raw",
-                 "The raw input value to the Nitrogen Oxide (NOx) index as "
-                 "measured by the AirGradient SGP sensor",
-                 "gauge");
-      add_metric_point("", String(noxRaw));
-    }
-  }
-
-  if (utils::isValidCO2(co2)) {
-    add_metric("co2",
-               "Carbon dioxide concentration as measured by the AirGradient S8 "
-               "sensor, in parts per million",
-               "gauge", "ppm");
-    add_metric_point("", String(co2));
-  }
-
-  if (utils::isValidTemperature(_temp)) {
-    add_metric("temperature",
-               "The ambient temperature as measured by the AirGradient SHT / PMS "
-               "sensor, in degrees Celsius",
-               "gauge", "celsius");
-    add_metric_point("", String(_temp));
-  }
   if (utils::isValidTemperature(atmpCompensated)) {
     add_metric("temperature_compensated",
                "The compensated ambient temperature as measured by the AirGradient SHT / PMS "
@@ -238,11 +184,6 @@ String OpenMetrics::getPayload(void) {
                "gauge", "celsius");
     add_metric_point("", String(atmpCompensated));
   }
-  if (utils::isValidHumidity(_hum)) {
-    add_metric("humidity", "The relative humidity as measured by the AirGradient SHT sensor",
-               "gauge", "percent");
-    add_metric_point("", String(_hum));
-  }
   if (utils::isValidHumidity(rhumCompensated)) {
     add_metric("humidity_compensated",
                "The compensated relative humidity as measured by the AirGradient SHT / PMS sensor",
@@ -250,6 +191,61 @@ String OpenMetrics::getPayload(void) {
     add_metric_point("", String(rhumCompensated));
   }
 
+  if (config.hasSensorPMS1 && config.hasSensorPMS2) {
+    const Measurements::Fusion::Status &fusion = snapshot.pmsFusion;
+    add_metric("pms_confidence",
+               "Confidence in the PM values combined from every PMS channel, from 0 to 1",
+               "gauge");
+    add_metric_point("", String(fusion.confidence));
+    add_metric("pms_health", "Health of each PMS channel: 0 ok, 1 suspect, 2 faulty", "gauge");
+    for (int i = 0; i < MEASUREMENT_CHANNELS; i++) {
+      add_metric_point("channel=\"" + String(i + 1) + "\"", String((int)fusion.health[i]));
+    }
+  }
+
+  // Statistics of the samples of every measurement moving average window
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    const Measurements::MeasurementDescriptor &desc =
+        Measurements::descriptor((Measurements::MeasurementType)i);
+    if (desc.metricName == nullptr) {
+      continue;
+    }
+    bool hasSamples = false;
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      hasSamples |= Measurements::statisticsOf(snapshot, desc.type, ch).count > 0;
+    }
+    if (!hasSamples) {
+      continue;
+    }
+
+    add_metric(String(desc.metricName) + "_window",
+               "Mean, standard deviation, minimum and maximum of the " + String(desc.name) +
+                   " samples in the moving average window",
+               "gauge", desc.metricUnit);
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      const Measurements::Statistics &statistics =
+          Measurements::statisticsOf(snapshot, desc.type, ch);
+      if (statistics.count > 0) {
+        String channel = "channel=\"" + String(ch) + "\",statistic=";
+        add_metric_point(channel + "\"mean\"", String(statistics.mean));
+        add_metric_point(channel + "\"stddev\"", String(statistics.stddev));
+        add_metric_point(channel + "\"min\"", String(statistics.min));
+        add_metric_point(channel + "\"max\"", String(statistics.max));
+      }
+    }
+
+    add_metric(String(desc.metricName) + "_window_samples",
+               "Number of " + String(desc.name) + " samples in the moving average window",
+               "gauge");
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      const Measurements::Statistics &statistics =
+          Measurements::statisticsOf(snapshot, desc.type, ch);
+      if (statistics.count > 0) {
+        add_metric_point("channel=\"" + String(ch) + "\"", String(statistics.count));
+      }
+    }
+  }
+
   response += "# EOF\n";
   return response;
 }
@@ -3,11 +3,7 @@
 #include "AirGradient.h"
 #include "Libraries/Arduino_JSON/src/Arduino_JSON.h"
 #ifdef ESP8266
-#include <ESP8266HTTPClient.h>
 #include <ESP8266WiFi.h>
-#include <WiFiClient.h>
-#else
-#include <HTTPClient.h>
 #endif
 
 AgApiClient::AgApiClient(Stream &debug, Configuration &config)
@@ -22,6 +18,7 @@ AgApiClient::~AgApiClient() {}
 void AgApiClient::begin(void) {
   getConfigFailed = false;
   postToServerFailed = false;
+  http.setReuse(true);
   logInfo("Init apiRoot: " + apiRoot);
   logInfo("begin");
 }
@@ -37,43 +34,45 @@ bool AgApiClient::fetchServerConfiguration(void) {
   String uri = apiRoot + "/sensors/airgradient:" +
                ag->deviceId() + "/one/config";
 
-  /** Init http client */
-#ifdef ESP8266
-  HTTPClient client;
-  WiFiClient wifiClient;
-  if (client.begin(wifiClient, uri) == false) {
-    getConfigFailed = true;
-    return false;
-  }
-#else
-  HTTPClient client;
-  client.setConnectTimeout(timeoutMs); // Set timeout when establishing connection to server
-  client.setTimeout(timeoutMs); // Timeout when waiting for response from AG server
-  if (apiRootChanged) {
-    // If apiRoot is changed, assume not using https
-    if (client.begin(uri) == false) {
+  int retCode;
+  bool reused;
+  do {
+    /** Init http client */
+    if (beginRequest(uri, reused) == false) {
       logError("Begin HTTPClient failed (GET)");
       getConfigFailed = true;
       return false;
     }
-  } else {
-    // By default, airgradient using https
-    if (client.begin(uri, AG_SERVER_ROOT_CA) == false) {
-      logError("Begin HTTPClient using tls failed (GET)");
-      getConfigFailed = true;
-      return false;
+
+    /** Server answers 304 without content if configuration didn't change since the last applied */
+    if (config.isRemoteConfigCurrent()) {
+      if (configEtag.length() > 0) {
+        http.addHeader("If-None-Match", configEtag);
+      }
+      if (configLastModified.length() > 0) {
+        http.addHeader("If-Modified-Since", configLastModified);
+      }
     }
-  }
-#endif
+    const char *headers[] = {"ETag", "Last-Modified"};
+    http.collectHeaders(headers, 2);
 
-  /** Get data */
-  int retCode = client.GET();
+    /** Get data */
+    retCode = http.GET();
 
-  logInfo(String("GET: ") + uri);
-  logInfo(String("Return code: ") + String(retCode));
+    logInfo(String("GET: ") + uri);
+    logInfo(String("Return code: ") + String(retCode));
+  } while (retryRequest(retCode, reused));
+
+  /** Return code 304 mean configuration not modified */
+  if (retCode == 304) {
+    http.end();
+    getConfigFailed = false;
+    notAvailableOnDashboard = false;
+    return true;
+  }
 
   if (retCode != 200) {
-    client.end();
+    closeConnection();
     getConfigFailed = true;
 
     /** Return code 400 mean device not setup on cloud. */
@@ -88,11 +87,20 @@ bool AgApiClient::fetchServerConfiguration(void) {
   notAvailableOnDashboard = false;
 
   /** Get response string */
-  String respContent = client.getString();
-  client.end();
+  String respContent = http.getString();
+  String etag = http.header("ETag");
+  String lastModified = http.header("Last-Modified");
+  http.end();
 
   /** Parse configuration and return result */
-  return config.parse(respContent, false);
+  if (config.parse(respContent, false) == false) {
+    configEtag = "";
+    configLastModified = "";
+    return false;
+  }
+  configEtag = etag;
+  configLastModified = lastModified;
+  return true;
 }
 
 /**
@@ -105,50 +113,97 @@ bool AgApiClient::fetchServerConfiguration(void) {
  */
 bool AgApiClient::postToServer(String data) {
   String uri = apiRoot + "/sensors/airgradient:" + ag->deviceId() + "/measures";
-#ifdef ESP8266
-  HTTPClient client;
-  WiFiClient wifiClient;
-  if (client.begin(wifiClient, uri) == false) {
-    getConfigFailed = true;
-    return false;
-  }
-#else
-  HTTPClient client;
-  client.setConnectTimeout(timeoutMs); // Set timeout when establishing connection to server
-  client.setTimeout(timeoutMs); // Timeout when waiting for response from AG server
-  if (apiRootChanged) {
-    // If apiRoot is changed, assume not using https
-    if (client.begin(uri) == false) {
+  int retCode;
+  bool reused;
+  do {
+    if (beginRequest(uri, reused) == false) {
       logError("Begin HTTPClient failed (POST)");
       getConfigFailed = true;
       return false;
     }
-  } else {
-    // By default, airgradient using https
-    if (client.begin(uri, AG_SERVER_ROOT_CA) == false) {
-      logError("Begin HTTPClient using tls failed (POST)");
-      getConfigFailed = true;
-      return false;
-    }
-  }
-#endif
-  client.addHeader("content-type", "application/json");
-  int retCode = client.POST(data);
-  client.end();
+    http.addHeader("content-type", "application/json");
+    retCode = http.POST(data);
 
-  logInfo(String("POST: ") + uri);
-  logInfo(String("Return code: ") + String(retCode));
+    logInfo(String("POST: ") + uri);
+    logInfo(String("Return code: ") + String(retCode));
+  } while (retryRequest(retCode, reused));
 
   if ((retCode == 200) || (retCode == 429)) {
+    http.end();
     postToServerFailed = false;
     return true;
   } else {
+    closeConnection();
     logError("Post response failed code: " + String(retCode));
   }
   postToServerFailed = true;
   return false;
 }
 
+/**
+ * @brief Begin a request on the connection left open by the previous one, or on a new one
+ *
+ * @param uri request URI
+ * @param reused set to true if the connection of a previous request is reused
+ * @return true Success
+ * @return false Failure
+ */
+bool AgApiClient::beginRequest(const String &uri, bool &reused) {
+  http.setTimeout(timeoutMs); // Timeout when waiting for response from AG server
+#ifndef ESP8266
+  http.setConnectTimeout(timeoutMs); // Set timeout when establishing connection to server
+  if (!apiRootChanged) {
+    // By default, airgradient using https. HTTPClient opens its TLS connection for this request
+    // and closes it on end()
+    reused = false;
+    if (http.begin(uri, AG_SERVER_ROOT_CA) == false) {
+      return false;
+    }
+    connections++;
+    return true;
+  }
+  // If apiRoot is changed, assume not using https
+#endif
+  if (http.begin(plainClient, uri) == false) {
+    return false;
+  }
+
+  reused = plainClient.connected();
+  if (reused) {
+    connectionReuses++;
+  } else {
+    connections++;
+  }
+  return true;
+}
+
+/**
+ * @brief Check if a failed request must be sent again. Server can close an idle connection at
+ * any time, a request sent on a reused connection is tried once more on a new one
+ *
+ * @param retCode return code of the request
+ * @param reused true if the request was sent on a reused connection
+ * @return true Send it again
+ * @return false Done
+ */
+bool AgApiClient::retryRequest(int retCode, bool reused) {
+  // Negative codes are connection errors, server didn't answer
+  if (retCode >= 0 || !reused) {
+    return false;
+  }
+  logWarning("Reused connection failed, retry on a new connection");
+  closeConnection();
+  return true;
+}
+
+/**
+ * @brief Close the connection, response might not be fully read
+ */
+void AgApiClient::closeConnection(void) {
+  http.end();
+  plainClient.stop();
+}
+
 /**
  * @brief Get failed status when get configuration from AirGradient cloud
  *
@@ -201,8 +256,11 @@ bool AgApiClient::sendPing(int rssi, int bootCount) {
 String AgApiClient::getApiRoot() const { return apiRoot; }
 
 void AgApiClient::setApiRoot(const String &apiRoot) {
+  closeConnection();
   this->apiRootChanged = true;
   this->apiRoot = apiRoot;
+  this->configEtag = "";
+  this->configLastModified = "";
 }
 
 /**
@@ -212,4 +270,14 @@ void AgApiClient::setApiRoot(const String &apiRoot) {
  */
 void AgApiClient::setTimeout(uint16_t timeoutMs) {
   this->timeoutMs = timeoutMs;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Get number of requests that opened a new connection, with a TLS handshake on https
+ */
+uint32_t AgApiClient::getConnections(void) { return connections; }
+
+/**
+ * @brief Get number of requests sent on the connection left open by a previous request
+ */
+uint32_t AgApiClient::getConnectionReuses(void) { return connectionReuses; }
@@ -15,6 +15,12 @@
 #include "AirGradient.h"
 #include "Main/PrintLog.h"
 #include <Arduino.h>
+#ifdef ESP8266
+#include <ESP8266HTTPClient.h>
+#include <WiFiClient.h>
+#else
+#include <HTTPClient.h>
+#endif
 
 class AgApiClient : public PrintLog {
 private:
@@ -32,6 +38,21 @@ private:
   bool postToServerFailed;
   bool notAvailableOnDashboard = false; // Device not setup on Airgradient cloud dashboard.
   uint16_t timeoutMs = 15000;           // Default set to 15s
+  String configEtag;         // ETag of the last configuration applied, empty if none
+  String configLastModified; // Last-Modified of the last configuration applied, empty if none
+
+  // Plain http connection kept open between requests, HTTPClient closes it on destruction so
+  // it's kept too. Only the DIY examples (ESP8266) use this client, so it saves the TCP
+  // connection setup there. https requests on ESP32 still open a TLS connection each, owned by
+  // HTTPClient. OneOpenAir posts through the airgradient-client library instead
+  HTTPClient http;
+  WiFiClient plainClient;
+  uint32_t connections = 0;      // Requests that opened a new connection
+  uint32_t connectionReuses = 0; // Requests sent on the connection of a previous one
+
+  bool beginRequest(const String &uri, bool &reused);
+  bool retryRequest(int retCode, bool reused);
+  void closeConnection(void);
 
 public:
   AgApiClient(Stream &stream, Configuration &config);
@@ -49,6 +70,8 @@ public:
   String getApiRoot() const;
   void setApiRoot(const String &apiRoot);
   void setTimeout(uint16_t timeoutMs);
+  uint32_t getConnections(void);
+  uint32_t getConnectionReuses(void);
 };
 
 #endif /** _AG_API_CLIENT_H_ */
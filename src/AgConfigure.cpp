@@ -1,15 +1,76 @@
 #include "AgConfigure.h"
+#include "AgValue.h"
 #if ESP32
 #include "FS.h"
 #include "SPIFFS.h"
 #else
 #include "EEPROM.h"
 #endif
+#include <stddef.h>
 #include <time.h>
 
 #define EEPROM_CONFIG_SIZE 1024
 #define CONFIG_FILE_NAME "/AgConfigure_Configuration.json"
 
+/** Time without configuration change before it is saved, so changes in a row are written once */
+#define CONFIG_SAVE_QUIET_PERIOD 5000
+/** Maximum time a configuration change waits to be saved, when it keeps changing */
+#define CONFIG_SAVE_MAX_DELAY 30000
+
+#ifdef ESP32
+/** Mark of a configuration image file */
+#define CONFIG_IMAGE_MAGIC 0x47434741
+/**
+ * Configuration image format, increment when the meaning of a Configuration::Values member
+ * change. Layout changes are part of the format, see configImageFormat()
+ */
+#define CONFIG_IMAGE_FORMAT 2
+/** Larger JSON length means the image header is corrupted */
+#define CONFIG_IMAGE_JSON_MAX 8192
+
+// Configuration images are written alternately, so the previous one is still there if the device
+// loses power while the newest is written
+static const char *CONFIG_IMAGE_FILE_NAMES[] = {"/AgConfigure_Config_A.bin",
+                                                "/AgConfigure_Config_B.bin"};
+
+/**
+ * Header of a configuration image file, followed by the Configuration::Values then the JSON
+ * configuration without terminator. Values, nested configuration included, are loaded as they
+ * are. JSON is only parsed once the configuration is changed or exported, and to load the image
+ * of a firmware with another format
+ */
+struct ConfigImageHeader {
+  uint32_t magic;      // CONFIG_IMAGE_MAGIC
+  uint16_t format;     // configImageFormat() of the firmware that saved it
+  uint16_t valuesSize; // sizeof(Configuration::Values) of the firmware that saved it
+  uint32_t sequence;   // Incremented on every save, the newest valid image is loaded
+  uint32_t jsonLength;
+  uint32_t crc; // CRC32 of the previous members, values and JSON
+};
+
+/** FNV-1a of a string and of a number, byte by byte */
+static constexpr uint32_t fnv1a(const char *text, uint32_t hash) {
+  return *text == 0 ? hash : fnv1a(text + 1, (hash ^ (uint8_t)*text) * 16777619u);
+}
+static constexpr uint32_t fnv1a(uint32_t value, int bytes, uint32_t hash) {
+  return bytes == 0 ? hash : fnv1a(value >> 8, bytes - 1, (hash ^ (value & 0xff)) * 16777619u);
+}
+
+// Declaration, offset and size of every Configuration::Values member in order, hashed into
+// the image format
+#define CONFIGURATION_VALUES_LAYOUT(type, name, extent)                                            \
+  hash = fnv1a(#type " " #name #extent, hash);                                                     \
+  hash = fnv1a(offsetof(Configuration::Values, name), 4, hash);                                    \
+  hash = fnv1a(sizeof(Configuration::Values::name), 4, hash);
+
+/** Format saved in the image header, CONFIG_IMAGE_FORMAT and the layout of the Values */
+static uint16_t configImageFormat(void) {
+  uint32_t hash = fnv1a(CONFIG_IMAGE_FORMAT, 4, 2166136261u);
+  CONFIGURATION_VALUES(CONFIGURATION_VALUES_LAYOUT)
+  return hash ^ (hash >> 16);
+}
+#endif
+
 const char *CONFIGURATION_CONTROL_NAME[] = {
     [ConfigurationControlLocal] = "local",
     [ConfigurationControlCloud] = "cloud",
@@ -37,6 +98,20 @@ const char *TEMP_HUM_CORRECTION_ALGORITHM_NAMES[] = {
     [COR_ALGO_TEMP_HUM_SLR_CUSTOM] = "custom",
 };
 
+const char *MEASUREMENT_FILTER_MODE_NAMES[] = {
+    [MEASUREMENT_FILTER_UNKNOWN] = "-", // This is only to pass "non-trivial designated initializers" error
+    [MEASUREMENT_FILTER_MEAN] = "mean",
+    [MEASUREMENT_FILTER_MEDIAN] = "median",
+    [MEASUREMENT_FILTER_HAMPEL] = "hampel",
+};
+
+const char *REPORTING_MODE_NAMES[] = {
+    [REPORTING_MODE_UNKNOWN] = "-", // This is only to pass "non-trivial designated initializers" error
+    [REPORTING_MODE_INTERVAL] = "interval",
+    [REPORTING_MODE_ON_CHANGE] = "onChange",
+    [REPORTING_MODE_DELTA] = "delta",
+};
+
 #define JSON_PROP_NAME(name) jprop_##name
 #define JSON_PROP_DEF(name) const char *JSON_PROP_NAME(name) = #name
 
@@ -64,6 +139,12 @@ JSON_PROP_DEF(atmp);
 JSON_PROP_DEF(rhum);
 JSON_PROP_DEF(extendedPmMeasures);
 JSON_PROP_DEF(satellites);
+JSON_PROP_DEF(measurementFilters);
+JSON_PROP_DEF(windowStatistics);
+JSON_PROP_DEF(reportingMode);
+JSON_PROP_DEF(reportingHeartbeat);
+JSON_PROP_DEF(reportingDeadbands);
+JSON_PROP_DEF(postBatchSize);
 JSON_PROP_DEF(cellOperators);
 JSON_PROP_DEF(cellOperatorId);
 
@@ -85,11 +166,32 @@ JSON_PROP_DEF(cellOperatorId);
 #define jprop_offlineMode_default                     false
 #define jprop_monitorDisplayCompensatedValues_default false
 #define jprop_extendedPmMeasures_default              false
+#define jprop_windowStatistics_default                false
+#define jprop_reportingMode_default                   REPORTING_MODE_NAMES[REPORTING_MODE_INTERVAL]
+#define jprop_reportingHeartbeat_default              900
+#define jprop_postBatchSize_default                   1
 #define jprop_cellOperators_default                   ""
 #define jprop_cellOperatorId_default                  0
 
 JSONVar jconfig;
 
+static_assert(CONFIGURATION_MEASUREMENTS == Measurements::_MEASUREMENT_TYPE_MAX,
+              "CONFIGURATION_MEASUREMENTS must be the MeasurementType count");
+
+/**
+ * @brief Get the MeasurementType of a measurement JSON key
+ *
+ * @return int type, -1 if no measurement has this key
+ */
+static int measurementOfKey(const String &key) {
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    if (key == Measurements::descriptor((Measurements::MeasurementType)i).jsonKey) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 static bool jsonTypeInvalid(JSONVar root, String validType) {
   String type = JSON.typeof_(root);
   if (type == validType || type == "undefined" || type == "unknown" ||
@@ -99,6 +201,16 @@ static bool jsonTypeInvalid(JSONVar root, String validType) {
   return true;
 }
 
+/**
+ * @brief Get member names of a JSON object, JSONVar::keys() crash on object without member
+ */
+static JSONVar jsonObjectKeys(JSONVar &object) {
+  if (JSON.stringify(object) == "{}") {
+    return JSON.parse("[]");
+  }
+  return object.keys();
+}
+
 /**
  * @brief Get LedBarMode Name
  *
@@ -156,6 +268,32 @@ TempHumCorrectionAlgorithm Configuration::matchTempHumAlgorithm(String algorithm
   return result;
 }
 
+MeasurementFilterMode Configuration::matchMeasurementFilterMode(String mode) {
+  const size_t enumSize = sizeof(MEASUREMENT_FILTER_MODE_NAMES) / sizeof(MEASUREMENT_FILTER_MODE_NAMES[0]);
+  MeasurementFilterMode result = MEASUREMENT_FILTER_UNKNOWN;
+
+  for (size_t enumVal = 0; enumVal < enumSize; enumVal++) {
+    if (mode == MEASUREMENT_FILTER_MODE_NAMES[enumVal]) {
+      result = static_cast<MeasurementFilterMode>(enumVal);
+    }
+  }
+
+  return result;
+}
+
+ReportingMode Configuration::matchReportingMode(String mode) {
+  const size_t enumSize = sizeof(REPORTING_MODE_NAMES) / sizeof(REPORTING_MODE_NAMES[0]);
+  ReportingMode result = REPORTING_MODE_UNKNOWN;
+
+  for (size_t enumVal = 0; enumVal < enumSize; enumVal++) {
+    if (mode == REPORTING_MODE_NAMES[enumVal]) {
+      result = static_cast<ReportingMode>(enumVal);
+    }
+  }
+
+  return result;
+}
+
 bool Configuration::updatePmCorrection(JSONVar &json) {
   if (!json.hasOwnProperty("corrections")) {
     logInfo("corrections not found");
@@ -231,8 +369,11 @@ bool Configuration::updatePmCorrection(JSONVar &json) {
     return false; // No changes needed
   }
 
-  // Deep copy corrections from root to jconfig, so it will be saved later
-  jconfig[jprop_corrections] = corrections;
+  // Deep copy corrections from root to jconfig, so it will be saved later. Loaded from jconfig
+  // itself they are there already, replacing them would free the object being copied
+  if (&json != &jconfig) {
+    jconfig[jprop_corrections] = corrections;
+  }
 
   // Update pmCorrection with new values
   pmCorrection.algorithm = algo;
@@ -313,8 +454,11 @@ bool Configuration::updateTempHumCorrection(JSONVar &json, TempHumCorrection &ta
     return false; // No changes needed
   }
 
-  // Deep copy corrections from root to jconfig, so it will be saved later
-  jconfig[jprop_corrections] = corrections;
+  // Deep copy corrections from root to jconfig, so it will be saved later. Loaded from jconfig
+  // itself they are there already, replacing them would free the object being copied
+  if (&json != &jconfig) {
+    jconfig[jprop_corrections] = corrections;
+  }
 
   // Update target with new values
   target.algorithm = algo;
@@ -418,47 +562,235 @@ void Configuration::emptySatellites() {
 }
 
 /**
- * @brief Save configure to device storage (EEPROM)
+ * @brief Update measurement filter table from JSON object of measurement name to filter mode
+ *
+ * Entries with unknown mode, or not a measurement JSON key, are not kept, measurements not
+ * listed use mean. Caller is responsible to copy the object to jconfig.
+ *
+ * @param filters JSON object, ex: {"pm02":"hampel"}
+ * @return true if table changed
+ */
+bool Configuration::updateMeasurementFilters(JSONVar &filters) {
+  MeasurementFilterMode updated[CONFIGURATION_MEASUREMENTS];
+  for (int i = 0; i < CONFIGURATION_MEASUREMENTS; i++) {
+    updated[i] = MEASUREMENT_FILTER_MEAN;
+  }
+  int count = 0;
+
+  JSONVar keys = jsonObjectKeys(filters);
+  for (int i = 0; i < keys.length(); i++) {
+    String measurement = keys[i];
+    if (JSON.typeof_(filters[measurement]) != "string") {
+      continue;
+    }
+    MeasurementFilterMode mode = matchMeasurementFilterMode(filters[measurement]);
+    if (mode == MEASUREMENT_FILTER_UNKNOWN || mode == MEASUREMENT_FILTER_MEAN) {
+      continue;
+    }
+    int type = measurementOfKey(measurement);
+    if (type < 0) {
+      logWarning("Unknown measurement filter measurement, ignored: " + measurement);
+      continue;
+    }
+    updated[type] = mode;
+    count++;
+  }
+
+  if (memcmp(updated, _measurementFilters, sizeof(updated)) == 0) {
+    return false;
+  }
+  memcpy(_measurementFilters, updated, sizeof(updated));
+  logInfo(String(count) + " measurement filter(s) configured");
+  return true;
+}
+
+/**
+ * @brief Set every measurement to its default reporting deadband, absolute only
+ */
+void Configuration::defaultReportingDeadbands(ReportingDeadband *deadbands) {
+  for (int i = 0; i < CONFIGURATION_MEASUREMENTS; i++) {
+    deadbands[i].absolute = Measurements::descriptor((Measurements::MeasurementType)i).deadband;
+    deadbands[i].relative = 0;
+  }
+}
+
+/**
+ * @brief Update reporting deadbands table from JSON object
  *
+ * Entries that are not an object with numeric absolute and relative members, or not a
+ * measurement JSON key, are not kept, they use the measurement default deadband. Caller is
+ * responsible to copy the object to jconfig.
+ *
+ * @param deadbands JSON object, ex: {"pm02":{"absolute":1,"relative":0.1}}
+ * @return true if table changed
+ */
+bool Configuration::updateReportingDeadbands(JSONVar &deadbands) {
+  ReportingDeadband updated[CONFIGURATION_MEASUREMENTS];
+  defaultReportingDeadbands(updated);
+  int count = 0;
+
+  JSONVar keys = jsonObjectKeys(deadbands);
+  for (int i = 0; i < keys.length(); i++) {
+    String measurement = keys[i];
+    JSONVar deadband = deadbands[measurement];
+    if (JSON.typeof_(deadband) != "object" || JSON.typeof_(deadband["absolute"]) != "number" ||
+        JSON.typeof_(deadband["relative"]) != "number") {
+      continue;
+    }
+    int type = measurementOfKey(measurement);
+    if (type < 0) {
+      logWarning("Unknown reporting deadband measurement, ignored: " + measurement);
+      continue;
+    }
+    updated[type].absolute = (double)deadband["absolute"];
+    updated[type].relative = (double)deadband["relative"];
+    count++;
+  }
+
+  if (memcmp(updated, _reportingDeadbands, sizeof(updated)) == 0) {
+    return false;
+  }
+  memcpy(_reportingDeadbands, updated, sizeof(updated));
+  logInfo(String(count) + " reporting deadband(s) configured");
+  return true;
+}
+
+/**
+ * @brief Request to save configure to device storage, it's written by handle() once it stopped
+ * changing. Call every time the JSON configuration is changed
  */
 void Configuration::saveConfig(void) {
+  lock();
+  _remoteConfigCurrent = false;
+  uint32_t now = millis();
+  if (!_savePending) {
+    _savePending = true;
+    _savePendingSince = now;
+  }
+  _saveChangedAt = now;
+  unlock();
+}
+
+/**
+ * @brief Save configure to device storage (EEPROM, configuration image on ESP32) if its content
+ * changed since the last save
+ *
+ */
+void Configuration::writeConfig(void) {
+#ifdef ESP8266
   String data = toString();
   int len = data.length();
-#ifdef ESP8266
+  uint32_t crc = utils::crc32(data.c_str(), len);
+  if (_savedCrcValid && crc == _savedCrc) {
+    _flashWritesSkipped++;
+    logInfo("Save Config skipped, unchanged");
+    return;
+  }
   for (int i = 0; i < len; i++) {
     EEPROM.write(i, data[i]);
   }
-  EEPROM.commit();
+  // Commit erase and write the whole EEPROM flash sector
+  if (!EEPROM.commit()) {
+    logError("Commit EEPROM failed");
+    return;
+  }
+  _savedCrc = crc;
+  _savedCrcValid = true;
 #else
-  File file = SPIFFS.open(CONFIG_FILE_NAME, "w", true);
-  if (file && !file.isDirectory()) {
-    if (file.write((const uint8_t *)data.c_str(), len) != len) {
-      logError("Write SPIFFS file failed");
-    }
-    file.close();
-  } else {
-    logError("Open SPIFFS file to write failed");
+  if (!saveConfigImage()) {
+    return;
+  }
+#endif
+  _flashWrites++;
+  logInfo("Save Config, " + String(_flashWrites) + " writes since boot");
+}
+
+/**
+ * @brief Save the configuration changes once it stopped changing for CONFIG_SAVE_QUIET_PERIOD, or
+ * CONFIG_SAVE_MAX_DELAY after the oldest change. Call from the main loop
+ */
+void Configuration::handle(void) {
+  if (!_savePending) {
+    return;
+  }
+  uint32_t now = millis();
+  if ((now - _saveChangedAt) < CONFIG_SAVE_QUIET_PERIOD &&
+      (now - _savePendingSince) < CONFIG_SAVE_MAX_DELAY) {
+    return;
+  }
+  flush();
+}
+
+/**
+ * @brief Save the configuration changes now, ex: before restarting the device
+ */
+void Configuration::flush(void) {
+  lock();
+  if (_savePending) {
+    _savePending = false;
+    writeConfig();
+  }
+  unlock();
+}
+
+/**
+ * @brief Number of configuration writes to flash since boot, each EEPROM write erases a flash
+ * sector on ESP8266
+ */
+uint32_t Configuration::getFlashWrites(void) { return _flashWrites; }
+
+/**
+ * @brief Number of configuration saves skipped since boot as the content was unchanged
+ */
+uint32_t Configuration::getFlashWritesSkipped(void) { return _flashWritesSkipped; }
+
+void Configuration::lock(void) {
+#ifdef ESP32
+  if (_mutex) {
+    xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+  }
+#endif
+}
+
+void Configuration::unlock(void) {
+#ifdef ESP32
+  if (_mutex) {
+    xSemaphoreGiveRecursive(_mutex);
   }
 #endif
-  logInfo("Save Config");
 }
 
 void Configuration::loadConfig(void) {
+#ifdef ESP8266
   char *buf = (char *)malloc(EEPROM_CONFIG_SIZE);
   if (buf == NULL) {
     logError("Malloc read file buffer failed");
     return;
   }
   memset(buf, 0, EEPROM_CONFIG_SIZE);
-#ifdef ESP8266
   for (int i = 0; i < EEPROM_CONFIG_SIZE; i++) {
     buf[i] = EEPROM.read(i);
   }
 #else
+  if (loadConfigImage()) {
+    return;
+  }
+
+  // No valid image, first boot or configuration saved as JSON by a previous firmware
   File file = SPIFFS.open(CONFIG_FILE_NAME);
+  size_t size = (file && !file.isDirectory()) ? file.size() : 0;
+  char *buf = (char *)malloc(size + 1);
+  if (buf == NULL) {
+    logError("Malloc read file buffer failed");
+    if (file) {
+      file.close();
+    }
+    return;
+  }
+  memset(buf, 0, size + 1);
   if (file && !file.isDirectory()) {
     logInfo("Reading file...");
-    if(file.readBytes(buf, file.size()) != file.size()) {
+    if(file.readBytes(buf, size) != size) {
       logError("Reading file: failed - size not match");
     } else {
       logInfo("Reading file: success");
@@ -470,13 +802,181 @@ void Configuration::loadConfig(void) {
 #endif
   toConfig(buf);
   free(buf);
+
+#ifdef ESP32
+  // Configuration is kept in the images from now on
+  _savePending = false;
+  if (saveConfigImage() && SPIFFS.exists(CONFIG_FILE_NAME)) {
+    SPIFFS.remove(CONFIG_FILE_NAME);
+  }
+#endif
+}
+
+#ifdef ESP32
+/**
+ * @brief Read and check the header of a configuration image file
+ *
+ * @return true Header valid and file size match, the body still has to be checked
+ */
+static bool readConfigImageHeader(int slot, ConfigImageHeader &header) {
+  File file = SPIFFS.open(CONFIG_IMAGE_FILE_NAMES[slot]);
+  if (!file || file.isDirectory()) {
+    return false;
+  }
+  bool valid = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+               header.magic == CONFIG_IMAGE_MAGIC && header.jsonLength <= CONFIG_IMAGE_JSON_MAX &&
+               file.size() == sizeof(header) + header.valuesSize + header.jsonLength;
+  file.close();
+  return valid;
+}
+
+/**
+ * @brief Read the body of a configuration image file, Values then JSON
+ *
+ * @return char* body terminated by a null character, to free. NULL if it can't be read or the
+ * CRC doesn't match
+ */
+static char *readConfigImageBody(int slot, const ConfigImageHeader &header) {
+  size_t size = header.valuesSize + header.jsonLength;
+  char *body = (char *)malloc(size + 1);
+  if (body == NULL) {
+    return NULL;
+  }
+
+  File file = SPIFFS.open(CONFIG_IMAGE_FILE_NAMES[slot]);
+  bool valid = file && file.seek(sizeof(header)) && file.read((uint8_t *)body, size) == size;
+  if (file) {
+    file.close();
+  }
+  if (valid) {
+    uint32_t crc = utils::crc32(&header, offsetof(ConfigImageHeader, crc));
+    valid = utils::crc32(body, size, crc) == header.crc;
+  }
+  if (!valid) {
+    free(body);
+    return NULL;
+  }
+  body[size] = 0;
+  return body;
+}
+
+/**
+ * @brief Load the newest valid configuration image, older one is loaded if the newest is
+ * corrupted (ex: device lost power while it was written)
+ *
+ * @return true Loaded
+ * @return false No valid image, configuration is unchanged
+ */
+bool Configuration::loadConfigImage(void) {
+  ConfigImageHeader headers[2];
+  bool valid[2];
+  for (int slot = 0; slot < 2; slot++) {
+    valid[slot] = readConfigImageHeader(slot, headers[slot]);
+  }
+
+  // Newest first, sequence wraps around
+  int newest = 0;
+  if (valid[1] && (!valid[0] || (int32_t)(headers[1].sequence - headers[0].sequence) > 0)) {
+    newest = 1;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    int slot = (newest + i) % 2;
+    const ConfigImageHeader &header = headers[slot];
+    char *body = valid[slot] ? readConfigImageBody(slot, header) : NULL;
+    if (body == NULL) {
+      if (valid[slot] || SPIFFS.exists(CONFIG_IMAGE_FILE_NAMES[slot])) {
+        logWarning(String("Configuration image ") + CONFIG_IMAGE_FILE_NAMES[slot] + " corrupted");
+      }
+      continue;
+    }
+
+    // Next save goes to the other slot, so this image is kept until a newer one is complete
+    const char *json = body + header.valuesSize;
+    _imageSlot = slot;
+    _imageSequence = header.sequence;
+    if (header.format == configImageFormat() && header.valuesSize == sizeof(Values)) {
+      // Image was validated when saved, values are used as they are and JSON is kept unparsed
+      Values values;
+      memcpy(&values, body, sizeof(values));
+      publishValues(values);
+      restoreNestedConfig(values);
+      _imageJson = json;
+      _savedCrc = utils::crc32(body, header.valuesSize + header.jsonLength);
+      _savedCrcValid = true;
+    } else {
+      // Saved by another firmware, load it from JSON and save it again in this firmware format
+      logInfo("Configuration image format changed");
+      toConfig(json);
+      saveConfig();
+    }
+    free(body);
+    logInfo(String("Configuration image ") + CONFIG_IMAGE_FILE_NAMES[slot] + " loaded");
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Write the configuration image to the slot not holding the newest one
+ *
+ * @return true Success
+ * @return false Failure, newest image is unchanged
+ */
+bool Configuration::saveConfigImage(void) {
+  // Values published are the ones of the JSON, it doesn't have to be parsed to build them
+  String json = toString();
+  Values values = this->values();
+
+  // Content CRC, sequence excepted
+  uint32_t crc = utils::crc32(&values, sizeof(values));
+  crc = utils::crc32(json.c_str(), json.length(), crc);
+  if (_savedCrcValid && crc == _savedCrc) {
+    _flashWritesSkipped++;
+    logInfo("Save Config skipped, unchanged");
+    return false;
+  }
+
+  ConfigImageHeader header;
+  header.magic = CONFIG_IMAGE_MAGIC;
+  header.format = configImageFormat();
+  header.valuesSize = sizeof(values);
+  header.sequence = _imageSequence + 1;
+  header.jsonLength = json.length();
+  header.crc = utils::crc32(&header, offsetof(ConfigImageHeader, crc));
+  header.crc = utils::crc32(&values, sizeof(values), header.crc);
+  header.crc = utils::crc32(json.c_str(), json.length(), header.crc);
+
+  int slot = (_imageSlot + 1) % 2;
+  File file = SPIFFS.open(CONFIG_IMAGE_FILE_NAMES[slot], "w", true);
+  if (!file || file.isDirectory()) {
+    logError("Open SPIFFS file to write failed");
+    return false;
+  }
+  bool written =
+      file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+      file.write((const uint8_t *)&values, sizeof(values)) == sizeof(values) &&
+      file.write((const uint8_t *)json.c_str(), json.length()) == json.length();
+  file.close();
+  if (!written) {
+    logError("Write SPIFFS file failed");
+    return false;
+  }
+
+  _imageSlot = slot;
+  _imageSequence = header.sequence;
+  _savedCrc = crc;
+  _savedCrcValid = true;
+  return true;
 }
+#endif
 
 /**
  * @brief Set configuration default
  *
  */
 void Configuration::defaultConfig(void) {
+  _imageJson = "";
   jconfig = JSON.parse("{}");
 
   jconfig[jprop_country] = jprop_country_default;
@@ -503,16 +1003,18 @@ void Configuration::defaultConfig(void) {
   jconfig[jprop_offlineMode] = jprop_offlineMode_default;
   jconfig[jprop_monitorDisplayCompensatedValues] = jprop_monitorDisplayCompensatedValues_default;
   jconfig[jprop_extendedPmMeasures] = jprop_extendedPmMeasures_default;
+  jconfig[jprop_windowStatistics] = jprop_windowStatistics_default;
+  jconfig[jprop_reportingMode] = jprop_reportingMode_default;
+  jconfig[jprop_reportingHeartbeat] = jprop_reportingHeartbeat_default;
+  jconfig[jprop_postBatchSize] = jprop_postBatchSize_default;
   jconfig[jprop_cellOperators] = jprop_cellOperators_default;
   jconfig[jprop_cellOperatorId] = jprop_cellOperatorId_default;
 
-  // PM2.5 default correction
-  pmCorrection.algorithm = COR_ALGO_PM_NONE;
+  // Default corrections, filters and deadbands
+  defaultNestedConfig();
   pmCorrection.changed = false;
-  pmCorrection.intercept = 0;
-  pmCorrection.scalingFactor = 1;
-  pmCorrection.useEPA = false;
 
+  updateValues();
   saveConfig();
 }
 
@@ -531,7 +1033,14 @@ void Configuration::printConfig(void) {
  * @param debugLog Serial Stream
  */
 Configuration::Configuration(Stream &debugLog)
-    : PrintLog(debugLog, "Configure") {}
+    : PrintLog(debugLog, "Configure") {
+  // Tables read before the configuration is loaded hold their defaults
+  pmCorrection.changed = false;
+  tempCorrection.changed = false;
+  rhumCorrection.changed = false;
+  defaultNestedConfig();
+  buildNestedValues(_values[0]);
+}
 
 /**
  * @brief Destroy the Ag Configure:: Ag Configure object
@@ -547,6 +1056,12 @@ Configuration::~Configuration() {}
  */
 bool Configuration::begin(void) {
 #ifdef ESP32
+  _mutex = xSemaphoreCreateRecursiveMutex();
+  if (_mutex == NULL) {
+    logError("Create mutex failed");
+    return false;
+  }
+
   if (!SPIFFS.begin(true)) {
     logError("Init SPIFFS failed");
     return false;
@@ -575,6 +1090,40 @@ void Configuration::setConfigurationUpdatedCallback(ConfigurationUpdatedCallback
  * @return false Failure
  */
 bool Configuration::parse(String data, bool isLocal) {
+  lock();
+  // Server sends the same configuration on most fetches, nothing to do if it's still the one
+  // applied
+  uint32_t crc = 0;
+  if (!isLocal) {
+    crc = utils::crc32(data.c_str(), data.length());
+    if (_remoteConfigCurrent && crc == _remoteConfigCrc) {
+      failedMessage = "";
+      unlock();
+      logInfo("Configuration unchanged, parse skipped");
+      return true;
+    }
+  }
+
+  // Configuration is changed while it's parsed, restored from this copy if it's invalid
+  loadJson();
+  _rollbackConfig = toString();
+  bool success = parseConfig(data, isLocal);
+  _rollbackConfig = "";
+  if (success && !isLocal) {
+    _remoteConfigCrc = crc;
+    _remoteConfigCurrent = true;
+  }
+  unlock();
+  return success;
+}
+
+/**
+ * @brief Check if the configuration is still the last one applied from AirGradient server, no
+ * change was made from another source since. A not modified server response can then be ignored
+ */
+bool Configuration::isRemoteConfigCurrent(void) { return _remoteConfigCurrent; }
+
+bool Configuration::parseConfig(String data, bool isLocal) {
   logInfo("Parsing configuration: " + data);
 
   JSONVar root = JSON.parse(data);
@@ -840,7 +1389,7 @@ bool Configuration::parse(String data, bool isLocal) {
   if (JSON.typeof_(root[jprop_mqttBrokerUrl]) == "string") {
     String broker = root[jprop_mqttBrokerUrl];
     String oldBroker = jconfig[jprop_mqttBrokerUrl];
-    if (broker.length() <= 255) {
+    if (broker.length() <= MAX_CONFIG_URL_LENGTH) {
       if (broker != oldBroker) {
         changed = true;
         configLogInfo(String(jprop_mqttBrokerUrl), oldBroker, broker);
@@ -870,7 +1419,7 @@ bool Configuration::parse(String data, bool isLocal) {
     if (JSON.typeof_(root[jprop_httpDomain]) == "string") {
       String httpDomain = root[jprop_httpDomain];
       String oldHttpDomain = jconfig[jprop_httpDomain];
-      if (httpDomain.length() <= 255) {
+      if (httpDomain.length() <= MAX_CONFIG_URL_LENGTH) {
         if (httpDomain != oldHttpDomain) {
           changed = true;
           configLogInfo(String(jprop_httpDomain), oldHttpDomain, httpDomain);
@@ -1075,6 +1624,23 @@ bool Configuration::parse(String data, bool isLocal) {
     }
   }
 
+  if (JSON.typeof_(root[jprop_windowStatistics]) == "boolean") {
+    bool value = root[jprop_windowStatistics];
+    bool oldValue = jconfig[jprop_windowStatistics];
+    if (value != oldValue) {
+      changed = true;
+      configLogInfo(String(jprop_windowStatistics),
+                    String(oldValue ? "true" : "false"),
+                    String(value ? "true" : "false"));
+      jconfig[jprop_windowStatistics] = value;
+    }
+  } else {
+    if (jsonTypeInvalid(root[jprop_windowStatistics], "boolean")) {
+      failedMessage = jsonTypeInvalidMessage(String(jprop_windowStatistics), "boolean");
+      jsonInvalid();
+      return false;
+    }
+  }
 
   // PM2.5 Corrections
   if (updatePmCorrection(root)) {
@@ -1091,11 +1657,150 @@ bool Configuration::parse(String data, bool isLocal) {
     changed = true;
   }
 
+  if (JSON.typeof_(root[jprop_measurementFilters]) == "object") {
+    JSONVar filters = root[jprop_measurementFilters];
+    JSONVar keys = jsonObjectKeys(filters);
+    for (int i = 0; i < keys.length(); i++) {
+      String name = String(jprop_measurementFilters) + "." + (const char *)keys[i];
+      JSONVar filter = filters[(const char *)keys[i]];
+      if (JSON.typeof_(filter) != "string") {
+        failedMessage = jsonTypeInvalidMessage(name, "string");
+        jsonInvalid();
+        return false;
+      }
+      if (matchMeasurementFilterMode(filter) == MEASUREMENT_FILTER_UNKNOWN) {
+        failedMessage = jsonValueInvalidMessage(name, filter);
+        jsonInvalid();
+        return false;
+      }
+    }
+
+    if (updateMeasurementFilters(filters)) {
+      changed = true;
+      configLogInfo(String(jprop_measurementFilters),
+                    JSON.stringify(jconfig[jprop_measurementFilters]),
+                    JSON.stringify(filters));
+      jconfig[jprop_measurementFilters] = filters;
+    }
+  } else {
+    if (jsonTypeInvalid(root[jprop_measurementFilters], "object")) {
+      failedMessage = jsonTypeInvalidMessage(String(jprop_measurementFilters), "object");
+      jsonInvalid();
+      return false;
+    }
+  }
+
+  if (JSON.typeof_(root[jprop_reportingMode]) == "string") {
+    String mode = root[jprop_reportingMode];
+    if (matchReportingMode(mode) == REPORTING_MODE_UNKNOWN) {
+      failedMessage = jsonValueInvalidMessage(String(jprop_reportingMode), mode);
+      jsonInvalid();
+      return false;
+    }
+    String oldMode = jconfig[jprop_reportingMode];
+    if (mode != oldMode) {
+      configLogInfo(String(jprop_reportingMode), oldMode, mode);
+      jconfig[jprop_reportingMode] = mode;
+      changed = true;
+    }
+  } else {
+    if (jsonTypeInvalid(root[jprop_reportingMode], "string")) {
+      failedMessage = jsonTypeInvalidMessage(String(jprop_reportingMode), "string");
+      jsonInvalid();
+      return false;
+    }
+  }
+
+  if (JSON.typeof_(root[jprop_reportingHeartbeat]) == "number") {
+    int value = root[jprop_reportingHeartbeat];
+    if (value < 60 || value > 86400) {
+      failedMessage = jsonValueInvalidMessage(String(jprop_reportingHeartbeat), String(value));
+      jsonInvalid();
+      return false;
+    }
+    int oldValue = jconfig[jprop_reportingHeartbeat];
+    if (value != oldValue) {
+      configLogInfo(String(jprop_reportingHeartbeat), String(oldValue), String(value));
+      jconfig[jprop_reportingHeartbeat] = value;
+      changed = true;
+    }
+  } else {
+    if (jsonTypeInvalid(root[jprop_reportingHeartbeat], "number")) {
+      failedMessage = jsonTypeInvalidMessage(String(jprop_reportingHeartbeat), "number");
+      jsonInvalid();
+      return false;
+    }
+  }
+
+  if (JSON.typeof_(root[jprop_postBatchSize]) == "number") {
+    int value = root[jprop_postBatchSize];
+    if (value < 1 || value > 15) {
+      failedMessage = jsonValueInvalidMessage(String(jprop_postBatchSize), String(value));
+      jsonInvalid();
+      return false;
+    }
+    int oldValue = jconfig[jprop_postBatchSize];
+    if (value != oldValue) {
+      configLogInfo(String(jprop_postBatchSize), String(oldValue), String(value));
+      jconfig[jprop_postBatchSize] = value;
+      changed = true;
+    }
+  } else {
+    if (jsonTypeInvalid(root[jprop_postBatchSize], "number")) {
+      failedMessage = jsonTypeInvalidMessage(String(jprop_postBatchSize), "number");
+      jsonInvalid();
+      return false;
+    }
+  }
+
+  if (JSON.typeof_(root[jprop_reportingDeadbands]) == "object") {
+    JSONVar deadbands = root[jprop_reportingDeadbands];
+    JSONVar keys = jsonObjectKeys(deadbands);
+    for (int i = 0; i < keys.length(); i++) {
+      String name = String(jprop_reportingDeadbands) + "." + (const char *)keys[i];
+      JSONVar deadband = deadbands[(const char *)keys[i]];
+      if (JSON.typeof_(deadband) != "object") {
+        failedMessage = jsonTypeInvalidMessage(name, "object");
+        jsonInvalid();
+        return false;
+      }
+      const char *members[] = {"absolute", "relative"};
+      for (int m = 0; m < 2; m++) {
+        if (JSON.typeof_(deadband[members[m]]) != "number") {
+          failedMessage = jsonTypeInvalidMessage(name + "." + members[m], "number");
+          jsonInvalid();
+          return false;
+        }
+        if ((double)deadband[members[m]] < 0) {
+          failedMessage = jsonValueInvalidMessage(name + "." + members[m],
+                                                  JSON.stringify(deadband[members[m]]));
+          jsonInvalid();
+          return false;
+        }
+      }
+    }
+
+    if (updateReportingDeadbands(deadbands)) {
+      changed = true;
+      configLogInfo(String(jprop_reportingDeadbands),
+                    JSON.stringify(jconfig[jprop_reportingDeadbands]),
+                    JSON.stringify(deadbands));
+      jconfig[jprop_reportingDeadbands] = deadbands;
+    }
+  } else {
+    if (jsonTypeInvalid(root[jprop_reportingDeadbands], "object")) {
+      failedMessage = jsonTypeInvalidMessage(String(jprop_reportingDeadbands), "object");
+      jsonInvalid();
+      return false;
+    }
+  }
+
   if (ledBarTestRequested || co2CalibrationRequested) {
     commandRequested = true;
     updated = true;
   }
 
+  updateValues();
   if (changed) {
     updated = true;
     saveConfig();
@@ -1111,7 +1816,12 @@ bool Configuration::parse(String data, bool isLocal) {
  *
  * @return String
  */
-String Configuration::toString(void) { return JSON.stringify(jconfig); }
+String Configuration::toString(void) {
+  lock();
+  String value = _imageJson.length() > 0 ? _imageJson : JSON.stringify(jconfig);
+  unlock();
+  return value;
+}
 
 /**
  * @brief Get current configuration value as JSON string
@@ -1120,38 +1830,96 @@ String Configuration::toString(void) { return JSON.stringify(jconfig); }
  * @return String
  */
 String Configuration::toString(AgFirmwareMode fwMode) {
+  lock();
+  loadJson();
   String model = jconfig[jprop_model];
   jconfig[jprop_model] = AgFirmwareModeName(fwMode);
   String value = toString();
   jconfig[jprop_model] = model;
+  unlock();
   return value;
 }
 
+/**
+ * @brief Get a consistent copy of the configuration values, safe to call from any task
+ *
+ * @return Values
+ */
+Configuration::Values Configuration::values(void) {
+  for (;;) {
+    uint32_t version = _valuesVersion;
+    __sync_synchronize();
+    Values copy = _values[version & 1];
+    __sync_synchronize();
+
+    // Writer only fill the other values until it publish the next version, so the copy is
+    // consistent if the version did not change
+    if (_valuesVersion == version) {
+      return copy;
+    }
+  }
+}
+
+/**
+ * @brief Counter incremented every time a configuration value change, so caller can cheaply
+ * check if it has to reload the values it depends on
+ */
+uint32_t Configuration::getValuesVersion(void) { return _valuesVersion; }
+
+/**
+ * @brief Get one configuration value without copying every values, see values()
+ */
+template <typename T> T Configuration::valueOf(T Values::*member) {
+  for (;;) {
+    uint32_t version = _valuesVersion;
+    __sync_synchronize();
+    T value = _values[version & 1].*member;
+    __sync_synchronize();
+    if (_valuesVersion == version) {
+      return value;
+    }
+  }
+}
+
+/**
+ * @brief Get one element of a configuration values table, see valueOf()
+ */
+template <typename T, int N> T Configuration::valueOf(T (Values::*member)[N], int index) {
+  for (;;) {
+    uint32_t version = _valuesVersion;
+    __sync_synchronize();
+    T value = (_values[version & 1].*member)[index];
+    __sync_synchronize();
+    if (_valuesVersion == version) {
+      return value;
+    }
+  }
+}
+
 /**
  * @brief Temperature unit (F or C)
  *
  * @return true F
  * @return false C
  */
-bool Configuration::isTemperatureUnitInF(void) {
-  String unit = jconfig[jprop_temperatureUnit];
-  return (unit == "f");
-}
-
+bool Configuration::isTemperatureUnitInF(void) { return valueOf(&Values::temperatureUnitInF); }
 
 bool Configuration::isExtendedPmMeasuresEnabled(void) {
-  return jconfig[jprop_extendedPmMeasures];
+  return valueOf(&Values::extendedPmMeasures);
 }
 
+/**
+ * @brief Window statistics of every measurement are added to the payload sent to AirGradient
+ * server
+ */
+bool Configuration::isWindowStatisticsEnabled(void) { return valueOf(&Values::windowStatistics); }
+
 /**
  * @brief Country name, it's short name ex: TH = Thailand
  *
  * @return String
  */
-String Configuration::getCountry(void) {
-  String country = jconfig[jprop_country];
-  return country;
-}
+String Configuration::getCountry(void) { return String(values().country); }
 
 /**
  * @brief PM unit standard (USAQI, ugm3)
@@ -1159,48 +1927,29 @@ String Configuration::getCountry(void) {
  * @return true USAQI
  * @return false ugm3
  */
-bool Configuration::isPmStandardInUSAQI(void) {
-  String standard = jconfig[jprop_pmStandard];
-  return (standard == getPMStandardString(true));
-}
+bool Configuration::isPmStandardInUSAQI(void) { return valueOf(&Values::pmStandardInUSAQI); }
 
 /**
  * @brief Get CO2 calibration ABC time
  *
  * @return int Number of day
  */
-int Configuration::getCO2CalibrationAbcDays(void) {
-  int value = jconfig[jprop_abcDays];
-  return value;
-}
+int Configuration::getCO2CalibrationAbcDays(void) { return valueOf(&Values::abcDays); }
 
 /**
  * @brief Get Led Bar Mode
  *
  * @return LedBarMode
  */
-LedBarMode Configuration::getLedBarMode(void) {
-  String mode = jconfig[jprop_ledBarMode];
-  if (mode == getLedBarModeName(LedBarModeCO2)) {
-    return LedBarModeCO2;
-  }
-  if (mode == getLedBarModeName(LedBarModeOff)) {
-    return LedBarModeOff;
-  }
-  if (mode == getLedBarModeName(LedBarModePm)) {
-    return LedBarModePm;
-  }
-  return LedBarModeOff;
-}
+LedBarMode Configuration::getLedBarMode(void) { return valueOf(&Values::ledBarMode); }
 
 /**
  * @brief Get LED bar mode name
  *
- * @return String
+ * @return const char* name, ex: "co2"
  */
-String Configuration::getLedBarModeName(void) {
-  String mode = jconfig[jprop_ledBarMode];
-  return mode;
+const char *Configuration::getLedBarModeName(void) {
+  return LED_BAR_MODE_NAMES[getLedBarMode()];
 }
 
 /**
@@ -1208,20 +1957,14 @@ String Configuration::getLedBarModeName(void) {
  *
  * @return String
  */
-String Configuration::getMqttBrokerUri(void) {
-  String broker = jconfig[jprop_mqttBrokerUrl];
-  return broker;
-}
+String Configuration::getMqttBrokerUri(void) { return String(values().mqttBrokerUri); }
 
 /**
  * @brief Get HTTP domain for post measures and get configuration
  *
  * @return String http domain, might be empty string
  */
-String Configuration::getHttpDomain(void) {
-  String httpDomain = jconfig[jprop_httpDomain];
-  return httpDomain;
-}
+String Configuration::getHttpDomain(void) { return String(values().httpDomain); }
 
 /**
  * @brief Get configuratoin post data to AirGradient cloud
@@ -1230,8 +1973,7 @@ String Configuration::getHttpDomain(void) {
  * @return false No-Post
  */
 bool Configuration::isPostDataToAirGradient(void) {
-  bool post = jconfig[jprop_postDataToAirGradient];
-  return post;
+  return valueOf(&Values::postDataToAirGradient);
 }
 
 /**
@@ -1240,20 +1982,7 @@ bool Configuration::isPostDataToAirGradient(void) {
  * @return ConfigurationControl
  */
 ConfigurationControl Configuration::getConfigurationControl(void) {
-  String ctrl = jconfig[jprop_configurationControl];
-  if (ctrl == String(CONFIGURATION_CONTROL_NAME
-                         [ConfigurationControl::ConfigurationControlBoth])) {
-    return ConfigurationControl::ConfigurationControlBoth;
-  }
-  if (ctrl == String(CONFIGURATION_CONTROL_NAME
-                         [ConfigurationControl::ConfigurationControlLocal])) {
-    return ConfigurationControl::ConfigurationControlLocal;
-  }
-  if (ctrl == String(CONFIGURATION_CONTROL_NAME
-                         [ConfigurationControl::ConfigurationControlCloud])) {
-    return ConfigurationControl::ConfigurationControlCloud;
-  }
-  return ConfigurationControl::ConfigurationControlBoth;
+  return valueOf(&Values::configurationControl);
 }
 
 /**
@@ -1286,7 +2015,11 @@ bool Configuration::isLedBarTestRequested(void) {
  * @brief Reset default configure
  */
 void Configuration::reset(void) {
+  lock();
   defaultConfig();
+  // Device is usually restarted right after
+  flush();
+  unlock();
   logInfo("Reset to default configure");
   printConfig();
 }
@@ -1297,7 +2030,10 @@ void Configuration::reset(void) {
  * @return String
  */
 String Configuration::getModel(void) {
+  lock();
+  loadJson();
   String model = jconfig[jprop_model];
+  unlock();
   return model;
 }
 
@@ -1322,7 +2058,7 @@ String Configuration::jsonValueInvalidMessage(String name, String value) {
 }
 
 void Configuration::jsonInvalid(void) {
-  loadConfig();
+  toConfig(_rollbackConfig.c_str());
   logError(failedMessage);
 }
 
@@ -1347,6 +2083,7 @@ String Configuration::getAbcDayString(int value) {
 }
 
 void Configuration::toConfig(const char *buf) {
+  loadJson();
   logInfo("Parse file to JSON");
   JSONVar root = JSON.parse(buf);
   if (!(root == undefined)) {
@@ -1521,6 +2258,38 @@ void Configuration::toConfig(const char *buf) {
     logInfo("toConfig: extendedPmMeasures changed");
   }
 
+  /** validate windowStatistics configuration */
+  if (JSON.typeof_(jconfig[jprop_windowStatistics]) != "boolean") {
+    jconfig[jprop_windowStatistics] = jprop_windowStatistics_default;
+    changed = true;
+    logInfo("toConfig: windowStatistics changed");
+  }
+
+  /** validate reportingMode configuration */
+  if (JSON.typeof_(jconfig[jprop_reportingMode]) != "string" ||
+      matchReportingMode(jconfig[jprop_reportingMode]) == REPORTING_MODE_UNKNOWN) {
+    jconfig[jprop_reportingMode] = jprop_reportingMode_default;
+    changed = true;
+    logInfo("toConfig: reportingMode changed");
+  }
+
+  /** validate reportingHeartbeat configuration */
+  if (JSON.typeof_(jconfig[jprop_reportingHeartbeat]) != "number" ||
+      (int)jconfig[jprop_reportingHeartbeat] < 60 ||
+      (int)jconfig[jprop_reportingHeartbeat] > 86400) {
+    jconfig[jprop_reportingHeartbeat] = jprop_reportingHeartbeat_default;
+    changed = true;
+    logInfo("toConfig: reportingHeartbeat changed");
+  }
+
+  /** validate postBatchSize configuration */
+  if (JSON.typeof_(jconfig[jprop_postBatchSize]) != "number" ||
+      (int)jconfig[jprop_postBatchSize] < 1 || (int)jconfig[jprop_postBatchSize] > 15) {
+    jconfig[jprop_postBatchSize] = jprop_postBatchSize_default;
+    changed = true;
+    logInfo("toConfig: postBatchSize changed");
+  }
+
   /** validate configuration control */
   if (JSON.typeof_(jprop_configurationControl) != "string") {
     isConfigFieldInvalid = true;
@@ -1602,30 +2371,9 @@ void Configuration::toConfig(const char *buf) {
         jprop_monitorDisplayCompensatedValues_default;
   }
 
-  // PM2.5 correction
-  /// Set default first before parsing local config
-  pmCorrection.algorithm = COR_ALGO_PM_NONE;
-  pmCorrection.intercept = 0;
-  pmCorrection.scalingFactor = 0;
-  pmCorrection.useEPA = false;
-  /// Load correction from saved config
-  updatePmCorrection(jconfig);
-
-  // Temperature correction
-  /// Set default first before parsing local config
-  tempCorrection.algorithm = COR_ALGO_TEMP_HUM_NONE;
-  tempCorrection.intercept = 0;
-  tempCorrection.scalingFactor = 0;
-  /// Load correction from saved config
-  updateTempHumCorrection(jconfig, tempCorrection, jprop_atmp);
-
-  // Relative humidity correction
-  /// Set default first before parsing local config
-  rhumCorrection.algorithm = COR_ALGO_TEMP_HUM_NONE;
-  rhumCorrection.intercept = 0;
-  rhumCorrection.scalingFactor = 0;
-  /// Load correction from saved config
-  updateTempHumCorrection(jconfig, rhumCorrection, jprop_rhum);
+  if (loadNestedConfig()) {
+    changed = true;
+  }
 
   // Validate cellOperators (string)
   if (JSON.typeof_(jconfig[jprop_cellOperators]) != "string" &&
@@ -1643,22 +2391,250 @@ void Configuration::toConfig(const char *buf) {
     logInfo("toConfig: cellOperatorId changed");
   }
 
+  updateValues();
   if (changed) {
     saveConfig();
   }
 }
 
+/**
+ * @brief Set corrections, measurement filters and reporting deadbands to their default, the
+ * changed flags are kept
+ */
+void Configuration::defaultNestedConfig(void) {
+  pmCorrection.algorithm = COR_ALGO_PM_NONE;
+  pmCorrection.intercept = 0;
+  pmCorrection.scalingFactor = 0;
+  pmCorrection.useEPA = false;
+
+  TempHumCorrection *corrections[] = {&tempCorrection, &rhumCorrection};
+  for (TempHumCorrection *correction : corrections) {
+    correction->algorithm = COR_ALGO_TEMP_HUM_NONE;
+    correction->intercept = 0;
+    correction->scalingFactor = 0;
+  }
+
+  for (int i = 0; i < CONFIGURATION_MEASUREMENTS; i++) {
+    _measurementFilters[i] = MEASUREMENT_FILTER_MEAN;
+  }
+  defaultReportingDeadbands(_reportingDeadbands);
+}
+
+/**
+ * @brief Load corrections, measurement filters and reporting deadbands from the JSON
+ * configuration, they are kept as typed members
+ *
+ * @return true if an invalid member was removed from the JSON configuration
+ */
+bool Configuration::loadNestedConfig(void) {
+  bool changed = false;
+
+  /// Set default first before parsing local config
+  defaultNestedConfig();
+
+  /// Load corrections from saved config
+  updatePmCorrection(jconfig);
+  updateTempHumCorrection(jconfig, tempCorrection, jprop_atmp);
+  updateTempHumCorrection(jconfig, rhumCorrection, jprop_rhum);
+
+  // Measurement filters
+  /// Load filters from saved config, not configured means every measurement use mean
+  if (jconfig.hasOwnProperty(jprop_measurementFilters)) {
+    if (JSON.typeof_(jconfig[jprop_measurementFilters]) == "object") {
+      JSONVar filters = jconfig[jprop_measurementFilters];
+      updateMeasurementFilters(filters);
+    } else {
+      jconfig[jprop_measurementFilters] = undefined;
+      changed = true;
+      logInfo("toConfig: measurementFilters changed");
+    }
+  }
+
+  // Reporting deadbands
+  /// Load deadbands from saved config, not configured means every measurement use its default
+  if (jconfig.hasOwnProperty(jprop_reportingDeadbands)) {
+    if (JSON.typeof_(jconfig[jprop_reportingDeadbands]) == "object") {
+      JSONVar deadbands = jconfig[jprop_reportingDeadbands];
+      updateReportingDeadbands(deadbands);
+    } else {
+      jconfig[jprop_reportingDeadbands] = undefined;
+      changed = true;
+      logInfo("toConfig: reportingDeadbands changed");
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * @brief Build the typed values from the JSON configuration, publish them as a new version if
+ * any changed. Call every time the JSON configuration is changed
+ */
+void Configuration::updateValues(void) {
+  Values next;
+  buildValues(next);
+  publishValues(next);
+}
+
+/**
+ * @brief Build the typed values from the JSON configuration
+ */
+void Configuration::buildValues(Values &next) {
+  loadJson();
+
+  // Zeroed so padding doesn't make equal values compare different
+  memset(&next, 0, sizeof(next));
+
+  String country = jconfig[jprop_country];
+  String mqttBrokerUri = jconfig[jprop_mqttBrokerUrl];
+  String httpDomain = jconfig[jprop_httpDomain];
+  String unit = jconfig[jprop_temperatureUnit];
+  String standard = jconfig[jprop_pmStandard];
+  String ledBarMode = jconfig[jprop_ledBarMode];
+  String ctrl = jconfig[jprop_configurationControl];
+  snprintf(next.country, sizeof(next.country), "%s", country.c_str());
+  snprintf(next.mqttBrokerUri, sizeof(next.mqttBrokerUri), "%s", mqttBrokerUri.c_str());
+  snprintf(next.httpDomain, sizeof(next.httpDomain), "%s", httpDomain.c_str());
+  next.temperatureUnitInF = (unit == "f");
+  next.pmStandardInUSAQI = (standard == getPMStandardString(true));
+
+  next.ledBarMode = LedBarModeOff;
+  for (int mode = LedBarModeOff; mode <= LedBarModeCO2; mode++) {
+    if (ledBarMode == LED_BAR_MODE_NAMES[mode]) {
+      next.ledBarMode = (LedBarMode)mode;
+    }
+  }
+
+  next.configurationControl = ConfigurationControlBoth;
+  for (int control = ConfigurationControlLocal; control <= ConfigurationControlBoth; control++) {
+    if (ctrl == CONFIGURATION_CONTROL_NAME[control]) {
+      next.configurationControl = (ConfigurationControl)control;
+    }
+  }
+
+  next.abcDays = jconfig[jprop_abcDays];
+  next.tvocLearningOffset = jconfig[jprop_tvocLearningOffset];
+  next.noxLearningOffset = jconfig[jprop_noxLearningOffset];
+  next.ledBarBrightness = jconfig[jprop_ledBarBrightness];
+  next.displayBrightness = jconfig[jprop_displayBrightness];
+  next.postDataToAirGradient = jconfig[jprop_postDataToAirGradient];
+  next.disableCloudConnection = jconfig[jprop_disableCloudConnection];
+  next.offlineMode = jconfig[jprop_offlineMode];
+  next.monitorDisplayCompensatedValues = jconfig[jprop_monitorDisplayCompensatedValues];
+  next.extendedPmMeasures = jconfig[jprop_extendedPmMeasures];
+  next.windowStatistics = jconfig[jprop_windowStatistics];
+
+  next.reportingMode = matchReportingMode(jconfig[jprop_reportingMode]);
+  if (next.reportingMode == REPORTING_MODE_UNKNOWN) {
+    next.reportingMode = REPORTING_MODE_INTERVAL;
+  }
+  next.reportingHeartbeat = jprop_reportingHeartbeat_default;
+  if (JSON.typeof_(jconfig[jprop_reportingHeartbeat]) == "number") {
+    next.reportingHeartbeat = jconfig[jprop_reportingHeartbeat];
+  }
+  next.postBatchSize = jprop_postBatchSize_default;
+  if (JSON.typeof_(jconfig[jprop_postBatchSize]) == "number") {
+    next.postBatchSize = jconfig[jprop_postBatchSize];
+  }
+
+  buildNestedValues(next);
+}
+
+/**
+ * @brief Copy corrections, measurement filters and reporting deadbands to zeroed values.
+ * Corrections are copied member by member, so padding and changed flags stay zero
+ */
+void Configuration::buildNestedValues(Values &next) {
+  next.pmCorrection.algorithm = pmCorrection.algorithm;
+  next.pmCorrection.intercept = pmCorrection.intercept;
+  next.pmCorrection.scalingFactor = pmCorrection.scalingFactor;
+  next.pmCorrection.useEPA = pmCorrection.useEPA;
+
+  const TempHumCorrection *corrections[] = {&tempCorrection, &rhumCorrection};
+  TempHumCorrection *published[] = {&next.tempCorrection, &next.rhumCorrection};
+  for (int i = 0; i < 2; i++) {
+    published[i]->algorithm = corrections[i]->algorithm;
+    published[i]->intercept = corrections[i]->intercept;
+    published[i]->scalingFactor = corrections[i]->scalingFactor;
+  }
+
+  memcpy(next.measurementFilters, _measurementFilters, sizeof(next.measurementFilters));
+  memcpy(next.reportingDeadbands, _reportingDeadbands, sizeof(next.reportingDeadbands));
+}
+
+/**
+ * @brief Set corrections, measurement filters and reporting deadbands from loaded values, the
+ * changed flags are kept
+ */
+void Configuration::restoreNestedConfig(const Values &values) {
+  pmCorrection.algorithm = values.pmCorrection.algorithm;
+  pmCorrection.intercept = values.pmCorrection.intercept;
+  pmCorrection.scalingFactor = values.pmCorrection.scalingFactor;
+  pmCorrection.useEPA = values.pmCorrection.useEPA;
+
+  TempHumCorrection *corrections[] = {&tempCorrection, &rhumCorrection};
+  const TempHumCorrection *loaded[] = {&values.tempCorrection, &values.rhumCorrection};
+  for (int i = 0; i < 2; i++) {
+    corrections[i]->algorithm = loaded[i]->algorithm;
+    corrections[i]->intercept = loaded[i]->intercept;
+    corrections[i]->scalingFactor = loaded[i]->scalingFactor;
+  }
+
+  memcpy(_measurementFilters, values.measurementFilters, sizeof(_measurementFilters));
+  memcpy(_reportingDeadbands, values.reportingDeadbands, sizeof(_reportingDeadbands));
+}
+
+/**
+ * @brief Parse the JSON of the configuration image loaded on boot into jconfig, if not done yet.
+ * Call with the lock held before jconfig is read or changed
+ */
+void Configuration::loadJson(void) {
+  if (_imageJson.length() == 0) {
+    return;
+  }
+  JSONVar root = JSON.parse(_imageJson);
+  _imageJson = "";
+  if (JSON.typeof_(root) == "object") {
+    jconfig = root;
+    return;
+  }
+
+  // CRC matched, so it was saved like this
+  logError("Configuration image JSON invalid, default configuration loaded");
+  defaultConfig();
+}
+
+/**
+ * @brief Publish values as a new version if any changed
+ */
+void Configuration::publishValues(const Values &next) {
+  lock();
+  uint32_t version = _valuesVersion;
+  if (memcmp(&next, &_values[version & 1], sizeof(next)) != 0) {
+    // Readers copy the current values while the next ones are written, the barrier order the
+    // writes before the version store
+    memcpy(&_values[(version + 1) & 1], &next, sizeof(next));
+    __sync_synchronize();
+    _valuesVersion = version + 1;
+  }
+  unlock();
+}
+
 String Configuration::getFailedMesage(void) { return failedMessage; }
 
 void Configuration::setPostToAirGradient(bool enable) {
+  lock();
+  loadJson();
   bool oldEnabled = jconfig[jprop_postDataToAirGradient];
   if (enable != oldEnabled) {
     jconfig[jprop_postDataToAirGradient] = enable;
     logInfo("postDataToAirGradient set to: " + String(enable));
+    updateValues();
     saveConfig();
   } else {
     logInfo("postDataToAirGradient: Ignored set to " + String(enable));
   }
+  unlock();
 }
 
 bool Configuration::noxLearnOffsetChanged(void) {
@@ -1673,15 +2649,9 @@ bool Configuration::tvocLearnOffsetChanged(void) {
   return changed;
 }
 
-int Configuration::getTvocLearningOffset(void) {
-  int value = jconfig[jprop_tvocLearningOffset];
-  return value;
-}
+int Configuration::getTvocLearningOffset(void) { return valueOf(&Values::tvocLearningOffset); }
 
-int Configuration::getNoxLearningOffset(void) {
-  int value = jconfig[jprop_noxLearningOffset];
-  return value;
-}
+int Configuration::getNoxLearningOffset(void) { return valueOf(&Values::noxLearningOffset); }
 
 String Configuration::wifiSSID(void) { return "airgradient-" + ag->deviceId(); }
 
@@ -1689,10 +2659,7 @@ String Configuration::wifiPass(void) { return String("cleanair"); }
 
 void Configuration::setAirGradient(AirGradient *ag) { this->ag = ag; }
 
-int Configuration::getLedBarBrightness(void) {
-  int value = jconfig[jprop_ledBarBrightness];
-  return value;
-}
+int Configuration::getLedBarBrightness(void) { return valueOf(&Values::ledBarBrightness); }
 
 bool Configuration::isLedBarBrightnessChanged(void) {
   bool changed = ledBarBrightnessChanged;
@@ -1700,20 +2667,20 @@ bool Configuration::isLedBarBrightnessChanged(void) {
   return changed;
 }
 
-int Configuration::getDisplayBrightness(void) {
-  int value = jconfig[jprop_displayBrightness];
-  return value;
-}
+int Configuration::getDisplayBrightness(void) { return valueOf(&Values::displayBrightness); }
 
 bool Configuration::isOfflineMode(void) {
-  bool offline = jconfig[jprop_offlineMode];
-  return (offline || _offlineMode);
+  return (valueOf(&Values::offlineMode) || _offlineMode);
 }
 
 void Configuration::setOfflineMode(bool offline) {
   logInfo("Set offline mode: " + String(offline ? "True" : "False"));
+  lock();
+  loadJson();
   jconfig[jprop_offlineMode] = offline;
+  updateValues();
   saveConfig();
+  unlock();
 }
 
 void Configuration::setOfflineModeWithoutSave(bool offline) {
@@ -1721,14 +2688,17 @@ void Configuration::setOfflineModeWithoutSave(bool offline) {
 }
 
 bool Configuration::isCloudConnectionDisabled(void) {
-  bool disabled = jconfig[jprop_disableCloudConnection];
-  return disabled;
+  return valueOf(&Values::disableCloudConnection);
 }
 
 void Configuration::setDisableCloudConnection(bool disable) {
   logInfo("Set DisableCloudConnection to " + String(disable ? "True" : "False"));
+  lock();
+  loadJson();
   jconfig[jprop_disableCloudConnection] = disable;
+  updateValues();
   saveConfig();
+  unlock();
 }
 
 bool Configuration::isLedBarModeChanged(void) {
@@ -1738,7 +2708,7 @@ bool Configuration::isLedBarModeChanged(void) {
 }
 
 bool Configuration::isMonitorDisplayCompensatedValues(void) {
-  return jconfig[jprop_monitorDisplayCompensatedValues];
+  return valueOf(&Values::monitorDisplayCompensatedValues);
 }
 
 bool Configuration::isDisplayBrightnessChanged(void) {
@@ -1774,11 +2744,17 @@ bool Configuration::isPMCorrectionEnabled(void) {
   return true;
 }
 
-Configuration::PMCorrection Configuration::getPMCorrection(void) { return pmCorrection; }
+Configuration::PMCorrection Configuration::getPMCorrection(void) {
+  return valueOf(&Values::pmCorrection);
+}
 
-Configuration::TempHumCorrection Configuration::getTempCorrection(void) { return tempCorrection; }
+Configuration::TempHumCorrection Configuration::getTempCorrection(void) {
+  return valueOf(&Values::tempCorrection);
+}
 
-Configuration::TempHumCorrection Configuration::getHumCorrection(void) { return rhumCorrection; }
+Configuration::TempHumCorrection Configuration::getHumCorrection(void) {
+  return valueOf(&Values::rhumCorrection);
+}
 
 bool Configuration::isSatellitesChanged(void) {
   bool changed = _satellitesChanged;
@@ -1790,25 +2766,70 @@ bool Configuration::isSatellitesEnabled(void) { return _satellitesEnabled; }
 
 const String *Configuration::getSatellites() const { return _satellites; }
 
+/**
+ * @brief Get filter mode of a measurement
+ *
+ * @param type Measurements::MeasurementType
+ * @return MeasurementFilterMode MEASUREMENT_FILTER_MEAN if not configured
+ */
+MeasurementFilterMode Configuration::getMeasurementFilter(int type) {
+  return valueOf(&Values::measurementFilters, type);
+}
+
+/**
+ * @brief Get how measurements are reported to AirGradient server and MQTT broker
+ *
+ * @return ReportingMode REPORTING_MODE_INTERVAL if not configured
+ */
+ReportingMode Configuration::getReportingMode(void) { return valueOf(&Values::reportingMode); }
+
+/**
+ * @brief Maximum time without a full measurements report when reporting on change, in seconds
+ */
+int Configuration::getReportingHeartbeat(void) { return valueOf(&Values::reportingHeartbeat); }
+
+/**
+ * @brief Get number of measures samples sent together on one request to AirGradient server
+ */
+int Configuration::getPostBatchSize(void) { return valueOf(&Values::postBatchSize); }
+
+/**
+ * @brief Get reporting deadband of a measurement, its default one if not configured
+ *
+ * @param type Measurements::MeasurementType
+ */
+Configuration::ReportingDeadband Configuration::getReportingDeadband(int type) {
+  return valueOf(&Values::reportingDeadbands, type);
+}
+
 String Configuration::getCellOperators(void) {
-  if (JSON.typeof_(jconfig[jprop_cellOperators]) != "string") {
-    return "";
+  String ops;
+  lock();
+  loadJson();
+  if (JSON.typeof_(jconfig[jprop_cellOperators]) == "string") {
+    ops = (const char *)jconfig[jprop_cellOperators];
   }
-  String ops = jconfig[jprop_cellOperators];
+  unlock();
   return ops;
 }
 
 uint32_t Configuration::getCellOperatorId(void) {
-  if (JSON.typeof_(jconfig[jprop_cellOperatorId]) != "number") {
-    return 0;
+  uint32_t id = 0;
+  lock();
+  loadJson();
+  if (JSON.typeof_(jconfig[jprop_cellOperatorId]) == "number") {
+    id = (uint32_t)(int)jconfig[jprop_cellOperatorId];
   }
-  uint32_t id = (uint32_t)(int)jconfig[jprop_cellOperatorId];
+  unlock();
   return id;
 }
 
 void Configuration::setCellOperatorState(const String &operators, uint32_t operatorId) {
+  lock();
+  loadJson();
   jconfig[jprop_cellOperators] = operators;
   jconfig[jprop_cellOperatorId] = (int)operatorId;
   saveConfig();
+  unlock();
   logInfo("Cellular operator state saved");
 }
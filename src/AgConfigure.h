@@ -8,6 +8,41 @@
 #include <Arduino.h>
 
 #define MAX_SATELLITES 10
+#define MAX_CONFIG_URL_LENGTH 255
+// Settings kept per measurement, one per Measurements::MeasurementType in its order. AgValue.h
+// includes this header, the count is checked against it in AgConfigure.cpp
+#define CONFIGURATION_MEASUREMENTS 19
+
+// Members of Configuration::Values as X(type, name, array extent). Values are saved in the
+// configuration images as they are, so the image format is computed from this list and an image
+// saved with another list is loaded from its JSON, see configImageFormat()
+#define CONFIGURATION_VALUES(X)                                                                    \
+  X(char, country, [3])                                                                            \
+  X(char, mqttBrokerUri, [MAX_CONFIG_URL_LENGTH + 1])                                              \
+  X(char, httpDomain, [MAX_CONFIG_URL_LENGTH + 1])                                                 \
+  X(bool, temperatureUnitInF, )                                                                    \
+  X(bool, pmStandardInUSAQI, )                                                                     \
+  X(LedBarMode, ledBarMode, )                                                                      \
+  X(ConfigurationControl, configurationControl, )                                                  \
+  X(int, abcDays, )                                                                                \
+  X(int, tvocLearningOffset, )                                                                     \
+  X(int, noxLearningOffset, )                                                                      \
+  X(int, ledBarBrightness, )                                                                       \
+  X(int, displayBrightness, )                                                                      \
+  X(bool, postDataToAirGradient, )                                                                 \
+  X(bool, disableCloudConnection, )                                                                \
+  X(bool, offlineMode, )                                                                           \
+  X(bool, monitorDisplayCompensatedValues, )                                                       \
+  X(bool, extendedPmMeasures, )                                                                    \
+  X(bool, windowStatistics, )                                                                      \
+  X(ReportingMode, reportingMode, )                                                                \
+  X(int, reportingHeartbeat, )                                                                     \
+  X(int, postBatchSize, )                                                                          \
+  X(PMCorrection, pmCorrection, )                                                                  \
+  X(TempHumCorrection, tempCorrection, )                                                           \
+  X(TempHumCorrection, rhumCorrection, )                                                           \
+  X(MeasurementFilterMode, measurementFilters, [CONFIGURATION_MEASUREMENTS])                       \
+  X(ReportingDeadband, reportingDeadbands, [CONFIGURATION_MEASUREMENTS])
 
 class Configuration : public PrintLog {
 public:
@@ -15,48 +50,105 @@ public:
     PMCorrectionAlgorithm algorithm;
     float intercept;
     float scalingFactor;
-    bool useEPA; // EPA 2021
-    bool changed;
+    bool useEPA;  // EPA 2021
+    bool changed; // Kept by the configuration being built, always false on Values
   };
 
   struct TempHumCorrection {
     TempHumCorrectionAlgorithm algorithm;
     float intercept;
     float scalingFactor;
-    bool changed;
+    bool changed; // Kept by the configuration being built, always false on Values
+  };
+
+  struct ReportingDeadband {
+    float absolute; // Change reported if more than absolute or relative times the value
+    float relative;
+  };
+
+  // Typed copy of the configuration values, built once every time the JSON configuration change
+  // so getters don't look the JSON tree up and allocate on every call. Members are listed in
+  // CONFIGURATION_VALUES
+  struct Values {
+#define CONFIGURATION_VALUES_MEMBER(type, name, extent) type name extent;
+    CONFIGURATION_VALUES(CONFIGURATION_VALUES_MEMBER)
+#undef CONFIGURATION_VALUES_MEMBER
   };
 
 private:
-  bool co2CalibrationRequested;
-  bool ledBarTestRequested;
-  bool updated;
+  bool co2CalibrationRequested = false;
+  bool ledBarTestRequested = false;
+  bool updated = false;
   bool commandRequested = false;
   String failedMessage;
-  bool _noxLearnOffsetChanged;
-  bool _tvocLearningOffsetChanged;
+  bool _noxLearnOffsetChanged = false;
+  bool _tvocLearningOffsetChanged = false;
   bool ledBarBrightnessChanged = false;
   bool displayBrightnessChanged = false;
   String otaNewFirmwareVersion;
   bool _offlineMode = false;
   bool _ledBarModeChanged = false;
+  // Corrections, filters and deadbands of the configuration being built, published in Values
   PMCorrection pmCorrection;
   TempHumCorrection tempCorrection;
   TempHumCorrection rhumCorrection;
   bool _satellitesEnabled = false;
   String _satellites[MAX_SATELLITES];
   bool _satellitesChanged = false;
+  MeasurementFilterMode _measurementFilters[CONFIGURATION_MEASUREMENTS];
+  ReportingDeadband _reportingDeadbands[CONFIGURATION_MEASUREMENTS];
+
+  // Published values, the writer fill the one not pointed by _valuesVersion while readers copy
+  // the other one
+  Values _values[2] = {};
+  volatile uint32_t _valuesVersion = 0;
+  // Configuration save requested, written once it stops changing, see handle()
+  bool _savePending = false;
+  uint32_t _savePendingSince = 0; // millis() of the oldest change not saved
+  uint32_t _saveChangedAt = 0;    // millis() of the newest change not saved
+  uint32_t _savedCrc = 0;         // Content CRC of the last save, same content isn't written again
+  bool _savedCrcValid = false;
+  uint32_t _flashWrites = 0;
+  uint32_t _flashWritesSkipped = 0;
+  String _rollbackConfig; // Configuration before the current parse()
+  // JSON of the configuration image loaded on boot, parsed into jconfig on first use, see
+  // loadJson(). Empty once parsed
+  String _imageJson;
+  // CRC of the last configuration from AirGradient server, same one isn't parsed again while no
+  // other change was made since
+  uint32_t _remoteConfigCrc = 0;
+  bool _remoteConfigCurrent = false;
+#ifdef ESP32
+  // Serialize the configuration changes, parse() runs on several tasks and saves on the main loop
+  SemaphoreHandle_t _mutex = NULL;
+  int _imageSlot = -1;         // Slot of the newest configuration image, -1 if none
+  uint32_t _imageSequence = 0; // Sequence of the newest configuration image
+#endif
 
   AirGradient *ag;
 
   String getLedBarModeName(LedBarMode mode);
   PMCorrectionAlgorithm matchPmAlgorithm(String algorithm);
   TempHumCorrectionAlgorithm matchTempHumAlgorithm(String algorithm);
+  MeasurementFilterMode matchMeasurementFilterMode(String mode);
+  ReportingMode matchReportingMode(String mode);
   bool updatePmCorrection(JSONVar &json);
   bool updateTempHumCorrection(JSONVar &json, TempHumCorrection &target,
                                const char *correctionName);
   bool updateSatellites(JSONVar &json);
   void emptySatellites();
+  bool updateMeasurementFilters(JSONVar &filters);
+  void defaultReportingDeadbands(ReportingDeadband *deadbands);
+  void defaultNestedConfig(void);
+  void buildNestedValues(Values &values);
+  void restoreNestedConfig(const Values &values);
+  void loadJson(void);
+  bool updateReportingDeadbands(JSONVar &deadbands);
   void saveConfig(void);
+  void writeConfig(void);
+  bool parseConfig(String data, bool isLocal);
+  void lock(void);
+  void unlock(void);
   void loadConfig(void);
   void defaultConfig(void);
   void printConfig(void);
@@ -67,6 +159,16 @@ private:
   String getPMStandardString(bool usaqi);
   String getAbcDayString(int value);
   void toConfig(const char *buf);
+  bool loadNestedConfig(void);
+  void updateValues(void);
+  void buildValues(Values &values);
+  void publishValues(const Values &values);
+#ifdef ESP32
+  bool loadConfigImage(void);
+  bool saveConfigImage(void);
+#endif
+  template <typename T> T valueOf(T Values::*member);
+  template <typename T, int N> T valueOf(T (Values::*member)[N], int index);
 
 public:
   Configuration(Stream &debugLog);
@@ -85,15 +187,23 @@ public:
 
   bool begin(void);
   bool parse(String data, bool isLocal);
+  bool isRemoteConfigCurrent(void);
+  void handle(void);
+  void flush(void);
+  uint32_t getFlashWrites(void);
+  uint32_t getFlashWritesSkipped(void);
   String toString(void);
   String toString(AgFirmwareMode fwMode);
+  Values values(void);
+  uint32_t getValuesVersion(void);
   bool isTemperatureUnitInF(void);
   bool isExtendedPmMeasuresEnabled(void);
+  bool isWindowStatisticsEnabled(void);
   String getCountry(void);
   bool isPmStandardInUSAQI(void);
   int getCO2CalibrationAbcDays(void);
   LedBarMode getLedBarMode(void);
-  String getLedBarModeName(void);
+  const char *getLedBarModeName(void);
   bool getDisplayMode(void);
   String getMqttBrokerUri(void);
   String getHttpDomain(void);
@@ -134,6 +244,11 @@ public:
   bool isSatellitesChanged(void);
   bool isSatellitesEnabled(void);
   const String *getSatellites() const;
+  MeasurementFilterMode getMeasurementFilter(int type);
+  ReportingMode getReportingMode(void);
+  int getReportingHeartbeat(void);
+  int getPostBatchSize(void);
+  ReportingDeadband getReportingDeadband(int type);
   String getCellOperators(void);
   uint32_t getCellOperatorId(void);
   void setCellOperatorState(const String &operators, uint32_t operatorId);
@@ -386,14 +386,13 @@ void OledDisplay::showDashboard(DashboardStatus status) {
       DISP()->setFont(u8g2_font_t0_12_tf);
       DISP()->drawStr(55, 27, "PM2.5");
 
-      /** Draw PM2.5 value */
-      int pm25 = round(value.getAverage(Measurements::PM25));
-      if (utils::isValidPm(pm25)) {
-        if (config.hasSensorSHT && config.isPMCorrectionEnabled()) {
-          pm25 = round(value.getCorrectedPM25(true));
-        }
-        if (config.isPmStandardInUSAQI()) {
-          sprintf(strBuf, "%d", ag->pms5003.convertPm25ToUsAqi(pm25));
+      /** Draw PM2.5 value, index is computed when measurements are published */
+      Measurements::AirQuality airQuality = value.getAirQuality();
+      bool showIndex = config.isPmStandardInUSAQI();
+      int pm25 = round(airQuality.pm25);
+      if (utils::isValidPm(pm25) && !(showIndex && airQuality.aqi.index < 0)) {
+        if (showIndex) {
+          sprintf(strBuf, "%d", airQuality.aqi.index);
         } else {
           sprintf(strBuf, "%d", pm25);
         }
@@ -405,8 +404,8 @@ void OledDisplay::showDashboard(DashboardStatus status) {
 
       /** Draw PM2.5 unit */
       DISP()->setFont(u8g2_font_t0_12_tf);
-      if (config.isPmStandardInUSAQI()) {
-        DISP()->drawUTF8(55, 61, "AQI");
+      if (showIndex) {
+        DISP()->drawUTF8(55, 61, AirQualityIndex::label(airQuality.aqi.standard));
       } else {
         DISP()->drawUTF8(55, 61, "ug/m³");
       }
@@ -449,10 +448,7 @@ void OledDisplay::showDashboard(DashboardStatus status) {
     ag->display.setText(strBuf);
 
     /** Set PM */
-    int pm25 = round(value.getAverage(Measurements::PM25));
-    if (config.hasSensorSHT && config.isPMCorrectionEnabled()) {
-      pm25 = round(value.getCorrectedPM25(true));
-    }
+    int pm25 = round(value.getAirQuality().pm25);
 
     ag->display.setCursor(0, 12);
     if (utils::isValidPm(pm25)) {
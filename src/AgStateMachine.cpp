@@ -173,10 +173,8 @@ int StateMachine::co2handleLeds(void) {
 int StateMachine::pm25handleLeds(void) {
   int totalUsed = ag->ledBar.getNumberOfLeds();
 
-  int pm25Value = round(value.getAverage(Measurements::PM25));
-  if (config.hasSensorSHT && config.isPMCorrectionEnabled()) {
-    pm25Value = round(value.getCorrectedPM25(true));
-  }
+  // Corrected when measurements are published, not on every refresh
+  int pm25Value = round(value.getAirQuality().pm25);
 
   if (pm25Value <= 5) {
     /** G; 1 */
@@ -4,7 +4,7 @@
 #include "AirGradient.h"
 #include "App/AppDef.h"
 #include <cmath>
-#include <sstream>
+#include <stddef.h>
 
 #define json_prop_pmFirmware "firmware"
 #define json_prop_pm01Ae "pm01"
@@ -30,49 +30,222 @@
 #define json_prop_noxRaw "noxRaw"
 #define json_prop_co2 "rco2"
 
+// Wrappers so every validity check on the descriptor table share the same signature
+static bool validTemperature(float value) { return utils::isValidTemperature(value); }
+static bool validHumidity(float value) { return utils::isValidHumidity(value); }
+static bool validCO2(float value) { return utils::isValidCO2(value); }
+static bool validVOC(float value) { return utils::isValidVOC(value); }
+static bool validNOx(float value) { return utils::isValidNOx(value); }
+static bool validPm(float value) { return utils::isValidPm(value); }
+static bool validPmCount(float value) { return utils::isValidPm03Count(value); }
+
+// Channels of the temperature, humidity and PM measurements, a storage slot each
+static constexpr uint8_t CHANNELS = MEASUREMENT_CHANNELS;
+
+/**
+ * Measurement table indexed by MeasurementType. Adding a measurement only need a new entry here,
+ * a new MeasurementType and its slots count on AgValue.h
+ */
+static constexpr Measurements::MeasurementDescriptor MEASUREMENT_DESCRIPTORS[] = {
+    // {type, group, isFloat, slot, channels, invalidValue, isValid, deadband, name, jsonKey,
+    //  metricName, metricUnit, metricHelp}
+    {Measurements::Temperature, Measurements::GroupTempHum, true, 0, CHANNELS, INVALID_TEMPERATURE,
+     validTemperature, 0.1f, "Temperature", json_prop_temp, "temperature", "celsius",
+     "The ambient temperature as measured by the AirGradient SHT / PMS sensor, in degrees "
+     "Celsius"},
+    {Measurements::Humidity, Measurements::GroupTempHum, true, CHANNELS, CHANNELS, INVALID_HUMIDITY,
+     validHumidity, 0.5f, "Humidity", json_prop_rhum, "humidity", "percent",
+     "The relative humidity as measured by the AirGradient SHT sensor"},
+    {Measurements::CO2, Measurements::GroupCO2, false, 0, 1, INVALID_CO2, validCO2, 5, "CO2",
+     json_prop_co2, "co2", "ppm",
+     "Carbon dioxide concentration as measured by the AirGradient S8 sensor, in parts per "
+     "million"},
+    {Measurements::TVOC, Measurements::GroupVOC, false, 1, 1, INVALID_VOC, validVOC, 2, "TVOC",
+     json_prop_tvoc, "tvoc_index", "",
+     "The processed Total Volatile Organic Compounds (TVOC) index as measured by the "
+     "AirGradient SGP sensor"},
+    {Measurements::TVOCRaw, Measurements::GroupVOC, false, 2, 1, INVALID_VOC, validVOC, 50,
+     "TVOCRaw", json_prop_tvocRaw, "tvoc_raw", "",
+     "The raw input value to the Total Volatile Organic Compounds (TVOC) index as measured by "
+     "the AirGradient SGP sensor"},
+    {Measurements::NOx, Measurements::GroupVOC, false, 3, 1, INVALID_NOX, validNOx, 1, "NOx",
+     json_prop_nox, "nox_index", "",
+     "The processed Nitrogen Oxide (NOx) index as measured by the AirGradient SGP sensor"},
+    {Measurements::NOxRaw, Measurements::GroupVOC, false, 4, 1, INVALID_NOX, validNOx, 50, "NOxRaw",
+     json_prop_noxRaw, "nox_raw", "",
+     "The raw input value to the Nitrogen Oxide (NOx) index as measured by the AirGradient SGP "
+     "sensor"},
+    {Measurements::PM01, Measurements::GroupPM, false, 5, CHANNELS, INVALID_PMS, validPm, 1,
+     "PM1_AE", json_prop_pm01Ae, "pm1", "ugm3",
+     "PM1.0 concentration as measured by the AirGradient PMS sensor, in micrograms per cubic "
+     "meter"},
+    {Measurements::PM25, Measurements::GroupPM, false, 5 + CHANNELS, CHANNELS, INVALID_PMS, validPm,
+     1, "PM25_AE", json_prop_pm25Ae, "pm2d5", "ugm3",
+     "PM2.5 concentration as measured by the AirGradient PMS sensor, in micrograms per cubic "
+     "meter"},
+    {Measurements::PM10, Measurements::GroupPM, false, 5 + 2 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPm, 1, "PM10_AE", json_prop_pm10Ae, "pm10", "ugm3",
+     "PM10 concentration as measured by the AirGradient PMS sensor, in micrograms per cubic "
+     "meter"},
+    {Measurements::PM01_SP, Measurements::GroupPM, false, 5 + 3 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPm, 1, "PM1_SP", json_prop_pm01Sp, nullptr, "", ""},
+    {Measurements::PM25_SP, Measurements::GroupPM, false, 5 + 4 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPm, 1, "PM25_SP", json_prop_pm25Sp, nullptr, "", ""},
+    {Measurements::PM10_SP, Measurements::GroupPM, false, 5 + 5 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPm, 1, "PM10_SP", json_prop_pm10Sp, nullptr, "", ""},
+    {Measurements::PM03_PC, Measurements::GroupPM, false, 5 + 6 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPmCount, 20, "PM003_PC", json_prop_pm03Count, "pm0d3", "p100ml",
+     "PM0.3 concentration as measured by the AirGradient PMS sensor, in number of particules "
+     "per 100 milliliters"},
+    {Measurements::PM05_PC, Measurements::GroupPM, false, 5 + 7 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPmCount, 10, "PM005_PC", json_prop_pm05Count, nullptr, "", ""},
+    {Measurements::PM01_PC, Measurements::GroupPM, false, 5 + 8 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPmCount, 5, "PM01_PC", json_prop_pm1Count, nullptr, "", ""},
+    {Measurements::PM25_PC, Measurements::GroupPM, false, 5 + 9 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPmCount, 1, "PM25_PC", json_prop_pm25Count, nullptr, "", ""},
+    {Measurements::PM5_PC, Measurements::GroupPM, false, 5 + 10 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPmCount, 1, "PM05_PC", json_prop_pm5Count, nullptr, "", ""},
+    {Measurements::PM10_PC, Measurements::GroupPM, false, 5 + 11 * CHANNELS, CHANNELS, INVALID_PMS,
+     validPmCount, 1, "PM10_PC", json_prop_pm10Count, nullptr, "", ""},
+};
+
+/** Compile time sanity check of the measurement table */
+static constexpr bool descriptorsIndexedByType(int i) {
+  return i == Measurements::_MEASUREMENT_TYPE_MAX ||
+         (MEASUREMENT_DESCRIPTORS[i].type == i && descriptorsIndexedByType(i + 1));
+}
+static constexpr int slotsUsedBefore(int i, bool isFloat) {
+  return i == 0 ? 0
+                : slotsUsedBefore(i - 1, isFloat) +
+                      (MEASUREMENT_DESCRIPTORS[i - 1].isFloat == isFloat
+                           ? MEASUREMENT_DESCRIPTORS[i - 1].channels
+                           : 0);
+}
+static constexpr bool slotsContiguous(int i) {
+  return i == Measurements::_MEASUREMENT_TYPE_MAX ||
+         (MEASUREMENT_DESCRIPTORS[i].slot ==
+              slotsUsedBefore(i, MEASUREMENT_DESCRIPTORS[i].isFloat) &&
+          slotsContiguous(i + 1));
+}
+static_assert(sizeof(MEASUREMENT_DESCRIPTORS) / sizeof(MEASUREMENT_DESCRIPTORS[0]) ==
+                  Measurements::_MEASUREMENT_TYPE_MAX,
+              "Every MeasurementType needs an entry on MEASUREMENT_DESCRIPTORS");
+static_assert(descriptorsIndexedByType(0), "MEASUREMENT_DESCRIPTORS must follow MeasurementType");
+static_assert(slotsContiguous(0), "MEASUREMENT_DESCRIPTORS slots must not overlap");
+static_assert(slotsUsedBefore(Measurements::_MEASUREMENT_TYPE_MAX, true) ==
+                  MEASUREMENT_FLOAT_SLOTS,
+              "MEASUREMENT_FLOAT_SLOTS does not match MEASUREMENT_DESCRIPTORS");
+static_assert(slotsUsedBefore(Measurements::_MEASUREMENT_TYPE_MAX, false) ==
+                  MEASUREMENT_INTEGER_SLOTS,
+              "MEASUREMENT_INTEGER_SLOTS does not match MEASUREMENT_DESCRIPTORS");
+
+/**
+ * Measures has one float per channel in MeasurementType order. Float measurements come first, so
+ * the value index is the slot, offset by the float slots for integer measurements
+ */
+static constexpr int measuresIndex(const Measurements::MeasurementDescriptor &desc) {
+  return desc.isFloat ? desc.slot : MEASUREMENT_FLOAT_SLOTS + desc.slot;
+}
+static constexpr bool measuresIndexMatchLayout(int i) {
+  return i == Measurements::_MEASUREMENT_TYPE_MAX ||
+         (measuresIndex(MEASUREMENT_DESCRIPTORS[i]) ==
+              slotsUsedBefore(i, true) + slotsUsedBefore(i, false) &&
+          measuresIndexMatchLayout(i + 1));
+}
+static_assert(measuresIndexMatchLayout(0), "Measures does not follow MeasurementType order");
+static_assert(MEASUREMENT_FILTER_WINDOWS <= INT8_MAX, "Filter window index must fit in int8_t");
+static_assert(MEASUREMENT_AVERAGE_MAX_PERIOD <= 128,
+              "Window statistics and round of the values must fit in uint8_t");
+static_assert(sizeof(float) == sizeof(uint32_t) && sizeof(int) == sizeof(uint32_t),
+              "Sample pool slices values of 4 bytes");
+static_assert(MEASUREMENT_SAMPLE_POOL <= UINT16_MAX, "Window offset must fit in uint16_t");
+static_assert(MEASUREMENT_SAMPLE_POOL >= Measurements::_MEASUREMENT_TYPE_MAX * sizeof(uint32_t) +
+                                            (MEASUREMENT_FLOAT_SLOTS + MEASUREMENT_INTEGER_SLOTS) *
+                                                2 * sizeof(uint32_t),
+              "Sample pool must fit a window of one sample for every measurement channel");
+static_assert(offsetof(Measurements::Measures, co2) ==
+                  measuresIndex(MEASUREMENT_DESCRIPTORS[Measurements::CO2]) * sizeof(float),
+              "Measures does not follow MeasurementType order");
+static_assert(offsetof(Measurements::Measures, bootCount) ==
+                  (MEASUREMENT_FLOAT_SLOTS + MEASUREMENT_INTEGER_SLOTS) * sizeof(float),
+              "Measures must have one float per MeasurementType channel");
+
 Measurements::Measurements(Configuration &config) : config(config) {
 #ifndef ESP8266
   _resetReason = (int)ESP_RST_UNKNOWN;
 #endif
 
   /* Set invalid value for each measurements as default value when initialized*/
-  _temperature[0].update.avg = utils::getInvalidTemperature();
-  _temperature[1].update.avg = utils::getInvalidTemperature();
-  _humidity[0].update.avg = utils::getInvalidHumidity();
-  _humidity[1].update.avg = utils::getInvalidHumidity();
-  _co2.update.avg = utils::getInvalidCO2();
-  _tvoc.update.avg = utils::getInvalidVOC();
-  _tvoc_raw.update.avg = utils::getInvalidVOC();
-  _nox.update.avg = utils::getInvalidNOx();
-  _nox_raw.update.avg = utils::getInvalidNOx();
-
-  _pm_03_pc[0].update.avg = utils::getInvalidPmValue();
-  _pm_03_pc[1].update.avg = utils::getInvalidPmValue();
-  _pm_05_pc[0].update.avg = utils::getInvalidPmValue();
-  _pm_05_pc[1].update.avg = utils::getInvalidPmValue();
-  _pm_5_pc[0].update.avg = utils::getInvalidPmValue();
-  _pm_5_pc[1].update.avg = utils::getInvalidPmValue();
-
-  _pm_01[0].update.avg = utils::getInvalidPmValue();
-  _pm_01_sp[0].update.avg = utils::getInvalidPmValue();
-  _pm_01_pc[0].update.avg = utils::getInvalidPmValue();
-  _pm_01[1].update.avg = utils::getInvalidPmValue();
-  _pm_01_sp[1].update.avg = utils::getInvalidPmValue();
-  _pm_01_pc[1].update.avg = utils::getInvalidPmValue();
-
-  _pm_25[0].update.avg = utils::getInvalidPmValue();
-  _pm_25_sp[0].update.avg = utils::getInvalidPmValue();
-  _pm_25_pc[0].update.avg = utils::getInvalidPmValue();
-  _pm_25[1].update.avg = utils::getInvalidPmValue();
-  _pm_25_sp[1].update.avg = utils::getInvalidPmValue();
-  _pm_25_pc[1].update.avg = utils::getInvalidPmValue();
-
-  _pm_10[0].update.avg = utils::getInvalidPmValue();
-  _pm_10_sp[0].update.avg = utils::getInvalidPmValue();
-  _pm_10_pc[0].update.avg = utils::getInvalidPmValue();
-  _pm_10[1].update.avg = utils::getInvalidPmValue();
-  _pm_10_sp[1].update.avg = utils::getInvalidPmValue();
-  _pm_10_pc[1].update.avg = utils::getInvalidPmValue();
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      Update &update = updateOf(desc.type, ch);
+      update.invalidCounter = 0;
+      update.max = 0;
+      update.window = 0;
+      update.avg = desc.invalidValue;
+    }
+  }
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    _filterModes[i] = MEASUREMENT_FILTER_MEAN;
+    _filterWindowOf[i] = -1;
+    _windows[i] = {};
+  }
+  // Every channel keeps one sample until its period is set
+  layoutWindows();
+
+  for (int i = 0; i < 2; i++) {
+    _snapshots[i].airQuality.pm25 = descriptor(PM25).invalidValue;
+    _snapshots[i].airQuality.aqi = _aqi.result();
+  }
+
+  // Readers always have a snapshot, even before the first update
+  _updated = true;
+  publish();
+}
+
+const Measurements::MeasurementDescriptor &Measurements::descriptor(MeasurementType type) {
+  if (type < 0 || type >= _MEASUREMENT_TYPE_MAX) {
+    Serial.printf("ERROR! Measurement type %d is undefined\n", (int)type);
+    delay(1000);
+    assert(0);
+  }
+  return MEASUREMENT_DESCRIPTORS[type];
+}
+
+Measurements::FloatValue *Measurements::floatValue(MeasurementType type, int ch) {
+  const MeasurementDescriptor &desc = descriptor(type);
+  if (!desc.isFloat) {
+    return nullptr;
+  }
+
+  // Measurement with only one channel ignore the channel
+  int slot = desc.slot + (ch <= desc.channels ? ch - 1 : 0);
+  return &_floatValues[slot];
+}
+
+Measurements::IntegerValue *Measurements::integerValue(MeasurementType type, int ch) {
+  const MeasurementDescriptor &desc = descriptor(type);
+  if (desc.isFloat) {
+    return nullptr;
+  }
+
+  // Measurement with only one channel ignore the channel
+  int slot = desc.slot + (ch <= desc.channels ? ch - 1 : 0);
+  return &_integerValues[slot];
+}
+
+Measurements::Update &Measurements::updateOf(MeasurementType type, int ch) {
+  if (descriptor(type).isFloat) {
+    return floatValue(type, ch)->update;
+  }
+  return integerValue(type, ch)->update;
+}
+
+float Measurements::averageOf(MeasurementType type, int ch) { return updateOf(type, ch).avg; }
+
+bool Measurements::isValid(MeasurementType type, float value) {
+  return descriptor(type).isValid(value);
 }
 
 void Measurements::setAirGradient(AirGradient *ag) { this->ag = ag; }
@@ -82,242 +255,201 @@ void Measurements::setSatellites(AgSatellites *satellites) { this->satellites_ =
 void Measurements::printCurrentAverage() {
   Serial.println();
   if (config.hasSensorS8) {
-    if (utils::isValidCO2(_co2.update.avg)) {
-      Serial.printf("CO2 = %.2f ppm\n", _co2.update.avg);
+    if (utils::isValidCO2(averageOf(CO2))) {
+      Serial.printf("CO2 = %.2f ppm\n", averageOf(CO2));
     } else {
       Serial.printf("CO2 = -\n");
     }
   }
 
   if (config.hasSensorSHT) {
-    if (utils::isValidTemperature(_temperature[0].update.avg)) {
-      Serial.printf("Temperature = %.2f C\n", _temperature[0].update.avg);
+    if (utils::isValidTemperature(averageOf(Temperature))) {
+      Serial.printf("Temperature = %.2f C\n", averageOf(Temperature));
     } else {
       Serial.printf("Temperature = -\n");
     }
-    if (utils::isValidHumidity(_humidity[0].update.avg)) {
-      Serial.printf("Relative Humidity = %.2f\n", _humidity[0].update.avg);
+    if (utils::isValidHumidity(averageOf(Humidity))) {
+      Serial.printf("Relative Humidity = %.2f\n", averageOf(Humidity));
     } else {
       Serial.printf("Relative Humidity = -\n");
     }
   }
 
   if (config.hasSensorSGP) {
-    if (utils::isValidVOC(_tvoc.update.avg)) {
-      Serial.printf("TVOC Index = %.1f\n", _tvoc.update.avg);
+    if (utils::isValidVOC(averageOf(TVOC))) {
+      Serial.printf("TVOC Index = %.1f\n", averageOf(TVOC));
     } else {
       Serial.printf("TVOC Index = -\n");
     }
-    if (utils::isValidVOC(_tvoc_raw.update.avg)) {
-      Serial.printf("TVOC Raw = %.1f\n", _tvoc_raw.update.avg);
+    if (utils::isValidVOC(averageOf(TVOCRaw))) {
+      Serial.printf("TVOC Raw = %.1f\n", averageOf(TVOCRaw));
     } else {
       Serial.printf("TVOC Raw = -\n");
     }
-    if (utils::isValidNOx(_nox.update.avg)) {
-      Serial.printf("NOx Index = %.1f\n", _nox.update.avg);
+    if (utils::isValidNOx(averageOf(NOx))) {
+      Serial.printf("NOx Index = %.1f\n", averageOf(NOx));
     } else {
       Serial.printf("NOx Index = -\n");
     }
-    if (utils::isValidNOx(_nox_raw.update.avg)) {
-      Serial.printf("NOx Raw = %.1f\n", _nox_raw.update.avg);
+    if (utils::isValidNOx(averageOf(NOxRaw))) {
+      Serial.printf("NOx Raw = %.1f\n", averageOf(NOxRaw));
     } else {
       Serial.printf("NOx Raw = -\n");
     }
   }
 
-  if (config.hasSensorPMS1 || config.hasSensorSPS30) {
-    printCurrentPMAverage(1);
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    if (!hasPMSChannel(ch)) {
+      continue;
+    }
+    printCurrentPMAverage(ch);
     if (!config.hasSensorSHT) {
-      if (utils::isValidTemperature(_temperature[0].update.avg)) {
-        Serial.printf("[1] Temperature = %.2f C\n", _temperature[0].update.avg);
+      if (utils::isValidTemperature(averageOf(Temperature, ch))) {
+        Serial.printf("[%d] Temperature = %.2f C\n", ch, averageOf(Temperature, ch));
       } else {
-        Serial.printf("[1] Temperature = -\n");
+        Serial.printf("[%d] Temperature = -\n", ch);
       }
-      if (utils::isValidHumidity(_humidity[0].update.avg)) {
-        Serial.printf("[1] Relative Humidity = %.2f\n", _humidity[0].update.avg);
+      if (utils::isValidHumidity(averageOf(Humidity, ch))) {
+        Serial.printf("[%d] Relative Humidity = %.2f\n", ch, averageOf(Humidity, ch));
       } else {
-        Serial.printf("[1] Relative Humidity = -\n");
+        Serial.printf("[%d] Relative Humidity = -\n", ch);
       }
     }
   }
-  if (config.hasSensorPMS2) {
-    printCurrentPMAverage(2);
-    if (!config.hasSensorSHT) {
-      if (utils::isValidTemperature(_temperature[1].update.avg)) {
-        Serial.printf("[2] Temperature = %.2f C\n", _temperature[1].update.avg);
-      } else {
-        Serial.printf("[2] Temperature = -\n");
+
+  Serial.println();
+}
+
+void Measurements::maxPeriod(MeasurementType type, int max) {
+  // Moving average window is sliced from the sample pool, make sure max period fit
+  if (max > MEASUREMENT_AVERAGE_MAX_PERIOD) {
+    Serial.printf("%s max period %d exceed list capacity, limit to %d\n",
+                  measurementTypeStr(type).c_str(), max, MEASUREMENT_AVERAGE_MAX_PERIOD);
+    max = MEASUREMENT_AVERAGE_MAX_PERIOD;
+  }
+
+  for (int ch = 1; ch <= descriptor(type).channels; ch++) {
+    updateOf(type, ch).max = max;
+    updateOf(type, ch).window = 0;
+  }
+  _windows[type].requested = max > 0 ? max : 0;
+  layoutWindows();
+}
+
+void Measurements::averagingWindow(MeasurementType type, uint32_t duration, uint32_t interval) {
+  // Values of every interval in duration, and the newest one pushed before the oldest one expires
+  uint32_t samples = MEASUREMENT_AVERAGE_MAX_PERIOD;
+  if (interval > 0) {
+    samples = (duration + interval - 1) / interval + 1;
+  }
+  if (samples > MEASUREMENT_AVERAGE_MAX_PERIOD) {
+    Serial.printf("%s window of %lums needs %lu samples, limit to %d\n",
+                  measurementTypeStr(type).c_str(), (unsigned long)duration,
+                  (unsigned long)samples, MEASUREMENT_AVERAGE_MAX_PERIOD);
+    samples = MEASUREMENT_AVERAGE_MAX_PERIOD;
+  }
+
+  for (int ch = 1; ch <= descriptor(type).channels; ch++) {
+    updateOf(type, ch).max = samples;
+    updateOf(type, ch).window = duration;
+  }
+  // Channels updated within half an interval of each other share the round time
+  _windows[type].requested = samples;
+  _windows[type].joinTime = (interval > 0 ? interval : duration / samples) / 2;
+  layoutWindows();
+}
+
+void Measurements::layoutWindows(void) {
+  // Room for a window of one sample is always left for the types after the one laid out
+  size_t reserved = 0;
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    reserved += windowBytes(1, MEASUREMENT_DESCRIPTORS[i].channels, true);
+  }
+
+  size_t used = 0;
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    Window &window = _windows[i];
+    bool timed = updateOf(desc.type, 1).window > 0;
+    reserved -= windowBytes(1, desc.channels, true);
+
+    size_t capacity = window.requested > 0 ? window.requested : 1;
+    size_t room = MEASUREMENT_SAMPLE_POOL - used - reserved;
+    while (capacity > 1 && windowBytes(capacity, desc.channels, timed) > room) {
+      capacity--;
+    }
+
+    if (window.offset != used || window.capacity != capacity || window.timed != timed) {
+      if (capacity < window.requested) {
+        Serial.printf("%s window needs %d samples, sample pool only has room for %d\n",
+                      measurementTypeStr(desc.type).c_str(), window.requested, (int)capacity);
       }
-      if (utils::isValidHumidity(_humidity[1].update.avg)) {
-        Serial.printf("[2] Relative Humidity = %.2f\n", _humidity[1].update.avg);
-      } else {
-        Serial.printf("[2] Relative Humidity = -\n");
+      window.offset = used;
+      window.capacity = capacity;
+      window.timed = timed;
+      uint8_t *slice = &_samplePool[used];
+      if (timed) {
+        _clocks[i].attach(reinterpret_cast<uint32_t *>(slice), capacity);
+        slice += capacity * sizeof(uint32_t);
+      }
+      for (int ch = 1; ch <= desc.channels; ch++) {
+        if (desc.isFloat) {
+          attachWindow(desc.type, ch, *floatValue(desc.type, ch), slice, capacity, timed);
+        } else {
+          attachWindow(desc.type, ch, *integerValue(desc.type, ch), slice, capacity, timed);
+        }
+        slice += channelBytes(capacity, timed);
       }
     }
+    _clocks[i].setJoinTime(window.joinTime);
+    used += windowBytes(capacity, desc.channels, timed);
+
+    // Limit the period to the slice, a time window keeps as many samples as it can
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      Update &update = updateOf(desc.type, ch);
+      update.max = timed || window.requested > capacity ? capacity : window.requested;
+    }
   }
+}
 
-  Serial.println();
+size_t Measurements::windowBytes(size_t capacity, int channels, bool timed) {
+  return (timed ? capacity * sizeof(uint32_t) : 0) + channels * channelBytes(capacity, timed);
 }
 
-void Measurements::maxPeriod(MeasurementType type, int max) {
-  switch (type) {
-  case Temperature:
-    _temperature[0].update.max = max;
-    _temperature[1].update.max = max;
-    break;
-  case Humidity:
-    _humidity[0].update.max = max;
-    _humidity[1].update.max = max;
-    break;
-  case CO2:
-    _co2.update.max = max;
-    break;
-  case TVOC:
-    _tvoc.update.max = max;
-    break;
-  case TVOCRaw:
-    _tvoc_raw.update.max = max;
-    break;
-  case NOx:
-    _nox.update.max = max;
-    break;
-  case NOxRaw:
-    _nox_raw.update.max = max;
-    break;
-  case PM25:
-    _pm_25[0].update.max = max;
-    _pm_25[1].update.max = max;
-    break;
-  case PM01:
-    _pm_01[0].update.max = max;
-    _pm_01[1].update.max = max;
-    break;
-  case PM10:
-    _pm_10[0].update.max = max;
-    _pm_10[1].update.max = max;
-    break;
-  case PM01_SP:
-    _pm_01_sp[0].update.max = max;
-    _pm_01_sp[1].update.max = max;
-    break;
-  case PM25_SP:
-    _pm_25_sp[0].update.max = max;
-    _pm_25_sp[1].update.max = max;
-    break;
-  case PM10_SP:
-    _pm_10_sp[0].update.max = max;
-    _pm_10_sp[1].update.max = max;
-    break;
-  case PM03_PC:
-    _pm_03_pc[0].update.max = max;
-    _pm_03_pc[1].update.max = max;
-    break;
-  case PM05_PC:
-    _pm_05_pc[0].update.max = max;
-    _pm_05_pc[1].update.max = max;
-    break;
-  case PM01_PC:
-    _pm_01_pc[0].update.max = max;
-    _pm_01_pc[1].update.max = max;
-    break;
-  case PM25_PC:
-    _pm_25_pc[0].update.max = max;
-    _pm_25_pc[1].update.max = max;
-    break;
-  case PM5_PC:
-    _pm_5_pc[0].update.max = max;
-    _pm_5_pc[1].update.max = max;
-    break;
-  case PM10_PC:
-    _pm_10_pc[0].update.max = max;
-    _pm_10_pc[1].update.max = max;
-    break;
-  };
+size_t Measurements::channelBytes(size_t capacity, bool timed) {
+  // Values, then the window statistics queues and the value rounds, padded for the next values
+  size_t bytes = capacity * (timed ? 3 : 2);
+  return capacity * sizeof(uint32_t) + (bytes + 3) / 4 * 4;
+}
+
+/** Values of a window are the first capacity 4 bytes elements of its slice */
+template <typename T>
+static void attachValues(RingBuffer<T, 0> &values, uint8_t *slice, size_t capacity) {
+  values.attach(reinterpret_cast<T *>(slice), capacity);
+}
+
+template <typename V>
+void Measurements::attachWindow(MeasurementType type, int ch, V &value, uint8_t *slice,
+                                size_t capacity, bool timed) {
+  attachValues(value.listValues, slice, capacity);
+  slice += capacity * sizeof(uint32_t);
+  value.statistics.attach(slice, capacity);
+  if (timed) {
+    value.timeWeighted.attach(slice + 2 * capacity, capacity);
+  }
+  value.sumValues = 0;
+  value.update.invalidCounter = 0;
+  value.update.avg = descriptor(type).invalidValue;
+  // Empty the sorted window of the channel too
+  resetFilter(type, value, _filterModes[type], filterWindow(type, ch));
 }
 
 bool Measurements::update(MeasurementType type, int val, int ch) {
   // Sanity check to validate channel, assert if invalid
   validateChannel(ch);
 
-  // Follow array indexing just for get address of the value type
-  ch = ch - 1;
-
   // Define data point source
-  IntegerValue *temporary = nullptr;
-  // Act as reference invalid value respective to target measurements
-  int invalidValue = 0;
-  switch (type) {
-  case CO2:
-    temporary = &_co2;
-    invalidValue = utils::getInvalidCO2();
-    break;
-  case TVOC:
-    temporary = &_tvoc;
-    invalidValue = utils::getInvalidVOC();
-    break;
-  case TVOCRaw:
-    temporary = &_tvoc_raw;
-    invalidValue = utils::getInvalidVOC();
-    break;
-  case NOx:
-    temporary = &_nox;
-    invalidValue = utils::getInvalidNOx();
-    break;
-  case NOxRaw:
-    temporary = &_nox_raw;
-    invalidValue = utils::getInvalidNOx();
-    break;
-  case PM25:
-    temporary = &_pm_25[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM01:
-    temporary = &_pm_01[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM10:
-    temporary = &_pm_10[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM01_SP:
-    temporary = &_pm_01_sp[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM25_SP:
-    temporary = &_pm_25_sp[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM10_SP:
-    temporary = &_pm_10_sp[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM03_PC:
-    temporary = &_pm_03_pc[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM05_PC:
-    temporary = &_pm_05_pc[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM01_PC:
-    temporary = &_pm_01_pc[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM25_PC:
-    temporary = &_pm_25_pc[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM5_PC:
-    temporary = &_pm_5_pc[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  case PM10_PC:
-    temporary = &_pm_10_pc[ch];
-    invalidValue = utils::getInvalidPmValue();
-    break;
-  default:
-    break;
-  };
+  IntegerValue *temporary = integerValue(type, ch);
 
   // Sanity check if measurement type is defined for integer data type or not
   if (temporary == nullptr) {
@@ -326,16 +458,70 @@ bool Measurements::update(MeasurementType type, int val, int ch) {
     return false;
   }
 
-  // Restore channel value for debugging purpose
-  ch = ch + 1;
+  return updateMovingAverage(type, *temporary, val, ch);
+}
+
+bool Measurements::update(MeasurementType type, float val, int ch) {
+  // Sanity check to validate channel, assert if invalid
+  validateChannel(ch);
+
+  // Define data point source
+  FloatValue *temporary = floatValue(type, ch);
+
+  // Sanity check if measurement type is defined for float data type or not
+  if (temporary == nullptr) {
+    Serial.printf("%s is not defined for float data type\n", measurementTypeStr(type).c_str());
+    // TODO: Just assert?
+    return false;
+  }
+
+  return updateMovingAverage(type, *temporary, val, ch);
+}
+
+template <typename V, typename T>
+bool Measurements::updateMovingAverage(MeasurementType type, V &value, T val, int ch) {
+  _updated = true;
+  if (type == PM25) {
+    _pm25Updated = true;
+  }
+
+  // Act as reference invalid value respective to target measurements
+  T invalidValue = descriptor(type).invalidValue;
+  MeasurementFilterMode mode = filterOf(type);
+  FilterWindow *sorted = filterWindow(type, ch);
+  SampleClock &clock = _clocks[type];
+  uint32_t now = millis();
+
+  // Remove the values older than the time window, invalid updates included so a sensor that
+  // stopped giving valid values doesn't keep its last average
+  bool expired = false;
+  while (value.update.window > 0 &&
+         value.timeWeighted.expired(now, value.update.window, clock)) {
+    removeOldest(type, value, sorted);
+    expired = true;
+  }
 
   if (val == invalidValue) {
-    temporary->update.invalidCounter++;
-    if (temporary->update.invalidCounter >= temporary->update.max) {
+    value.update.invalidCounter++;
+    if (value.update.window > 0) {
+      if (value.listValues.empty()) {
+        Serial.printf("%s{%d} no valid value in the last %lums! Setting its average value to "
+                      "invalid!\n",
+                      measurementTypeStr(type).c_str(), ch, (unsigned long)value.update.window);
+        value.update.avg = invalidValue;
+        return false;
+      }
+      if (expired && value.update.avg != invalidValue) {
+        value.update.avg = filteredAverage(value, mode, sorted);
+      }
+      return true;
+    }
+
+    if (value.update.invalidCounter >= value.update.max) {
       Serial.printf("%s{%d} invalid value update counter reached (%dx)! Setting its average value "
                     "to invalid!\n",
-                    measurementTypeStr(type).c_str(), ch, temporary->update.max);
-      temporary->update.avg = invalidValue;
+                    measurementTypeStr(type).c_str(), ch, value.update.max);
+      value.update.avg = invalidValue;
       return false;
     }
 
@@ -344,139 +530,195 @@ bool Measurements::update(MeasurementType type, int val, int ch) {
   }
 
   // Reset invalid counter when update new valid value
-  temporary->update.invalidCounter = 0;
+  value.update.invalidCounter = 0;
 
+  // Remove the oldest value on the list when the list already reach max elements
+  while (!value.listValues.empty() && (int)value.listValues.size() >= value.update.max) {
+    removeOldest(type, value, sorted);
+  }
   // Add new value to the end of the list
-  temporary->listValues.push_back(val);
-  // Sum the new value
-  temporary->sumValues = temporary->sumValues + val;
-  // Remove the oldest value on the list when the list exceed max elements
-  if (temporary->listValues.size() > temporary->update.max) {
-    auto it = temporary->listValues.begin();
-    temporary->sumValues = temporary->sumValues - *it; // subtract the oldest value from sum
-    temporary->listValues.erase(it);                   // And remove it from the list
+  value.listValues.push(val);
+  value.statistics.add(value.listValues);
+  if (value.update.window > 0) {
+    value.timeWeighted.add(value.listValues, clock, now);
+  }
+  if (sorted) {
+    sorted->insert(val);
   }
+  // Sum the new value
+  value.sumValues = value.sumValues + val;
 
   // Calculate average based on how many elements on the list
-  temporary->update.avg = temporary->sumValues / (float)temporary->listValues.size();
+  value.update.avg = filteredAverage(value, mode, sorted);
   if (_debug) {
-    Serial.printf("%s{%d}: %.2f\n", measurementTypeStr(type).c_str(), ch, temporary->update.avg);
+    Serial.printf("%s{%d}: %.2f\n", measurementTypeStr(type).c_str(), ch, value.update.avg);
   }
 
   return true;
 }
 
-bool Measurements::update(MeasurementType type, float val, int ch) {
-  // Sanity check to validate channel, assert if invalid
-  validateChannel(ch);
+template <typename V>
+void Measurements::removeOldest(MeasurementType type, V &value, FilterWindow *sorted) {
+  // subtract the oldest value from sum, and remove it from the list
+  value.sumValues = value.sumValues - value.listValues.front();
+  if (sorted) {
+    sorted->remove(value.listValues.front());
+  }
+  value.statistics.remove(value.listValues);
+  if (value.update.window > 0) {
+    value.timeWeighted.remove(value.listValues, _clocks[type]);
+  }
+  value.listValues.pop();
+}
 
-  // Follow array indexing just for get address of the value type
-  ch = ch - 1;
+MeasurementFilterMode Measurements::filterOf(MeasurementType type) {
+  uint32_t version = config.getValuesVersion();
+  if (version == _filtersVersion) {
+    return _filterModes[type];
+  }
+  _filtersVersion = version;
 
-  // Define data point source
-  FloatValue *temporary = nullptr;
-  // Act as reference invalid value respective to target measurements
-  float invalidValue = 0;
-  switch (type) {
-  case Temperature:
-    temporary = &_temperature[ch];
-    invalidValue = utils::getInvalidTemperature();
-    break;
-  case Humidity:
-    temporary = &_humidity[ch];
-    invalidValue = utils::getInvalidHumidity();
-    break;
-  default:
-    break;
+  bool changed = false;
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    MeasurementFilterMode mode = config.getMeasurementFilter(desc.type);
+    if (mode == _filterModes[i]) {
+      continue;
+    }
+
+    _filterModes[i] = mode;
+    changed = true;
+    Serial.printf("%s filter mode set to %s\n", measurementTypeStr(desc.type).c_str(),
+                  mode == MEASUREMENT_FILTER_HAMPEL   ? "hampel"
+                  : mode == MEASUREMENT_FILTER_MEDIAN ? "median"
+                                                      : "mean");
+  }
+  if (!changed) {
+    return _filterModes[type];
+  }
+
+  // Hand out the filter windows again in MeasurementType order, so they stay packed at the start
+  // of the pool, then rebuild every channel from its values
+  int next = 0;
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    _filterWindowOf[i] = -1;
+    if (_filterModes[i] != MEASUREMENT_FILTER_MEAN) {
+      if (next + desc.channels <= MEASUREMENT_FILTER_WINDOWS) {
+        _filterWindowOf[i] = next;
+        next += desc.channels;
+      } else {
+        Serial.printf("%s filter needs more than %d filter windows, filter by mean instead\n",
+                      measurementTypeStr(desc.type).c_str(), MEASUREMENT_FILTER_WINDOWS);
+        _filterModes[i] = MEASUREMENT_FILTER_MEAN;
+      }
+    }
+
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      if (desc.isFloat) {
+        resetFilter(desc.type, *floatValue(desc.type, ch), _filterModes[i],
+                    filterWindow(desc.type, ch));
+      } else {
+        resetFilter(desc.type, *integerValue(desc.type, ch), _filterModes[i],
+                    filterWindow(desc.type, ch));
+      }
+    }
   }
 
-  // Sanity check if measurement type is defined for float data type or not
-  if (temporary == nullptr) {
-    Serial.printf("%s is not defined for float data type\n", measurementTypeStr(type).c_str());
-    // TODO: Just assert?
-    return false;
+  return _filterModes[type];
+}
+
+Measurements::FilterWindow *Measurements::filterWindow(MeasurementType type, int ch) {
+  const MeasurementDescriptor &desc = descriptor(type);
+  if (_filterWindowOf[type] < 0) {
+    return nullptr;
   }
 
-  // Restore channel value for debugging purpose
-  ch = ch + 1;
+  // Measurement with only one channel ignore the channel
+  return &_filterWindows[_filterWindowOf[type] + (ch <= desc.channels ? ch - 1 : 0)];
+}
 
-  if (val == invalidValue) {
-    temporary->update.invalidCounter++;
-    if (temporary->update.invalidCounter >= temporary->update.max) {
-      Serial.printf("%s{%d} invalid value update counter reached (%dx)! Setting its average value "
-                    "to invalid!\n",
-                    measurementTypeStr(type).c_str(), ch, temporary->update.max);
-      temporary->update.avg = invalidValue;
-      return false;
+template <typename V>
+void Measurements::resetFilter(MeasurementType type, V &value, MeasurementFilterMode mode,
+                               FilterWindow *sorted) {
+  if (sorted) {
+    sorted->clear();
+    for (size_t i = 0; i < value.listValues.size(); i++) {
+      sorted->insert(value.listValues[i]);
     }
+  }
 
-    // Still consider updating value to valid
-    return true;
+  // Keep invalid average until a new valid value is updated
+  if (!value.listValues.empty() && value.update.avg != descriptor(type).invalidValue) {
+    value.update.avg = filteredAverage(value, mode, sorted);
   }
+}
 
-  // Reset invalid counter when update new valid value
-  temporary->update.invalidCounter = 0;
+template <typename V>
+float Measurements::filteredAverage(V &value, MeasurementFilterMode mode,
+                                    const FilterWindow *sorted) {
+  size_t count = value.listValues.size();
+  if (mode == MEASUREMENT_FILTER_MEDIAN) {
+    return sorted->median();
+  }
+  if (mode == MEASUREMENT_FILTER_MEAN && value.update.window > 0 && value.timeWeighted.span() > 0) {
+    // Weight each value by the time it covers
+    return value.timeWeighted.mean();
+  }
+  if (mode != MEASUREMENT_FILTER_HAMPEL || count < MEASUREMENT_HAMPEL_MIN_SAMPLES) {
+    return value.sumValues / (float)count;
+  }
 
-  // Add new value to the end of the list
-  temporary->listValues.push_back(val);
-  // Sum the new value
-  temporary->sumValues = temporary->sumValues + val;
-  // Remove the oldest value on the list when the list exceed max elements
-  if (temporary->listValues.size() > temporary->update.max) {
-    auto it = temporary->listValues.begin();
-    temporary->sumValues = temporary->sumValues - *it; // subtract the oldest value from sum
-    temporary->listValues.erase(it);                   // And remove it from the list
+  float median = sorted->median();
+  float sigma = 1.4826f * sorted->mad(median);
+  if (sigma < MEASUREMENT_HAMPEL_MIN_SIGMA) {
+    sigma = MEASUREMENT_HAMPEL_MIN_SIGMA;
   }
+  float bound = MEASUREMENT_HAMPEL_THRESHOLD * sigma;
 
-  // Calculate average based on how many elements on the list
-  temporary->update.avg = temporary->sumValues / (float)temporary->listValues.size();
-  if (_debug) {
-    Serial.printf("%s{%d}: %.2f\n", measurementTypeStr(type).c_str(), ch, temporary->update.avg);
+  // Outliers are at both ends of the sorted window, average them as if they were the median
+  float outlierSum = 0;
+  size_t outliers = 0;
+  for (size_t i = 0; i < count && (*sorted)[i] < median - bound; i++) {
+    outlierSum += (*sorted)[i];
+    outliers++;
+  }
+  for (size_t i = count; i > 0 && (*sorted)[i - 1] > median + bound; i--) {
+    outlierSum += (*sorted)[i - 1];
+    outliers++;
   }
 
-  return true;
+  return (value.sumValues - outlierSum + outliers * median) / (float)count;
 }
 
-int Measurements::get(MeasurementType type, int ch) {
+template <typename V> Measurements::Statistics Measurements::windowStatistics(const V &value) {
+  Statistics statistics = {};
+  statistics.count = value.listValues.size();
+  if (statistics.count > 0) {
+    statistics.mean = value.statistics.mean();
+    statistics.stddev = sqrtf(value.statistics.variance(value.listValues));
+    statistics.min = value.statistics.minimum(value.listValues);
+    statistics.max = value.statistics.maximum(value.listValues);
+  }
+  return statistics;
+}
+
+Measurements::Statistics Measurements::getStatistics(MeasurementType type, int ch) {
   // Sanity check to validate channel, assert if invalid
   validateChannel(ch);
 
-  // Follow array indexing just for get address of the value type
-  ch = ch - 1;
+  if (descriptor(type).isFloat) {
+    return windowStatistics(*floatValue(type, ch));
+  }
+  return windowStatistics(*integerValue(type, ch));
+}
+
+int Measurements::get(MeasurementType type, int ch) {
+  // Sanity check to validate channel, assert if invalid
+  validateChannel(ch);
 
   // Define data point source
-  IntegerValue *temporary = nullptr;
-  switch (type) {
-  case CO2:
-    temporary = &_co2;
-    break;
-  case TVOC:
-    temporary = &_tvoc;
-    break;
-  case TVOCRaw:
-    temporary = &_tvoc_raw;
-    break;
-  case NOx:
-    temporary = &_nox;
-    break;
-  case NOxRaw:
-    temporary = &_nox_raw;
-    break;
-  case PM25:
-    temporary = &_pm_25[ch];
-    break;
-  case PM01:
-    temporary = &_pm_01[ch];
-    break;
-  case PM10:
-    temporary = &_pm_10[ch];
-    break;
-  case PM03_PC:
-    temporary = &_pm_03_pc[ch];
-    break;
-  default:
-    break;
-  };
+  IntegerValue *temporary = integerValue(type, ch);
 
   // Sanity check if measurement type is defined for integer data type or not
   if (temporary == nullptr) {
@@ -497,21 +739,8 @@ float Measurements::getFloat(MeasurementType type, int ch) {
   // Sanity check to validate channel, assert if invalid
   validateChannel(ch);
 
-  // Follow array indexing just for get address of the value type
-  ch = ch - 1;
-
   // Define data point source
-  FloatValue *temporary = nullptr;
-  switch (type) {
-  case Temperature:
-    temporary = &_temperature[ch];
-    break;
-  case Humidity:
-    temporary = &_humidity[ch];
-    break;
-  default:
-    break;
-  }
+  FloatValue *temporary = floatValue(type, ch);
 
   // Sanity check if measurement type is defined for float data type or not
   if (temporary == nullptr) {
@@ -532,47 +761,8 @@ float Measurements::getAverage(MeasurementType type, int ch) {
   // Sanity check to validate channel, assert if invalid
   validateChannel(ch);
 
-  bool undefined = false;
-
-  // Follow array indexing just for get address of the value type
-  ch = ch - 1;
-
-  // Define data point source. Data type doesn't matter because only to get the average value
-  float measurementAverage;
-  switch (type) {
-  case CO2:
-    measurementAverage = _co2.update.avg;
-    break;
-  case TVOC:
-    measurementAverage = _tvoc.update.avg;
-    break;
-  case NOx:
-    measurementAverage = _nox.update.avg;
-    break;
-  case PM25:
-    measurementAverage = _pm_25[ch].update.avg;
-    break;
-  case Temperature:
-    measurementAverage = _temperature[ch].update.avg;
-    break;
-  case Humidity:
-    measurementAverage = _humidity[ch].update.avg;
-    break;
-  default:
-    // Invalidate, measurements type not handled
-    undefined = true;
-    break;
-  };
-
-  // Sanity check if measurement type is not defined
-  if (undefined) {
-    Serial.printf("ERROR! %s is not defined on get average value function\n",
-                  measurementTypeStr(type).c_str());
-    delay(1000);
-    assert(0);
-  }
-
-  return measurementAverage;
+  // Data type doesn't matter because only to get the average value
+  return averageOf(type, ch);
 }
 
 String Measurements::pms5003FirmwareVersion(int fwCode) {
@@ -588,137 +778,72 @@ String Measurements::pms5003FirmwareVersionBase(String prefix, int fwCode) {
 }
 
 String Measurements::measurementTypeStr(MeasurementType type) {
-  String str;
-  switch (type) {
-  case Temperature:
-    str = "Temperature";
-    break;
-  case Humidity:
-    str = "Humidity";
-    break;
-  case CO2:
-    str = "CO2";
-    break;
-  case TVOC:
-    str = "TVOC";
-    break;
-  case TVOCRaw:
-    str = "TVOCRaw";
-    break;
-  case NOx:
-    str = "NOx";
-    break;
-  case NOxRaw:
-    str = "NOxRaw";
-    break;
-  case PM25:
-    str = "PM25_AE";
-    break;
-  case PM01:
-    str = "PM1_AE";
-    break;
-  case PM10:
-    str = "PM10_AE";
-    break;
-  case PM25_SP:
-    str = "PM25_SP";
-    break;
-  case PM01_SP:
-    str = "PM1_SP";
-    break;
-  case PM10_SP:
-    str = "PM10_SP";
-    break;
-  case PM03_PC:
-    str = "PM003_PC";
-    break;
-  case PM05_PC:
-    str = "PM005_PC";
-    break;
-  case PM01_PC:
-    str = "PM01_PC";
-    break;
-  case PM25_PC:
-    str = "PM25_PC";
-    break;
-  case PM5_PC:
-    str = "PM05_PC";
-    break;
-  case PM10_PC:
-    str = "PM10_PC";
-    break;
-  default:
-    break;
-  };
-
-  return str;
+  return descriptor(type).name;
 }
 
 void Measurements::printCurrentPMAverage(int ch) {
-  int idx = ch - 1;
-
-  if (utils::isValidPm(_pm_01[idx].update.avg)) {
-    Serial.printf("[%d] Atmospheric PM 1.0 = %.2f ug/m3\n", ch, _pm_01[idx].update.avg);
+  if (utils::isValidPm(averageOf(PM01, ch))) {
+    Serial.printf("[%d] Atmospheric PM 1.0 = %.2f ug/m3\n", ch, averageOf(PM01, ch));
   } else {
     Serial.printf("[%d] Atmospheric PM 1.0 = -\n", ch);
   }
-  if (utils::isValidPm(_pm_25[idx].update.avg)) {
-    Serial.printf("[%d] Atmospheric PM 2.5 = %.2f ug/m3\n", ch, _pm_25[idx].update.avg);
+  if (utils::isValidPm(averageOf(PM25, ch))) {
+    Serial.printf("[%d] Atmospheric PM 2.5 = %.2f ug/m3\n", ch, averageOf(PM25, ch));
   } else {
     Serial.printf("[%d] Atmospheric PM 2.5 = -\n", ch);
   }
-  if (utils::isValidPm(_pm_10[idx].update.avg)) {
-    Serial.printf("[%d] Atmospheric PM 10 = %.2f ug/m3\n", ch, _pm_10[idx].update.avg);
+  if (utils::isValidPm(averageOf(PM10, ch))) {
+    Serial.printf("[%d] Atmospheric PM 10 = %.2f ug/m3\n", ch, averageOf(PM10, ch));
   } else {
     Serial.printf("[%d] Atmospheric PM 10 = -\n", ch);
   }
-  if (utils::isValidPm(_pm_01_sp[idx].update.avg)) {
-    Serial.printf("[%d] Standard Particle PM 1.0 = %.2f ug/m3\n", ch, _pm_01_sp[idx].update.avg);
+  if (utils::isValidPm(averageOf(PM01_SP, ch))) {
+    Serial.printf("[%d] Standard Particle PM 1.0 = %.2f ug/m3\n", ch, averageOf(PM01_SP, ch));
   } else {
     Serial.printf("[%d] Standard Particle PM 1.0 = -\n", ch);
   }
-  if (utils::isValidPm(_pm_25_sp[idx].update.avg)) {
-    Serial.printf("[%d] Standard Particle PM 2.5 = %.2f ug/m3\n", ch, _pm_25_sp[idx].update.avg);
+  if (utils::isValidPm(averageOf(PM25_SP, ch))) {
+    Serial.printf("[%d] Standard Particle PM 2.5 = %.2f ug/m3\n", ch, averageOf(PM25_SP, ch));
   } else {
     Serial.printf("[%d] Standard Particle PM 2.5 = -\n", ch);
   }
-  if (utils::isValidPm(_pm_10_sp[idx].update.avg)) {
-    Serial.printf("[%d] Standard Particle PM 10 = %.2f ug/m3\n", ch, _pm_10_sp[idx].update.avg);
+  if (utils::isValidPm(averageOf(PM10_SP, ch))) {
+    Serial.printf("[%d] Standard Particle PM 10 = %.2f ug/m3\n", ch, averageOf(PM10_SP, ch));
   } else {
     Serial.printf("[%d] Standard Particle PM 10 = -\n", ch);
   }
-  if (utils::isValidPm03Count(_pm_03_pc[idx].update.avg)) {
-    Serial.printf("[%d] Particle Count 0.3 = %.1f\n", ch, _pm_03_pc[idx].update.avg);
+  if (utils::isValidPm03Count(averageOf(PM03_PC, ch))) {
+    Serial.printf("[%d] Particle Count 0.3 = %.1f\n", ch, averageOf(PM03_PC, ch));
   } else {
     Serial.printf("[%d] Particle Count 0.3 = -\n", ch);
   }
-  if (utils::isValidPm03Count(_pm_05_pc[idx].update.avg)) {
-    Serial.printf("[%d] Particle Count 0.5 = %.1f\n", ch, _pm_05_pc[idx].update.avg);
+  if (utils::isValidPm03Count(averageOf(PM05_PC, ch))) {
+    Serial.printf("[%d] Particle Count 0.5 = %.1f\n", ch, averageOf(PM05_PC, ch));
   } else {
     Serial.printf("[%d] Particle Count 0.5 = -\n", ch);
   }
-  if (utils::isValidPm03Count(_pm_01_pc[idx].update.avg)) {
-    Serial.printf("[%d] Particle Count 1.0 = %.1f\n", ch, _pm_01_pc[idx].update.avg);
+  if (utils::isValidPm03Count(averageOf(PM01_PC, ch))) {
+    Serial.printf("[%d] Particle Count 1.0 = %.1f\n", ch, averageOf(PM01_PC, ch));
   } else {
     Serial.printf("[%d] Particle Count 1.0 = -\n", ch);
   }
-  if (utils::isValidPm03Count(_pm_25_pc[idx].update.avg)) {
-    Serial.printf("[%d] Particle Count 2.5 = %.1f\n", ch, _pm_25_pc[idx].update.avg);
+  if (utils::isValidPm03Count(averageOf(PM25_PC, ch))) {
+    Serial.printf("[%d] Particle Count 2.5 = %.1f\n", ch, averageOf(PM25_PC, ch));
   } else {
     Serial.printf("[%d] Particle Count 2.5 = -\n", ch);
   }
 
-  if (_pm_5_pc[idx].listValues.empty() == false) {
-    if (utils::isValidPm03Count(_pm_5_pc[idx].update.avg)) {
-      Serial.printf("[%d] Particle Count 5.0 = %.1f\n", ch, _pm_5_pc[idx].update.avg);
+  if (integerValue(PM5_PC, ch)->listValues.empty() == false) {
+    if (utils::isValidPm03Count(averageOf(PM5_PC, ch))) {
+      Serial.printf("[%d] Particle Count 5.0 = %.1f\n", ch, averageOf(PM5_PC, ch));
     } else {
       Serial.printf("[%d] Particle Count 5.0 = -\n", ch);
     }
   }
 
-  if (_pm_10_pc[idx].listValues.empty() == false) {
-    if (utils::isValidPm03Count(_pm_10_pc[idx].update.avg)) {
-      Serial.printf("[%d] Particle Count 10 = %.1f\n", ch, _pm_10_pc[idx].update.avg);
+  if (integerValue(PM10_PC, ch)->listValues.empty() == false) {
+    if (utils::isValidPm03Count(averageOf(PM10_PC, ch))) {
+      Serial.printf("[%d] Particle Count 10 = %.1f\n", ch, averageOf(PM10_PC, ch));
     } else {
       Serial.printf("[%d] Particle Count 10 = -\n", ch);
     }
@@ -726,27 +851,67 @@ void Measurements::printCurrentPMAverage(int ch) {
 }
 
 void Measurements::validateChannel(int ch) {
-  if (ch != 1 && ch != 2) {
-    Serial.printf("ERROR! Channel %d is undefined. Only channel 1 or 2 is the optional value!", ch);
+  if (ch < 1 || ch > MEASUREMENT_CHANNELS) {
+    Serial.printf("ERROR! Channel %d is undefined. Only channel 1 to %d is the optional value!",
+                  ch, MEASUREMENT_CHANNELS);
     delay(1000);
     assert(0);
   }
 }
 
+bool Measurements::hasPMSChannel(int ch) {
+  switch (ch) {
+  case 1:
+    return config.hasSensorPMS1 || config.hasSensorSPS30;
+  case 2:
+    return config.hasSensorPMS2;
+  default:
+    // Extra co-location sensors have no configuration flag, present once they have a value
+    return utils::isValidPm(averageOf(PM25, ch));
+  }
+}
+
 float Measurements::getCorrectedTempHum(MeasurementType type, int ch, bool forceCorrection) {
   // Sanity check to validate channel, assert if invalid
   validateChannel(ch);
 
-  // Follow array indexing just for get address of the value type
-  ch = ch - 1;
-  bool undefined = false;
+  // Nothing updated since the last publish, its corrections are of the same averages
+  if (!_updated) {
+    uint32_t version = _snapshotVersion;
+    __sync_synchronize();
+    float corrected = getCorrectedTempHum(_snapshots[version & 1], type, ch, forceCorrection);
+    __sync_synchronize();
+    if (_snapshotVersion == version) {
+      return corrected;
+    }
+  }
+
+  return correctTempHum(type, averageOf(type, ch), forceCorrection);
+}
+
+float Measurements::getCorrectedTempHum(const Measures &mc, MeasurementType type, int ch,
+                                        bool forceCorrection) {
+  return correctTempHum(type, valueOf(mc, type, ch), forceCorrection);
+}
+
+float Measurements::getCorrectedTempHum(const Snapshot &snapshot, MeasurementType type, int ch,
+                                        bool forceCorrection) {
+  if (type == Temperature) {
+    return correctedOf(snapshot,
+                       forceCorrection ? CorrectedTemperatureForced : CorrectedTemperature, ch);
+  }
+  if (type == Humidity) {
+    return correctedOf(snapshot, forceCorrection ? CorrectedHumidityForced : CorrectedHumidity,
+                       ch);
+  }
+  return getCorrectedTempHum(snapshot.average, type, ch, forceCorrection);
+}
 
-  float rawValue;
+float Measurements::correctTempHum(MeasurementType type, float rawValue, bool forceCorrection) {
   Configuration::TempHumCorrection correction;
 
   switch (type) {
   case Temperature: {
-    rawValue = _temperature[ch].update.avg;
     Configuration::TempHumCorrection tmp = config.getTempCorrection();
 
     // Apply 'standard' correction if its defined or correction forced
@@ -763,7 +928,6 @@ float Measurements::getCorrectedTempHum(MeasurementType type, int ch, bool force
     break;
   }
   case Humidity: {
-    rawValue = _humidity[ch].update.avg;
     Configuration::TempHumCorrection tmp = config.getHumCorrection();
 
     // Apply 'standard' correction if its defined or correction forced
@@ -798,23 +962,187 @@ float Measurements::getCorrectedTempHum(MeasurementType type, int ch, bool force
   return corrected;
 }
 
-float Measurements::getCorrectedPM25(bool useAvg, int ch, bool forceCorrection) {
-  float pm25;
-  float corrected;
-  float humidity;
-  float pm003Count;
-  if (useAvg) {
-    // Directly call from the index
-    int channel = ch - 1; // Array index
-    pm25 = _pm_25[channel].update.avg;
-    humidity = _humidity[channel].update.avg;
-    pm003Count = _pm_03_pc[channel].update.avg;
+float Measurements::getCorrectedPM25(bool useAvg, int ch, bool forceCorrection) {
+  // Nothing updated since the last publish, its corrections are of the same values
+  if (!_updated) {
+    uint32_t version = _snapshotVersion;
+    __sync_synchronize();
+    float corrected = getCorrectedPM25(_snapshots[version & 1], useAvg, ch, forceCorrection);
+    __sync_synchronize();
+    if (_snapshotVersion == version) {
+      return corrected;
+    }
+  }
+
+  if (useAvg) {
+    // Directly call from the index
+    return correctPM25(averageOf(PM25, ch), averageOf(Humidity, ch), averageOf(PM03_PC, ch),
+                       forceCorrection);
+  }
+  return correctPM25(get(PM25, ch), getFloat(Humidity, ch), get(PM03_PC, ch), forceCorrection);
+}
+
+float Measurements::getCorrectedPM25(const Measures &mc, int ch, bool forceCorrection) {
+  return correctPM25(valueOf(mc, PM25, ch), valueOf(mc, Humidity, ch), valueOf(mc, PM03_PC, ch),
+                     forceCorrection);
+}
+
+float Measurements::getCorrectedPM25(const Snapshot &snapshot, bool useAvg, int ch,
+                                     bool forceCorrection) {
+  if (!useAvg) {
+    if (forceCorrection) {
+      return getCorrectedPM25(snapshot.latest, ch, true);
+    }
+    return correctedOf(snapshot, CorrectedPM25Latest, ch);
+  }
+  return correctedOf(snapshot, forceCorrection ? CorrectedPM25Forced : CorrectedPM25, ch);
+}
+
+float Measurements::computeCorrected(const Snapshot &snapshot, CorrectedValue value, int ch) {
+  switch (value) {
+  case CorrectedPM25:
+    return getCorrectedPM25(snapshot.average, ch, false);
+  case CorrectedPM25Forced:
+    return getCorrectedPM25(snapshot.average, ch, true);
+  case CorrectedPM25Latest:
+    return getCorrectedPM25(snapshot.latest, ch, false);
+  case CorrectedTemperature:
+    return getCorrectedTempHum(snapshot.average, Temperature, ch, false);
+  case CorrectedTemperatureForced:
+    return getCorrectedTempHum(snapshot.average, Temperature, ch, true);
+  case CorrectedHumidity:
+    return getCorrectedTempHum(snapshot.average, Humidity, ch, false);
+  default:
+    return getCorrectedTempHum(snapshot.average, Humidity, ch, true);
+  }
+}
+
+/**
+ * @brief Get a corrected value memoized on the snapshot, or compute it and ask the next publish
+ * to memoize it
+ */
+float Measurements::correctedOf(const Snapshot &snapshot, CorrectedValue value, int ch) {
+  // Sanity check to validate channel, assert if invalid
+  validateChannel(ch);
+
+  const Corrections &corrections = snapshot.corrections;
+  if ((corrections.computed & (1UL << (value * MEASUREMENT_CHANNELS + ch - 1))) &&
+      corrections.configVersion == config.getValuesVersion()) {
+    return corrections.values[value][ch - 1];
+  }
+
+  _correctionRequested[value][ch - 1] = true;
+  return computeCorrected(snapshot, value, ch);
+}
+
+/**
+ * @brief Set the corrected values asked by readers on a snapshot being published, only
+ * computing the ones whose inputs changed since the previous snapshot
+ */
+void Measurements::updateCorrections(Snapshot &snapshot, const Snapshot &previous) {
+  Corrections &corrections = snapshot.corrections;
+  const Corrections &memo = previous.corrections;
+  corrections.computed = 0;
+  corrections.configVersion = config.getValuesVersion();
+  if (ag == nullptr) {
+    // Correction functions belong to the sensors, computed once it is set
+    return;
+  }
+
+  bool stale = memo.configVersion != corrections.configVersion;
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    const auto changed = [&](const Measures &current, const Measures &before,
+                             MeasurementType type) {
+      return valueOf(current, type, ch) != valueOf(before, type, ch);
+    };
+    bool pm25Changed = changed(snapshot.average, previous.average, PM25) ||
+                       changed(snapshot.average, previous.average, Humidity) ||
+                       changed(snapshot.average, previous.average, PM03_PC);
+    bool pm25LatestChanged = changed(snapshot.latest, previous.latest, PM25) ||
+                             changed(snapshot.latest, previous.latest, Humidity) ||
+                             changed(snapshot.latest, previous.latest, PM03_PC);
+    bool temperatureChanged = changed(snapshot.average, previous.average, Temperature);
+    bool humidityChanged = changed(snapshot.average, previous.average, Humidity);
+
+    for (int i = 0; i < _CORRECTED_VALUE_MAX; i++) {
+      CorrectedValue value = (CorrectedValue)i;
+      if (!_correctionRequested[value][ch - 1]) {
+        continue;
+      }
+
+      bool inputChanged;
+      switch (value) {
+      case CorrectedPM25:
+      case CorrectedPM25Forced:
+        inputChanged = pm25Changed;
+        break;
+      case CorrectedPM25Latest:
+        inputChanged = pm25LatestChanged;
+        break;
+      case CorrectedTemperature:
+      case CorrectedTemperatureForced:
+        inputChanged = temperatureChanged;
+        break;
+      default:
+        inputChanged = humidityChanged;
+        break;
+      }
+
+      uint32_t bit = 1UL << (value * MEASUREMENT_CHANNELS + ch - 1);
+      if (!stale && !inputChanged && (memo.computed & bit)) {
+        corrections.values[value][ch - 1] = memo.values[value][ch - 1];
+      } else {
+        corrections.values[value][ch - 1] = computeCorrected(snapshot, value, ch);
+      }
+      corrections.computed |= bit;
+    }
+  }
+}
+
+/**
+ * @brief Add the PM2.5 of a snapshot being published to the air quality index. Only called once
+ * per PM2.5 update, so the hourly means are not weighted by the updates of other measurements
+ */
+void Measurements::updateAirQuality(Snapshot &snapshot) {
+  // Correction needs the humidity of the SHT, as the display always did
+  bool correct = ag != nullptr && config.hasSensorSHT && config.isPMCorrectionEnabled();
+  int channels = config.hasSensorPMS1 && config.hasSensorPMS2 ? MEASUREMENT_CHANNELS : 1;
+  float pm25[MEASUREMENT_CHANNELS] = {};
+  bool valid[MEASUREMENT_CHANNELS] = {};
+  bool anyValid = false;
+  for (int ch = 1; ch <= channels; ch++) {
+    pm25[ch - 1] = valueOf(snapshot.average, PM25, ch);
+    valid[ch - 1] = utils::isValidPm(round(pm25[ch - 1]));
+    if (valid[ch - 1] && correct) {
+      pm25[ch - 1] = correctedOf(snapshot, CorrectedPM25, ch);
+    }
+    anyValid = anyValid || valid[ch - 1];
+  }
+
+  AirQuality &airQuality = snapshot.airQuality;
+  if (anyValid) {
+    airQuality.pm25 = snapshot.pmsFusion.combine(pm25, valid);
   } else {
-    pm25 = get(PM25, ch);
-    humidity = getFloat(Humidity, ch);
-    pm003Count = get(PM03_PC, ch);
+    airQuality.pm25 = pm25[0];
+  }
+
+  // Standard only change with the country, don't look it up on every publish
+  uint32_t version = config.getValuesVersion();
+  if (version != _configValuesVersion) {
+    _configValuesVersion = version;
+    AirQualityIndex::Standard standard = AirQualityIndex::standardOf(config.values().country);
+    if (standard != _aqi.standard()) {
+      Serial.printf("Air quality index standard: %s\n", AirQualityIndex::name(standard));
+      _aqi.setStandard(standard);
+    }
   }
+  _aqi.add(airQuality.pm25, anyValid, millis());
+  airQuality.aqi = _aqi.result();
+}
 
+float Measurements::correctPM25(float pm25, float humidity, float pm003Count,
+                                bool forceCorrection) {
+  float corrected;
   Configuration::PMCorrection pmCorrection = config.getPMCorrection();
   switch (pmCorrection.algorithm) {
   case PMCorrectionAlgorithm::COR_ALGO_PM_UNKNOWN:
@@ -861,735 +1189,1125 @@ float Measurements::getCorrectedPM25(bool useAvg, int ch, bool forceCorrection)
 }
 
 Measurements::Measures Measurements::getMeasures() {
-  Measures mc;
+  Snapshot published;
+  snapshot(published);
+  Measures mc = published.average;
   mc.bootCount = _bootCount;
   mc.freeHeap = ESP.getFreeHeap();
-  // co2, tvoc, nox
-  mc.co2 = _co2.update.avg;
-  mc.tvoc = _tvoc.update.avg;
-  mc.tvoc_raw = _tvoc_raw.update.avg;
-  mc.nox = _nox.update.avg;
-  mc.nox_raw = _nox_raw.update.avg;
-  // Temperature & Humidity
-  mc.temperature[0] = _temperature[0].update.avg;
-  mc.humidity[0] = _humidity[0].update.avg;
-  mc.temperature[1] = _temperature[1].update.avg;
-  mc.humidity[1] = _humidity[1].update.avg;
-  // PM atmospheric
-  mc.pm_01[0] = _pm_01[0].update.avg;
-  mc.pm_25[0] = _pm_25[0].update.avg;
-  mc.pm_10[0] = _pm_10[0].update.avg;
-  mc.pm_01[1] = _pm_01[1].update.avg;
-  mc.pm_25[1] = _pm_25[1].update.avg;
-  mc.pm_10[1] = _pm_10[1].update.avg;
-  // PM standard particle
-  mc.pm_01_sp[0] = _pm_01_sp[0].update.avg;
-  mc.pm_25_sp[0] = _pm_25_sp[0].update.avg;
-  mc.pm_10_sp[0] = _pm_10_sp[0].update.avg;
-  mc.pm_01_sp[1] = _pm_01_sp[1].update.avg;
-  mc.pm_25_sp[1] = _pm_25_sp[1].update.avg;
-  mc.pm_10_sp[1] = _pm_10_sp[1].update.avg;
-  // Particle Count
-  mc.pm_03_pc[0] = _pm_03_pc[0].update.avg;
-  mc.pm_05_pc[0] = _pm_05_pc[0].update.avg;
-  mc.pm_01_pc[0] = _pm_01_pc[0].update.avg;
-  mc.pm_25_pc[0] = _pm_25_pc[0].update.avg;
-  mc.pm_5_pc[0] = _pm_5_pc[0].update.avg;
-  mc.pm_10_pc[0] = _pm_10_pc[0].update.avg;
-  mc.pm_03_pc[1] = _pm_03_pc[1].update.avg;
-  mc.pm_05_pc[1] = _pm_05_pc[1].update.avg;
-  mc.pm_01_pc[1] = _pm_01_pc[1].update.avg;
-  mc.pm_25_pc[1] = _pm_25_pc[1].update.avg;
-  mc.pm_5_pc[1] = _pm_5_pc[1].update.avg;
-  mc.pm_10_pc[1] = _pm_10_pc[1].update.avg;
 
+  // Leave a faulty PMS channel out while another one is healthier and has a value, so it is not
+  // averaged into the measures payload
+  const Fusion::Status &fusion = published.pmsFusion;
+  bool healthyValid = false;
+  for (int i = 0; i < MEASUREMENT_CHANNELS; i++) {
+    healthyValid = healthyValid || (fusion.health[i] != Fusion::HealthFaulty &&
+                                    utils::isValidPm(valueOf(mc, PM25, i + 1)));
+  }
+  for (int i = 0; i < MEASUREMENT_CHANNELS && healthyValid; i++) {
+    if (fusion.health[i] != Fusion::HealthFaulty) {
+      continue;
+    }
+    float *values = (float *)&mc;
+    for (int t = 0; t < _MEASUREMENT_TYPE_MAX; t++) {
+      const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[t];
+      if (desc.group == GroupPM && desc.channels > i) {
+        values[measuresIndex(desc) + i] = desc.invalidValue;
+      }
+    }
+  }
   return mc;
 }
 
-std::string Measurements::buildMeasuresPayload(Measures &mc, bool extendedPmMeasures) {
-  std::ostringstream oss;
+void Measurements::publish() {
+  if (!_updated) {
+    return;
+  }
+  _updated = false;
+
+  // Only this task change the version, readers copy the snapshot it points to. The barrier order
+  // the previous version store before the writes, so readers see the version change before the
+  // snapshot they copy is overwritten
+  uint32_t version = _snapshotVersion + 1;
+  __sync_synchronize();
+
+  Snapshot &snapshot = _snapshots[version & 1];
+  float *average = (float *)&snapshot.average;
+  float *latest = (float *)&snapshot.latest;
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      int index = measuresIndex(desc) + ch - 1;
+      average[index] = averageOf(desc.type, ch);
+      // Same as get() and getFloat(), 0 if there is no value yet
+      if (desc.isFloat) {
+        FloatValue *value = floatValue(desc.type, ch);
+        latest[index] = value->listValues.empty() ? 0 : value->listValues.back();
+        snapshot.statistics[index] = windowStatistics(*value);
+      } else {
+        IntegerValue *value = integerValue(desc.type, ch);
+        latest[index] = value->listValues.empty() ? 0 : value->listValues.back();
+        snapshot.statistics[index] = windowStatistics(*value);
+      }
+    }
+  }
+  snapshot.average.bootCount = snapshot.latest.bootCount = 0;
+  snapshot.average.signal = snapshot.latest.signal = 0;
+  snapshot.average.freeHeap = snapshot.latest.freeHeap = 0;
+  snapshot.pmsFusion = _pmsFusion.status();
+  // Previous snapshot is the one readers copy, only this task writes it
+  updateCorrections(snapshot, _snapshots[(version - 1) & 1]);
+  if (_pm25Updated) {
+    _pm25Updated = false;
+    updateAirQuality(snapshot);
+  } else {
+    snapshot.airQuality = _snapshots[(version - 1) & 1].airQuality;
+  }
+  snapshot.version = version;
+
+  // Snapshot writes complete before it is pointed by the version
+  __sync_synchronize();
+  _snapshotVersion = version;
+}
 
-  // CO2
-  if (utils::isValidCO2(mc.co2)) {
-    oss << std::round(mc.co2);
+Measurements::AirQuality Measurements::getAirQuality() {
+  for (;;) {
+    uint32_t version = _snapshotVersion;
+    __sync_synchronize();
+    AirQuality copy = _snapshots[version & 1].airQuality;
+    __sync_synchronize();
+
+    // Same as snapshot(), without copying every measurement
+    if (_snapshotVersion == version) {
+      return copy;
+    }
   }
+}
 
-  oss << ",";
+void Measurements::fusePMS() {
+  // Channel sample is valid if the last update was, it is then the latest value
+  bool valid[MEASUREMENT_CHANNELS];
+  float value[MEASUREMENT_CHANNELS];
+  for (int i = 0; i < MEASUREMENT_CHANNELS; i++) {
+    IntegerValue *pm25 = integerValue(PM25, i + 1);
+    valid[i] = pm25->update.invalidCounter == 0 && !pm25->listValues.empty();
+    value[i] = valid[i] ? pm25->listValues.back() : 0;
+  }
+
+  Fusion::Status previous = _pmsFusion.status();
+  _pmsFusion.update(value, valid);
+  const Fusion::Status &status = _pmsFusion.status();
+  for (int i = 0; i < MEASUREMENT_CHANNELS; i++) {
+    if (status.health[i] != previous.health[i]) {
+      Serial.printf("PMS channel %d health changed: %s -> %s\n", i + 1,
+                    Fusion::healthName(previous.health[i]),
+                    Fusion::healthName(status.health[i]));
+    }
+  }
+  _updated = true;
+}
 
-  // Temperature
-  if (utils::isValidTemperature(mc.temperature[0]) &&
-      utils::isValidTemperature(mc.temperature[1])) {
-    float temp = (mc.temperature[0] + mc.temperature[1]) / 2.0f;
-    oss << std::round(temp * 10);
-  } else if (utils::isValidTemperature(mc.temperature[0])) {
-    oss << std::round(mc.temperature[0] * 10);
-  } else if (utils::isValidTemperature(mc.temperature[1])) {
-    oss << std::round(mc.temperature[1] * 10);
+void Measurements::snapshot(Snapshot &out) {
+  for (;;) {
+    uint32_t version = _snapshotVersion;
+    __sync_synchronize();
+    out = _snapshots[version & 1];
+    __sync_synchronize();
+
+    // Writer only fill the other snapshot until it publish the next version, so the copy is
+    // consistent if the version did not change
+    if (_snapshotVersion == version) {
+      return;
+    }
   }
+}
 
-  oss << ",";
+float Measurements::valueOf(const Measures &mc, MeasurementType type, int ch) {
+  const MeasurementDescriptor &desc = descriptor(type);
+  // Measurement with only one channel ignore the channel
+  int index = measuresIndex(desc) + (ch >= 1 && ch <= desc.channels ? ch - 1 : 0);
+  return ((const float *)&mc)[index];
+}
 
-  // Humidity
-  if (utils::isValidHumidity(mc.humidity[0]) && utils::isValidHumidity(mc.humidity[1])) {
-    float hum = (mc.humidity[0] + mc.humidity[1]) / 2.0f;
-    oss << std::round(hum * 10);
-  } else if (utils::isValidHumidity(mc.humidity[0])) {
-    oss << std::round(mc.humidity[0] * 10);
-  } else if (utils::isValidHumidity(mc.humidity[1])) {
-    oss << std::round(mc.humidity[1] * 10);
+float Measurements::fusedOf(const Snapshot &snapshot, const Measures &mc, MeasurementType type) {
+  const MeasurementDescriptor &desc = descriptor(type);
+  float values[MEASUREMENT_CHANNELS];
+  bool valid[MEASUREMENT_CHANNELS];
+  float sum = 0;
+  int count = 0;
+  for (int i = 0; i < MEASUREMENT_CHANNELS; i++) {
+    values[i] = valueOf(mc, type, i + 1);
+    valid[i] = i < desc.channels && desc.isValid(values[i]);
+    if (valid[i]) {
+      sum += values[i];
+      count++;
+    }
+  }
+  if (count == 0) {
+    return desc.invalidValue;
+  }
+  // Only PM channels are arbitrated, others are averaged
+  if (desc.group == GroupPM) {
+    return snapshot.pmsFusion.combine(values, valid);
   }
+  return sum / count;
+}
 
-  oss << ",";
+const Measurements::Statistics &Measurements::statisticsOf(const Snapshot &snapshot,
+                                                           MeasurementType type, int ch) {
+  const MeasurementDescriptor &desc = descriptor(type);
+  // Same index as valueOf
+  int index = measuresIndex(desc) + (ch >= 1 && ch <= desc.channels ? ch - 1 : 0);
+  return snapshot.statistics[index];
+}
 
-  /// PM1.0 atmospheric environment
-  if (utils::isValidPm(mc.pm_01[0]) && utils::isValidPm(mc.pm_01[1])) {
-    float pm01 = (mc.pm_01[0] + mc.pm_01[1]) / 2.0f;
-    oss << std::round(pm01 * 10);
-  } else if (utils::isValidPm(mc.pm_01[0])) {
-    oss << std::round(mc.pm_01[0] * 10);
-  } else if (utils::isValidPm(mc.pm_01[1])) {
-    oss << std::round(mc.pm_01[1] * 10);
+/** Measures field sent on the cellular payload */
+struct MeasuresPayloadField {
+  Measurements::MeasurementType type;
+  size_t offset;   // Offset of the value (array of channels) in Measures
+  int scale;       // Value is sent as integer of value * scale
+  int32_t minimum; // PackedMeasures keep the sent value as a 16 bits offset from minimum
+};
+
+/** Cellular payload fields in payload order, before signal */
+static const MeasuresPayloadField MEASURES_PAYLOAD_FIELDS[] = {
+    {Measurements::CO2, offsetof(Measurements::Measures, co2), 1, 0},
+    {Measurements::Temperature, offsetof(Measurements::Measures, temperature), 10, INT16_MIN},
+    {Measurements::Humidity, offsetof(Measurements::Measures, humidity), 10, 0},
+    {Measurements::PM01, offsetof(Measurements::Measures, pm_01), 10, 0},
+    {Measurements::PM25, offsetof(Measurements::Measures, pm_25), 10, 0},
+    {Measurements::PM10, offsetof(Measurements::Measures, pm_10), 10, 0},
+    {Measurements::TVOC, offsetof(Measurements::Measures, tvoc), 1, 0},
+    {Measurements::NOx, offsetof(Measurements::Measures, nox), 1, 0},
+    {Measurements::PM03_PC, offsetof(Measurements::Measures, pm_03_pc), 1, 0},
+};
+
+/** Extended PM fields, sent after the MAX payload placeholders */
+static const MeasuresPayloadField MEASURES_PAYLOAD_EXTENDED_FIELDS[] = {
+    {Measurements::PM05_PC, offsetof(Measurements::Measures, pm_05_pc), 1, 0},
+    {Measurements::PM01_PC, offsetof(Measurements::Measures, pm_01_pc), 1, 0},
+    {Measurements::PM25_PC, offsetof(Measurements::Measures, pm_25_pc), 1, 0},
+    {Measurements::PM5_PC, offsetof(Measurements::Measures, pm_5_pc), 1, 0},
+    {Measurements::PM10_PC, offsetof(Measurements::Measures, pm_10_pc), 1, 0},
+    {Measurements::PM25_SP, offsetof(Measurements::Measures, pm_25_sp), 10, 0},
+};
+
+/** PackedMeasures keep the signal as a 16 bits offset from it */
+#define MEASURES_PACKED_SIGNAL_MINIMUM INT16_MIN
+
+/**
+ * Append to a fixed buffer with snprintf semantic: length keep counting when the buffer is full
+ * so the required size is known, output is NUL terminated if size is not 0
+ */
+struct PayloadWriter {
+  char *buf;
+  size_t size;
+  size_t length;
+
+  void put(char c) {
+    if (length + 1 < size) {
+      buf[length] = c;
+    }
+    length++;
   }
 
-  oss << ",";
+  void put(const char *str) {
+    while (*str) {
+      put(*str++);
+    }
+  }
 
-  /// PM2.5 atmospheric environment
-  if (utils::isValidPm(mc.pm_25[0]) && utils::isValidPm(mc.pm_25[1])) {
-    float pm25 = (mc.pm_25[0] + mc.pm_25[1]) / 2.0f;
-    oss << std::round(pm25 * 10);
-  } else if (utils::isValidPm(mc.pm_25[0])) {
-    oss << std::round(mc.pm_25[0] * 10);
-  } else if (utils::isValidPm(mc.pm_25[1])) {
-    oss << std::round(mc.pm_25[1] * 10);
+  void put(int32_t value) {
+    char digits[11];
+    int count = 0;
+    // Negate as unsigned, INT32_MIN has no positive int32 counterpart
+    uint32_t abs = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+    do {
+      digits[count++] = '0' + (abs % 10);
+      abs /= 10;
+    } while (abs);
+
+    if (value < 0) {
+      put('-');
+    }
+    while (count) {
+      put(digits[--count]);
+    }
   }
 
-  oss << ",";
+  size_t finish() {
+    if (size) {
+      buf[length < size ? length : size - 1] = '\0';
+    }
+    return length;
+  }
+};
+
+/**
+ * @brief Get payload value of a measures field, average of valid channels scaled and rounded
+ * half away from zero
+ *
+ * @return true Value is valid
+ */
+static bool measuresPayloadValue(const Measurements::Measures &mc,
+                                 const MeasuresPayloadField &field, int32_t &result) {
+  const Measurements::MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[field.type];
+  const float *values = (const float *)((const char *)&mc + field.offset);
+
+  float sum = 0;
+  int count = 0;
+  for (int ch = 0; ch < desc.channels; ch++) {
+    if (desc.isValid(values[ch])) {
+      sum += values[ch];
+      count++;
+    }
+  }
+  if (count == 0) {
+    return false;
+  }
+  float value = sum / count;
 
-  /// PM10 atmospheric environment
-  if (utils::isValidPm(mc.pm_10[0]) && utils::isValidPm(mc.pm_10[1])) {
-    float pm10 = (mc.pm_10[0] + mc.pm_10[1]) / 2.0f;
-    oss << std::round(pm10 * 10);
-  } else if (utils::isValidPm(mc.pm_10[0])) {
-    oss << std::round(mc.pm_10[0] * 10);
-  } else if (utils::isValidPm(mc.pm_10[1])) {
-    oss << std::round(mc.pm_10[1] * 10);
+  // Round in double, exact for every float value in int32 range
+  double scaled = value * field.scale;
+  if (scaled >= 2147483647.0) {
+    result = INT32_MAX;
+  } else if (scaled <= -2147483648.0) {
+    result = INT32_MIN;
+  } else {
+    result = (int32_t)(scaled >= 0 ? scaled + 0.5 : scaled - 0.5);
   }
+  return true;
+}
 
-  oss << ",";
+#define MEASURES_PAYLOAD_BASE_COUNT                                                             \
+  (sizeof(MEASURES_PAYLOAD_FIELDS) / sizeof(MEASURES_PAYLOAD_FIELDS[0]))
+#define MEASURES_PAYLOAD_EXTENDED_COUNT                                                         \
+  (sizeof(MEASURES_PAYLOAD_EXTENDED_FIELDS) / sizeof(MEASURES_PAYLOAD_EXTENDED_FIELDS[0]))
+/** Signal is sent right after the base fields */
+#define MEASURES_PAYLOAD_SIGNAL_INDEX MEASURES_PAYLOAD_BASE_COUNT
+#define MEASURES_PAYLOAD_VALUE_COUNT                                                            \
+  (MEASURES_PAYLOAD_BASE_COUNT + 1 + MEASURES_PAYLOAD_EXTENDED_COUNT)
+
+/** Every value of one measures cycle as sent on the payload, in payload order */
+struct MeasuresPayloadRecord {
+  uint32_t present; // Bit set if value at index is valid
+  int32_t values[MEASURES_PAYLOAD_VALUE_COUNT];
+};
+
+static_assert(MEASURES_PAYLOAD_VALUE_COUNT == MEASURES_PAYLOAD_VALUES,
+              "PackedMeasures must have one value per payload value");
+
+static size_t measuresPayloadValueCount(bool extendedPmMeasures) {
+  return extendedPmMeasures ? MEASURES_PAYLOAD_VALUE_COUNT : MEASURES_PAYLOAD_SIGNAL_INDEX + 1;
+}
+
+/** Minimum of the PackedMeasures value at payload index */
+static int32_t measuresPackedMinimum(size_t index) {
+  if (index < MEASURES_PAYLOAD_SIGNAL_INDEX) {
+    return MEASURES_PAYLOAD_FIELDS[index].minimum;
+  }
+  if (index == MEASURES_PAYLOAD_SIGNAL_INDEX) {
+    return MEASURES_PACKED_SIGNAL_MINIMUM;
+  }
+  return MEASURES_PAYLOAD_EXTENDED_FIELDS[index - MEASURES_PAYLOAD_SIGNAL_INDEX - 1].minimum;
+}
 
-  // TVOC
-  if (utils::isValidVOC(mc.tvoc)) {
-    oss << std::round(mc.tvoc);
+static void collectMeasures(const Measurements::Measures &mc, bool extendedPmMeasures,
+                            MeasuresPayloadRecord &record) {
+  record.present = 0;
+  for (size_t i = 0; i < MEASURES_PAYLOAD_BASE_COUNT; i++) {
+    if (measuresPayloadValue(mc, MEASURES_PAYLOAD_FIELDS[i], record.values[i])) {
+      record.present |= 1UL << i;
+    }
   }
 
-  oss << ",";
+  record.values[MEASURES_PAYLOAD_SIGNAL_INDEX] = mc.signal;
+  if (mc.signal < 0) {
+    record.present |= 1UL << MEASURES_PAYLOAD_SIGNAL_INDEX;
+  }
 
-  // NOx
-  if (utils::isValidNOx(mc.nox)) {
-    oss << std::round(mc.nox);
+  if (extendedPmMeasures) {
+    for (size_t i = 0; i < MEASURES_PAYLOAD_EXTENDED_COUNT; i++) {
+      size_t index = MEASURES_PAYLOAD_SIGNAL_INDEX + 1 + i;
+      if (measuresPayloadValue(mc, MEASURES_PAYLOAD_EXTENDED_FIELDS[i], record.values[index])) {
+        record.present |= 1UL << index;
+      }
+    }
   }
+}
 
-  oss << ",";
+static void collectMeasures(const Measurements::PackedMeasures &mc, bool extendedPmMeasures,
+                            MeasuresPayloadRecord &record) {
+  size_t count = measuresPayloadValueCount(extendedPmMeasures);
+  record.present = mc.present & ((1UL << count) - 1);
+  for (size_t i = 0; i < count; i++) {
+    record.values[i] = measuresPackedMinimum(i) + mc.values[i];
+  }
+}
 
-  /// PM 0.3 particle count
-  if (utils::isValidPm03Count(mc.pm_03_pc[0]) && utils::isValidPm03Count(mc.pm_03_pc[1])) {
-    oss << std::round((mc.pm_03_pc[0] + mc.pm_03_pc[1]) / 2.0f);
-  } else if (utils::isValidPm03Count(mc.pm_03_pc[0])) {
-    oss << std::round(mc.pm_03_pc[0]);
-  } else if (utils::isValidPm03Count(mc.pm_03_pc[1])) {
-    oss << std::round(mc.pm_03_pc[1]);
+static void writeCsvRecord(PayloadWriter &writer, const MeasuresPayloadRecord &record,
+                           bool extendedPmMeasures) {
+  size_t count = measuresPayloadValueCount(extendedPmMeasures);
+  for (size_t i = 0; i < count; i++) {
+    if (i == MEASURES_PAYLOAD_SIGNAL_INDEX + 1) {
+      writer.put(",,,,,,,,"); // Add placeholder for MAX payload (BMS & O3/NO2)
+    } else if (i > 0) {
+      writer.put(',');
+    }
+    if (record.present & (1UL << i)) {
+      writer.put(record.values[i]);
+    }
   }
+}
 
-  oss << ",";
+std::string Measurements::buildMeasuresPayload(Measures &mc, bool extendedPmMeasures) {
+  std::string payload(encodeMeasuresPayload(mc, extendedPmMeasures, NULL, 0), '\0');
+  encodeMeasuresPayload(mc, extendedPmMeasures, &payload[0], payload.size() + 1);
+  return payload;
+}
 
-  if (mc.signal < 0) {
-    oss << mc.signal;
+size_t Measurements::encodeMeasuresPayload(const Measures &mc, bool extendedPmMeasures,
+                                           char *buf, size_t size) {
+  PayloadWriter writer = {buf, size, 0};
+  MeasuresPayloadRecord record;
+  collectMeasures(mc, extendedPmMeasures, record);
+  writeCsvRecord(writer, record, extendedPmMeasures);
+  return writer.finish();
+}
+
+bool Measurements::packMeasures(const Measures &mc, PackedMeasures &packed) {
+  MeasuresPayloadRecord record;
+  collectMeasures(mc, true, record);
+
+  bool inRange = true;
+  packed.present = record.present;
+  for (size_t i = 0; i < MEASURES_PAYLOAD_VALUE_COUNT; i++) {
+    packed.values[i] = 0;
+    if ((record.present & (1UL << i)) == 0) {
+      continue;
+    }
+    int64_t offset = (int64_t)record.values[i] - measuresPackedMinimum(i);
+    if (offset < 0 || offset > UINT16_MAX) {
+      inRange = false;
+      offset = offset < 0 ? 0 : UINT16_MAX;
+    }
+    packed.values[i] = (uint16_t)offset;
   }
+  return inRange;
+}
 
-  if (extendedPmMeasures) {
-    oss << ",,,,,,,,"; // Add placeholder for MAX payload (BMS & O3/NO2)
+/** Batch CSV payload of Measures or PackedMeasures */
+template <typename M>
+static size_t encodeMeasuresBatch(uint32_t interval, const M *mcs, int count,
+                                  bool extendedPmMeasures, char *buf, size_t size) {
+  PayloadWriter writer = {buf, size, 0};
+  MeasuresPayloadRecord record;
+  writer.put((int32_t)interval);
+  for (int i = 0; i < count; i++) {
+    writer.put(',');
+    collectMeasures(mcs[i], extendedPmMeasures, record);
+    writeCsvRecord(writer, record, extendedPmMeasures);
+  }
+  return writer.finish();
+}
 
-    /// PM 0.5 particle count
-    if (utils::isValidPm03Count(mc.pm_05_pc[0]) && utils::isValidPm03Count(mc.pm_05_pc[1])) {
-      oss << std::round((mc.pm_05_pc[0] + mc.pm_05_pc[1]) / 2.0f);
-    } else if (utils::isValidPm03Count(mc.pm_05_pc[0])) {
-      oss << std::round(mc.pm_05_pc[0]);
-    } else if (utils::isValidPm03Count(mc.pm_05_pc[1])) {
-      oss << std::round(mc.pm_05_pc[1]);
+size_t Measurements::encodeMeasuresPayload(uint32_t interval, const Measures *mcs, int count,
+                                           bool extendedPmMeasures, char *buf, size_t size) {
+  return encodeMeasuresBatch(interval, mcs, count, extendedPmMeasures, buf, size);
+}
+
+size_t Measurements::encodeMeasuresPayload(uint32_t interval, const PackedMeasures *mcs,
+                                           int count, bool extendedPmMeasures, char *buf,
+                                           size_t size) {
+  return encodeMeasuresBatch(interval, mcs, count, extendedPmMeasures, buf, size);
+}
+
+/** Binary payload header flag: records include the extended PM fields */
+#define MEASURES_BINARY_FLAG_EXTENDED 0x01
+
+/** Append bytes to a fixed buffer, length keep counting when the buffer is full */
+struct BinaryPayloadWriter {
+  uint8_t *buf;
+  size_t size;
+  size_t length;
+
+  void put(uint8_t b) {
+    if (length < size) {
+      buf[length] = b;
+    }
+    length++;
+  }
+
+  void putVarint(uint64_t value) {
+    while (value >= 0x80) {
+      put((uint8_t)(value | 0x80));
+      value >>= 7;
     }
+    put((uint8_t)value);
+  }
+};
 
-    oss << ",";
+struct BinaryPayloadReader {
+  const uint8_t *buf;
+  size_t size;
+  size_t pos;
 
-    /// PM 1.0 particle count
-    if (utils::isValidPm03Count(mc.pm_01_pc[0]) && utils::isValidPm03Count(mc.pm_01_pc[1])) {
-      oss << std::round((mc.pm_01_pc[0] + mc.pm_01_pc[1]) / 2.0f);
-    } else if (utils::isValidPm03Count(mc.pm_01_pc[0])) {
-      oss << std::round(mc.pm_01_pc[0]);
-    } else if (utils::isValidPm03Count(mc.pm_01_pc[1])) {
-      oss << std::round(mc.pm_01_pc[1]);
+  bool get(uint8_t &b) {
+    if (pos >= size) {
+      return false;
     }
+    b = buf[pos++];
+    return true;
+  }
 
-    oss << ",";
+  bool getVarint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t b;
+      if (!get(b)) {
+        return false;
+      }
+      value |= (uint64_t)(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/**
+ * Record is sent as a varint bit mask of the values changed since previous record (validity or
+ * value), followed by one varint token per changed value: 0 if the value is not valid, else
+ * zigzag of the difference to the previous value (0 if it was not valid) plus 1
+ */
+static void writeBinaryRecord(BinaryPayloadWriter &writer, const MeasuresPayloadRecord &record,
+                              const MeasuresPayloadRecord &previous, size_t count) {
+  uint32_t changed = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t bit = 1UL << i;
+    if ((record.present & bit) != (previous.present & bit) ||
+        ((record.present & bit) && record.values[i] != previous.values[i])) {
+      changed |= bit;
+    }
+  }
 
-    /// PM 2.5 particle count
-    if (utils::isValidPm03Count(mc.pm_25_pc[0]) && utils::isValidPm03Count(mc.pm_25_pc[1])) {
-      oss << std::round((mc.pm_25_pc[0] + mc.pm_25_pc[1]) / 2.0f);
-    } else if (utils::isValidPm03Count(mc.pm_25_pc[0])) {
-      oss << std::round(mc.pm_25_pc[0]);
-    } else if (utils::isValidPm03Count(mc.pm_25_pc[1])) {
-      oss << std::round(mc.pm_25_pc[1]);
+  writer.putVarint(changed);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t bit = 1UL << i;
+    if ((changed & bit) == 0) {
+      continue;
     }
+    if ((record.present & bit) == 0) {
+      writer.putVarint(0);
+      continue;
+    }
+
+    int64_t base = (previous.present & bit) ? previous.values[i] : 0;
+    int64_t delta = (int64_t)record.values[i] - base;
+    uint64_t zigzag = delta < 0 ? ((uint64_t)(-(delta + 1)) << 1) | 1 : (uint64_t)delta << 1;
+    writer.putVarint(zigzag + 1);
+  }
+}
 
-    oss << ",";
+static bool readBinaryRecord(BinaryPayloadReader &reader, MeasuresPayloadRecord &record,
+                             size_t count) {
+  uint64_t changed;
+  if (!reader.getVarint(changed) || (changed >> count) != 0) {
+    return false;
+  }
 
-    /// PM 5.0 particle count
-    if (utils::isValidPm03Count(mc.pm_5_pc[0]) && utils::isValidPm03Count(mc.pm_5_pc[1])) {
-      oss << std::round((mc.pm_5_pc[0] + mc.pm_5_pc[1]) / 2.0f);
-    } else if (utils::isValidPm03Count(mc.pm_5_pc[0])) {
-      oss << std::round(mc.pm_5_pc[0]);
-    } else if (utils::isValidPm03Count(mc.pm_5_pc[1])) {
-      oss << std::round(mc.pm_5_pc[1]);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t bit = 1UL << i;
+    if ((changed & bit) == 0) {
+      continue;
     }
 
-    oss << ",";
+    uint64_t token;
+    if (!reader.getVarint(token)) {
+      return false;
+    }
+    if (token == 0) {
+      record.present &= ~bit;
+      continue;
+    }
 
-    /// PM 10 particle count
-    if (utils::isValidPm03Count(mc.pm_10_pc[0]) && utils::isValidPm03Count(mc.pm_10_pc[1])) {
-      oss << std::round((mc.pm_10_pc[0] + mc.pm_10_pc[1]) / 2.0f);
-    } else if (utils::isValidPm03Count(mc.pm_10_pc[0])) {
-      oss << std::round(mc.pm_10_pc[0]);
-    } else if (utils::isValidPm03Count(mc.pm_10_pc[1])) {
-      oss << std::round(mc.pm_10_pc[1]);
+    uint64_t zigzag = token - 1;
+    int64_t delta = (zigzag & 1) ? -(int64_t)(zigzag >> 1) - 1 : (int64_t)(zigzag >> 1);
+    int64_t base = (record.present & bit) ? record.values[i] : 0;
+    if (delta > (int64_t)INT32_MAX - base || delta < (int64_t)INT32_MIN - base) {
+      return false;
     }
+    record.values[i] = (int32_t)(base + delta);
+    record.present |= bit;
+  }
+  return true;
+}
+
+/** Batch binary payload of Measures or PackedMeasures */
+template <typename M>
+static size_t encodeMeasuresBinaryBatch(uint32_t interval, const M *mcs, int count,
+                                        bool extendedPmMeasures, uint8_t *buf, size_t size) {
+  BinaryPayloadWriter writer = {buf, size, 0};
+  writer.put(MEASURES_BINARY_PAYLOAD_VERSION);
+  writer.put(extendedPmMeasures ? MEASURES_BINARY_FLAG_EXTENDED : 0);
+  writer.putVarint(interval);
+  writer.putVarint(count);
+
+  // First record is sent against a record without any valid value
+  MeasuresPayloadRecord records[2];
+  records[1].present = 0;
+  size_t valueCount = measuresPayloadValueCount(extendedPmMeasures);
+  for (int i = 0; i < count; i++) {
+    MeasuresPayloadRecord &record = records[i % 2];
+    collectMeasures(mcs[i], extendedPmMeasures, record);
+    writeBinaryRecord(writer, record, records[(i + 1) % 2], valueCount);
+  }
+  return writer.length;
+}
+
+size_t Measurements::encodeMeasuresBinaryPayload(uint32_t interval, const Measures *mcs,
+                                                 int count, bool extendedPmMeasures,
+                                                 uint8_t *buf, size_t size) {
+  return encodeMeasuresBinaryBatch(interval, mcs, count, extendedPmMeasures, buf, size);
+}
+
+size_t Measurements::encodeMeasuresBinaryPayload(uint32_t interval, const PackedMeasures *mcs,
+                                                 int count, bool extendedPmMeasures,
+                                                 uint8_t *buf, size_t size) {
+  return encodeMeasuresBinaryBatch(interval, mcs, count, extendedPmMeasures, buf, size);
+}
 
-    oss << ",";
+size_t Measurements::decodeMeasuresBinaryPayload(const uint8_t *data, size_t length, char *buf,
+                                                 size_t size) {
+  BinaryPayloadReader reader = {data, length, 0};
+  uint8_t version, flags;
+  uint64_t interval, count;
+  if (!reader.get(version) || version != MEASURES_BINARY_PAYLOAD_VERSION ||
+      !reader.get(flags) || (flags & ~MEASURES_BINARY_FLAG_EXTENDED) != 0 ||
+      !reader.getVarint(interval) || interval > INT32_MAX || !reader.getVarint(count)) {
+    return 0;
+  }
 
-    /// PM2.5 standard particle
-    if (utils::isValidPm(mc.pm_25_sp[0]) && utils::isValidPm(mc.pm_25_sp[1])) {
-      float pm10 = (mc.pm_25_sp[0] + mc.pm_25_sp[1]) / 2.0f;
-      oss << std::round(pm10 * 10);
-    } else if (utils::isValidPm(mc.pm_25_sp[0])) {
-      oss << std::round(mc.pm_25_sp[0] * 10);
-    } else if (utils::isValidPm(mc.pm_25_sp[1])) {
-      oss << std::round(mc.pm_25_sp[1] * 10);
+  bool extendedPmMeasures = flags & MEASURES_BINARY_FLAG_EXTENDED;
+  size_t valueCount = measuresPayloadValueCount(extendedPmMeasures);
+  PayloadWriter writer = {buf, size, 0};
+  MeasuresPayloadRecord record;
+  record.present = 0;
+  writer.put((int32_t)interval);
+  for (uint64_t i = 0; i < count; i++) {
+    if (!readBinaryRecord(reader, record, valueCount)) {
+      return 0;
     }
+    writer.put(',');
+    writeCsvRecord(writer, record, extendedPmMeasures);
   }
 
-  return oss.str();
+  // Anything left means the payload is not what was encoded
+  if (reader.pos != reader.size) {
+    return 0;
+  }
+  return writer.finish();
 }
 
-String Measurements::toString(bool localServer, AgFirmwareMode fwMode, int rssi) {
-  JSONVar root;
+bool Measurements::reportChanged(MeasurementType type, float reported, float value) {
+  const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[type];
+  bool reportedValid = desc.isValid(reported);
+  if (reportedValid != desc.isValid(value)) {
+    return true;
+  }
+  if (!reportedValid) {
+    return false;
+  }
 
-  if (ag->isOne() || (ag->isPro4_2()) || ag->isPro3_3() || ag->isBasic()) {
-    root = buildIndoor(localServer);
-  } else {
-    root = buildOutdoor(localServer, fwMode);
+  Configuration::ReportingDeadband band = config.getReportingDeadband(type);
+  float deadband = band.relative * fabsf(reported);
+  if (deadband < band.absolute) {
+    deadband = band.absolute;
+  }
+  return fabsf(value - reported) > deadband;
+}
+
+bool Measurements::hasField(uint64_t fields, MeasurementType type, int ch) {
+  const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[type];
+  return fields & (1ULL << (measuresIndex(desc) + ch - 1));
+}
+
+bool Measurements::hasAnyField(uint64_t fields, MeasurementType type) {
+  const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[type];
+  uint64_t channels = ((1ULL << desc.channels) - 1) << measuresIndex(desc);
+  return fields & channels;
+}
+
+Measurements::ReportDecision Measurements::prepareReport(ReportState &state, bool partial) {
+  // Values the decision is taken on, toJson() replace them with the values it writes
+  Snapshot published;
+  snapshot(published);
+  state.pending = published.average;
+  state.fields = MEASUREMENT_REPORT_ALL_FIELDS;
+  state.decision = ReportFull;
+
+  ReportingMode mode = config.getReportingMode();
+  uint32_t heartbeat = (uint32_t)config.getReportingHeartbeat() * 1000;
+  if (mode == REPORTING_MODE_INTERVAL || !state.hasReported ||
+      (millis() - state.reportedAt) >= heartbeat) {
+    return state.decision;
+  }
+
+  uint64_t changed = 0;
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      if (reportChanged(desc.type, valueOf(state.reported, desc.type, ch),
+                        valueOf(published.average, desc.type, ch))) {
+        changed |= 1ULL << (measuresIndex(desc) + ch - 1);
+      }
+    }
   }
 
-  // CO2
-  if (config.hasSensorS8 && utils::isValidCO2(_co2.update.avg)) {
-    root[json_prop_co2] = ag->round2(_co2.update.avg);
+  if (changed == 0) {
+    state.decision = ReportSkip;
+  } else if (partial && mode == REPORTING_MODE_DELTA) {
+    state.decision = ReportChanged;
+    state.fields = changed;
   }
+  return state.decision;
+}
 
-  /// TVOx and NOx
-  if (config.hasSensorSGP) {
-    if (utils::isValidVOC(_tvoc.update.avg)) {
-      root[json_prop_tvoc] = ag->round2(_tvoc.update.avg);
+void Measurements::commitReport(ReportState &state) {
+  if (state.decision == ReportSkip) {
+    return;
+  }
+  if (state.decision == ReportFull) {
+    state.reported = state.pending;
+    state.reportedAt = millis();
+    state.hasReported = true;
+    return;
+  }
+
+  // Only the fields sent are now known by the consumer
+  float *reported = (float *)&state.reported;
+  const float *pending = (const float *)&state.pending;
+  for (int i = 0; i < MEASUREMENT_FLOAT_SLOTS + MEASUREMENT_INTEGER_SLOTS; i++) {
+    if (state.fields & (1ULL << i)) {
+      reported[i] = pending[i];
     }
-    if (utils::isValidVOC(_tvoc_raw.update.avg)) {
-      root[json_prop_tvocRaw] = ag->round2(_tvoc_raw.update.avg);
+  }
+}
+
+bool Measurements::hasChangedSince(const Measures &reference) {
+  Snapshot published;
+  snapshot(published);
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      if (reportChanged(desc.type, valueOf(reference, desc.type, ch),
+                        valueOf(published.average, desc.type, ch))) {
+        return true;
+      }
     }
-    if (utils::isValidNOx(_nox.update.avg)) {
-      root[json_prop_nox] = ag->round2(_nox.update.avg);
+  }
+  return false;
+}
+
+String Measurements::toString(bool localServer, AgFirmwareMode fwMode, int rssi,
+                              ReportState *report) {
+  String result;
+  // Reserve typical payload size so the string is not reallocated while JSON is written
+  result.reserve(MEASUREMENT_JSON_RESERVE_SIZE);
+  StringPrint out(result);
+  toJson(out, localServer, fwMode, rssi, report);
+
+  Serial.printf("\n---- PAYLOAD\n %s \n-----\n", result.c_str());
+  return result;
+}
+
+size_t Measurements::toJson(char *buf, size_t size, bool localServer, AgFirmwareMode fwMode,
+                            int rssi, ReportState *report) {
+  BufferPrint out(buf, size);
+  toJson(out, localServer, fwMode, rssi, report);
+  if (out.overflow()) {
+    Serial.printf("JSON payload does not fit buffer size %d\n", (int)size);
+    return 0;
+  }
+
+  Serial.printf("\n---- PAYLOAD\n %s \n-----\n", buf);
+  return out.length();
+}
+
+size_t Measurements::toJson(Print &out, bool localServer, AgFirmwareMode fwMode, int rssi,
+                            ReportState *report) {
+  // Every value come from the same snapshot, the writer task may update measurements meanwhile
+  Snapshot published;
+  snapshot(published);
+  const Measures &avg = published.average;
+  uint64_t fields = MEASUREMENT_REPORT_ALL_FIELDS;
+  if (report) {
+    fields = report->fields;
+    report->pending = avg;
+  }
+
+  JsonWriter json(out);
+  json.beginObject();
+
+  if (ag->isOne() || (ag->isPro4_2()) || ag->isPro3_3() || ag->isBasic()) {
+    writeIndoor(json, published, localServer, fields);
+  } else {
+    writeOutdoor(json, published, localServer, fwMode, fields);
+  }
+
+  // CO2, TVOC and NOx
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    if (!hasField(fields, desc.type, 1)) {
+      continue;
     }
-    if (utils::isValidNOx(_nox_raw.update.avg)) {
-      root[json_prop_noxRaw] = ag->round2(_nox_raw.update.avg);
+    if ((desc.group == GroupCO2 && config.hasSensorS8) ||
+        (desc.group == GroupVOC && config.hasSensorSGP)) {
+      float value = valueOf(avg, desc.type);
+      if (desc.isValid(value)) {
+        json.add(desc.jsonKey, ag->round2(value));
+      }
     }
   }
 
-  root["boot"] = _bootCount;
-  root["bootCount"] = _bootCount;
-  root["wifi"] = rssi;
+  json.add("boot", _bootCount);
+  json.add("bootCount", _bootCount);
+  json.add("wifi", rssi);
 
   if (localServer) {
     if (ag->isOne()) {
-      root["ledMode"] = config.getLedBarModeName();
+      json.add("ledMode", config.getLedBarModeName());
     }
-    root["serialno"] = ag->deviceId();
-    root["firmware"] = ag->getVersion();
-    root["model"] = AgFirmwareModeName(fwMode);
+    json.add("serialno", ag->deviceId());
+    json.add("firmware", ag->getVersion());
+    json.add("model", AgFirmwareModeName(fwMode));
   } else {
 #ifndef ESP8266
-    root["resetReason"] = _resetReason;
-    root["freeHeap"] = ESP.getFreeHeap();
+    json.add("resetReason", _resetReason);
+    json.add("freeHeap", ESP.getFreeHeap());
 #endif
+    if (config.isWindowStatisticsEnabled()) {
+      writeStatistics(json, published);
+    }
   }
 
-
 #ifndef ESP8266
   // Add satellites data
   if (satellites_ && config.isSatellitesEnabled()) {
     AgSatellites::Satellite *satellites = satellites_->getSatellites();
-    JSONVar satellitesObj;
     int count = 0;
 
     for (int i = 0; i < MAX_SATELLITES; i++) {
       if (satellites[i].id.length() > 0 && satellites[i].data.useCount < 2 &&
           utils::isValidTemperature(satellites[i].data.temp) &&
           utils::isValidHumidity(satellites[i].data.rhum)) {
+        // Only open satellites object when there is at least one valid satellite
+        if (count == 0) {
+          json.beginObject("satellites");
+        }
 
-        String macKey = satellites[i].id;
-        satellitesObj[macKey.c_str()]["atmp"] = ag->round2(satellites[i].data.temp);
-        satellitesObj[macKey.c_str()]["rhum"] = ag->round2(satellites[i].data.rhum);
-        satellitesObj[macKey.c_str()]["wifi"] = ag->round2(satellites[i].data.rssi);
+        json.beginObject(satellites[i].id.c_str());
+        json.add("atmp", ag->round2(satellites[i].data.temp));
+        json.add("rhum", ag->round2(satellites[i].data.rhum));
+        json.add("wifi", ag->round2(satellites[i].data.rssi));
+        json.endObject();
         satellites[i].data.useCount++;
         count++;
       }
     }
 
     if (count > 0) {
-      root["satellites"] = satellitesObj;
+      json.endObject();
     }
   }
 #endif // ESP8266
 
-  String result = JSON.stringify(root);
-  Serial.printf("\n---- PAYLOAD\n %s \n-----\n", result.c_str());
-  return result;
+  json.endObject();
+  return json.length();
 }
 
-JSONVar Measurements::buildOutdoor(bool localServer, AgFirmwareMode fwMode) {
-  JSONVar outdoor;
+void Measurements::writeOutdoor(JsonWriter &json, const Snapshot &published, bool localServer,
+                                AgFirmwareMode fwMode, uint64_t fields) {
+  const Measures &avg = published.average;
   if (fwMode == FW_MODE_O_1P || fwMode == FW_MODE_O_1PS || fwMode == FW_MODE_O_1PST) {
-    // buildPMS params:
-    /// Because only have 1 PMS, allCh is set to false
+    // writePMS params:
+    /// Because only have 1 PMS, set ch based on hasSensorPMSx
     /// But enable temp hum from PMS
     /// compensated values if requested by local server
-    /// Set ch based on hasSensorPMSx
-    if (config.hasSensorPMS1) {
-      outdoor = buildPMS(1, false, true, localServer);
-      if (!localServer) {
-        outdoor[json_prop_pmFirmware] =
-            pms5003TFirmwareVersion(ag->pms5003t_1.getFirmwareVersion());
+    int ch = config.hasSensorPMS1 ? 1 : 2;
+    writePMS(json, published, ch, true, localServer, fields);
+    if (!localServer) {
+      PMS5003T &pms = ch == 1 ? ag->pms5003t_1 : ag->pms5003t_2;
+      json.add(json_prop_pmFirmware, pms5003TFirmwareVersion(pms.getFirmwareVersion()));
+    }
+  } else {
+    // FW_MODE_O_1PPT && FW_MODE_O_1PP: Outdoor monitor that have 2 PMS sensor
+    /// Fused value of every channel, then each channel values in "channels" object
+    const Fusion::Status &fusion = published.pmsFusion;
+    writePMSAverage(json, published, true, localServer, fields);
+    if (localServer) {
+      json.add("pmsConfidence", ag->round2(fusion.confidence));
+    }
+
+    int count = 0;
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      // Channel without any valid value is omitted, unless PMS5003T version is added
+      if (localServer && !hasPMSChannelData(avg, ch)) {
+        continue;
       }
-    } else {
-      outdoor = buildPMS(2, false, true, localServer);
+      // Channel without any reported field is omitted from a partial report
+      if (fields != MEASUREMENT_REPORT_ALL_FIELDS && !hasPMSChannelData(fields, ch)) {
+        continue;
+      }
+      if (count == 0) {
+        json.beginObject("channels");
+      }
+
+      char name[2] = {(char)('0' + ch), '\0'};
+      json.beginObject(name);
+      writePMS(json, published, ch, true, localServer, fields);
       if (!localServer) {
-        outdoor[json_prop_pmFirmware] =
-            pms5003TFirmwareVersion(ag->pms5003t_2.getFirmwareVersion());
+        // Only the two PMS5003T of the monitor report a firmware version
+        if (ch <= 2) {
+          PMS5003T &pms = ch == 1 ? ag->pms5003t_1 : ag->pms5003t_2;
+          json.add(json_prop_pmFirmware, pms5003TFirmwareVersion(pms.getFirmwareVersion()));
+        }
+      } else {
+        json.add("pmsHealth", Fusion::healthName(fusion.health[ch - 1]));
       }
+      json.endObject();
+      count++;
     }
-  } else {
-    // FW_MODE_O_1PPT && FW_MODE_O_1PP: Outdoor monitor that have 2 PMS sensor
-    // buildPMS params:
-    /// Have 2 PMS sensor, allCh is set to true (ch params ignored)
-    /// Enable temp hum from PMS
-    /// compensated values if requested by local server
-    outdoor = buildPMS(1, true, true, localServer);
-    // PMS5003T version
-    if (!localServer) {
-      outdoor["channels"]["1"][json_prop_pmFirmware] =
-          pms5003TFirmwareVersion(ag->pms5003t_1.getFirmwareVersion());
-      outdoor["channels"]["2"][json_prop_pmFirmware] =
-          pms5003TFirmwareVersion(ag->pms5003t_2.getFirmwareVersion());
+
+    if (count > 0) {
+      json.endObject();
     }
   }
-
-  return outdoor;
 }
 
-JSONVar Measurements::buildIndoor(bool localServer) {
-  JSONVar indoor;
-
+void Measurements::writeIndoor(JsonWriter &json, const Snapshot &published, bool localServer,
+                               uint64_t fields) {
+  const Measures &avg = published.average;
   if (config.hasSensorPMS1 || config.hasSensorSPS30) {
-    // buildPMS params:
-    /// PMS channel 1 (indoor only have 1 PMS; hence allCh false)
+    // writePMS params:
+    /// PMS channel 1 (indoor only have 1 PMS)
     /// Not include temperature and humidity from PMS sensor
     /// Include compensated calculation
-    indoor = buildPMS(1, false, false, true);
+    writePMS(json, published, 1, false, true, fields);
     if (!localServer && config.hasSensorPMS1) {
       // PMS firmware version only available for PMS5003
-      indoor[json_prop_pmFirmware] = this->pms5003FirmwareVersion(ag->pms5003.getFirmwareVersion());
+      json.add(json_prop_pmFirmware, pms5003FirmwareVersion(ag->pms5003.getFirmwareVersion()));
     }
   }
 
   if (config.hasSensorSHT) {
     // Add temperature
-    if (utils::isValidTemperature(_temperature[0].update.avg)) {
-      indoor[json_prop_temp] = ag->round2(_temperature[0].update.avg);
+    if (hasField(fields, Temperature, 1) && utils::isValidTemperature(valueOf(avg, Temperature))) {
+      json.add(json_prop_temp, ag->round2(valueOf(avg, Temperature)));
       if (localServer) {
-        indoor[json_prop_tempCompensated] = ag->round2(getCorrectedTempHum(Temperature));
+        json.add(json_prop_tempCompensated,
+                 ag->round2(getCorrectedTempHum(published, Temperature)));
       }
     }
     // Add humidity
-    if (utils::isValidHumidity(_humidity[0].update.avg)) {
-      indoor[json_prop_rhum] = ag->round2(_humidity[0].update.avg);
+    if (hasField(fields, Humidity, 1) && utils::isValidHumidity(valueOf(avg, Humidity))) {
+      json.add(json_prop_rhum, ag->round2(valueOf(avg, Humidity)));
       if (localServer) {
-        indoor[json_prop_rhumCompensated] = ag->round2(getCorrectedTempHum(Humidity));
+        json.add(json_prop_rhumCompensated, ag->round2(getCorrectedTempHum(published, Humidity)));
       }
     }
   }
-
-  return indoor;
 }
 
-JSONVar Measurements::buildPMS(int ch, bool allCh, bool withTempHum, bool compensate) {
-  JSONVar pms;
-
-  // When only one of the channel
-  if (allCh == false) {
-    // Sanity check to validate channel, assert if invalid
-    validateChannel(ch);
-
-    // Follow array indexing just for get address of the value type
-    int chIndex = ch - 1;
+void Measurements::writePMS(JsonWriter &json, const Snapshot &published, int ch,
+                            bool withTempHum, bool compensate, uint64_t fields) {
+  const Measures &avg = published.average;
+  // Sanity check to validate channel, assert if invalid
+  validateChannel(ch);
 
-    if (utils::isValidPm(_pm_01[chIndex].update.avg)) {
-      pms[json_prop_pm01Ae] = ag->round2(_pm_01[chIndex].update.avg);
-    }
-    if (utils::isValidPm(_pm_25[chIndex].update.avg)) {
-      pms[json_prop_pm25Ae] = ag->round2(_pm_25[chIndex].update.avg);
-    }
-    if (utils::isValidPm(_pm_10[chIndex].update.avg)) {
-      pms[json_prop_pm10Ae] = ag->round2(_pm_10[chIndex].update.avg);
-    }
-    if (utils::isValidPm(_pm_01_sp[chIndex].update.avg)) {
-      pms[json_prop_pm01Sp] = ag->round2(_pm_01_sp[chIndex].update.avg);
-    }
-    if (utils::isValidPm(_pm_25_sp[chIndex].update.avg)) {
-      pms[json_prop_pm25Sp] = ag->round2(_pm_25_sp[chIndex].update.avg);
-    }
-    if (utils::isValidPm(_pm_10_sp[chIndex].update.avg)) {
-      pms[json_prop_pm10Sp] = ag->round2(_pm_10_sp[chIndex].update.avg);
-    }
-    if (utils::isValidPm03Count(_pm_03_pc[chIndex].update.avg)) {
-      pms[json_prop_pm03Count] = ag->round2(_pm_03_pc[chIndex].update.avg);
-    }
-    if (utils::isValidPm03Count(_pm_05_pc[chIndex].update.avg)) {
-      pms[json_prop_pm05Count] = ag->round2(_pm_05_pc[chIndex].update.avg);
-    }
-    if (utils::isValidPm03Count(_pm_01_pc[chIndex].update.avg)) {
-      pms[json_prop_pm1Count] = ag->round2(_pm_01_pc[chIndex].update.avg);
+  // Every PMS measurements
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    if (desc.group != GroupPM || !hasField(fields, desc.type, ch)) {
+      continue;
     }
-    if (utils::isValidPm03Count(_pm_25_pc[chIndex].update.avg)) {
-      pms[json_prop_pm25Count] = ag->round2(_pm_25_pc[chIndex].update.avg);
-    }
-    if (_pm_5_pc[chIndex].listValues.empty() == false) {
-      // Only include pm5.0 count when values available on its list
-      // If not, means no pm5_pc available from the sensor
-      if (utils::isValidPm03Count(_pm_5_pc[chIndex].update.avg)) {
-        pms[json_prop_pm5Count] = ag->round2(_pm_5_pc[chIndex].update.avg);
-      }
-    }
-    if (_pm_10_pc[chIndex].listValues.empty() == false) {
-      // Only include pm10 count when values available on its list
-      // If not, means no pm10_pc available from the sensor
-      if (utils::isValidPm03Count(_pm_10_pc[chIndex].update.avg)) {
-        pms[json_prop_pm10Count] = ag->round2(_pm_10_pc[chIndex].update.avg);
-      }
+    // Measurement not available from the sensor stay invalid, eg. pm5.0 and pm10 count on
+    // PMS5003T
+    float value = valueOf(avg, desc.type, ch);
+    if (desc.isValid(value)) {
+      json.add(desc.jsonKey, ag->round2(value));
     }
+  }
 
-    if (withTempHum) {
-      float _vc;
-      // Set temperature if valid
-      if (utils::isValidTemperature(_temperature[chIndex].update.avg)) {
-        pms[json_prop_temp] = ag->round2(_temperature[chIndex].update.avg);
-        // Compensate temperature when flag is set
-        if (compensate) {
-          _vc = getCorrectedTempHum(Temperature, ch, true);
-          if (utils::isValidTemperature(_vc)) {
-            pms[json_prop_tempCompensated] = ag->round2(_vc);
-          }
+  if (withTempHum) {
+    float _vc;
+    // Set temperature if valid
+    if (hasField(fields, Temperature, ch) &&
+        utils::isValidTemperature(valueOf(avg, Temperature, ch))) {
+      json.add(json_prop_temp, ag->round2(valueOf(avg, Temperature, ch)));
+      // Compensate temperature when flag is set
+      if (compensate) {
+        _vc = getCorrectedTempHum(published, Temperature, ch, true);
+        if (utils::isValidTemperature(_vc)) {
+          json.add(json_prop_tempCompensated, ag->round2(_vc));
         }
       }
-      // Set humidity if valid
-      if (utils::isValidHumidity(_humidity[chIndex].update.avg)) {
-        pms[json_prop_rhum] = ag->round2(_humidity[chIndex].update.avg);
-        // Compensate relative humidity when flag is set
-        if (compensate) {
-          _vc = getCorrectedTempHum(Humidity, ch, true);
-          if (utils::isValidHumidity(_vc)) {
-            pms[json_prop_rhumCompensated] = ag->round2(_vc);
-          }
+    }
+    // Set humidity if valid
+    if (hasField(fields, Humidity, ch) && utils::isValidHumidity(valueOf(avg, Humidity, ch))) {
+      json.add(json_prop_rhum, ag->round2(valueOf(avg, Humidity, ch)));
+      // Compensate relative humidity when flag is set
+      if (compensate) {
+        _vc = getCorrectedTempHum(published, Humidity, ch, true);
+        if (utils::isValidHumidity(_vc)) {
+          json.add(json_prop_rhumCompensated, ag->round2(_vc));
         }
       }
     }
+  }
 
-    // Add pm25 compensated value only if PM2.5 and humidity value is valid
-    if (compensate) {
-      if (utils::isValidPm(_pm_25[chIndex].update.avg) &&
-          utils::isValidHumidity(_humidity[chIndex].update.avg)) {
-        float pm25 = getCorrectedPM25(true, ch, true);
-        pms[json_prop_pm25Compensated] = ag->round2(pm25);
-      }
+  // Add pm25 compensated value only if PM2.5 and humidity value is valid, reported when one of
+  // them is
+  if (compensate && (hasField(fields, PM25, ch) || hasField(fields, Humidity, ch))) {
+    if (utils::isValidPm(valueOf(avg, PM25, ch)) &&
+        utils::isValidHumidity(valueOf(avg, Humidity, ch))) {
+      float pm25 = getCorrectedPM25(published, true, ch, true);
+      json.add(json_prop_pm25Compensated, ag->round2(pm25));
     }
+  }
+}
 
-    // Directly return the json object
-    return pms;
-  };
-
-  /** Handle both channels by averaging their values; if one channel's value is not valid, skip
-   * averaging and use the valid value from the other channel */
-
-  /// PM1.0 atmospheric environment
-  if (utils::isValidPm(_pm_01[0].update.avg) && utils::isValidPm(_pm_01[1].update.avg)) {
-    float avg = (_pm_01[0].update.avg + _pm_01[1].update.avg) / 2.0f;
-    pms[json_prop_pm01Ae] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm01Ae] = ag->round2(_pm_01[0].update.avg);
-    pms["channels"]["2"][json_prop_pm01Ae] = ag->round2(_pm_01[1].update.avg);
-  } else if (utils::isValidPm(_pm_01[0].update.avg)) {
-    pms[json_prop_pm01Ae] = ag->round2(_pm_01[0].update.avg);
-    pms["channels"]["1"][json_prop_pm01Ae] = ag->round2(_pm_01[0].update.avg);
-  } else if (utils::isValidPm(_pm_01[1].update.avg)) {
-    pms[json_prop_pm01Ae] = ag->round2(_pm_01[1].update.avg);
-    pms["channels"]["2"][json_prop_pm01Ae] = ag->round2(_pm_01[1].update.avg);
-  }
-
-  /// PM2.5 atmospheric environment
-  if (utils::isValidPm(_pm_25[0].update.avg) && utils::isValidPm(_pm_25[1].update.avg)) {
-    float avg = (_pm_25[0].update.avg + _pm_25[1].update.avg) / 2.0f;
-    pms[json_prop_pm25Ae] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm25Ae] = ag->round2(_pm_25[0].update.avg);
-    pms["channels"]["2"][json_prop_pm25Ae] = ag->round2(_pm_25[1].update.avg);
-  } else if (utils::isValidPm(_pm_25[0].update.avg)) {
-    pms[json_prop_pm25Ae] = ag->round2(_pm_25[0].update.avg);
-    pms["channels"]["1"][json_prop_pm25Ae] = ag->round2(_pm_25[0].update.avg);
-  } else if (utils::isValidPm(_pm_25[1].update.avg)) {
-    pms[json_prop_pm25Ae] = ag->round2(_pm_25[1].update.avg);
-    pms["channels"]["2"][json_prop_pm25Ae] = ag->round2(_pm_25[1].update.avg);
-  }
-
-  /// PM10 atmospheric environment
-  if (utils::isValidPm(_pm_10[0].update.avg) && utils::isValidPm(_pm_10[1].update.avg)) {
-    float avg = (_pm_10[0].update.avg + _pm_10[1].update.avg) / 2.0f;
-    pms[json_prop_pm10Ae] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm10Ae] = ag->round2(_pm_10[0].update.avg);
-    pms["channels"]["2"][json_prop_pm10Ae] = ag->round2(_pm_10[1].update.avg);
-  } else if (utils::isValidPm(_pm_10[0].update.avg)) {
-    pms[json_prop_pm10Ae] = ag->round2(_pm_10[0].update.avg);
-    pms["channels"]["1"][json_prop_pm10Ae] = ag->round2(_pm_10[0].update.avg);
-  } else if (utils::isValidPm(_pm_10[1].update.avg)) {
-    pms[json_prop_pm10Ae] = ag->round2(_pm_10[1].update.avg);
-    pms["channels"]["2"][json_prop_pm10Ae] = ag->round2(_pm_10[1].update.avg);
-  }
-
-  /// PM1.0 standard particle
-  if (utils::isValidPm(_pm_01_sp[0].update.avg) && utils::isValidPm(_pm_01_sp[1].update.avg)) {
-    float avg = (_pm_01_sp[0].update.avg + _pm_01_sp[1].update.avg) / 2.0f;
-    pms[json_prop_pm01Sp] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm01Sp] = ag->round2(_pm_01_sp[0].update.avg);
-    pms["channels"]["2"][json_prop_pm01Sp] = ag->round2(_pm_01_sp[1].update.avg);
-  } else if (utils::isValidPm(_pm_01_sp[0].update.avg)) {
-    pms[json_prop_pm01Sp] = ag->round2(_pm_01_sp[0].update.avg);
-    pms["channels"]["1"][json_prop_pm01Sp] = ag->round2(_pm_01_sp[0].update.avg);
-  } else if (utils::isValidPm(_pm_01_sp[1].update.avg)) {
-    pms[json_prop_pm01Sp] = ag->round2(_pm_01_sp[1].update.avg);
-    pms["channels"]["2"][json_prop_pm01Sp] = ag->round2(_pm_01_sp[1].update.avg);
-  }
-
-  /// PM2.5 standard particle
-  if (utils::isValidPm(_pm_25_sp[0].update.avg) && utils::isValidPm(_pm_25_sp[1].update.avg)) {
-    float avg = (_pm_25_sp[0].update.avg + _pm_25_sp[1].update.avg) / 2.0f;
-    pms[json_prop_pm25Sp] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm25Sp] = ag->round2(_pm_25_sp[0].update.avg);
-    pms["channels"]["2"][json_prop_pm25Sp] = ag->round2(_pm_25_sp[1].update.avg);
-  } else if (utils::isValidPm(_pm_25_sp[0].update.avg)) {
-    pms[json_prop_pm25Sp] = ag->round2(_pm_25_sp[0].update.avg);
-    pms["channels"]["1"][json_prop_pm25Sp] = ag->round2(_pm_25_sp[0].update.avg);
-  } else if (utils::isValidPm(_pm_25_sp[1].update.avg)) {
-    pms[json_prop_pm25Sp] = ag->round2(_pm_25_sp[1].update.avg);
-    pms["channels"]["2"][json_prop_pm25Sp] = ag->round2(_pm_25_sp[1].update.avg);
-  }
-
-  /// PM10 standard particle
-  if (utils::isValidPm(_pm_10_sp[0].update.avg) && utils::isValidPm(_pm_10_sp[1].update.avg)) {
-    float avg = (_pm_10_sp[0].update.avg + _pm_10_sp[1].update.avg) / 2.0f;
-    pms[json_prop_pm10Sp] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm10Sp] = ag->round2(_pm_10_sp[0].update.avg);
-    pms["channels"]["2"][json_prop_pm10Sp] = ag->round2(_pm_10_sp[1].update.avg);
-  } else if (utils::isValidPm(_pm_10_sp[0].update.avg)) {
-    pms[json_prop_pm10Sp] = ag->round2(_pm_10_sp[0].update.avg);
-    pms["channels"]["1"][json_prop_pm10Sp] = ag->round2(_pm_10_sp[0].update.avg);
-  } else if (utils::isValidPm(_pm_10_sp[1].update.avg)) {
-    pms[json_prop_pm10Sp] = ag->round2(_pm_10_sp[1].update.avg);
-    pms["channels"]["2"][json_prop_pm10Sp] = ag->round2(_pm_10_sp[1].update.avg);
-  }
-
-  /// PM003 particle count
-  if (utils::isValidPm03Count(_pm_03_pc[0].update.avg) &&
-      utils::isValidPm03Count(_pm_03_pc[1].update.avg)) {
-    float avg = (_pm_03_pc[0].update.avg + _pm_03_pc[1].update.avg) / 2.0f;
-    pms[json_prop_pm03Count] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm03Count] = ag->round2(_pm_03_pc[0].update.avg);
-    pms["channels"]["2"][json_prop_pm03Count] = ag->round2(_pm_03_pc[1].update.avg);
-  } else if (utils::isValidPm03Count(_pm_03_pc[0].update.avg)) {
-    pms[json_prop_pm03Count] = ag->round2(_pm_03_pc[0].update.avg);
-    pms["channels"]["1"][json_prop_pm03Count] = ag->round2(_pm_03_pc[0].update.avg);
-  } else if (utils::isValidPm03Count(_pm_03_pc[1].update.avg)) {
-    pms[json_prop_pm03Count] = ag->round2(_pm_03_pc[1].update.avg);
-    pms["channels"]["2"][json_prop_pm03Count] = ag->round2(_pm_03_pc[1].update.avg);
-  }
-
-  /// PM0.5 particle count
-  if (utils::isValidPm03Count(_pm_05_pc[0].update.avg) &&
-      utils::isValidPm03Count(_pm_05_pc[1].update.avg)) {
-    float avg = (_pm_05_pc[0].update.avg + _pm_05_pc[1].update.avg) / 2.0f;
-    pms[json_prop_pm05Count] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm05Count] = ag->round2(_pm_05_pc[0].update.avg);
-    pms["channels"]["2"][json_prop_pm05Count] = ag->round2(_pm_05_pc[1].update.avg);
-  } else if (utils::isValidPm03Count(_pm_05_pc[0].update.avg)) {
-    pms[json_prop_pm05Count] = ag->round2(_pm_05_pc[0].update.avg);
-    pms["channels"]["1"][json_prop_pm05Count] = ag->round2(_pm_05_pc[0].update.avg);
-  } else if (utils::isValidPm03Count(_pm_05_pc[1].update.avg)) {
-    pms[json_prop_pm05Count] = ag->round2(_pm_05_pc[1].update.avg);
-    pms["channels"]["2"][json_prop_pm05Count] = ag->round2(_pm_05_pc[1].update.avg);
-  }
-  /// PM1.0 particle count
-  if (utils::isValidPm03Count(_pm_01_pc[0].update.avg) &&
-      utils::isValidPm03Count(_pm_01_pc[1].update.avg)) {
-    float avg = (_pm_01_pc[0].update.avg + _pm_01_pc[1].update.avg) / 2.0f;
-    pms[json_prop_pm1Count] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm1Count] = ag->round2(_pm_01_pc[0].update.avg);
-    pms["channels"]["2"][json_prop_pm1Count] = ag->round2(_pm_01_pc[1].update.avg);
-  } else if (utils::isValidPm03Count(_pm_01_pc[0].update.avg)) {
-    pms[json_prop_pm1Count] = ag->round2(_pm_01_pc[0].update.avg);
-    pms["channels"]["1"][json_prop_pm1Count] = ag->round2(_pm_01_pc[0].update.avg);
-  } else if (utils::isValidPm03Count(_pm_01_pc[1].update.avg)) {
-    pms[json_prop_pm1Count] = ag->round2(_pm_01_pc[1].update.avg);
-    pms["channels"]["2"][json_prop_pm1Count] = ag->round2(_pm_01_pc[1].update.avg);
-  }
-
-  /// PM2.5 particle count
-  if (utils::isValidPm03Count(_pm_25_pc[0].update.avg) &&
-      utils::isValidPm03Count(_pm_25_pc[1].update.avg)) {
-    float avg = (_pm_25_pc[0].update.avg + _pm_25_pc[1].update.avg) / 2.0f;
-    pms[json_prop_pm25Count] = ag->round2(avg);
-    pms["channels"]["1"][json_prop_pm25Count] = ag->round2(_pm_25_pc[0].update.avg);
-    pms["channels"]["2"][json_prop_pm25Count] = ag->round2(_pm_25_pc[1].update.avg);
-  } else if (utils::isValidPm03Count(_pm_25_pc[0].update.avg)) {
-    pms[json_prop_pm25Count] = ag->round2(_pm_25_pc[0].update.avg);
-    pms["channels"]["1"][json_prop_pm25Count] = ag->round2(_pm_25_pc[0].update.avg);
-  } else if (utils::isValidPm03Count(_pm_25_pc[1].update.avg)) {
-    pms[json_prop_pm25Count] = ag->round2(_pm_25_pc[1].update.avg);
-    pms["channels"]["2"][json_prop_pm25Count] = ag->round2(_pm_25_pc[1].update.avg);
-  }
-
-  // NOTE: No need for particle count 5.0 and 10. When allCh is true, basically monitor using
-  // PM5003T, which don't have PC 5.0 and 10
+void Measurements::writePMSAverage(JsonWriter &json, const Snapshot &published, bool withTempHum,
+                                   bool compensate, uint64_t fields) {
+  const Measures &avg = published.average;
+  /** Handle every channel by averaging their valid values, or use the value of the only valid
+   * channel. PM values are weighted by channel health, so a faulty channel is left out */
 
-  if (withTempHum) {
-    /// Temperature
-    if (utils::isValidTemperature(_temperature[0].update.avg) &&
-        utils::isValidTemperature(_temperature[1].update.avg)) {
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    if (desc.group != GroupPM || !hasAnyField(fields, desc.type)) {
+      continue;
+    }
 
-      float temperature = (_temperature[0].update.avg + _temperature[1].update.avg) / 2.0f;
-      pms[json_prop_temp] = ag->round2(temperature);
-      pms["channels"]["1"][json_prop_temp] = ag->round2(_temperature[0].update.avg);
-      pms["channels"]["2"][json_prop_temp] = ag->round2(_temperature[1].update.avg);
+    // NOTE: Particle count 5.0 and 10 are always invalid here. When both channel used, basically
+    // monitor using PM5003T, which don't have PC 5.0 and 10
+    float value = fusedOf(published, avg, desc.type);
+    if (desc.isValid(value)) {
+      json.add(desc.jsonKey, ag->round2(value));
+    }
+  }
 
-      if (compensate) {
-        // Compensate both temperature channel
-        float temp1 = getCorrectedTempHum(Temperature, 1, true);
-        float temp2 = getCorrectedTempHum(Temperature, 2, true);
-        float tempAverage = (temp1 + temp2) / 2.0f;
-        pms[json_prop_tempCompensated] = ag->round2(tempAverage);
-        pms["channels"]["1"][json_prop_tempCompensated] = ag->round2(temp1);
-        pms["channels"]["2"][json_prop_tempCompensated] = ag->round2(temp2);
+  if (withTempHum) {
+    /// Temperature and relative humidity
+    const MeasurementType types[] = {Temperature, Humidity};
+    const char *compensatedKeys[] = {json_prop_tempCompensated, json_prop_rhumCompensated};
+    for (int i = 0; i < 2; i++) {
+      const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[types[i]];
+      if (!hasAnyField(fields, desc.type)) {
+        continue;
       }
-
-    } else if (utils::isValidTemperature(_temperature[0].update.avg)) {
-      pms[json_prop_temp] = ag->round2(_temperature[0].update.avg);
-      pms["channels"]["1"][json_prop_temp] = ag->round2(_temperature[0].update.avg);
-
-      if (compensate) {
-        // Compensate channel 1
-        float temp1 = getCorrectedTempHum(Temperature, 1, true);
-        pms[json_prop_tempCompensated] = ag->round2(temp1);
-        pms["channels"]["1"][json_prop_tempCompensated] = ag->round2(temp1);
+      float value = fusedOf(published, avg, desc.type);
+      if (!desc.isValid(value)) {
+        continue;
       }
-
-    } else if (utils::isValidTemperature(_temperature[1].update.avg)) {
-      pms[json_prop_temp] = ag->round2(_temperature[1].update.avg);
-      pms["channels"]["2"][json_prop_temp] = ag->round2(_temperature[1].update.avg);
+      json.add(desc.jsonKey, ag->round2(value));
 
       if (compensate) {
-        // Compensate channel 2
-        float temp2 = getCorrectedTempHum(Temperature, 2, true);
-        pms[json_prop_tempCompensated] = ag->round2(temp2);
-        pms["channels"]["2"][json_prop_tempCompensated] = ag->round2(temp2);
+        // Compensate the valid channels only
+        float sum = 0;
+        int count = 0;
+        for (int ch = 1; ch <= desc.channels; ch++) {
+          if (desc.isValid(valueOf(avg, desc.type, ch))) {
+            sum += getCorrectedTempHum(published, desc.type, ch, true);
+            count++;
+          }
+        }
+        json.add(compensatedKeys[i], ag->round2(sum / count));
       }
     }
+  }
 
-    /// Relative humidity
-    if (utils::isValidHumidity(_humidity[0].update.avg) &&
-        utils::isValidHumidity(_humidity[1].update.avg)) {
-      float humidity = (_humidity[0].update.avg + _humidity[1].update.avg) / 2.0f;
-      pms[json_prop_rhum] = ag->round2(humidity);
-      pms["channels"]["1"][json_prop_rhum] = ag->round2(_humidity[0].update.avg);
-      pms["channels"]["2"][json_prop_rhum] = ag->round2(_humidity[1].update.avg);
-
-      if (compensate) {
-        // Compensate both humidity channel
-        float hum1 = getCorrectedTempHum(Humidity, 1, true);
-        float hum2 = getCorrectedTempHum(Humidity, 2, true);
-        float humAverage = (hum1 + hum2) / 2.0f;
-        pms[json_prop_rhumCompensated] = ag->round2(humAverage);
-        pms["channels"]["1"][json_prop_rhumCompensated] = ag->round2(hum1);
-        pms["channels"]["2"][json_prop_rhumCompensated] = ag->round2(hum2);
-      }
-
-    } else if (utils::isValidHumidity(_humidity[0].update.avg)) {
-      pms[json_prop_rhum] = ag->round2(_humidity[0].update.avg);
-      pms["channels"]["1"][json_prop_rhum] = ag->round2(_humidity[0].update.avg);
-
-      if (compensate) {
-        // Compensate humidity channel 1
-        float hum1 = getCorrectedTempHum(Humidity, 1, true);
-        pms[json_prop_rhumCompensated] = ag->round2(hum1);
-        pms["channels"]["1"][json_prop_rhumCompensated] = ag->round2(hum1);
+  if (compensate && (hasAnyField(fields, PM25) || hasAnyField(fields, Humidity))) {
+    // Add pm25 compensated value
+    /// First get every channel compensated value
+    float pm25Comp[MEASUREMENT_CHANNELS];
+    bool valid[MEASUREMENT_CHANNELS];
+    bool anyValid = false;
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      pm25Comp[ch - 1] = utils::getInvalidPmValue();
+      if (utils::isValidPm(valueOf(avg, PM25, ch)) &&
+          utils::isValidHumidity(valueOf(avg, Humidity, ch))) {
+        pm25Comp[ch - 1] = getCorrectedPM25(published, true, ch, true);
       }
+      valid[ch - 1] = utils::isValidPm(pm25Comp[ch - 1]);
+      anyValid = anyValid || valid[ch - 1];
+    }
 
-    } else if (utils::isValidHumidity(_humidity[1].update.avg)) {
-      pms[json_prop_rhum] = ag->round2(_humidity[1].update.avg);
-      pms["channels"]["2"][json_prop_rhum] = ag->round2(_humidity[1].update.avg);
-
-      if (compensate) {
-        // Compensate humidity channel 2
-        float hum2 = getCorrectedTempHum(Humidity, 2, true);
-        pms[json_prop_rhumCompensated] = ag->round2(hum2);
-        pms["channels"]["2"][json_prop_rhumCompensated] = ag->round2(hum2);
-      }
+    /// Get weighted average or the compensated value of the only valid channel
+    if (anyValid) {
+      json.add(json_prop_pm25Compensated, ag->round2(published.pmsFusion.combine(pm25Comp, valid)));
     }
+  }
+}
 
-    if (compensate) {
-      // Add pm25 compensated value
-      /// First get both channel compensated value
-      float pm25_comp1 = utils::getInvalidPmValue();
-      float pm25_comp2 = utils::getInvalidPmValue();
-      if (utils::isValidPm(_pm_25[0].update.avg) &&
-          utils::isValidHumidity(_humidity[0].update.avg)) {
-        pm25_comp1 = getCorrectedPM25(true, 1, true);
-        pms["channels"]["1"][json_prop_pm25Compensated] = ag->round2(pm25_comp1);
+/**
+ * @brief Write window statistics of every measurement channel that has samples, as
+ * "statistics":{"<channel>":{"<measurement>":{"count","mean","stddev","min","max"}}}
+ */
+void Measurements::writeStatistics(JsonWriter &json, const Snapshot &published) {
+  json.beginObject("statistics");
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    bool hasChannel = false;
+    for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+      const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+      if (ch > desc.channels) {
+        continue;
       }
-      if (utils::isValidPm(_pm_25[1].update.avg) &&
-          utils::isValidHumidity(_humidity[1].update.avg)) {
-        pm25_comp2 = getCorrectedPM25(true, 2, true);
-        pms["channels"]["2"][json_prop_pm25Compensated] = ag->round2(pm25_comp2);
+      const Statistics &statistics = statisticsOf(published, desc.type, ch);
+      if (statistics.count == 0) {
+        continue;
       }
 
-      /// Get average or one of the channel compensated value if only one channel is valid
-      if (utils::isValidPm(pm25_comp1) && utils::isValidPm(pm25_comp2)) {
-        pms[json_prop_pm25Compensated] = ag->round2((pm25_comp1 + pm25_comp2) / 2.0f);
-      } else if (utils::isValidPm(pm25_comp1)) {
-        pms[json_prop_pm25Compensated] = ag->round2(pm25_comp1);
-      } else if (utils::isValidPm(pm25_comp2)) {
-        pms[json_prop_pm25Compensated] = ag->round2(pm25_comp2);
+      // Only open channel object when there is at least one measurement with samples
+      if (!hasChannel) {
+        char name[2] = {(char)('0' + ch), '\0'};
+        json.beginObject(name);
+        hasChannel = true;
       }
+      json.beginObject(desc.jsonKey);
+      json.add("count", statistics.count);
+      json.add("mean", ag->round2(statistics.mean));
+      json.add("stddev", ag->round2(statistics.stddev));
+      json.add("min", ag->round2(statistics.min));
+      json.add("max", ag->round2(statistics.max));
+      json.endObject();
+    }
+    if (hasChannel) {
+      json.endObject();
+    }
+  }
+  json.endObject();
+}
+
+bool Measurements::hasPMSChannelData(uint64_t fields, int ch) {
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    if ((desc.group == GroupPM || desc.group == GroupTempHum) && hasField(fields, desc.type, ch)) {
+      return true;
     }
   }
+  return false;
+}
 
-  return pms;
+bool Measurements::hasPMSChannelData(const Measures &avg, int ch) {
+  for (int i = 0; i < _MEASUREMENT_TYPE_MAX; i++) {
+    const MeasurementDescriptor &desc = MEASUREMENT_DESCRIPTORS[i];
+    if ((desc.group == GroupPM || desc.group == GroupTempHum) &&
+        desc.isValid(valueOf(avg, desc.type, ch))) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void Measurements::setDebug(bool debug) { _debug = debug; }
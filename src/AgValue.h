@@ -5,12 +5,71 @@
 #include "AirGradient.h"
 #include "App/AppDef.h"
 #include "Libraries/Arduino_JSON/src/Arduino_JSON.h"
+#include "Main/AirQualityIndex.h"
+#include "Main/JsonWriter.h"
+#include "Main/PMSFusion.h"
+#include "Main/RingBuffer.h"
+#include "Main/SortedWindow.h"
+#include "Main/TimeWeightedMean.h"
+#include "Main/WindowStatistics.h"
 #include "Main/utils.h"
 #include <Arduino.h>
 #include <cstdint>
 #include <vector>
 #include <string>
 
+// Maximum number of samples kept for each moving average. Needs to cover the largest period set
+// through Measurements::maxPeriod() or averagingWindow() by the examples (30 samples for SGP41 on
+// 1s interval)
+#define MEASUREMENT_AVERAGE_MAX_PERIOD 30
+// Hampel filter, a sample further than threshold * sigma from the window median is an outlier.
+// Sigma is estimated as 1.4826 * MAD, with a lower bound so a flat window doesn't flag the sensor
+// resolution as outlier
+#define MEASUREMENT_HAMPEL_THRESHOLD 3.0f
+#define MEASUREMENT_HAMPEL_MIN_SIGMA 1.0f
+#define MEASUREMENT_HAMPEL_MIN_SAMPLES 3
+/** Initial capacity of the toString payload, fit a typical payload without satellites */
+#define MEASUREMENT_JSON_RESERVE_SIZE 768
+/** ReportState fields of a full report */
+#define MEASUREMENT_REPORT_ALL_FIELDS UINT64_MAX
+/** Schema version, first byte of the binary measures payload */
+#define MEASURES_BINARY_PAYLOAD_VERSION 1
+/** Number of values of the cellular payload: base fields, signal and extended PM fields */
+#define MEASURES_PAYLOAD_VALUES 16
+
+// Number of channels of the temperature, humidity and PM measurements, one per PMS sensor.
+// Board build parameter: 1 for a single sensor monitor (default on ESP8266, BASIC and DIY Pro
+// only have one PMS), 2 for the Open Air FW_MODE_O_1PPx dual PMS5003T (default), up to 4 for
+// co-location setups
+#ifndef MEASUREMENT_CHANNELS
+#ifdef ESP8266
+#define MEASUREMENT_CHANNELS 1
+#else
+#define MEASUREMENT_CHANNELS 2
+#endif
+#endif
+#if MEASUREMENT_CHANNELS < 1 || MEASUREMENT_CHANNELS > 4
+#error "MEASUREMENT_CHANNELS must be 1 to 4"
+#endif
+
+// Storage slots needed by every channel of float and integer MeasurementType, checked at compile
+// time against the descriptor table in AgValue.cpp
+#define MEASUREMENT_FLOAT_SLOTS (2 * MEASUREMENT_CHANNELS)
+#define MEASUREMENT_INTEGER_SLOTS (5 + 12 * MEASUREMENT_CHANNELS)
+
+// Sorted windows shared by the channels filtered by median or Hampel, one per channel. Channels
+// filtered by mean, the default, don't need one
+#ifndef MEASUREMENT_FILTER_WINDOWS
+#define MEASUREMENT_FILTER_WINDOWS (4 * MEASUREMENT_CHANNELS)
+#endif
+
+// Bytes shared by the moving average windows of every MeasurementType channel, each type takes a
+// slice sized to its period when it is set, see Measurements::layoutWindows(). Fit the periods
+// set by the examples
+#ifndef MEASUREMENT_SAMPLE_POOL
+#define MEASUREMENT_SAMPLE_POOL (1536 + 1024 * MEASUREMENT_CHANNELS)
+#endif
+
 // Forward declaration
 class AgSatellites;
 
@@ -20,13 +79,25 @@ private:
   struct Update {
     int invalidCounter; // Counting on how many invalid value that are passed to update function
     int max;            // Maximum length of the period of the moving average
+    uint32_t window;    // Duration of the moving average in ms, 0 if only limited by max
     float avg;          // Moving average value, updated every update function called
   };
 
+  // Moving average window of every channel of a measurement type, a slice of the sample pool
+  struct Window {
+    uint8_t requested; // Samples asked by maxPeriod() or averagingWindow()
+    uint8_t capacity;  // Samples of the slice, less than requested if the pool is too small
+    uint16_t offset;   // Of the slice in the sample pool
+    bool timed;        // Time window, the slice also has the SampleClock and the value rounds
+    uint32_t joinTime; // Of the SampleClock
+  };
+
   // Reading type for sensor value that outputs float
   struct FloatValue {
-    float sumValues;               // Total value from each update
-    std::vector<float> listValues; // List of update value that are kept
+    float sumValues; // Total value from each update
+    RingBuffer<float, 0> listValues;       // Update values that are kept, in the sample pool
+    WindowStatistics<float, 0> statistics; // Of listValues
+    TimeWeightedMean<float> timeWeighted;  // Of listValues, only kept for a time window
     Update update;
   };
 
@@ -34,7 +105,9 @@ private:
   struct IntegerValue {
     unsigned long sumValues; // Total value from each update; unsigned long to accomodate TVOx and
                              // NOx raw data
-    std::vector<int> listValues; // List of update value that are kept
+    RingBuffer<int, 0> listValues;       // Update values that are kept, in the sample pool
+    WindowStatistics<int, 0> statistics; // Of listValues
+    TimeWeightedMean<int> timeWeighted;  // Of listValues, only kept for a time window
     Update update;
   };
 
@@ -42,31 +115,108 @@ public:
   Measurements(Configuration &config);
   ~Measurements() {}
 
+  // PMS fusion of every channel
+  typedef PMSFusion<MEASUREMENT_CHANNELS> Fusion;
+
   struct Measures {
-    float temperature[2];
-    float humidity[2];
+    float temperature[MEASUREMENT_CHANNELS];
+    float humidity[MEASUREMENT_CHANNELS];
     float co2;
     float tvoc; // Index value
     float tvoc_raw;
     float nox; // Index value
     float nox_raw;
-    float pm_01[2];    // pm 1.0 atmospheric environment
-    float pm_25[2];    // pm 2.5 atmospheric environment
-    float pm_10[2];    // pm 10 atmospheric environment
-    float pm_01_sp[2]; // pm 1.0 standard particle
-    float pm_25_sp[2]; // pm 2.5 standard particle
-    float pm_10_sp[2]; // pm 10 standard particle
-    float pm_03_pc[2]; // particle count 0.3
-    float pm_05_pc[2]; // particle count 0.5
-    float pm_01_pc[2]; // particle count 1.0
-    float pm_25_pc[2]; // particle count 2.5
-    float pm_5_pc[2];  // particle count 5.0
-    float pm_10_pc[2]; // particle count 10
+    float pm_01[MEASUREMENT_CHANNELS];    // pm 1.0 atmospheric environment
+    float pm_25[MEASUREMENT_CHANNELS];    // pm 2.5 atmospheric environment
+    float pm_10[MEASUREMENT_CHANNELS];    // pm 10 atmospheric environment
+    float pm_01_sp[MEASUREMENT_CHANNELS]; // pm 1.0 standard particle
+    float pm_25_sp[MEASUREMENT_CHANNELS]; // pm 2.5 standard particle
+    float pm_10_sp[MEASUREMENT_CHANNELS]; // pm 10 standard particle
+    float pm_03_pc[MEASUREMENT_CHANNELS]; // particle count 0.3
+    float pm_05_pc[MEASUREMENT_CHANNELS]; // particle count 0.5
+    float pm_01_pc[MEASUREMENT_CHANNELS]; // particle count 1.0
+    float pm_25_pc[MEASUREMENT_CHANNELS]; // particle count 2.5
+    float pm_5_pc[MEASUREMENT_CHANNELS];  // particle count 5.0
+    float pm_10_pc[MEASUREMENT_CHANNELS]; // particle count 10
     int bootCount;
     int signal;
     uint32_t freeHeap;
   };
 
+  // Measures cycle packed for queueing, about a fifth of Measures. Every value of the cellular
+  // payload, extended PM fields included, as sent (channel average at the payload scale) stored
+  // as a 16 bits offset from the field minimum, so it's lossless at the payload precision
+  struct PackedMeasures {
+    uint16_t present; // Bit set if value at index is valid, in payload order
+    uint16_t values[MEASURES_PAYLOAD_VALUES];
+  };
+
+  // Statistics of the samples kept for the moving average of a measurement channel
+  struct Statistics {
+    int count;    // Number of samples, other fields are 0 if there is no sample
+    float mean;   // Mean of the samples, regardless of the filter mode
+    float stddev; // Sample standard deviation, 0 if less than 2 samples
+    float min;
+    float max;
+  };
+
+  // Corrected values memoized on snapshots, see Corrections
+  enum CorrectedValue {
+    CorrectedPM25,              // Average, with the configured correction
+    CorrectedPM25Forced,        // Average, with correction forced
+    CorrectedPM25Latest,        // Latest value, with the configured correction
+    CorrectedTemperature,       // Average, with the configured correction
+    CorrectedTemperatureForced, // Average, with correction forced
+    CorrectedHumidity,          // Average, with the configured correction
+    CorrectedHumidityForced,    // Average, with correction forced
+    _CORRECTED_VALUE_MAX
+  };
+
+  // Corrected values of every channel, computed on publish once a reader asked for them, then
+  // kept while their inputs and the configuration corrections don't change
+  struct Corrections {
+    // Bit (value * MEASUREMENT_CHANNELS + ch - 1) set if values[value][ch - 1] is computed
+    uint32_t computed;
+    uint32_t configVersion; // Configuration::getValuesVersion() they are computed with
+    float values[_CORRECTED_VALUE_MAX][MEASUREMENT_CHANNELS];
+  };
+
+  // PM2.5 shown on the display and LED bar, computed on publish once per PM2.5 update
+  struct AirQuality {
+    float pm25;                  // Average, of the channels fused if the monitor has two and
+                                 // corrected if PM correction is enabled
+    AirQualityIndex::Result aqi; // Index of the configuration country standard
+  };
+
+  // Consistent copy of every measurement, see publish() and snapshot()
+  struct Snapshot {
+    uint32_t version; // Incremented on every publish
+    Measures average; // Moving average of every measurement, as getAverage()
+    Measures latest;  // Latest value of every measurement, as get() and getFloat()
+    // Window statistics of every measurement channel, as getStatistics(). See statisticsOf()
+    Statistics statistics[MEASUREMENT_FLOAT_SLOTS + MEASUREMENT_INTEGER_SLOTS];
+    Fusion::Status pmsFusion;    // PMS channels health and weights, see fusePMS()
+    Corrections corrections;     // See getCorrectedTempHum and getCorrectedPM25 of a Snapshot
+    AirQuality airQuality;       // See getAirQuality()
+  };
+
+  // What a consumer has to send, see prepareReport()
+  enum ReportDecision {
+    ReportSkip,    // Nothing changed beyond its deadband since the last report
+    ReportFull,    // Every measurement
+    ReportChanged, // Only the measurements that changed, see ReportState::fields
+  };
+
+  // Measurements last reported to one consumer, each consumer (cloud, MQTT) keeps its own
+  struct ReportState {
+    ReportDecision decision;
+    uint64_t fields;     // Bit (Measures float index) set if the measurement is reported
+    Measures reported;   // Averages last acknowledged by the consumer, see commitReport()
+    Measures pending;    // Averages written on the report being sent
+    uint32_t reportedAt; // millis() of the last full report
+    bool hasReported;    // False until the first report is acknowledged
+  };
+
   void setAirGradient(AirGradient *ag);
   void setSatellites(AgSatellites *satellites);
 
@@ -91,18 +241,70 @@ public:
     PM25_PC, // Particle 2.5 count
     PM5_PC,  // Particle 5.0 count
     PM10_PC, // Particle 10 count
+    _MEASUREMENT_TYPE_MAX
+  };
+
+  // Sensor group that provide the measurement
+  enum MeasurementGroup {
+    GroupTempHum,
+    GroupCO2,
+    GroupVOC,
+    GroupPM,
+  };
+
+  // Static description of each MeasurementType, see descriptor()
+  struct MeasurementDescriptor {
+    MeasurementType type;         // Must match its index on the table
+    MeasurementGroup group;       // Sensor group of the measurement
+    bool isFloat;                 // Use FLOAT as the data type, otherwise INT
+    uint8_t slot;                 // Storage slot of channel 1, next channel use the next slot
+    uint8_t channels;             // Number of channel available
+    int invalidValue;             // Value that indicate measurement is invalid
+    bool (*isValid)(float value); // Check if a value is a valid measurement
+    float deadband; // Default change to report when reporting on change, see prepareReport()
+    const char *name;             // Name for logging
+    const char *jsonKey;          // Key on JSON payload
+    const char *metricName;       // OpenMetrics name, nullptr if not exported as metric
+    const char *metricUnit;       // OpenMetrics unit, empty if no unit
+    const char *metricHelp;       // OpenMetrics help text
   };
 
+  /**
+   * @brief Get static description of a measurement type
+   *
+   * @param type measurement type
+   * @return descriptor from the measurement table, indexed by type
+   */
+  static const MeasurementDescriptor &descriptor(MeasurementType type);
+
   void printCurrentAverage();
 
   /**
    * @brief Set each MeasurementType maximum period length for moving average
    *
    * @param type the target measurement type to set
-   * @param max the maximum period length
+   * @param max the maximum period length, limited to MEASUREMENT_AVERAGE_MAX_PERIOD. Values kept
+   * are cleared if the window storage changes
    */
   void maxPeriod(MeasurementType, int max);
 
+  /**
+   * @brief Set each MeasurementType moving average to a time window instead of a number of samples
+   *
+   * Values older than duration leave the average, so a stalled sensor read or a paused loop
+   * doesn't stretch the period it covers, and the average becomes invalid once no valid value was
+   * updated for duration. In mean filter mode the average is time weighted, see TimeWeightedMean.
+   * Samples kept are sized to the update interval and limited to MEASUREMENT_AVERAGE_MAX_PERIOD,
+   * so update interval should be at least duration / MEASUREMENT_AVERAGE_MAX_PERIOD. maxPeriod()
+   * switches back to a number of samples. Values kept are cleared if the window storage changes
+   *
+   * @param type the target measurement type to set
+   * @param duration length of the window in milliseconds
+   * @param interval update interval of the measurement in milliseconds, all its channels are
+   * updated together. 0 if unknown, MEASUREMENT_AVERAGE_MAX_PERIOD samples are kept
+   */
+  void averagingWindow(MeasurementType type, uint32_t duration, uint32_t interval = 0);
+
   /**
    * @brief update target measurement type with new value.
    * Each MeasurementType has last raw value and moving average value based on max period
@@ -111,7 +313,7 @@ public:
    * @param type measurement type that will be updated
    * @param val (int) the new value
    * @param ch (int) the MeasurementType channel, not every MeasurementType has more than 1 channel.
-   * Currently maximum channel is 2. Default: 1 (channel 1)
+   * Maximum channel is MEASUREMENT_CHANNELS. Default: 1 (channel 1)
    * @return false if new value invalid consecutively reach threshold (max period)
    * @return true otherwise
    */
@@ -125,7 +327,7 @@ public:
    * @param type measurement type that will be updated
    * @param val (float) the new value
    * @param ch (int) the MeasurementType channel, not every MeasurementType has more than 1 channel.
-   * Currently maximum channel is 2. Default: 1 (channel 1)
+   * Maximum channel is MEASUREMENT_CHANNELS. Default: 1 (channel 1)
    * @return false if new value invalid consecutively reach threshold (max period)
    * @return true otherwise
    */
@@ -158,6 +360,16 @@ public:
    */
   float getAverage(MeasurementType type, int ch = 1);
 
+  /**
+   * @brief Get count, mean, standard deviation, minimum and maximum of the samples kept for the
+   * target measurement moving average
+   *
+   * @param type measurement type that will be retrieve
+   * @param ch target type value channel
+   * @return statistics of the moving average window
+   */
+  Statistics getStatistics(MeasurementType type, int ch = 1);
+
   /**
    * @brief Get Temperature or Humidity correction value
    * Only if correction is applied from configuration or forceCorrection is True
@@ -170,6 +382,20 @@ public:
    */
   float getCorrectedTempHum(MeasurementType type, int ch = 1, bool forceCorrection = false);
 
+  /**
+   * @brief Get Temperature or Humidity correction value of a snapshot value, see
+   * getCorrectedTempHum
+   */
+  float getCorrectedTempHum(const Measures &mc, MeasurementType type, int ch = 1,
+                            bool forceCorrection = false);
+
+  /**
+   * @brief Get Temperature or Humidity correction value of a snapshot average, computed once
+   * when the snapshot was published. See getCorrectedTempHum
+   */
+  float getCorrectedTempHum(const Snapshot &snapshot, MeasurementType type, int ch = 1,
+                            bool forceCorrection = false);
+
   /**
    * @brief Get the Corrected PM25 object based on the correction algorithm from configuration
    *
@@ -182,15 +408,199 @@ public:
    */
   float getCorrectedPM25(bool useAvg = false, int ch = 1, bool forceCorrection = false);
 
+  /**
+   * @brief Get corrected PM2.5 of a snapshot value, see getCorrectedPM25
+   *
+   * @param mc Snapshot average or latest values
+   */
+  float getCorrectedPM25(const Measures &mc, int ch = 1, bool forceCorrection = false);
+
+  /**
+   * @brief Get corrected PM2.5 of a snapshot, computed once when the snapshot was published,
+   * except the latest value with correction forced. See getCorrectedPM25
+   */
+  float getCorrectedPM25(const Snapshot &snapshot, bool useAvg, int ch = 1,
+                         bool forceCorrection = false);
+
+  /**
+   * @brief Publish current measurements as a new snapshot for the other tasks
+   *
+   * Call from the task that update the measurements, once every value of an update batch is
+   * set. Does nothing if no measurement was updated since the last publish
+   */
+  void publish();
+
+  /**
+   * @brief Get PM2.5 and its air quality index of the last published snapshot, safe to call from
+   * any task. Index is of the standard of Configuration::getCountry(), see AirQualityIndex
+   */
+  AirQuality getAirQuality();
+
+  /**
+   * @brief Arbitrate the PMS channels, such as both of the Open Air monitor, with their latest
+   * PM2.5 sample
+   *
+   * Call once per PMS read cycle, after every channel is updated. Resulting health and weights
+   * are published with the snapshot and used for the values combined from the channels
+   */
+  void fusePMS();
+
+  /**
+   * @brief Value of a measurement combined from its valid channels, PM weighted by the channels
+   * health of the snapshot
+   *
+   * @return invalid value of the measurement if no channel is valid
+   */
+  static float fusedOf(const Snapshot &snapshot, const Measures &mc, MeasurementType type);
+
+  /**
+   * @brief Get a consistent copy of the last published snapshot, safe to call from any task
+   *
+   * Never block the writer: the copy is taken again if a publish completed while it was copied.
+   * Copied straight into the caller storage, a snapshot is about 1KB of the reader stack
+   *
+   * @param out set to the snapshot
+   */
+  void snapshot(Snapshot &out);
+
+  /**
+   * @brief Get value of a measurement type channel from a Measures
+   */
+  static float valueOf(const Measures &mc, MeasurementType type, int ch = 1);
+
+  /**
+   * @brief Get window statistics of a measurement type channel from a Snapshot
+   */
+  static const Statistics &statisticsOf(const Snapshot &snapshot, MeasurementType type,
+                                        int ch = 1);
+
+  /**
+   * @brief Decide what a consumer has to send according to the configuration reporting mode
+   *
+   * Interval mode always report every measurement. Otherwise a report is only needed once a
+   * measurement average moved by more than its deadband from the last acknowledged report, or
+   * became valid or invalid, or reporting heartbeat elapsed since the last full report.
+   *
+   * @param state consumer report state, decision and fields are updated
+   * @param partial consumer accept a payload with only the changed measurements, delta mode
+   * @return ReportDecision same as state.decision
+   */
+  ReportDecision prepareReport(ReportState &state, bool partial);
+
+  /**
+   * @brief Record the report prepared on state as acknowledged, call once it is sent
+   */
+  void commitReport(ReportState &state);
+
+  /**
+   * @brief Check if a measurement average moved by more than its deadband from reference, or
+   * became valid or invalid, regardless of the reporting mode. See prepareReport()
+   *
+   * @param reference averages to compare with, see getMeasures()
+   */
+  bool hasChangedSince(const Measures &reference);
+
   /**
    * build json payload for every measurements
+   *
+   * @param report if not nullptr, only the fields of the prepared report are written
+   */
+  String toString(bool localServer, AgFirmwareMode fwMode, int rssi,
+                  ReportState *report = nullptr);
+
+  /**
+   * @brief Write json payload for every measurements to a Print sink, without building a JSON
+   * tree in memory. Same content as toString
+   *
+   * @return size_t number of bytes written
    */
-  String toString(bool localServer, AgFirmwareMode fwMode, int rssi);
+  size_t toJson(Print &out, bool localServer, AgFirmwareMode fwMode, int rssi,
+                ReportState *report = nullptr);
+
+  /**
+   * @brief Write json payload for every measurements to a caller supplied buffer, NUL
+   * terminated
+   *
+   * @return size_t payload length, 0 if buffer is too small
+   */
+  size_t toJson(char *buf, size_t size, bool localServer, AgFirmwareMode fwMode, int rssi,
+                ReportState *report = nullptr);
 
   Measures getMeasures();
 
   std::string buildMeasuresPayload(Measures &mc, bool extendedPmMeasures);
 
+  /**
+   * @brief Encode one measures cycle as cellular payload into a caller supplied buffer
+   *
+   * Same semantic as snprintf: output is NUL terminated and truncated if buffer is too small,
+   * call with NULL buffer and size 0 to get the length to allocate
+   *
+   * @return size_t payload length, excluding NUL terminator
+   */
+  static size_t encodeMeasuresPayload(const Measures &mc, bool extendedPmMeasures, char *buf,
+                                      size_t size);
+
+  /**
+   * @brief Encode a batch of measures cycle as cellular payload: interval followed by every
+   * measures cycle, comma separated
+   *
+   * Same semantic as snprintf, see encodeMeasuresPayload
+   *
+   * @param interval measurement interval in seconds
+   * @return size_t payload length, excluding NUL terminator
+   */
+  static size_t encodeMeasuresPayload(uint32_t interval, const Measures *mcs, int count,
+                                      bool extendedPmMeasures, char *buf, size_t size);
+
+  /**
+   * @brief Pack a measures cycle for queueing, see PackedMeasures
+   *
+   * @return false if a value is out of the 16 bits range of its field and was saturated, only
+   * happens on values outside of the sensors range
+   */
+  static bool packMeasures(const Measures &mc, PackedMeasures &packed);
+
+  /**
+   * @brief Same as encodeMeasuresPayload of Measures batch, from packed measures cycles
+   */
+  static size_t encodeMeasuresPayload(uint32_t interval, const PackedMeasures *mcs, int count,
+                                      bool extendedPmMeasures, char *buf, size_t size);
+
+  /**
+   * @brief Encode a batch of measures cycle as compact binary payload
+   *
+   * Carry the same values as the CSV payload: header is schema version and flags bytes, then
+   * interval and number of cycles as varint. Every cycle is sent as varint delta of the values
+   * that changed since the previous cycle, see AgValue.cpp for the record layout.
+   * Like encodeMeasuresPayload, call with NULL buffer and size 0 to get the length to allocate
+   *
+   * @param interval measurement interval in seconds
+   * @return size_t payload length, can be more than size if buffer is too small
+   */
+  static size_t encodeMeasuresBinaryPayload(uint32_t interval, const Measures *mcs, int count,
+                                            bool extendedPmMeasures, uint8_t *buf, size_t size);
+
+  /**
+   * @brief Same as encodeMeasuresBinaryPayload of Measures batch, from packed measures cycles
+   */
+  static size_t encodeMeasuresBinaryPayload(uint32_t interval, const PackedMeasures *mcs,
+                                            int count, bool extendedPmMeasures, uint8_t *buf,
+                                            size_t size);
+
+  /**
+   * @brief Reference decoder of the binary payload, convert it back to the CSV payload
+   * encodeMeasuresPayload() gives for the same batch. Plain C++, so it also builds on host
+   *
+   * Same semantic as snprintf for the CSV output, see encodeMeasuresPayload
+   *
+   * @param data binary payload
+   * @param length binary payload length
+   * @return size_t CSV payload length, 0 if binary payload is malformed or of unknown version
+   */
+  static size_t decodeMeasuresBinaryPayload(const uint8_t *data, size_t length, char *buf,
+                                            size_t size);
+
   /**
    * Set to true if want to debug every update value
    */
@@ -205,33 +615,46 @@ public:
 
 private:
   Configuration &config;
-  AirGradient *ag;
+  AirGradient *ag = nullptr;
   AgSatellites *satellites_ = nullptr;
 
-  // Some declared as an array (channel), because FW_MODE_O_1PPx has two PMS5003T
-  FloatValue _temperature[2];
-  FloatValue _humidity[2];
-  IntegerValue _co2;
-  IntegerValue _tvoc; // Index value
-  IntegerValue _tvoc_raw;
-  IntegerValue _nox; // Index value
-  IntegerValue _nox_raw;
-  IntegerValue _pm_01[2];    // pm 1.0 atmospheric environment
-  IntegerValue _pm_25[2];    // pm 2.5 atmospheric environment
-  IntegerValue _pm_10[2];    // pm 10 atmospheric environment
-  IntegerValue _pm_01_sp[2]; // pm 1.0 standard particle
-  IntegerValue _pm_25_sp[2]; // pm 2.5 standard particle
-  IntegerValue _pm_10_sp[2]; // pm 10 standard particle
-  IntegerValue _pm_03_pc[2]; // particle count 0.3
-  IntegerValue _pm_05_pc[2]; // particle count 0.5
-  IntegerValue _pm_01_pc[2]; // particle count 1.0
-  IntegerValue _pm_25_pc[2]; // particle count 2.5
-  IntegerValue _pm_5_pc[2];  // particle count 5.0
-  IntegerValue _pm_10_pc[2]; // particle count 10
+  // Storage of every MeasurementType channel, index by descriptor slot. Temperature, humidity
+  // and PM have MEASUREMENT_CHANNELS channels, one per PMS sensor
+  FloatValue _floatValues[MEASUREMENT_FLOAT_SLOTS];
+  IntegerValue _integerValues[MEASUREMENT_INTEGER_SLOTS];
   int _bootCount;
   int _resetReason;
   bool _debug = false;
 
+  // Published snapshots, the writer fill the one not pointed by _snapshotVersion while readers
+  // copy the other one
+  Snapshot _snapshots[2];
+  volatile uint32_t _snapshotVersion = 0;
+  bool _updated = false; // Measurement updated since the last publish
+  Fusion _pmsFusion;
+  // Corrected values asked by readers, memoized from the next publish on. Only ever set to true
+  volatile bool _correctionRequested[_CORRECTED_VALUE_MAX][MEASUREMENT_CHANNELS] = {};
+  AirQualityIndex _aqi;
+  uint32_t _configValuesVersion = 0; // Configuration values the AQI standard was set from
+  bool _pm25Updated = false; // PM2.5 updated since the last publish
+
+  // Filter mode of every MeasurementType, reloaded when configuration values change
+  MeasurementFilterMode _filterModes[_MEASUREMENT_TYPE_MAX];
+  uint32_t _filtersVersion = 0;
+  // Values of the window in ascending order, of the channels not filtered by mean. Integer
+  // measurements are exact as float
+  typedef SortedWindow<float, MEASUREMENT_AVERAGE_MAX_PERIOD> FilterWindow;
+  FilterWindow _filterWindows[MEASUREMENT_FILTER_WINDOWS];
+  // Filter window of channel 1 of every MeasurementType, next channel use the next window. -1 if
+  // filtered by mean
+  int8_t _filterWindowOf[_MEASUREMENT_TYPE_MAX];
+
+  // Moving average window of every MeasurementType, and the round times shared by its channels
+  // for a time window. Storage of the values is sliced from _samplePool, see layoutWindows()
+  Window _windows[_MEASUREMENT_TYPE_MAX];
+  SampleClock _clocks[_MEASUREMENT_TYPE_MAX];
+  alignas(uint32_t) uint8_t _samplePool[MEASUREMENT_SAMPLE_POOL];
+
   /**
    * @brief Get PMS5003 firmware version string
    *
@@ -265,12 +688,121 @@ private:
    * abort program if invalid
    */
   void validateChannel(int ch);
+  bool hasPMSChannel(int ch);
 
   void printCurrentPMAverage(int ch);
 
-  JSONVar buildOutdoor(bool localServer, AgFirmwareMode fwMode);
-  JSONVar buildIndoor(bool localServer);
-  JSONVar buildPMS(int ch, bool allCh, bool withTempHum, bool compensate);
+  /**
+   * @brief Get storage of target measurement type channel
+   *
+   * @return nullptr if measurement type is not using respective data type
+   */
+  FloatValue *floatValue(MeasurementType type, int ch);
+  IntegerValue *integerValue(MeasurementType type, int ch);
+
+  /**
+   * @brief Get moving average state of target measurement type channel regardless of data type
+   */
+  Update &updateOf(MeasurementType type, int ch);
+
+  /**
+   * @brief Get moving average value of target measurement type channel
+   */
+  float averageOf(MeasurementType type, int ch = 1);
+
+  /**
+   * @brief Check if value is valid for target measurement type
+   */
+  bool isValid(MeasurementType type, float value);
+
+  /**
+   * @brief Add new value to a measurement moving average
+   */
+  template <typename V, typename T>
+  bool updateMovingAverage(MeasurementType type, V &value, T val, int ch);
+
+  /**
+   * @brief Remove the oldest value of a measurement moving average. List must not be empty
+   *
+   * @param sorted filter window of the channel, nullptr if filtered by mean
+   */
+  template <typename V> void removeOldest(MeasurementType type, V &value, FilterWindow *sorted);
+
+  /**
+   * @brief Slice the sample pool again after a window changed. Types are laid out in
+   * MeasurementType order, so the ones whose slice moved or resized are cleared
+   */
+  void layoutWindows(void);
+
+  /**
+   * @brief Bytes of the slice of a window, its SampleClock if timed and every channel storage
+   */
+  static size_t windowBytes(size_t capacity, int channels, bool timed);
+  static size_t channelBytes(size_t capacity, bool timed);
+
+  /**
+   * @brief Give a measurement channel its storage, channelBytes() from slice, and forget its
+   * values
+   */
+  template <typename V>
+  void attachWindow(MeasurementType type, int ch, V &value, uint8_t *slice, size_t capacity,
+                    bool timed);
+
+  /**
+   * @brief Get filter mode of target measurement type, reload every mode from configuration
+   * and hand out the filter windows again if it changed
+   */
+  MeasurementFilterMode filterOf(MeasurementType type);
+
+  /**
+   * @brief Get filter window of target measurement type channel, only valid after filterOf()
+   *
+   * @return nullptr if measurement type is filtered by mean
+   */
+  FilterWindow *filterWindow(MeasurementType type, int ch);
+
+  /**
+   * @brief Rebuild sorted window and average of a measurement channel after its filter mode
+   * or its filter window changed
+   */
+  template <typename V>
+  void resetFilter(MeasurementType type, V &value, MeasurementFilterMode mode,
+                   FilterWindow *sorted);
+
+  /**
+   * @brief Average of the values kept, as given by the filter mode. List must not be empty
+   *
+   * @param sorted filter window of the channel, only used if filter mode is not mean
+   */
+  template <typename V>
+  float filteredAverage(V &value, MeasurementFilterMode mode, const FilterWindow *sorted);
+
+  /**
+   * @brief Get statistics of the values kept for a measurement channel moving average
+   */
+  template <typename V> Statistics windowStatistics(const V &value);
+
+  float correctTempHum(MeasurementType type, float rawValue, bool forceCorrection);
+  float correctPM25(float pm25, float humidity, float pm003Count, bool forceCorrection);
+  float computeCorrected(const Snapshot &snapshot, CorrectedValue value, int ch);
+  float correctedOf(const Snapshot &snapshot, CorrectedValue value, int ch);
+  void updateCorrections(Snapshot &snapshot, const Snapshot &previous);
+  void updateAirQuality(Snapshot &snapshot);
+
+  bool reportChanged(MeasurementType type, float reported, float value);
+  static bool hasField(uint64_t fields, MeasurementType type, int ch);
+  static bool hasAnyField(uint64_t fields, MeasurementType type);
+  void writeOutdoor(JsonWriter &json, const Snapshot &published, bool localServer,
+                    AgFirmwareMode fwMode, uint64_t fields);
+  void writeIndoor(JsonWriter &json, const Snapshot &published, bool localServer,
+                   uint64_t fields);
+  void writePMS(JsonWriter &json, const Snapshot &published, int ch, bool withTempHum,
+                bool compensate, uint64_t fields);
+  void writePMSAverage(JsonWriter &json, const Snapshot &published, bool withTempHum,
+                       bool compensate, uint64_t fields);
+  void writeStatistics(JsonWriter &json, const Snapshot &published);
+  bool hasPMSChannelData(const Measures &avg, int ch);
+  bool hasPMSChannelData(uint64_t fields, int ch);
 };
 
 #endif /** _AG_VALUE_H_ */
@@ -112,6 +112,22 @@ enum TempHumCorrectionAlgorithm {
   COR_ALGO_TEMP_HUM_SLR_CUSTOM
 };
 
+// Don't change the order of the enum
+enum MeasurementFilterMode {
+  MEASUREMENT_FILTER_UNKNOWN, // Unknown filter
+  MEASUREMENT_FILTER_MEAN,    // Moving average, default
+  MEASUREMENT_FILTER_MEDIAN,  // Rolling median
+  MEASUREMENT_FILTER_HAMPEL,  // Moving average of samples with outliers replaced by the median
+};
+
+// Don't change the order of the enum
+enum ReportingMode {
+  REPORTING_MODE_UNKNOWN,   // Unknown mode
+  REPORTING_MODE_INTERVAL,  // Full payload on every transmission, default
+  REPORTING_MODE_ON_CHANGE, // Full payload, only if a measurement changed beyond its deadband
+  REPORTING_MODE_DELTA,     // Only the measurements that changed, where the transport allows it
+};
+
 enum AgFirmwareMode {
   FW_MODE_I_9PSL,       /** ONE_INDOOR */
   FW_MODE_O_1PST,       /** PMS5003T, S8 and SGP41 */
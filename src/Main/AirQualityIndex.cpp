@@ -0,0 +1,340 @@
+#include "AirQualityIndex.h"
+#include <ctype.h>
+#include <string.h>
+
+namespace {
+
+enum Averaging {
+  AveragingNowCast,
+  AveragingHourly,
+  AveragingDaily,
+};
+
+// Concentrations from low to high map linearly to indexes from low to high, a band with the same
+// low and high index is a step
+struct Breakpoint {
+  float concentrationLow;
+  float concentrationHigh;
+  int16_t indexLow;
+  int16_t indexHigh;
+  uint8_t category;
+};
+
+struct Table {
+  const char *name;
+  const char *label;
+  Averaging averaging;
+  int scale; // Concentration is truncated to 1 / scale ug/m3 before the lookup
+  const Breakpoint *breakpoints;
+  uint8_t count;
+  const char *const *categories;
+};
+
+const Breakpoint US_EPA[] = {
+    {0.0f, 9.0f, 0, 50, 0},         {9.1f, 35.4f, 51, 100, 1},
+    {35.5f, 55.4f, 101, 150, 2},    {55.5f, 125.4f, 151, 200, 3},
+    {125.5f, 225.4f, 201, 300, 4},  {225.5f, 325.4f, 301, 500, 5},
+};
+const char *const US_EPA_CATEGORIES[] = {
+    "Good",      "Moderate",       "Unhealthy for Sensitive Groups",
+    "Unhealthy", "Very Unhealthy", "Hazardous",
+};
+
+// Very high is open ended, index stays 100 above 110 ug/m3
+const Breakpoint EU_CAQI[] = {
+    {0, 15, 0, 25, 0},   {15, 30, 25, 50, 1},    {30, 55, 50, 75, 2},
+    {55, 110, 75, 100, 3}, {110, 110, 100, 100, 4},
+};
+const char *const EU_CAQI_CATEGORIES[] = {
+    "Very low", "Low", "Medium", "High", "Very high",
+};
+
+const Breakpoint UK_DAQI[] = {
+    {0, 11, 1, 1, 0},  {12, 23, 2, 2, 0},  {24, 35, 3, 3, 0}, {36, 41, 4, 4, 1},
+    {42, 47, 5, 5, 1}, {48, 53, 6, 6, 1},  {54, 58, 7, 7, 2}, {59, 64, 8, 8, 2},
+    {65, 70, 9, 9, 2}, {71, 71, 10, 10, 3},
+};
+const char *const UK_DAQI_CATEGORIES[] = {
+    "Low", "Moderate", "High", "Very High",
+};
+
+// Severe is open ended, interpolated up to 380 ug/m3
+const Breakpoint INDIA_NAQI[] = {
+    {0, 30, 0, 50, 0},       {31, 60, 51, 100, 1},    {61, 90, 101, 200, 2},
+    {91, 120, 201, 300, 3},  {121, 250, 301, 400, 4}, {251, 380, 401, 500, 5},
+};
+const char *const INDIA_NAQI_CATEGORIES[] = {
+    "Good", "Satisfactory", "Moderate", "Poor", "Very Poor", "Severe",
+};
+
+const Breakpoint CHINA_AQI[] = {
+    {0, 35, 0, 50, 0},       {35, 75, 50, 100, 1},    {75, 115, 100, 150, 2},
+    {115, 150, 150, 200, 3}, {150, 250, 200, 300, 4}, {250, 350, 300, 400, 5},
+    {350, 500, 400, 500, 5},
+};
+const char *const CHINA_AQI_CATEGORIES[] = {
+    "Excellent",           "Good",
+    "Lightly Polluted",    "Moderately Polluted",
+    "Heavily Polluted",    "Severely Polluted",
+};
+
+#define AQI_TABLE(breakpoints) breakpoints, sizeof(breakpoints) / sizeof(breakpoints[0])
+
+// Indexed by Standard
+const Table TABLES[AirQualityIndex::_STANDARD_MAX] = {
+    {"US EPA", "AQI", AveragingNowCast, 10, AQI_TABLE(US_EPA), US_EPA_CATEGORIES},
+    {"EU CAQI", "CAQI", AveragingHourly, 1, AQI_TABLE(EU_CAQI), EU_CAQI_CATEGORIES},
+    {"UK DAQI", "DAQI", AveragingDaily, 1, AQI_TABLE(UK_DAQI), UK_DAQI_CATEGORIES},
+    {"India NAQI", "AQI", AveragingDaily, 1, AQI_TABLE(INDIA_NAQI), INDIA_NAQI_CATEGORIES},
+    {"China AQI", "AQI", AveragingDaily, 1, AQI_TABLE(CHINA_AQI), CHINA_AQI_CATEGORIES},
+};
+
+// Member states of the European Union, where the CAQI is used
+const char EU_COUNTRIES[] = "AT BE BG HR CY CZ DK EE FI FR DE GR HU IE IT LV LT LU MT NL PL PT "
+                            "RO SK SI ES SE";
+
+} // namespace
+
+AirQualityIndex::AirQualityIndex() { reset(); }
+
+void AirQualityIndex::reset(void) {
+  _started = false;
+  _hourSum = 0;
+  _hourSamples = 0;
+  memset(_hourly, 0, sizeof(_hourly));
+  _hourValid = 0;
+  _head = 0;
+  _dailySum = 0;
+  _dailyHours = 0;
+  _nowCast = 0;
+  _nowCastValid = false;
+  _currentValid = false;
+  _current = 0;
+  updateResult();
+}
+
+bool AirQualityIndex::hourValid(int age) const {
+  return _hourValid & (1UL << ((_head + AQI_HISTORY_HOURS - age) % AQI_HISTORY_HOURS));
+}
+
+float AirQualityIndex::hourMean(int age) const {
+  return _hourly[(_head + AQI_HISTORY_HOURS - age) % AQI_HISTORY_HOURS] / 10.0f;
+}
+
+void AirQualityIndex::closeHour(void) {
+  _head = (_head + 1) % AQI_HISTORY_HOURS;
+  uint32_t bit = 1UL << _head;
+
+  // Hour leaving the 24 hours
+  if (_hourValid & bit) {
+    _dailySum -= _hourly[_head];
+    _dailyHours--;
+  }
+
+  if (_hourSamples > 0) {
+    float mean = _hourSum / _hourSamples;
+    uint32_t tenths = mean > 0 ? (uint32_t)(mean * 10.0f + 0.5f) : 0;
+    _hourly[_head] = tenths > UINT16_MAX ? UINT16_MAX : tenths;
+    _hourValid |= bit;
+    _dailySum += _hourly[_head];
+    _dailyHours++;
+  } else {
+    _hourly[_head] = 0;
+    _hourValid &= ~bit;
+  }
+  _hourSum = 0;
+  _hourSamples = 0;
+
+  updateNowCast();
+}
+
+/**
+ * @brief NowCast of the last 12 hours, as specified by the EPA for PM
+ *
+ * Hours are weighted by w^age, where w is the ratio of the lowest to the highest hourly mean,
+ * not less than 0.5. Needs 2 of the 3 last hours
+ */
+void AirQualityIndex::updateNowCast(void) {
+  _nowCastValid = false;
+  if (hourValid(0) + hourValid(1) + hourValid(2) < 2) {
+    return;
+  }
+
+  float low = 0;
+  float high = 0;
+  bool first = true;
+  for (int age = 0; age < AQI_NOWCAST_HOURS; age++) {
+    if (!hourValid(age)) {
+      continue;
+    }
+    float mean = hourMean(age);
+    if (first || mean < low) {
+      low = mean;
+    }
+    if (first || mean > high) {
+      high = mean;
+    }
+    first = false;
+  }
+
+  float weight = high > 0 ? low / high : 1;
+  if (weight < AQI_NOWCAST_MIN_WEIGHT) {
+    weight = AQI_NOWCAST_MIN_WEIGHT;
+  }
+
+  float sum = 0;
+  float weights = 0;
+  float factor = 1;
+  for (int age = 0; age < AQI_NOWCAST_HOURS; age++) {
+    if (hourValid(age)) {
+      sum += factor * hourMean(age);
+      weights += factor;
+    }
+    factor *= weight;
+  }
+  _nowCast = sum / weights;
+  _nowCastValid = true;
+}
+
+void AirQualityIndex::updateResult(void) {
+  bool averaged = false;
+  float concentration = _current;
+  switch (TABLES[_standard].averaging) {
+  case AveragingNowCast:
+    if (_nowCastValid) {
+      averaged = true;
+      concentration = _nowCast;
+    }
+    break;
+  case AveragingHourly:
+    if (hourValid(0)) {
+      averaged = true;
+      concentration = hourMean(0);
+    }
+    break;
+  default:
+    if (_dailyHours >= AQI_DAILY_MIN_HOURS) {
+      averaged = true;
+      concentration = _dailySum / 10.0f / _dailyHours;
+    }
+    break;
+  }
+
+  _result.standard = _standard;
+  _result.averaged = averaged;
+  if (!averaged && !_currentValid) {
+    _result.index = -1;
+    _result.category = 0;
+    _result.concentration = 0;
+    return;
+  }
+  _result.concentration = concentration;
+  _result.index = indexOf(_standard, concentration, &_result.category);
+}
+
+void AirQualityIndex::add(float concentration, bool valid, uint32_t now) {
+  if (!_started) {
+    _started = true;
+    _hourStart = now;
+  }
+
+  uint32_t elapsed = now - _hourStart;
+  if (elapsed >= (AQI_HISTORY_HOURS + 1) * AQI_HOUR_MS) {
+    // Whole history is older than the averaging periods
+    reset();
+    _started = true;
+    _hourStart = now;
+  } else {
+    while (elapsed >= AQI_HOUR_MS) {
+      closeHour();
+      _hourStart += AQI_HOUR_MS;
+      elapsed -= AQI_HOUR_MS;
+    }
+  }
+
+  _currentValid = valid;
+  if (valid) {
+    _current = concentration;
+    _hourSum += concentration;
+    _hourSamples++;
+  }
+  updateResult();
+}
+
+void AirQualityIndex::setStandard(Standard standard) {
+  if (standard == _standard || standard < 0 || standard >= _STANDARD_MAX) {
+    return;
+  }
+  _standard = standard;
+  updateResult();
+}
+
+int AirQualityIndex::indexOf(Standard standard, float concentration, uint8_t *category) {
+  const Table &table = TABLES[standard];
+  if (!(concentration > 0)) {
+    concentration = 0;
+  }
+  // Above the table first, so the truncation below never converts out of the long range
+  const Breakpoint &last = table.breakpoints[table.count - 1];
+  if (concentration > last.concentrationHigh) {
+    if (category) {
+      *category = last.category;
+    }
+    return last.indexHigh;
+  }
+  // Truncated like the standard reports concentrations
+  concentration = (float)(long)(concentration * table.scale) / table.scale;
+
+  const Breakpoint *band = &last;
+  for (int i = 0; i < table.count; i++) {
+    if (concentration <= table.breakpoints[i].concentrationHigh) {
+      band = &table.breakpoints[i];
+      break;
+    }
+  }
+  if (category) {
+    *category = band->category;
+  }
+
+  // Truncated concentration can be in the gap below a band
+  if (band->indexLow == band->indexHigh || concentration <= band->concentrationLow) {
+    return band->indexLow;
+  }
+  float index = (band->indexHigh - band->indexLow) * (concentration - band->concentrationLow) /
+                    (band->concentrationHigh - band->concentrationLow) +
+                band->indexLow;
+  return (int)(index + 0.5f);
+}
+
+AirQualityIndex::Standard AirQualityIndex::standardOf(const char *country) {
+  if (country == nullptr || strlen(country) != 2) {
+    return StandardUsEpa;
+  }
+  char code[3] = {(char)toupper(country[0]), (char)toupper(country[1]), 0};
+  if (strcmp(code, "GB") == 0 || strcmp(code, "UK") == 0) {
+    return StandardUkDaqi;
+  }
+  if (strcmp(code, "IN") == 0) {
+    return StandardIndiaNaqi;
+  }
+  if (strcmp(code, "CN") == 0) {
+    return StandardChinaAqi;
+  }
+  for (const char *eu = EU_COUNTRIES; *eu; eu += 3) {
+    if (eu[0] == code[0] && eu[1] == code[1]) {
+      return StandardEuCaqi;
+    }
+    if (eu[2] == 0) {
+      break;
+    }
+  }
+  return StandardUsEpa;
+}
+
+const char *AirQualityIndex::label(Standard standard) { return TABLES[standard].label; }
+
+const char *AirQualityIndex::name(Standard standard) { return TABLES[standard].name; }
+
+const char *AirQualityIndex::categoryName(Standard standard, uint8_t category) {
+  return TABLES[standard].categories[category];
+}
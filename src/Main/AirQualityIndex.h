@@ -0,0 +1,119 @@
+#ifndef _AG_AIR_QUALITY_INDEX_H_
+#define _AG_AIR_QUALITY_INDEX_H_
+
+#include <stdint.h>
+
+/** Length of the hourly history, longest averaging period of the standards */
+#define AQI_HISTORY_HOURS 24
+/** Number of hours of the NowCast */
+#define AQI_NOWCAST_HOURS 12
+/** NowCast weight factor lower bound for PM */
+#define AQI_NOWCAST_MIN_WEIGHT 0.5f
+/** Hours with a value needed for a 24 hour mean, 75% data capture */
+#define AQI_DAILY_MIN_HOURS 18
+#define AQI_HOUR_MS 3600000UL
+
+/**
+ * @brief PM2.5 air quality index of the US EPA, EU CAQI, UK DAQI, India NAQI and China AQI
+ *
+ * Fed with PM2.5 concentration samples, it keeps the mean of each of the last 24 hours. Every
+ * hour it updates the EPA NowCast of the last 12 hours and the 24 hour running mean, so the
+ * index of each sample is only a lookup in the breakpoint table of the standard, over the
+ * averaging period of the standard: NowCast for US EPA, last hour for EU CAQI and 24 hour mean for
+ * the others. Until there is enough history for it, index is of the current sample.
+ *
+ * Hours are counted from the first sample on the caller clock, so no wall time is needed.
+ *
+ * Plain C++ without Arduino dependency, so it can be tested on host with recorded traces.
+ */
+class AirQualityIndex {
+public:
+  enum Standard {
+    StandardUsEpa,     // US EPA AQI 2024, 0 to 500 on NowCast
+    StandardEuCaqi,    // EU Common Air Quality Index, 0 to 100 on the hourly mean
+    StandardUkDaqi,    // UK Daily Air Quality Index, 1 to 10 on the 24 hour mean
+    StandardIndiaNaqi, // India National AQI, 0 to 500 on the 24 hour mean
+    StandardChinaAqi,  // China AQI (HJ 633-2012), 0 to 500 on the 24 hour mean
+    _STANDARD_MAX
+  };
+
+  // Index of the last sample, small enough to be copied on every measurements snapshot
+  struct Result {
+    Standard standard;
+    int16_t index;       // -1 if there is no valid concentration
+    uint8_t category;    // 0 is the best category of the standard, see categoryName()
+    bool averaged;       // Concentration is of the averaging period of the standard
+    float concentration; // PM2.5 in ug/m3 the index is of
+  };
+
+private:
+  Standard _standard = StandardUsEpa;
+  bool _started = false;
+  uint32_t _hourStart = 0; // Caller time the current hour started
+  float _hourSum = 0;      // Sum of the valid samples of the current hour
+  uint32_t _hourSamples = 0;
+
+  // Hourly means in 0.1 ug/m3, _hourly[_head] is the last complete hour. Integer so the running
+  // sum is exact however long it runs
+  uint16_t _hourly[AQI_HISTORY_HOURS];
+  uint32_t _hourValid = 0; // Bit set if the hour of the same index has a mean
+  uint8_t _head = 0;
+  uint32_t _dailySum = 0; // Sum of the valid hourly means
+  uint8_t _dailyHours = 0;
+
+  float _nowCast = 0;
+  bool _nowCastValid = false;
+
+  bool _currentValid = false;
+  float _current = 0;
+  Result _result;
+
+  bool hourValid(int age) const;
+  float hourMean(int age) const;
+  void closeHour(void);
+  void updateNowCast(void);
+  void updateResult(void);
+
+public:
+  AirQualityIndex();
+  ~AirQualityIndex() {}
+
+  void reset(void);
+
+  /**
+   * @brief Add one PM2.5 sample
+   *
+   * @param concentration PM2.5 in ug/m3, ignored if not valid
+   * @param now caller clock in milliseconds, wrapping around is handled
+   */
+  void add(float concentration, bool valid, uint32_t now);
+
+  /** Set standard of the result, keeping the history */
+  void setStandard(Standard standard);
+  Standard standard(void) const { return _standard; }
+
+  /** Index of the last sample */
+  const Result &result(void) const { return _result; }
+
+  /**
+   * @brief Index of a PM2.5 concentration from the breakpoint table of a standard, without
+   * averaging. Concentration is truncated to the resolution of the standard
+   *
+   * @param category set to the category of the index if not nullptr
+   */
+  static int indexOf(Standard standard, float concentration, uint8_t *category = nullptr);
+
+  /**
+   * @brief Standard used in a country
+   *
+   * @param country ALPHA-2 country code. US EPA if the country has none of the others
+   */
+  static Standard standardOf(const char *country);
+
+  /** Short name shown next to the index, ex: AQI, CAQI */
+  static const char *label(Standard standard);
+  static const char *name(Standard standard);
+  static const char *categoryName(Standard standard, uint8_t category);
+};
+
+#endif /** _AG_AIR_QUALITY_INDEX_H_ */
@@ -0,0 +1,92 @@
+#ifndef _AG_FIXED_POINT_H_
+#define _AG_FIXED_POINT_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Run the correction kernels (PM2.5 compensation, SLR corrections, PMS5003T temperature and
+ * humidity compensation, PM2.5 to AQI) in fixed point instead of float. For targets without FPU
+ * such as the ESP32-C3, where every float operation is a library call. Results stay within
+ * 0.1 of the float kernels. Build with -DAG_FIXED_POINT_CORRECTION=1 to enable
+ */
+#ifndef AG_FIXED_POINT_CORRECTION
+#define AG_FIXED_POINT_CORRECTION 0
+#endif
+
+/** Value with 16 fraction bits, in 64 bit so the product of two values is not truncated */
+typedef int64_t q16_t;
+
+/** Q16 value of a constant, evaluated at compile time */
+#define Q16(x) ((q16_t)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+/** Constant factor with 32 fraction bits, for q16MulQ32 */
+#define Q32(x) ((int64_t)((x) * 4294967296.0 + ((x) < 0 ? -0.5 : 0.5)))
+
+/**
+ * @brief Convert float to fixed point with the given fraction bits, truncated toward zero
+ *
+ * Decoded from the float bits, so no float operation is involved. Magnitude must stay under
+ * 2^(62 - fraction)
+ */
+inline int64_t fixedFromFloat(float value, int fraction) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int biased = (bits >> 23) & 0xff;
+  if (biased == 0) {
+    // Zero or subnormal, too small for any fraction used here
+    return 0;
+  }
+
+  int64_t mantissa = (bits & 0x7fffff) | 0x800000;
+  int shift = biased - 127 - 23 + fraction;
+  int64_t result;
+  if (shift > 38) {
+    // Saturate, also for infinity and NaN
+    result = INT64_MAX;
+  } else if (shift >= 0) {
+    result = mantissa << shift;
+  } else if (shift > -32) {
+    result = mantissa >> -shift;
+  } else {
+    result = 0;
+  }
+  return (bits & 0x80000000) ? -result : result;
+}
+
+inline q16_t q16FromFloat(float value) { return fixedFromFloat(value, 16); }
+
+/**
+ * @brief Convert Q16 value to float, truncated to the float precision without float operation
+ */
+inline float q16ToFloat(q16_t value) {
+  if (value == 0) {
+    return 0;
+  }
+
+  uint32_t sign = 0;
+  uint64_t magnitude = (uint64_t)value;
+  if (value < 0) {
+    sign = 0x80000000;
+    magnitude = (uint64_t)(-value);
+  }
+
+  // Place the most significant bit as the implicit float bit
+  int top = 63 - __builtin_clzll(magnitude);
+  uint32_t mantissa =
+      top > 23 ? (uint32_t)(magnitude >> (top - 23)) : (uint32_t)(magnitude << (23 - top));
+  uint32_t bits = sign | ((uint32_t)(top - 16 + 127) << 23) | (mantissa & 0x7fffff);
+
+  float result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+/** Product of two Q16 values, rounded. Product of the magnitudes must stay under 2^63 */
+inline q16_t q16Mul(q16_t a, q16_t b) { return (a * b + (1 << 15)) >> 16; }
+
+/** Product of a Q16 value and a Q32 factor, rounded. Product must stay under 2^63 */
+inline q16_t q16MulQ32(q16_t value, int64_t factor) {
+  return (value * factor + ((int64_t)1 << 31)) >> 32;
+}
+
+#endif /** _AG_FIXED_POINT_H_ */
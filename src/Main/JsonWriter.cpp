@@ -0,0 +1,183 @@
+#include "JsonWriter.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+JsonWriter::JsonWriter(Print &out) : _out(out) {}
+
+JsonWriter::~JsonWriter() {}
+
+void JsonWriter::write(const char *str, size_t len) {
+  _length += _out.write((const uint8_t *)str, len);
+}
+
+/**
+ * @brief Write quoted string, escaped the same way as cJSON
+ */
+void JsonWriter::writeString(const char *str) {
+  write("\"", 1);
+  const char *start = str;
+  for (; *str; str++) {
+    unsigned char c = (unsigned char)*str;
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    // Flush the unescaped part before escape sequence
+    write(start, str - start);
+    start = str + 1;
+
+    char escaped[7];
+    switch (c) {
+    case '"':
+      write("\\\"", 2);
+      break;
+    case '\\':
+      write("\\\\", 2);
+      break;
+    case '\b':
+      write("\\b", 2);
+      break;
+    case '\f':
+      write("\\f", 2);
+      break;
+    case '\n':
+      write("\\n", 2);
+      break;
+    case '\r':
+      write("\\r", 2);
+      break;
+    case '\t':
+      write("\\t", 2);
+      break;
+    default:
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      write(escaped, 6);
+      break;
+    }
+  }
+  write(start, str - start);
+  write("\"", 1);
+}
+
+void JsonWriter::writeKey(const char *key) {
+  uint32_t bit = 1UL << _depth;
+  if (_hasMember & bit) {
+    write(",", 1);
+  }
+  _hasMember |= bit;
+
+  if (key) {
+    writeString(key);
+    write(":", 1);
+  }
+}
+
+/**
+ * @brief Begin root object
+ */
+void JsonWriter::beginObject(void) { beginObject(NULL); }
+
+/**
+ * @brief Begin object as member of current object
+ *
+ * @param key member name, NULL for root object
+ */
+void JsonWriter::beginObject(const char *key) {
+  if (_depth > 0) {
+    writeKey(key);
+  }
+  write("{", 1);
+
+  if (_depth < JSON_WRITER_MAX_DEPTH) {
+    _depth++;
+  }
+  _hasMember &= ~(1UL << _depth);
+}
+
+void JsonWriter::endObject(void) {
+  write("}", 1);
+  if (_depth > 0) {
+    _depth--;
+  }
+}
+
+/**
+ * @brief Add number member, formatted like cJSON: 15 significant digits unless the value can't
+ * be recovered from it
+ */
+void JsonWriter::add(const char *key, double value) {
+  writeKey(key);
+
+  if (isnan(value) || isinf(value)) {
+    write("null", 4);
+    return;
+  }
+
+  char buf[26];
+  int len = snprintf(buf, sizeof(buf), "%1.15g", value);
+  if (strtod(buf, NULL) != value) {
+    len = snprintf(buf, sizeof(buf), "%1.17g", value);
+  }
+  write(buf, len);
+}
+
+void JsonWriter::add(const char *key, int value) { add(key, (long)value); }
+
+void JsonWriter::add(const char *key, unsigned int value) { add(key, (unsigned long)value); }
+
+void JsonWriter::add(const char *key, long value) {
+  writeKey(key);
+  char buf[24];
+  int len = snprintf(buf, sizeof(buf), "%ld", value);
+  write(buf, len);
+}
+
+void JsonWriter::add(const char *key, unsigned long value) {
+  writeKey(key);
+  char buf[24];
+  int len = snprintf(buf, sizeof(buf), "%lu", value);
+  write(buf, len);
+}
+
+void JsonWriter::add(const char *key, bool value) {
+  writeKey(key);
+  if (value) {
+    write("true", 4);
+  } else {
+    write("false", 5);
+  }
+}
+
+void JsonWriter::add(const char *key, const char *value) {
+  writeKey(key);
+  writeString(value ? value : "");
+}
+
+void JsonWriter::add(const char *key, const String &value) { add(key, value.c_str()); }
+
+BufferPrint::BufferPrint(char *buf, size_t size) : _buf(buf), _size(size) {
+  if (_size > 0) {
+    _buf[0] = '\0';
+  }
+}
+
+BufferPrint::~BufferPrint() {}
+
+size_t BufferPrint::write(uint8_t c) { return write(&c, 1); }
+
+size_t BufferPrint::write(const uint8_t *buffer, size_t size) {
+  // Keep one byte for NUL terminator
+  size_t available = _size > _length ? _size - _length - 1 : 0;
+  if (size > available) {
+    _overflow = true;
+    size = available;
+  }
+
+  memcpy(_buf + _length, buffer, size);
+  _length += size;
+  if (_size > 0) {
+    _buf[_length] = '\0';
+  }
+  return size;
+}
@@ -0,0 +1,91 @@
+#ifndef _AG_JSON_WRITER_H_
+#define _AG_JSON_WRITER_H_
+
+#include <Arduino.h>
+
+/** Maximum nesting level of objects */
+#define JSON_WRITER_MAX_DEPTH 8
+
+/**
+ * @brief Streaming JSON writer
+ *
+ * Write compact JSON directly to a Print sink while it is built, without building a tree in
+ * memory. Output format is the same as JSON.stringify of Arduino_JSON (cJSON unformatted).
+ * Caller is responsible to call begin/end in matching order.
+ */
+class JsonWriter {
+private:
+  Print &_out;
+  size_t _length = 0;
+  uint8_t _depth = 0;
+  uint32_t _hasMember = 0; // Bit set if object at depth already has a member
+
+  void write(const char *str, size_t len);
+  void writeString(const char *str);
+  void writeKey(const char *key);
+
+public:
+  JsonWriter(Print &out);
+  ~JsonWriter();
+
+  void beginObject(void);
+  void beginObject(const char *key);
+  void endObject(void);
+
+  void add(const char *key, double value);
+  void add(const char *key, int value);
+  void add(const char *key, unsigned int value);
+  void add(const char *key, long value);
+  void add(const char *key, unsigned long value);
+  void add(const char *key, bool value);
+  void add(const char *key, const char *value);
+  void add(const char *key, const String &value);
+
+  /** Number of bytes written */
+  size_t length(void) const { return _length; }
+};
+
+/**
+ * @brief Print sink to a caller supplied fixed buffer, output is always NUL terminated
+ */
+class BufferPrint : public Print {
+private:
+  char *_buf;
+  size_t _size;
+  size_t _length = 0;
+  bool _overflow = false;
+
+public:
+  BufferPrint(char *buf, size_t size);
+  ~BufferPrint();
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+
+  /** Number of bytes stored, excluding NUL terminator */
+  size_t length(void) const { return _length; }
+  /** True if output was truncated because buffer is too small */
+  bool overflow(void) const { return _overflow; }
+};
+
+/**
+ * @brief Print sink appending to a String
+ */
+class StringPrint : public Print {
+private:
+  String &_str;
+
+public:
+  StringPrint(String &str) : _str(str) {}
+  ~StringPrint() {}
+
+  size_t write(uint8_t c) override {
+    _str += (char)c;
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    return _str.concat((const char *)buffer, size) ? size : 0;
+  }
+};
+
+#endif /** _AG_JSON_WRITER_H_ */
@@ -0,0 +1,34 @@
+#include "PMSFusion.h"
+
+PMSFusionHealth::Health PMSFusionHealth::healthOf(Health current, int score) {
+  if (score >= PMS_FUSION_FAULTY_SCORE) {
+    return HealthFaulty;
+  }
+  // Faulty channel must get back under suspect score to recover, so it doesn't flap
+  if (score >= PMS_FUSION_SUSPECT_SCORE) {
+    return current == HealthFaulty ? HealthFaulty : HealthSuspect;
+  }
+  return HealthOk;
+}
+
+float PMSFusionHealth::weightOf(Health health) {
+  switch (health) {
+  case HealthOk:
+    return 1;
+  case HealthSuspect:
+    return PMS_FUSION_SUSPECT_WEIGHT;
+  default:
+    return 0;
+  }
+}
+
+const char *PMSFusionHealth::healthName(Health health) {
+  switch (health) {
+  case HealthOk:
+    return "ok";
+  case HealthSuspect:
+    return "suspect";
+  default:
+    return "faulty";
+  }
+}
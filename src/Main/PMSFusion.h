@@ -0,0 +1,289 @@
+#ifndef _AG_PMS_FUSION_H_
+#define _AG_PMS_FUSION_H_
+
+#include <math.h>
+#include <stdint.h>
+
+/** Channels agree if they differ less than absolute + relative tolerance, in ug/m3 */
+#define PMS_FUSION_ABS_TOLERANCE 5.0f
+#define PMS_FUSION_REL_TOLERANCE 0.2f
+/** Number of samples of the running divergence */
+#define PMS_FUSION_DIVERGENCE_WINDOW 16
+/** Number of samples of the channel ratio, short term and learned while channels agree */
+#define PMS_FUSION_RATIO_WINDOW 8
+#define PMS_FUSION_BASELINE_WINDOW 256
+/** Ratio is only learned under this divergence, so a slow drift is not learned as normal */
+#define PMS_FUSION_BASELINE_MAX_DIVERGENCE 0.5f
+/** Number of samples of the relative sample to sample variation of each channel */
+#define PMS_FUSION_JITTER_WINDOW 16
+/** Channel is noisy if it varies this times more than the other one, plus the floor */
+#define PMS_FUSION_JITTER_RATIO 3.0f
+#define PMS_FUSION_JITTER_FLOOR 0.1f
+/** Channel is stuck after this number of identical samples */
+#define PMS_FUSION_STUCK_SAMPLES 30
+/** Fault score thresholds, a blamed sample add 2 and a sample in agreement remove 1 */
+#define PMS_FUSION_SUSPECT_SCORE 10
+#define PMS_FUSION_FAULTY_SCORE 30
+#define PMS_FUSION_MAX_SCORE 60
+/** Weight of a suspect channel on fused values, faulty channel is excluded */
+#define PMS_FUSION_SUSPECT_WEIGHT 0.25f
+
+/** Channel health, shared by every channel count */
+class PMSFusionHealth {
+public:
+  enum Health {
+    HealthOk,
+    HealthSuspect, // Contributes with PMS_FUSION_SUSPECT_WEIGHT
+    HealthFaulty,  // Excluded from fused values while another channel is valid
+  };
+
+  static const char *healthName(Health health);
+
+protected:
+  static Health healthOf(Health current, int score);
+  static float weightOf(Health health);
+};
+
+/**
+ * @brief Fusion and fault arbitration of N PMS channels, such as the two PMS5003T of the Open
+ * Air monitor
+ *
+ * Fed with one PM2.5 sample of each channel per read cycle, it tracks the running divergence
+ * of every pair of channels. When a pair disagree, the channel at fault is blamed from its own
+ * behavior: stuck on the same value, much noisier than the other one, or else reading low
+ * against the ratio learned while they agreed, as a degrading laser under-counts particles.
+ * Blamed channel becomes suspect then faulty, and recovers once channels agree again. A channel
+ * reading high can't be told from the other one reading low, so a blame from the ratio alone
+ * halves the confidence. With more than two channels a faulty one is blamed by every pair it is
+ * part of, while the healthy ones agree with each other.
+ *
+ * Plain C++ without Arduino dependency, so it can be tested on host with recorded traces.
+ *
+ * @tparam N number of channels
+ */
+template <int N> class PMSFusion : public PMSFusionHealth {
+public:
+  // Fusion result, small enough to be copied on every measurements snapshot
+  struct Status {
+    Health health[N];
+    float weight[N];  // Weight of each channel on fused values
+    float confidence; // 0 no confidence to 1 every channel healthy and in agreement
+    float divergence; // Highest running divergence, more than 1 means channels disagree
+
+    /**
+     * @brief Weighted value of the valid channels of a measurement, mean of the valid channels
+     * if none has weight. Result is only meaningful if at least one channel is valid
+     */
+    float combine(const float values[N], const bool valid[N]) const;
+  };
+
+private:
+  static const int PAIRS = N > 1 ? N * (N - 1) / 2 : 1;
+
+  struct Channel {
+    float last;     // Last valid sample
+    bool hasLast;   // last is set
+    float jitter;   // Running relative sample to sample variation
+    uint16_t stuck; // Number of consecutive identical samples
+    int16_t score;  // Fault score, see PMS_FUSION_*_SCORE
+  };
+
+  // Two channels i < j, in order (0, 1), (0, 2) .. (1, 2) ..
+  struct Pair {
+    float divergence; // Running divergence
+    float ratio;      // Short term ratio of channel i to channel j
+    float baseline;   // Ratio learned while channels agree
+  };
+
+  Channel _channels[N];
+  Pair _pairs[PAIRS];
+  Status _status;
+
+  void track(Channel &channel, float value);
+  void blame(int index, int other);
+
+public:
+  PMSFusion() { reset(); }
+  ~PMSFusion() {}
+
+  void reset(void);
+
+  /**
+   * @brief Add one PM2.5 sample of each channel
+   *
+   * @param values sample of each channel, ignored if not valid
+   */
+  void update(const float values[N], const bool valid[N]);
+
+  const Status &status(void) const { return _status; }
+};
+
+template <int N>
+float PMSFusion<N>::Status::combine(const float values[N], const bool valid[N]) const {
+  float total = 0;
+  float sum = 0;
+  float mean = 0;
+  int count = 0;
+  int last = N - 1;
+  for (int i = 0; i < N; i++) {
+    if (valid[i]) {
+      total += weight[i];
+      sum += weight[i] * values[i];
+      mean += values[i];
+      count++;
+      last = i;
+    }
+  }
+  if (count <= 1) {
+    return values[last];
+  }
+  if (total <= 0) {
+    // Every valid channel faulty, no way to tell which one is right
+    return mean / count;
+  }
+  return sum / total;
+}
+
+template <int N> void PMSFusion<N>::reset(void) {
+  for (int i = 0; i < N; i++) {
+    _channels[i].last = 0;
+    _channels[i].hasLast = false;
+    _channels[i].jitter = 0;
+    _channels[i].stuck = 0;
+    _channels[i].score = 0;
+    _status.health[i] = HealthOk;
+    _status.weight[i] = 1;
+  }
+  for (int p = 0; p < PAIRS; p++) {
+    _pairs[p].divergence = 0;
+    _pairs[p].ratio = 1;
+    _pairs[p].baseline = 1;
+  }
+  _status.confidence = 0;
+  _status.divergence = 0;
+}
+
+template <int N> void PMSFusion<N>::track(Channel &channel, float value) {
+  if (channel.hasLast) {
+    // Relative to the channel level, so a channel reading low is not seen as the quiet one
+    float jitter = fabsf(value - channel.last) / (PMS_FUSION_ABS_TOLERANCE + value);
+    channel.jitter += (jitter - channel.jitter) / PMS_FUSION_JITTER_WINDOW;
+    if (value == channel.last) {
+      if (channel.stuck < UINT16_MAX) {
+        channel.stuck++;
+      }
+    } else {
+      channel.stuck = 0;
+    }
+  }
+  channel.last = value;
+  channel.hasLast = true;
+}
+
+template <int N> void PMSFusion<N>::blame(int index, int other) {
+  Channel &blamed = _channels[index];
+  blamed.score += 2;
+  if (blamed.score > PMS_FUSION_MAX_SCORE) {
+    blamed.score = PMS_FUSION_MAX_SCORE;
+  }
+  if (_channels[other].score > 0) {
+    _channels[other].score--;
+  }
+}
+
+template <int N> void PMSFusion<N>::update(const float values[N], const bool valid[N]) {
+  for (int i = 0; i < N; i++) {
+    if (valid[i]) {
+      track(_channels[i], values[i]);
+    }
+  }
+
+  bool ratioOnly = false;
+  int p = 0;
+  for (int i = 0; i < N; i++) {
+    for (int j = i + 1; j < N; j++, p++) {
+      if (!valid[i] || !valid[j]) {
+        continue;
+      }
+      Pair &pair = _pairs[p];
+      float mean = (values[i] + values[j]) / 2.0f;
+      float divergence = fabsf(values[i] - values[j]) /
+                         (PMS_FUSION_ABS_TOLERANCE + PMS_FUSION_REL_TOLERANCE * mean);
+      pair.divergence += (divergence - pair.divergence) / PMS_FUSION_DIVERGENCE_WINDOW;
+
+      // Offset by the tolerance so the ratio is not dominated by noise at low concentration
+      float ratio =
+          (values[i] + PMS_FUSION_ABS_TOLERANCE) / (values[j] + PMS_FUSION_ABS_TOLERANCE);
+      pair.ratio += (ratio - pair.ratio) / PMS_FUSION_RATIO_WINDOW;
+
+      if (pair.divergence <= 1) {
+        if (pair.divergence <= PMS_FUSION_BASELINE_MAX_DIVERGENCE) {
+          pair.baseline += (pair.ratio - pair.baseline) / PMS_FUSION_BASELINE_WINDOW;
+        }
+        if (_channels[i].score > 0) {
+          _channels[i].score--;
+        }
+        if (_channels[j].score > 0) {
+          _channels[j].score--;
+        }
+        continue;
+      }
+
+      const Channel &chi = _channels[i];
+      const Channel &chj = _channels[j];
+      bool stucki = chi.stuck >= PMS_FUSION_STUCK_SAMPLES;
+      bool stuckj = chj.stuck >= PMS_FUSION_STUCK_SAMPLES;
+      if (stucki != stuckj) {
+        stucki ? blame(i, j) : blame(j, i);
+      } else if (chi.jitter > PMS_FUSION_JITTER_RATIO * chj.jitter + PMS_FUSION_JITTER_FLOOR) {
+        blame(i, j);
+      } else if (chj.jitter > PMS_FUSION_JITTER_RATIO * chi.jitter + PMS_FUSION_JITTER_FLOOR) {
+        blame(j, i);
+      } else {
+        // Channel reading lower than it used to against the other one
+        pair.ratio < pair.baseline ? blame(i, j) : blame(j, i);
+        ratioOnly = true;
+      }
+    }
+  }
+
+  for (int i = 0; i < N; i++) {
+    _status.health[i] = healthOf(_status.health[i], _channels[i].score);
+    _status.weight[i] = weightOf(_status.health[i]);
+  }
+
+  // Each channel gives its share of the confidence, a disagreement of contributing channels
+  // lower it further. Blame from the ratio alone is a guess, as a channel reading high can't be
+  // told from the other one reading low
+  float weights = 0;
+  for (int i = 0; i < N; i++) {
+    if (valid[i]) {
+      weights += _status.weight[i];
+    }
+  }
+  _status.confidence = weights / N;
+
+  float divergence = 0;
+  float contributing = 0;
+  p = 0;
+  for (int i = 0; i < N; i++) {
+    for (int j = i + 1; j < N; j++, p++) {
+      if (_pairs[p].divergence > divergence) {
+        divergence = _pairs[p].divergence;
+      }
+      if (valid[i] && valid[j] && _status.weight[i] > 0 && _status.weight[j] > 0 &&
+          _pairs[p].divergence > contributing) {
+        contributing = _pairs[p].divergence;
+      }
+    }
+  }
+  _status.divergence = divergence;
+  if (contributing > 1) {
+    _status.confidence /= contributing;
+  }
+  if (ratioOnly) {
+    _status.confidence /= 2.0f;
+  }
+}
+
+#endif /** _AG_PMS_FUSION_H_ */
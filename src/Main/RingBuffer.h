@@ -0,0 +1,165 @@
+#ifndef _AG_RING_BUFFER_H_
+#define _AG_RING_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fixed capacity FIFO ring buffer backed by a static array
+ *
+ * Storage is part of the object, so no heap allocation is ever done. Push and pop are O(1),
+ * elements are indexed from the oldest (0) to the newest (size() - 1).
+ *
+ * @tparam T element type
+ * @tparam N maximum number of elements that can be stored
+ */
+template <typename T, size_t N> class RingBuffer {
+private:
+  T _values[N];
+  size_t _head = 0;  // Index of the oldest element
+  size_t _count = 0; // Number of elements currently stored
+
+public:
+  /**
+   * @brief Append value as the newest element. When the buffer is full the oldest element is
+   * overwritten
+   *
+   * @param value value to append
+   */
+  void push(const T &value) {
+    _values[(_head + _count) % N] = value;
+    if (_count < N) {
+      _count++;
+    } else {
+      _head = (_head + 1) % N;
+    }
+  }
+
+  /**
+   * @brief Remove the oldest element, does nothing if empty
+   */
+  void pop() {
+    if (_count == 0) {
+      return;
+    }
+    _head = (_head + 1) % N;
+    _count--;
+  }
+
+  /**
+   * @brief Remove the newest element, does nothing if empty
+   */
+  void popBack() {
+    if (_count == 0) {
+      return;
+    }
+    _count--;
+  }
+
+  /** Oldest element, only valid if not empty */
+  const T &front() const { return _values[_head]; }
+
+  /** Newest element, only valid if not empty */
+  const T &back() const { return _values[(_head + _count - 1) % N]; }
+
+  /** Element at index, 0 is the oldest element */
+  const T &operator[](size_t index) const { return _values[(_head + index) % N]; }
+
+  void clear() {
+    _head = 0;
+    _count = 0;
+  }
+
+  size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  bool full() const { return _count == N; }
+  static constexpr size_t capacity() { return N; }
+};
+
+/**
+ * @brief FIFO ring buffer with a capacity set at run time, on storage given by the owner
+ *
+ * Same interface as RingBuffer<T, N>, for windows sized from configuration out of a pool shared by
+ * several buffers. Holds nothing until attach(), then push and pop are O(1) without division.
+ *
+ * @tparam T element type
+ */
+template <typename T> class RingBuffer<T, 0> {
+private:
+  T *_values = nullptr;
+  uint16_t _capacity = 0;
+  uint16_t _head = 0;  // Index of the oldest element
+  uint16_t _count = 0; // Number of elements currently stored
+
+  size_t wrap(size_t index) const { return index >= _capacity ? index - _capacity : index; }
+
+public:
+  /**
+   * @brief Use storage for the elements and forget every element
+   *
+   * @param storage array of at least capacity elements, owned by the caller
+   * @param capacity maximum number of elements that can be stored, at most UINT16_MAX
+   */
+  void attach(T *storage, size_t capacity) {
+    _values = storage;
+    _capacity = capacity;
+    clear();
+  }
+
+  /**
+   * @brief Append value as the newest element. When the buffer is full the oldest element is
+   * overwritten. Must be attached to a storage
+   *
+   * @param value value to append
+   */
+  void push(const T &value) {
+    _values[wrap(_head + _count)] = value;
+    if (_count < _capacity) {
+      _count++;
+    } else {
+      _head = wrap(_head + 1);
+    }
+  }
+
+  /**
+   * @brief Remove the oldest element, does nothing if empty
+   */
+  void pop() {
+    if (_count == 0) {
+      return;
+    }
+    _head = wrap(_head + 1);
+    _count--;
+  }
+
+  /**
+   * @brief Remove the newest element, does nothing if empty
+   */
+  void popBack() {
+    if (_count == 0) {
+      return;
+    }
+    _count--;
+  }
+
+  /** Oldest element, only valid if not empty */
+  const T &front() const { return _values[_head]; }
+
+  /** Newest element, only valid if not empty */
+  const T &back() const { return _values[wrap(_head + _count - 1)]; }
+
+  /** Element at index, 0 is the oldest element */
+  const T &operator[](size_t index) const { return _values[wrap(_head + index)]; }
+
+  void clear() {
+    _head = 0;
+    _count = 0;
+  }
+
+  size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  bool full() const { return _count == _capacity; }
+  size_t capacity() const { return _capacity; }
+};
+
+#endif /** _AG_RING_BUFFER_H_ */
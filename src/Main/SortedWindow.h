@@ -0,0 +1,158 @@
+#ifndef _AG_SORTED_WINDOW_H_
+#define _AG_SORTED_WINDOW_H_
+
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @brief Fixed capacity multiset kept in ascending order, for order statistics of a sliding
+ * window
+ *
+ * Caller inserts every value entering the window and remove every value leaving it, so the
+ * window is never sorted again. Positions are found by binary search, O(log n) comparisons, then
+ * the tail is shifted with one memmove. Median is O(1) and median absolute deviation O(log n).
+ *
+ * @tparam T element type, must be trivially copyable
+ * @tparam N maximum number of elements that can be stored
+ */
+template <typename T, size_t N> class SortedWindow {
+private:
+  T _values[N];
+  size_t _count = 0;
+
+  /** Index of the first element not less than value */
+  size_t lowerBound(const T &value) const {
+    size_t lo = 0;
+    size_t hi = _count;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (_values[mid] < value) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+public:
+  /**
+   * @brief Insert value at its sorted position, does nothing if full
+   */
+  void insert(const T &value) {
+    if (_count == N) {
+      return;
+    }
+    size_t index = lowerBound(value);
+    memmove(&_values[index + 1], &_values[index], (_count - index) * sizeof(T));
+    _values[index] = value;
+    _count++;
+  }
+
+  /**
+   * @brief Remove one element equal to value
+   *
+   * @return false if there is no such element
+   */
+  bool remove(const T &value) {
+    size_t index = lowerBound(value);
+    if (index == _count || value < _values[index]) {
+      return false;
+    }
+    memmove(&_values[index], &_values[index + 1], (_count - index - 1) * sizeof(T));
+    _count--;
+    return true;
+  }
+
+  /**
+   * @brief Median, average of the two middle elements if size is even. Only valid if not empty
+   */
+  float median() const {
+    size_t half = _count / 2;
+    if (_count % 2) {
+      return _values[half];
+    }
+    return ((float)_values[half - 1] + (float)_values[half]) / 2.0f;
+  }
+
+  /**
+   * @brief Median of the absolute deviation of every element from center, only valid if not
+   * empty
+   *
+   * Deviations of the elements below center and of the others are two ascending sequences, so
+   * their median is found by binary search over the split between them, without building them.
+   */
+  float mad(float center) const {
+    // Elements below center, deviation increase from split - 1 down to 0
+    size_t split = 0;
+    size_t hi = _count;
+    while (split < hi) {
+      size_t mid = (split + hi) / 2;
+      if ((float)_values[mid] < center) {
+        split = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    size_t half = _count / 2;
+    if (_count % 2) {
+      return kthDeviation(center, split, half);
+    }
+    return (kthDeviation(center, split, half - 1) + kthDeviation(center, split, half)) / 2.0f;
+  }
+
+  /** Element at index, 0 is the smallest */
+  const T &operator[](size_t index) const { return _values[index]; }
+
+  void clear() { _count = 0; }
+
+  size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  static constexpr size_t capacity() { return N; }
+
+private:
+  /** Deviation of the i-th element below center (0 is the closest) */
+  float lowDeviation(float center, size_t split, size_t i) const {
+    return center - (float)_values[split - 1 - i];
+  }
+
+  /** Deviation of the i-th element not below center (0 is the closest) */
+  float highDeviation(float center, size_t split, size_t i) const {
+    return (float)_values[split + i] - center;
+  }
+
+  /**
+   * @brief k-th (0 based) smallest deviation from center
+   */
+  float kthDeviation(float center, size_t split, size_t k) const {
+    size_t lowCount = split;
+    size_t highCount = _count - split;
+
+    // Find how many of the k + 1 smallest deviations are below center: smallest count taken
+    // from low where the next low deviation is not less than the last high one taken
+    size_t lo = k + 1 > highCount ? k + 1 - highCount : 0;
+    size_t hi = k + 1 < lowCount ? k + 1 : lowCount;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (lowDeviation(center, split, mid) < highDeviation(center, split, k - mid)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    size_t fromLow = lo;
+    size_t fromHigh = k + 1 - fromLow;
+    float result = fromLow > 0 ? lowDeviation(center, split, fromLow - 1) : 0;
+    if (fromHigh > 0) {
+      float high = highDeviation(center, split, fromHigh - 1);
+      if (high > result) {
+        result = high;
+      }
+    }
+    return result;
+  }
+};
+
+#endif /** _AG_SORTED_WINDOW_H_ */
@@ -0,0 +1,200 @@
+#ifndef _AG_TIME_WEIGHTED_MEAN_H_
+#define _AG_TIME_WEIGHTED_MEAN_H_
+
+#include "RingBuffer.h"
+#include <stdint.h>
+
+/**
+ * @brief Times of the last sampling rounds of a measurement, shared by the TimeWeightedMean of
+ * all its channels
+ *
+ * Channels of a measurement are sampled together, so their values share one time each round
+ * instead of every channel keeping its own. A value joins the newest round unless its channel
+ * already has a value in it or the round is older than the join time, otherwise it starts a new
+ * round. Rounds are numbered from 1, the oldest round is forgotten when a new one doesn't fit.
+ */
+class SampleClock {
+private:
+  RingBuffer<uint32_t, 0> _times; // Time of the last rounds, the newest at the back
+  uint32_t _newest = 0;           // Number of the newest round, 0 before the first round
+  uint32_t _joinTime = 0;         // Time in ms a value can be after the round it joins
+
+public:
+  /**
+   * @brief Use storage for the round times and forget every round
+   *
+   * @param storage array of capacity times, owned by the caller
+   * @param capacity rounds kept, at least the capacity of the windows of the channels
+   */
+  void attach(uint32_t *storage, size_t capacity) { _times.attach(storage, capacity); }
+
+  /**
+   * @brief Set the time in milliseconds a value can be after the round it joins, about half the
+   * update interval
+   */
+  void setJoinTime(uint32_t joinTime) { _joinTime = joinTime; }
+
+  /**
+   * @brief Get the round of a value sampled at now
+   *
+   * @param now caller clock in milliseconds, wrapping around is handled
+   * @param last round of the previous value of the channel, 0 if none
+   */
+  uint32_t round(uint32_t now, uint32_t last) {
+    if (!_times.empty() && last != _newest && now - _times.back() < _joinTime) {
+      return _newest;
+    }
+    _times.push(now);
+    return ++_newest;
+  }
+
+  /** Check if the time of round is still kept */
+  bool has(uint32_t round) const { return _newest - round < _times.size(); }
+
+  /** Time of round, only valid if has() */
+  uint32_t time(uint32_t round) const { return _times[_times.size() - 1 - (_newest - round)]; }
+
+  /** Number of the newest round */
+  uint32_t newest() const { return _newest; }
+};
+
+/**
+ * @brief Time weighted mean of the values of a sliding window kept in a RingBuffer
+ *
+ * Mean is the trapezoidal integral of the values over time divided by the time between the oldest
+ * and the newest value, so a value followed by a long gap (sensor read timeout, loop paused by an
+ * OTA) weighs as much as the gap instead of as much as one sample. With regular sampling it only
+ * differs from the arithmetic mean by the half weight of the oldest and newest values.
+ *
+ * Times are kept once per round by the SampleClock of the measurement, each value only keeps the
+ * low byte of its round number. A value whose round the clock forgot is expired, see expired().
+ *
+ * Integral is updated on add / remove, so every update is amortized O(1). Like WindowStatistics,
+ * it is computed again from the window once every window size updates so the float rounding error
+ * of the values that left the window doesn't accumulate.
+ *
+ * Caller owns the window: call add() after a value is pushed and remove() before the oldest value
+ * is popped, and remove the expired values before adding one.
+ *
+ * @tparam T element type of the window
+ */
+template <typename T> class TimeWeightedMean {
+private:
+  RingBuffer<uint8_t, 0> _rounds; // Low byte of the round of each value of the window
+  uint32_t _newestRound = 0;      // Round of the newest value ever added, 0 if none
+  uint32_t _oldestTime = 0;       // Time of the oldest value of the window
+  uint32_t _newestTime = 0;       // Time of the newest value of the window
+  float _area = 0;                // Integral of the values from the oldest to the newest time
+  uint8_t _sinceRebuild = 0;      // Updates since the integral was computed from the window
+  bool _stale = false;            // Integral lost a value whose round was forgotten
+
+  static float segment(const T &from, const T &to, uint32_t duration) {
+    return ((float)from + (float)to) * 0.5f * duration;
+  }
+
+  /** Round of the value at index, the window is always less than 128 rounds long */
+  uint32_t roundOf(size_t index) const {
+    return _newestRound - (uint8_t)((uint8_t)_newestRound - _rounds[index]);
+  }
+
+  /** Compute the integral from the value at first, its round and the next ones must be kept */
+  void rebuild(const RingBuffer<T, 0> &window, const SampleClock &clock, size_t first) {
+    _sinceRebuild = 0;
+    _stale = false;
+    _area = 0;
+    uint32_t previous = first == 0 ? _oldestTime : clock.time(roundOf(first));
+    _oldestTime = previous;
+    for (size_t i = first + 1; i < window.size(); i++) {
+      uint32_t time = clock.time(roundOf(i));
+      _area += segment(window[i - 1], window[i], time - previous);
+      previous = time;
+    }
+  }
+
+public:
+  /**
+   * @brief Use storage for the round of each value of a window and forget every value
+   *
+   * @param storage capacity bytes, owned by the caller
+   * @param capacity capacity of the window, at most 128
+   */
+  void attach(uint8_t *storage, size_t capacity) {
+    _rounds.attach(storage, capacity);
+    clear();
+  }
+
+  /**
+   * @brief Add the newest value of window, call after it is pushed
+   *
+   * @param now caller clock in milliseconds when the value was sampled, wrapping around is handled
+   */
+  void add(const RingBuffer<T, 0> &window, SampleClock &clock, uint32_t now) {
+    _newestRound = clock.round(now, _newestRound);
+    _newestTime = clock.time(_newestRound);
+    _rounds.push((uint8_t)_newestRound);
+    size_t count = window.size();
+    if (count < 2) {
+      _oldestTime = _newestTime;
+      _area = 0;
+      _sinceRebuild = 0;
+      return;
+    }
+    // Only the round of the oldest value can have been forgotten by this round, its time is kept
+    if (++_sinceRebuild >= count) {
+      rebuild(window, clock, 0);
+      return;
+    }
+    uint32_t previous = count == 2 ? _oldestTime : clock.time(roundOf(count - 2));
+    _area += segment(window[count - 2], window[count - 1], _newestTime - previous);
+  }
+
+  /**
+   * @brief Remove the oldest value of window, call before it is popped
+   */
+  void remove(const RingBuffer<T, 0> &window, const SampleClock &clock) {
+    if (window.empty()) {
+      return;
+    }
+    if (window.size() < 2) {
+      _area = 0;
+      _stale = false;
+    } else if (!clock.has(roundOf(1))) {
+      // Next value expires too, integral is computed again from the first value still kept
+      _stale = true;
+    } else if (_stale) {
+      rebuild(window, clock, 1);
+    } else {
+      uint32_t next = clock.time(roundOf(1));
+      _area -= segment(window[0], window[1], next - _oldestTime);
+      _oldestTime = next;
+    }
+    _rounds.pop();
+  }
+
+  /**
+   * @brief Forget every value, call after window is cleared
+   */
+  void clear() {
+    _rounds.clear();
+    _area = 0;
+    _sinceRebuild = 0;
+    _stale = false;
+  }
+
+  /**
+   * @brief Check if the oldest value is older than duration, or its round was forgotten
+   *
+   * @param now caller clock in milliseconds
+   */
+  bool expired(uint32_t now, uint32_t duration, const SampleClock &clock) const {
+    return !_rounds.empty() && (!clock.has(roundOf(0)) || (now - _oldestTime) >= duration);
+  }
+
+  /** Time from the oldest to the newest value in milliseconds, 0 if less than 2 values */
+  uint32_t span() const { return _rounds.size() < 2 ? 0 : _newestTime - _oldestTime; }
+
+  /** Time weighted mean of the window, only valid if span() is not 0 */
+  float mean() const { return _area / span(); }
+};
+
+#endif /** _AG_TIME_WEIGHTED_MEAN_H_ */
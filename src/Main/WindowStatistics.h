@@ -0,0 +1,162 @@
+#ifndef _AG_WINDOW_STATISTICS_H_
+#define _AG_WINDOW_STATISTICS_H_
+
+#include "RingBuffer.h"
+#include <stdint.h>
+
+/**
+ * @brief Incremental statistics of the values of a sliding window kept in a RingBuffer
+ *
+ * Mean and variance are updated with Welford add / remove steps, minimum and maximum with
+ * monotonic queues of sequence numbers, so every update is amortized O(1). Welford remove step
+ * accumulate rounding error on float, so mean and variance are computed again from the window
+ * once every window size updates, before the error of the values that left the window can
+ * outweigh the variance of the values in it.
+ *
+ * Caller owns the window: call add() after a value is pushed and remove() before the oldest
+ * value is popped.
+ *
+ * @tparam T element type of the window
+ * @tparam N window capacity, at most 128 so sequence numbers fit in a byte. 0 for a window with a
+ * capacity set at run time, see attach()
+ */
+template <typename T, size_t N> class WindowStatistics {
+  static_assert(N <= 128, "Sequence numbers must fit in uint8_t");
+
+private:
+  float _mean = 0;
+  float _m2 = 0;             // Sum of squared differences from the mean
+  uint8_t _next = 0;         // Sequence number of the next value pushed, wraps around
+  uint8_t _sinceRebuild = 0; // Updates since mean and variance were computed from the window
+  RingBuffer<uint8_t, N> _minimum; // Sequence numbers of the values with ascending value
+  RingBuffer<uint8_t, N> _maximum; // Sequence numbers of the values with descending value
+
+  /** Window value of a sequence number */
+  static const T &at(const RingBuffer<T, N> &window, uint8_t seq, uint8_t next) {
+    uint8_t oldest = next - (uint8_t)window.size();
+    return window[(uint8_t)(seq - oldest)];
+  }
+
+  void rebuild(const RingBuffer<T, N> &window) {
+    _sinceRebuild = 0;
+    size_t count = window.size();
+    if (count == 0) {
+      _mean = 0;
+      _m2 = 0;
+      return;
+    }
+
+    float sum = 0;
+    for (size_t i = 0; i < count; i++) {
+      sum += window[i];
+    }
+    _mean = sum / count;
+    _m2 = 0;
+    for (size_t i = 0; i < count; i++) {
+      float delta = window[i] - _mean;
+      _m2 += delta * delta;
+    }
+  }
+
+public:
+  /**
+   * @brief Use storage for the queues of a window with a capacity set at run time, N of 0, and
+   * forget every value
+   *
+   * @param storage 2 * capacity bytes, owned by the caller
+   * @param capacity capacity of the window, at most 128
+   */
+  void attach(uint8_t *storage, size_t capacity) {
+    _minimum.attach(storage, capacity);
+    _maximum.attach(storage + capacity, capacity);
+    _next = 0;
+    clear();
+  }
+
+  /**
+   * @brief Add the newest value of window, call after it is pushed
+   */
+  void add(const RingBuffer<T, N> &window) {
+    const T &value = window.back();
+    uint8_t seq = _next++;
+
+    while (!_minimum.empty() && value < at(window, _minimum.back(), _next)) {
+      _minimum.popBack();
+    }
+    _minimum.push(seq);
+    while (!_maximum.empty() && at(window, _maximum.back(), _next) < value) {
+      _maximum.popBack();
+    }
+    _maximum.push(seq);
+
+    if (++_sinceRebuild >= window.size()) {
+      rebuild(window);
+      return;
+    }
+    float delta = value - _mean;
+    _mean += delta / window.size();
+    _m2 += delta * (value - _mean);
+  }
+
+  /**
+   * @brief Remove the oldest value of window, call before it is popped
+   */
+  void remove(const RingBuffer<T, N> &window) {
+    if (window.empty()) {
+      return;
+    }
+
+    uint8_t oldest = _next - (uint8_t)window.size();
+    if (!_minimum.empty() && _minimum.front() == oldest) {
+      _minimum.pop();
+    }
+    if (!_maximum.empty() && _maximum.front() == oldest) {
+      _maximum.pop();
+    }
+
+    size_t count = window.size() - 1;
+    if (count == 0) {
+      _mean = 0;
+      _m2 = 0;
+      return;
+    }
+    const T &value = window.front();
+    float delta = value - _mean;
+    _mean -= delta / count;
+    _m2 -= delta * (value - _mean);
+    if (_m2 < 0) {
+      _m2 = 0;
+    }
+  }
+
+  /**
+   * @brief Forget every value, call after window is cleared
+   */
+  void clear() {
+    _mean = 0;
+    _m2 = 0;
+    _sinceRebuild = 0;
+    _minimum.clear();
+    _maximum.clear();
+  }
+
+  /** Mean of the window, 0 if empty */
+  float mean() const { return _mean; }
+
+  /** Sample variance of the window, 0 if less than 2 values */
+  float variance(const RingBuffer<T, N> &window) const {
+    return window.size() < 2 ? 0 : _m2 / (window.size() - 1);
+  }
+
+  /** Smallest value of the window, only valid if not empty */
+  const T &minimum(const RingBuffer<T, N> &window) const {
+    return at(window, _minimum.front(), _next);
+  }
+
+  /** Largest value of the window, only valid if not empty */
+  const T &maximum(const RingBuffer<T, N> &window) const {
+    return at(window, _maximum.front(), _next);
+  }
+};
+
+#endif /** _AG_WINDOW_STATISTICS_H_ */
@@ -2,26 +2,20 @@
 
 #define VALID_TEMPERATURE_MAX (125)
 #define VALID_TEMPERATURE_MIN (-40)
-#define INVALID_TEMPERATURE   (-1000)
 
 #define VALID_HUMIDITY_MAX    (100)
 #define VALID_HUMIDITY_MIN    (0)
-#define INVALID_HUMIDITY      (-1)
 
 #define VALID_PMS_MAX         (1000)
 #define VALID_PMS_MIN         (0)
-#define INVALID_PMS           (-1)
 
 #define VALID_PMS03COUNT_MIN  (0)
 
 #define VALID_CO2_MAX         (10000)
 #define VALID_CO2_MIN         (0)
-#define INVALID_CO2           (-1)
 
 #define VALID_NOX_MIN         (0)
 #define VALID_VOC_MIN         (0)
-#define INVALID_NOX           (-1)
-#define INVALID_VOC           (-1)
 
 utils::utils(/* args */) {}
 
@@ -92,3 +86,24 @@ float utils::degreeC_To_F(float t) {
   /** (t * 9)/5 + 32 */
   return t * 1.8f + 32.0f;
 }
+
+
+/**
+ * @brief CRC-32 (IEEE 802.3, same as zlib) of data
+ *
+ * @param crc CRC of the previous data to continue from, 0 to start
+ */
+uint32_t utils::crc32(const void *data, size_t length, uint32_t crc) {
+  // Half byte table, small enough for flash and fast enough for configuration sized data
+  static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+      0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+      0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc = table[(crc ^ bytes[i]) & 0x0f] ^ (crc >> 4);
+    crc = table[(crc ^ (bytes[i] >> 4)) & 0x0f] ^ (crc >> 4);
+  }
+  return ~crc;
+}
\ No newline at end of file
@@ -3,6 +3,14 @@
 
 #include <Arduino.h>
 
+/** Invalid value of each measurement, also returned by utils::getInvalidXXX() */
+#define INVALID_TEMPERATURE   (-1000)
+#define INVALID_HUMIDITY      (-1)
+#define INVALID_PMS           (-1)
+#define INVALID_CO2           (-1)
+#define INVALID_NOX           (-1)
+#define INVALID_VOC           (-1)
+
 class utils
 {
 private:
@@ -25,6 +33,7 @@ public:
   static int getInvalidNOx(void);
   static int getInvalidVOC(void);
   static float degreeC_To_F(float t);
+  static uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
 };
 
 
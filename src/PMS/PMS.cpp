@@ -1,5 +1,160 @@
 #include "PMS.h"
 #include "../Main/BoardDef.h"
+#include "../Main/FixedPoint.h"
+
+/** Float SLR correction, see PMSBase::slrCorrection */
+static float slrCorrectionFloat(float pm25, float pm003Count, float scalingFactor,
+                                float intercept) {
+  float calibrated;
+
+  float lowCalibrated = (scalingFactor * pm003Count) + intercept;
+  if (lowCalibrated < 31) {
+    calibrated = lowCalibrated;
+  } else {
+    calibrated = pm25;
+  }
+
+  // No negative value for pm2.5
+  if (calibrated < 0) {
+    return 0.0;
+  }
+
+  return calibrated;
+}
+
+/** Float SLR correction by 0.3um count, see PMSBase::slrCorrectionBy003Count */
+static float slrCorrectionBy003CountFloat(float pm003Count, float scalingFactor,
+                                          float intercept) {
+  float calibrated = (scalingFactor * pm003Count) + intercept;
+
+  // No negative value for pm2.5
+  if (calibrated < 0) {
+    return 0.0;
+  }
+
+  return calibrated;
+}
+
+/** Float SLR correction by raw PM2.5, see PMSBase::slrCorrectionByPm25Raw */
+static float slrCorrectionByPm25RawFloat(float pm25, float scalingFactor, float intercept) {
+  float calibrated;
+  if (pm25 == 0.0) {
+    calibrated = 0.0;
+  } else {
+    calibrated = (scalingFactor * pm25) + intercept;
+  }
+
+  // No negative value for pm2.5
+  if (calibrated < 0) {
+    return 0.0;
+  }
+
+  return calibrated;
+}
+
+/** Float PM2.5 compensation, see PMSBase::compensate */
+static float compensateFloat(float pm25, float humidity) {
+  float value;
+
+  // Correct invalid humidity value
+  if (humidity < 0) {
+    humidity = 0;
+  }
+  if (humidity > 100) {
+    humidity = 100.0f;
+  }
+
+  // If its already 0, do not proceed
+  if (pm25 == 0) {
+    return 0.0;
+  }
+
+  if (pm25 < 30) { /** pm2.5 < 30 */
+    value = (pm25 * 0.524f) - (humidity * 0.0862f) + 5.75f;
+  } else if (pm25 < 50) { /** 30 <= pm2.5 < 50 */
+    value = (0.786f * (pm25 * 0.05f - 1.5f) + 0.524f * (1.0f - (pm25 * 0.05f - 1.5f))) * pm25 -
+            (0.0862f * humidity) + 5.75f;
+  } else if (pm25 < 210) { /** 50 <= pm2.5 < 210 */
+    value = (0.786f * pm25) - (0.0862f * humidity) + 5.75f;
+  } else if (pm25 < 260) { /** 210 <= pm2.5 < 260 */
+    value = (0.69f * (pm25 * 0.02f - 4.2f) + 0.786f * (1.0f - (pm25 * 0.02f - 4.2f))) * pm25 -
+            (0.0862f * humidity * (1.0f - (pm25 * 0.02f - 4.2f))) +
+            (2.966f * (pm25 * 0.02f - 4.2f)) + (5.75f * (1.0f - (pm25 * 0.02f - 4.2f))) +
+            (8.84f * (1.e-4) * pm25 * pm25 * (pm25 * 0.02f - 4.2f));
+  } else { /** 260 <= pm2.5 */
+    value = 2.966f + (0.69f * pm25) + (8.84f * (1.e-4) * pm25 * pm25);
+  }
+
+  // No negative value for pm2.5
+  if (value < 0) {
+    return 0.0;
+  }
+
+  return value;
+}
+
+#if AG_FIXED_POINT_CORRECTION
+/** Fixed point kernels input magnitude limit, larger values use the float ones */
+#define PMS_FIXED_POINT_MAX Q16(10000)
+/** Limit of the SLR scaling factor magnitude for the fixed point kernels */
+#define PMS_FIXED_POINT_MAX_SCALING_FACTOR Q32(64)
+
+/**
+ * @brief Scaling factor times value, in Q16. Value with 8 fraction bits and scaling factor with
+ * 32, so a small scaling factor of the 0.3um count keeps its precision
+ */
+static q16_t slrProduct(float value, float scalingFactor) {
+  return (fixedFromFloat(value, 8) * fixedFromFloat(scalingFactor, 32) + ((int64_t)1 << 23)) >> 24;
+}
+
+static bool slrInRange(float value, float scalingFactor, float intercept) {
+  q16_t q = q16FromFloat(value);
+  int64_t factor = fixedFromFloat(scalingFactor, 32);
+  q16_t offset = q16FromFloat(intercept);
+  return q > -PMS_FIXED_POINT_MAX && q < PMS_FIXED_POINT_MAX &&
+         factor > -PMS_FIXED_POINT_MAX_SCALING_FACTOR &&
+         factor < PMS_FIXED_POINT_MAX_SCALING_FACTOR && offset > -PMS_FIXED_POINT_MAX &&
+         offset < PMS_FIXED_POINT_MAX;
+}
+
+/** Fixed point compensate, pm25 magnitude under PMS_FIXED_POINT_MAX */
+static q16_t compensateFixed(q16_t pm25, q16_t humidity) {
+  // Correct invalid humidity value
+  if (humidity < 0) {
+    humidity = 0;
+  }
+  if (humidity > Q16(100)) {
+    humidity = Q16(100);
+  }
+
+  q16_t humidityTerm = q16MulQ32(humidity, Q32(0.0862));
+  q16_t value;
+  if (pm25 < Q16(30)) { /** pm2.5 < 30 */
+    value = q16MulQ32(pm25, Q32(0.524)) - humidityTerm + Q16(5.75);
+  } else if (pm25 < Q16(50)) { /** 30 <= pm2.5 < 50 */
+    q16_t t = q16MulQ32(pm25, Q32(0.05)) - Q16(1.5);
+    q16_t slope = q16MulQ32(t, Q32(0.786)) + q16MulQ32(Q16(1) - t, Q32(0.524));
+    value = q16Mul(slope, pm25) - humidityTerm + Q16(5.75);
+  } else if (pm25 < Q16(210)) { /** 50 <= pm2.5 < 210 */
+    value = q16MulQ32(pm25, Q32(0.786)) - humidityTerm + Q16(5.75);
+  } else {
+    // 8.84e-4 * pm2.5^2, square kept with 12 fraction bits so it doesn't overflow
+    q16_t square = (pm25 * pm25) >> 20;
+    q16_t squareTerm = (square * Q32(8.84e-4) + (1 << 27)) >> 28;
+    if (pm25 < Q16(260)) { /** 210 <= pm2.5 < 260 */
+      q16_t t = q16MulQ32(pm25, Q32(0.02)) - Q16(4.2);
+      q16_t slope = q16MulQ32(t, Q32(0.69)) + q16MulQ32(Q16(1) - t, Q32(0.786));
+      value = q16Mul(slope, pm25) - q16Mul(humidityTerm, Q16(1) - t) + q16MulQ32(t, Q32(2.966)) +
+              q16MulQ32(Q16(1) - t, Q32(5.75)) + q16Mul(squareTerm, t);
+    } else { /** 260 <= pm2.5 */
+      value = Q16(2.966) + q16MulQ32(pm25, Q32(0.69)) + squareTerm;
+    }
+  }
+
+  // No negative value for pm2.5
+  return value < 0 ? 0 : value;
+}
+#endif
 
 /**
  * @brief Initializes the sensor and attempts to read data.
@@ -298,6 +453,23 @@ uint8_t PMSBase::getErrorCode(void) { return pms_errorCode; }
  * @return int
  */
 int PMSBase::pm25ToAQI(int pm02) {
+#if AG_FIXED_POINT_CORRECTION
+  // Same formula with breakpoints scaled by 10, so it is exact in integer
+  if (pm02 <= 9)
+    return 50 * pm02 / 9;
+  else if (pm02 <= 35)
+    return (100 - 51) * (pm02 * 10 - 90) / (354 - 91) + 51;
+  else if (pm02 <= 55)
+    return (150 - 101) * (pm02 * 10 - 355) / (554 - 355) + 101;
+  else if (pm02 <= 125)
+    return (200 - 151) * (pm02 * 10 - 555) / (1254 - 555) + 151;
+  else if (pm02 <= 225)
+    return (300 - 201) * (pm02 * 10 - 1255) / (2254 - 1255) + 201;
+  else if (pm02 <= 325)
+    return (500 - 301) * (pm02 * 10 - 2255) / (3254 - 2255) + 301;
+  else
+    return 500;
+#else
   if (pm02 <= 9.0)
     return ((50 - 0) / (9.0 - .0) * (pm02 - .0) + 0);
   else if (pm02 <= 35.4)
@@ -312,6 +484,7 @@ int PMSBase::pm25ToAQI(int pm02) {
     return ((500 - 301) / (325.4 - 225.5) * (pm02 - 225.5) + 301);
   else
     return 500;
+#endif
 }
 
 
@@ -327,50 +500,47 @@ int PMSBase::pm25ToAQI(int pm02) {
  * @return float Calibrated PM2.5 value
  */
 float PMSBase::slrCorrection(float pm25, float pm003Count, float scalingFactor, float intercept) {
-  float calibrated;
-
-  float lowCalibrated = (scalingFactor * pm003Count) + intercept;
-  if (lowCalibrated < 31) {
-    calibrated = lowCalibrated;
-  } else {
-    calibrated = pm25;
+#if AG_FIXED_POINT_CORRECTION
+  if (!slrInRange(pm003Count, scalingFactor, intercept)) {
+    return slrCorrectionFloat(pm25, pm003Count, scalingFactor, intercept);
   }
-
-  // No negative value for pm2.5
-  if (calibrated < 0) {
-    return 0.0;
+  q16_t lowCalibrated = slrProduct(pm003Count, scalingFactor) + q16FromFloat(intercept);
+  if (lowCalibrated < Q16(31)) {
+    return lowCalibrated < 0 ? 0.0 : q16ToFloat(lowCalibrated);
   }
-
-  return calibrated;
+  return pm25 < 0 ? 0.0 : pm25;
+#else
+  return slrCorrectionFloat(pm25, pm003Count, scalingFactor, intercept);
+#endif
 }
 
 
 float PMSBase::slrCorrectionBy003Count(float pm003Count, float scalingFactor, float intercept) {
-  float calibrated = (scalingFactor * pm003Count) + intercept;
-
-  // No negative value for pm2.5
-  if (calibrated < 0) {
-    return 0.0;
+#if AG_FIXED_POINT_CORRECTION
+  if (!slrInRange(pm003Count, scalingFactor, intercept)) {
+    return slrCorrectionBy003CountFloat(pm003Count, scalingFactor, intercept);
   }
-
-  return calibrated;
+  q16_t calibrated = slrProduct(pm003Count, scalingFactor) + q16FromFloat(intercept);
+  return calibrated < 0 ? 0.0 : q16ToFloat(calibrated);
+#else
+  return slrCorrectionBy003CountFloat(pm003Count, scalingFactor, intercept);
+#endif
 }
 
 float PMSBase::slrCorrectionByPm25Raw(float pm25, float scalingFactor,
                                       float intercept) {
-  float calibrated;
-  if (pm25 == 0.0) {
-    calibrated = 0.0;
-  } else {
-    calibrated = (scalingFactor * pm25) + intercept;
+#if AG_FIXED_POINT_CORRECTION
+  if (!slrInRange(pm25, scalingFactor, intercept)) {
+    return slrCorrectionByPm25RawFloat(pm25, scalingFactor, intercept);
   }
-
-  // No negative value for pm2.5
-  if (calibrated < 0) {
+  if (pm25 == 0.0) {
     return 0.0;
   }
-
-  return calibrated;
+  q16_t calibrated = slrProduct(pm25, scalingFactor) + q16FromFloat(intercept);
+  return calibrated < 0 ? 0.0 : q16ToFloat(calibrated);
+#else
+  return slrCorrectionByPm25RawFloat(pm25, scalingFactor, intercept);
+#endif
 }
 
 /**
@@ -383,43 +553,19 @@ float PMSBase::slrCorrectionByPm25Raw(float pm25, float scalingFactor,
  * @return compensated pm25 value
  */
 float PMSBase::compensate(float pm25, float humidity) {
-  float value;
-
-  // Correct invalid humidity value
-  if (humidity < 0) {
-    humidity = 0;
-  }
-  if (humidity > 100) {
-    humidity = 100.0f;
+#if AG_FIXED_POINT_CORRECTION
+  q16_t pm25Fixed = q16FromFloat(pm25);
+  if (pm25Fixed <= -PMS_FIXED_POINT_MAX || pm25Fixed >= PMS_FIXED_POINT_MAX) {
+    return compensateFloat(pm25, humidity);
   }
-
   // If its already 0, do not proceed
   if (pm25 == 0) {
     return 0.0;
   }
-
-  if (pm25 < 30) { /** pm2.5 < 30 */
-    value = (pm25 * 0.524f) - (humidity * 0.0862f) + 5.75f;
-  } else if (pm25 < 50) { /** 30 <= pm2.5 < 50 */
-    value = (0.786f * (pm25 * 0.05f - 1.5f) + 0.524f * (1.0f - (pm25 * 0.05f - 1.5f))) * pm25 -
-            (0.0862f * humidity) + 5.75f;
-  } else if (pm25 < 210) { /** 50 <= pm2.5 < 210 */
-    value = (0.786f * pm25) - (0.0862f * humidity) + 5.75f;
-  } else if (pm25 < 260) { /** 210 <= pm2.5 < 260 */
-    value = (0.69f * (pm25 * 0.02f - 4.2f) + 0.786f * (1.0f - (pm25 * 0.02f - 4.2f))) * pm25 -
-            (0.0862f * humidity * (1.0f - (pm25 * 0.02f - 4.2f))) +
-            (2.966f * (pm25 * 0.02f - 4.2f)) + (5.75f * (1.0f - (pm25 * 0.02f - 4.2f))) +
-            (8.84f * (1.e-4) * pm25 * pm25 * (pm25 * 0.02f - 4.2f));
-  } else { /** 260 <= pm2.5 */
-    value = 2.966f + (0.69f * pm25) + (8.84f * (1.e-4) * pm25 * pm25);
-  }
-
-  // No negative value for pm2.5
-  if (value < 0) {
-    return 0.0;
-  }
-
-  return value;
+  return q16ToFloat(compensateFixed(pm25Fixed, q16FromFloat(humidity)));
+#else
+  return compensateFloat(pm25, humidity);
+#endif
 }
 
 /**
@@ -1,4 +1,28 @@
 #include "PMS5003TBase.h"
+#include "../Main/FixedPoint.h"
+
+#if AG_FIXED_POINT_CORRECTION
+/** Fixed point kernels input magnitude limit, larger values use the float ones */
+#define PMS5003T_FIXED_POINT_MAX Q16(10000)
+#endif
+
+/** Float temperature compensation, see PMS5003TBase::compensateTemp */
+static float compensateTempFloat(float temp) {
+  if (temp < 10.0f) {
+    return temp * 1.327f - 6.738f;
+  }
+  return temp * 1.181f - 5.113f;
+}
+
+/** Float humidity compensation, see PMS5003TBase::compensateHum */
+static float compensateHumFloat(float hum) {
+  hum = hum * 1.259f + 7.34f;
+
+  if (hum > 100.0f) {
+    hum = 100.0f;
+  }
+  return hum;
+}
 
 PMS5003TBase::PMS5003TBase() {}
 
@@ -13,10 +37,18 @@ PMS5003TBase::~PMS5003TBase() {}
  * @return * float
  */
 float PMS5003TBase::compensateTemp(float temp) {
-  if (temp < 10.0f) {
-    return temp * 1.327f - 6.738f;
+#if AG_FIXED_POINT_CORRECTION
+  q16_t value = q16FromFloat(temp);
+  if (value <= -PMS5003T_FIXED_POINT_MAX || value >= PMS5003T_FIXED_POINT_MAX) {
+    return compensateTempFloat(temp);
   }
-  return temp * 1.181f - 5.113f;
+  if (value < Q16(10)) {
+    return q16ToFloat(q16MulQ32(value, Q32(1.327)) - Q16(6.738));
+  }
+  return q16ToFloat(q16MulQ32(value, Q32(1.181)) - Q16(5.113));
+#else
+  return compensateTempFloat(temp);
+#endif
 }
 
 /**
@@ -28,10 +60,14 @@ float PMS5003TBase::compensateTemp(float temp) {
  * @return * float
  */
 float PMS5003TBase::compensateHum(float hum) {
-  hum = hum * 1.259f + 7.34f;
-
-  if (hum > 100.0f) {
-    hum = 100.0f;
+#if AG_FIXED_POINT_CORRECTION
+  q16_t value = q16FromFloat(hum);
+  if (value <= -PMS5003T_FIXED_POINT_MAX || value >= PMS5003T_FIXED_POINT_MAX) {
+    return compensateHumFloat(hum);
   }
-  return hum;
+  value = q16MulQ32(value, Q32(1.259)) + Q16(7.34);
+  return value > Q16(100) ? 100.0f : q16ToFloat(value);
+#else
+  return compensateHumFloat(hum);
+#endif
 }
@@ -0,0 +1,42 @@
+/**
+ * PMS.cpp and PMS5003TBase.cpp built with the fixed point kernels. Their classes are renamed so
+ * they link next to the float build of agcore
+ */
+#undef AG_FIXED_POINT_CORRECTION
+#define AG_FIXED_POINT_CORRECTION 1
+#define PMSBase FixedPMSBase
+#define PMS5003TBase FixedPMS5003TBase
+#include "PMS/PMS.cpp"
+#include "PMS/PMS5003TBase.cpp"
+#undef PMSBase
+#undef PMS5003TBase
+
+#include "FixedPointKernels.h"
+
+static FixedPMSBase pms;
+static FixedPMS5003TBase pms5003t;
+
+int FixedPointKernels::pm25ToAQI(int pm02) { return pms.pm25ToAQI(pm02); }
+
+float FixedPointKernels::slrCorrection(float pm25, float pm003Count, float scalingFactor,
+                                       float intercept) {
+  return pms.slrCorrection(pm25, pm003Count, scalingFactor, intercept);
+}
+
+float FixedPointKernels::slrCorrectionBy003Count(float pm003Count, float scalingFactor,
+                                                 float intercept) {
+  return pms.slrCorrectionBy003Count(pm003Count, scalingFactor, intercept);
+}
+
+float FixedPointKernels::slrCorrectionByPm25Raw(float pm25, float scalingFactor,
+                                                float intercept) {
+  return pms.slrCorrectionByPm25Raw(pm25, scalingFactor, intercept);
+}
+
+float FixedPointKernels::compensate(float pm25, float humidity) {
+  return pms.compensate(pm25, humidity);
+}
+
+float FixedPointKernels::compensateTemp(float temp) { return pms5003t.compensateTemp(temp); }
+
+float FixedPointKernels::compensateHum(float hum) { return pms5003t.compensateHum(hum); }
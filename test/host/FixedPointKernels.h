@@ -0,0 +1,18 @@
+/**
+ * Correction kernels of PMSBase and PMS5003TBase built with AG_FIXED_POINT_CORRECTION, next to
+ * the float build of agcore, see FixedPointKernels.cpp
+ */
+#ifndef _FIXED_POINT_KERNELS_H_
+#define _FIXED_POINT_KERNELS_H_
+
+struct FixedPointKernels {
+  static int pm25ToAQI(int pm02);
+  static float slrCorrection(float pm25, float pm003Count, float scalingFactor, float intercept);
+  static float slrCorrectionBy003Count(float pm003Count, float scalingFactor, float intercept);
+  static float slrCorrectionByPm25Raw(float pm25, float scalingFactor, float intercept);
+  static float compensate(float pm25, float humidity);
+  static float compensateTemp(float temp);
+  static float compensateHum(float hum);
+};
+
+#endif /** _FIXED_POINT_KERNELS_H_ */
@@ -0,0 +1,55 @@
+/**
+ * Global operator new and delete replaced by ones keeping the size of each block in front of it
+ */
+#include "HeapCounter.h"
+#include "Libraries/Arduino_JSON/src/cjson/cJSON.h"
+#include <cstdlib>
+#include <new>
+
+HeapCounter heap;
+
+// Size of each block kept in front of it, aligned for any type
+union BlockHeader {
+  size_t size;
+  max_align_t align;
+};
+
+static void *countedMalloc(size_t size) {
+  BlockHeader *block = (BlockHeader *)malloc(sizeof(BlockHeader) + size);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  block->size = size;
+  heap.allocations++;
+  heap.live += size;
+  if (heap.live > heap.peak) {
+    heap.peak = heap.live;
+  }
+  return block + 1;
+}
+
+static void countedFree(void *pointer) {
+  if (pointer == nullptr) {
+    return;
+  }
+  BlockHeader *block = (BlockHeader *)pointer - 1;
+  heap.live -= block->size;
+  free(block);
+}
+
+void HeapCounter::countJson(void) {
+  cJSON_Hooks hooks = {countedMalloc, countedFree};
+  cJSON_InitHooks(&hooks);
+}
+
+void *operator new(size_t size) {
+  void *pointer = countedMalloc(size);
+  if (pointer == nullptr) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void *pointer) noexcept { countedFree(pointer); }
+
+void operator delete(void *pointer, size_t) noexcept { countedFree(pointer); }
@@ -0,0 +1,28 @@
+/**
+ * Heap use of the code run between two HeapCounter::reset(), counted by the global operator new
+ * and delete and by the cJSON allocation hooks, see HeapCounter.cpp. Benchmarks only
+ */
+#ifndef _HEAP_COUNTER_H_
+#define _HEAP_COUNTER_H_
+
+#include <stddef.h>
+
+struct HeapCounter {
+  size_t allocations;
+  size_t live;
+  size_t peak;
+  size_t base; // Live bytes at reset(), peak is reported above it
+
+  void reset(void) {
+    allocations = 0;
+    base = live;
+    peak = live;
+  }
+  size_t peakAboveBase(void) const { return peak - base; }
+
+  /** Count the allocations of cJSON too, call before any JSONVar is built */
+  static void countJson(void);
+};
+extern HeapCounter heap;
+
+#endif /** _HEAP_COUNTER_H_ */
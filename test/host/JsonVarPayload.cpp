@@ -0,0 +1,250 @@
+/**
+ * Measurements payload of the JSONVar builders replaced by JsonWriter: buildIndoor, buildOutdoor
+ * and buildPMS of the previous Measurements::toString. Values are read from the published
+ * snapshot with the public accessors, the fields added since (PMS fusion, window statistics)
+ * are built the same way
+ */
+#include "JsonVarPayload.h"
+
+typedef Measurements M;
+
+static String pmsFirmware(int code) { return String("PMS5003x-") + String(code); }
+
+/** buildPMS of one channel */
+static void buildPMS(JSONVar &pms, M &measurements, AirGradient &ag, const M::Snapshot &published,
+                     int ch, bool withTempHum, bool compensate) {
+  const M::Measures &avg = published.average;
+  for (int i = 0; i < M::_MEASUREMENT_TYPE_MAX; i++) {
+    const M::MeasurementDescriptor &desc = M::descriptor((M::MeasurementType)i);
+    if (desc.group != M::GroupPM) {
+      continue;
+    }
+    float value = M::valueOf(avg, desc.type, ch);
+    if (desc.isValid(value)) {
+      pms[desc.jsonKey] = ag.round2(value);
+    }
+  }
+
+  if (withTempHum) {
+    float _vc;
+    if (utils::isValidTemperature(M::valueOf(avg, M::Temperature, ch))) {
+      pms["atmp"] = ag.round2(M::valueOf(avg, M::Temperature, ch));
+      if (compensate) {
+        _vc = measurements.getCorrectedTempHum(published, M::Temperature, ch, true);
+        if (utils::isValidTemperature(_vc)) {
+          pms["atmpCompensated"] = ag.round2(_vc);
+        }
+      }
+    }
+    if (utils::isValidHumidity(M::valueOf(avg, M::Humidity, ch))) {
+      pms["rhum"] = ag.round2(M::valueOf(avg, M::Humidity, ch));
+      if (compensate) {
+        _vc = measurements.getCorrectedTempHum(published, M::Humidity, ch, true);
+        if (utils::isValidHumidity(_vc)) {
+          pms["rhumCompensated"] = ag.round2(_vc);
+        }
+      }
+    }
+  }
+
+  if (compensate) {
+    if (utils::isValidPm(M::valueOf(avg, M::PM25, ch)) &&
+        utils::isValidHumidity(M::valueOf(avg, M::Humidity, ch))) {
+      pms["pm02Compensated"] = ag.round2(measurements.getCorrectedPM25(published, true, ch, true));
+    }
+  }
+}
+
+/**
+ * buildPMS of every channel, each value set on the fused object and on its channel in
+ * "channels" as it is computed. Channels are averaged weighted by their health
+ */
+static void buildPMSAverage(JSONVar &pms, M &measurements, AirGradient &ag,
+                            const M::Snapshot &published, bool localServer) {
+  const M::Measures &avg = published.average;
+  const char *names[] = {"1", "2", "3", "4"};
+  for (int i = 0; i < M::_MEASUREMENT_TYPE_MAX; i++) {
+    const M::MeasurementDescriptor &desc = M::descriptor((M::MeasurementType)i);
+    if (desc.group != M::GroupPM) {
+      continue;
+    }
+    float value = M::fusedOf(published, avg, desc.type);
+    if (desc.isValid(value)) {
+      pms[desc.jsonKey] = ag.round2(value);
+    }
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      if (desc.isValid(M::valueOf(avg, desc.type, ch))) {
+        pms["channels"][names[ch - 1]][desc.jsonKey] = ag.round2(M::valueOf(avg, desc.type, ch));
+      }
+    }
+  }
+
+  const M::MeasurementType types[] = {M::Temperature, M::Humidity};
+  const char *compensatedKeys[] = {"atmpCompensated", "rhumCompensated"};
+  for (int i = 0; i < 2; i++) {
+    const M::MeasurementDescriptor &desc = M::descriptor(types[i]);
+    float value = M::fusedOf(published, avg, desc.type);
+    if (!desc.isValid(value)) {
+      continue;
+    }
+    pms[desc.jsonKey] = ag.round2(value);
+    float sum = 0;
+    int count = 0;
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      if (!desc.isValid(M::valueOf(avg, desc.type, ch))) {
+        continue;
+      }
+      JSONVar channel = pms["channels"][names[ch - 1]];
+      channel[desc.jsonKey] = ag.round2(M::valueOf(avg, desc.type, ch));
+      if (localServer) {
+        float compensated = measurements.getCorrectedTempHum(published, desc.type, ch, true);
+        if (desc.isValid(compensated)) {
+          channel[compensatedKeys[i]] = ag.round2(compensated);
+        }
+        sum += compensated;
+        count++;
+      }
+    }
+    if (localServer) {
+      pms[compensatedKeys[i]] = ag.round2(sum / count);
+    }
+  }
+
+  if (localServer) {
+    float pm25Comp[MEASUREMENT_CHANNELS];
+    bool valid[MEASUREMENT_CHANNELS];
+    bool anyValid = false;
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      pm25Comp[ch - 1] = utils::getInvalidPmValue();
+      if (utils::isValidPm(M::valueOf(avg, M::PM25, ch)) &&
+          utils::isValidHumidity(M::valueOf(avg, M::Humidity, ch))) {
+        pm25Comp[ch - 1] = measurements.getCorrectedPM25(published, true, ch, true);
+        pms["channels"][names[ch - 1]]["pm02Compensated"] = ag.round2(pm25Comp[ch - 1]);
+      }
+      valid[ch - 1] = utils::isValidPm(pm25Comp[ch - 1]);
+      anyValid = anyValid || valid[ch - 1];
+    }
+    if (anyValid) {
+      pms["pm02Compensated"] = ag.round2(published.pmsFusion.combine(pm25Comp, valid));
+    }
+    pms["pmsConfidence"] = ag.round2(published.pmsFusion.confidence);
+  }
+
+  // PMS5003T version, or the health of every channel with a value
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    if (!localServer) {
+      if (ch <= 2) {
+        PMS5003T &sensor = ch == 1 ? ag.pms5003t_1 : ag.pms5003t_2;
+        pms["channels"][names[ch - 1]]["firmware"] = pmsFirmware(sensor.getFirmwareVersion());
+      }
+    } else if (pms.hasOwnProperty("channels") && pms["channels"].hasOwnProperty(names[ch - 1])) {
+      pms["channels"][names[ch - 1]]["pmsHealth"] =
+          M::Fusion::healthName(published.pmsFusion.health[ch - 1]);
+    }
+  }
+}
+
+static void buildStatistics(JSONVar &root, AirGradient &ag, const M::Snapshot &published) {
+  JSONVar statistics = JSON.parse("{}");
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    char digit[2] = {(char)('0' + ch), '\0'};
+    const char *name = digit;
+    for (int i = 0; i < M::_MEASUREMENT_TYPE_MAX; i++) {
+      const M::MeasurementDescriptor &desc = M::descriptor((M::MeasurementType)i);
+      if (ch > desc.channels) {
+        continue;
+      }
+      const M::Statistics &window = M::statisticsOf(published, desc.type, ch);
+      if (window.count == 0) {
+        continue;
+      }
+      statistics[name][desc.jsonKey]["count"] = window.count;
+      statistics[name][desc.jsonKey]["mean"] = ag.round2(window.mean);
+      statistics[name][desc.jsonKey]["stddev"] = ag.round2(window.stddev);
+      statistics[name][desc.jsonKey]["min"] = ag.round2(window.min);
+      statistics[name][desc.jsonKey]["max"] = ag.round2(window.max);
+    }
+  }
+  root["statistics"] = statistics;
+}
+
+JSONVar JsonVarPayload::build(Measurements &measurements, AirGradient &ag, Configuration &config,
+                              bool localServer, AgFirmwareMode fwMode, int rssi) {
+  M::Snapshot published;
+  measurements.snapshot(published);
+  const M::Measures &avg = published.average;
+  JSONVar root;
+
+  if (ag.isOne() || ag.isPro4_2() || ag.isPro3_3() || ag.isBasic()) {
+    // buildIndoor
+    if (config.hasSensorPMS1 || config.hasSensorSPS30) {
+      buildPMS(root, measurements, ag, published, 1, false, true);
+      if (!localServer && config.hasSensorPMS1) {
+        root["firmware"] = pmsFirmware(ag.pms5003.getFirmwareVersion());
+      }
+    }
+    if (config.hasSensorSHT) {
+      if (utils::isValidTemperature(M::valueOf(avg, M::Temperature))) {
+        root["atmp"] = ag.round2(M::valueOf(avg, M::Temperature));
+        if (localServer) {
+          root["atmpCompensated"] =
+              ag.round2(measurements.getCorrectedTempHum(published, M::Temperature));
+        }
+      }
+      if (utils::isValidHumidity(M::valueOf(avg, M::Humidity))) {
+        root["rhum"] = ag.round2(M::valueOf(avg, M::Humidity));
+        if (localServer) {
+          root["rhumCompensated"] =
+              ag.round2(measurements.getCorrectedTempHum(published, M::Humidity));
+        }
+      }
+    }
+  } else if (fwMode == FW_MODE_O_1P || fwMode == FW_MODE_O_1PS || fwMode == FW_MODE_O_1PST) {
+    // buildOutdoor of one PMS
+    int ch = config.hasSensorPMS1 ? 1 : 2;
+    buildPMS(root, measurements, ag, published, ch, true, localServer);
+    if (!localServer) {
+      PMS5003T &sensor = ch == 1 ? ag.pms5003t_1 : ag.pms5003t_2;
+      root["firmware"] = pmsFirmware(sensor.getFirmwareVersion());
+    }
+  } else {
+    // buildOutdoor of every PMS
+    buildPMSAverage(root, measurements, ag, published, localServer);
+  }
+
+  for (int i = 0; i < M::_MEASUREMENT_TYPE_MAX; i++) {
+    const M::MeasurementDescriptor &desc = M::descriptor((M::MeasurementType)i);
+    if ((desc.group == M::GroupCO2 && config.hasSensorS8) ||
+        (desc.group == M::GroupVOC && config.hasSensorSGP)) {
+      float value = M::valueOf(avg, desc.type);
+      if (desc.isValid(value)) {
+        root[desc.jsonKey] = ag.round2(value);
+      }
+    }
+  }
+
+  root["boot"] = bootCount;
+  root["bootCount"] = bootCount;
+  root["wifi"] = rssi;
+
+  if (localServer) {
+    if (ag.isOne()) {
+      root["ledMode"] = config.getLedBarModeName();
+    }
+    root["serialno"] = ag.deviceId();
+    root["firmware"] = ag.getVersion();
+    root["model"] = AgFirmwareModeName(fwMode);
+  } else {
+    root["resetReason"] = resetReason;
+    root["freeHeap"] = ESP.getFreeHeap();
+    if (config.isWindowStatisticsEnabled()) {
+      buildStatistics(root, ag, published);
+    }
+  }
+  return root;
+}
+
+String JsonVarPayload::toString(Measurements &measurements, AirGradient &ag, Configuration &config,
+                                bool localServer, AgFirmwareMode fwMode, int rssi) {
+  return JSON.stringify(build(measurements, ag, config, localServer, fwMode, rssi));
+}
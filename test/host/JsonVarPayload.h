@@ -0,0 +1,23 @@
+/**
+ * Measurements payload built as a JSONVar tree, the way Measurements::toString built it before
+ * JsonWriter, see JsonVarPayload.cpp
+ */
+#ifndef _JSON_VAR_PAYLOAD_H_
+#define _JSON_VAR_PAYLOAD_H_
+
+#include "AgConfigure.h"
+#include "AgValue.h"
+#include "AirGradient.h"
+
+struct JsonVarPayload {
+  /** Values not readable from Measurements, as set on it */
+  int bootCount = 0;
+  int resetReason = 0;
+
+  JSONVar build(Measurements &measurements, AirGradient &ag, Configuration &config,
+                bool localServer, AgFirmwareMode fwMode, int rssi);
+  String toString(Measurements &measurements, AirGradient &ag, Configuration &config,
+                  bool localServer, AgFirmwareMode fwMode, int rssi);
+};
+
+#endif /** _JSON_VAR_PAYLOAD_H_ */
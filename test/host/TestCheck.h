@@ -0,0 +1,26 @@
+/**
+ * Assertions of the host tests, a failed check is reported and counted, main() returns
+ * testResult()
+ */
+#ifndef _TEST_CHECK_H_
+#define _TEST_CHECK_H_
+
+#include <cstdio>
+
+static int testFailures = 0;
+
+#define CHECK(condition)                                                                       \
+  do {                                                                                         \
+    if (!(condition)) {                                                                        \
+      if (testFailures++ < 20) {                                                               \
+        printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);                   \
+      }                                                                                        \
+    }                                                                                          \
+  } while (0)
+
+static int testResult(void) {
+  printf("%s, %d failures\n", testFailures ? "FAILED" : "PASSED", testFailures);
+  return testFailures ? 1 : 0;
+}
+
+#endif /** _TEST_CHECK_H_ */
@@ -0,0 +1,55 @@
+/**
+ * Time per call of the float and fixed point correction kernels. Not a test, run it by hand:
+ * on a host with FPU the float kernels are the fastest, the fixed point ones are meant for
+ * targets without FPU such as the ESP32-C3
+ */
+#include "FixedPointKernels.h"
+#include "PMS/PMS.h"
+#include "PMS/PMS5003TBase.h"
+#include <chrono>
+#include <cstdio>
+
+#define BENCH_INPUTS 1024
+#define BENCH_ROUNDS 2000
+
+static PMSBase pms;
+static PMS5003TBase pms5003t;
+static volatile float sink;
+
+static float inputs[BENCH_INPUTS];
+
+template <typename F> static double nanosecondsPerCall(F kernel) {
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    float sum = 0;
+    for (float input : inputs) {
+      sum += kernel(input);
+    }
+    sink = sum;
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / ((double)BENCH_ROUNDS * BENCH_INPUTS);
+}
+
+static void bench(const char *kernel, double floatNs, double fixedNs) {
+  printf("%-24s float %6.2f ns, fixed %6.2f ns\n", kernel, floatNs, fixedNs);
+}
+
+int main() {
+  // PM2.5 and temperature like inputs, every branch of the kernels taken
+  for (int i = 0; i < BENCH_INPUTS; i++) {
+    inputs[i] = (i * 37 % 3000) / 10.0f;
+  }
+
+  bench("compensate", nanosecondsPerCall([](float v) { return pms.compensate(v, 55); }),
+        nanosecondsPerCall([](float v) { return FixedPointKernels::compensate(v, 55); }));
+  bench("slrCorrectionBy003Count",
+        nanosecondsPerCall([](float v) { return pms.slrCorrectionBy003Count(v * 20, 0.02f, 1); }),
+        nanosecondsPerCall(
+            [](float v) { return FixedPointKernels::slrCorrectionBy003Count(v * 20, 0.02f, 1); }));
+  bench("compensateTemp", nanosecondsPerCall([](float v) { return pms5003t.compensateTemp(v); }),
+        nanosecondsPerCall([](float v) { return FixedPointKernels::compensateTemp(v); }));
+  bench("pm25ToAQI", nanosecondsPerCall([](float v) { return (float)pms.pm25ToAQI(v); }),
+        nanosecondsPerCall([](float v) { return (float)FixedPointKernels::pm25ToAQI(v); }));
+  return 0;
+}
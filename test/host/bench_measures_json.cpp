@@ -0,0 +1,83 @@
+/**
+ * Throughput and peak heap of the measurements JSON payload: JSONVar builders replaced by
+ * JsonWriter (see JsonVarPayload.cpp) against toString and toJson(char*, size). Not a test, run
+ * it by hand. cJSON is given counting hooks, it then grows its print buffer by malloc and copy
+ * instead of realloc
+ */
+#include "HeapCounter.h"
+#include "JsonVarPayload.h"
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+#define BENCH_PAYLOADS 20000
+
+static Configuration config(Serial);
+static Measurements measurements(config);
+static char buf[4096];
+
+/** Every measurement channel given a valid value, moving averages filled */
+static void fill(void) {
+  for (int round = 0; round < 10; round++) {
+    for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+      const Measurements::MeasurementDescriptor &desc =
+          Measurements::descriptor((Measurements::MeasurementType)i);
+      for (int ch = 1; ch <= desc.channels; ch++) {
+        if (desc.isFloat) {
+          measurements.update(desc.type, 20.5f + round * 0.37f + ch, ch);
+        } else {
+          measurements.update(desc.type, 100 + round * 7 + ch, ch);
+        }
+      }
+    }
+    measurements.fusePMS();
+  }
+  measurements.publish();
+}
+
+/** Run payload BENCH_PAYLOADS times, it returns the payload length */
+static void bench(const char *name, std::function<size_t(void)> payload) {
+  heap.reset();
+  size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_PAYLOADS; i++) {
+    bytes += payload();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  printf("  %-22s %6.1f MB/s, %4zu B payload, %6zu B peak heap, %3zu allocations/payload\n",
+         name, bytes / elapsed.count() / 1e6, bytes / BENCH_PAYLOADS, heap.peakAboveBase(),
+         heap.allocations / BENCH_PAYLOADS);
+}
+
+static void benchMonitor(AirGradient &ag, AgFirmwareMode fwMode, const char *monitor) {
+  measurements.setAirGradient(&ag);
+  config.setAirGradient(&ag);
+  fill();
+  JsonVarPayload reference;
+  for (bool localServer : {false, true}) {
+    printf("%s %s payload\n", monitor, localServer ? "local server" : "cloud");
+    bench("JSONVar", [&]() {
+      return reference.toString(measurements, ag, config, localServer, fwMode, -50).length();
+    });
+    bench("toString",
+          [&]() { return measurements.toString(localServer, fwMode, -50).length(); });
+    bench("toJson(char*, size)",
+          [&]() { return measurements.toJson(buf, sizeof(buf), localServer, fwMode, -50); });
+  }
+}
+
+int main() {
+  HeapCounter::countJson();
+  config.setConfigurationUpdatedCallback([]() {});
+
+  AirGradient indoor(ONE_INDOOR);
+  config.hasSensorPMS2 = false;
+  benchMonitor(indoor, FW_MODE_I_9PSL, "Indoor");
+
+  AirGradient outdoor(OPEN_AIR_OUTDOOR);
+  config.hasSensorS8 = false;
+  config.hasSensorSHT = false;
+  config.hasSensorPMS2 = true;
+  benchMonitor(outdoor, FW_MODE_O_1PPT, "Dual PMS outdoor");
+  return 0;
+}
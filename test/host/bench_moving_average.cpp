@@ -0,0 +1,103 @@
+/**
+ * Time per Measurements::update and heap used by the moving average windows, RingBuffer windows
+ * of the library against the std::vector push_back and erase windows they replaced. Not a test,
+ * run it by hand
+ */
+#include "AgConfigure.h"
+#include "AgValue.h"
+#include "HeapCounter.h"
+#include "Main/RingBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#define BENCH_UPDATES 200000
+#define BENCH_PERIOD MEASUREMENT_AVERAGE_MAX_PERIOD
+// Windows of a monitor, one per measurement and channel
+#define BENCH_WINDOWS 40
+
+/** Moving average window as Measurements kept it before the RingBuffer */
+struct VectorWindow {
+  std::vector<int> listValues;
+  int sumValues = 0;
+  float update(int val) {
+    listValues.push_back(val);
+    sumValues += val;
+    if (listValues.size() > BENCH_PERIOD) {
+      auto it = listValues.begin();
+      sumValues -= *it;
+      listValues.erase(it);
+    }
+    return sumValues / (float)listValues.size();
+  }
+};
+
+/** Moving average window of the library */
+struct RingWindow {
+  RingBuffer<int, BENCH_PERIOD> listValues;
+  int sumValues = 0;
+  float update(int val) {
+    if (listValues.full()) {
+      sumValues -= listValues.front();
+      listValues.pop();
+    }
+    listValues.push(val);
+    sumValues += val;
+    return sumValues / (float)listValues.size();
+  }
+};
+
+static volatile float sink;
+
+static void report(const char *name, std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  printf("%-28s %7.2f ns/update, %6zu allocations, %6zu B peak heap\n", name,
+         elapsed.count() / BENCH_UPDATES, heap.allocations, heap.peakAboveBase());
+}
+
+/** Windows updated in turn from empty, as after boot. Only the heap of their values counts */
+template <typename W> static void benchWindows(const char *name) {
+  static W windows[BENCH_WINDOWS];
+  heap.reset();
+  auto start = std::chrono::steady_clock::now();
+  float sum = 0;
+  for (int i = 0; i < BENCH_UPDATES; i++) {
+    sum += windows[i % BENCH_WINDOWS].update(i * 37 % 500);
+  }
+  sink = sum;
+  report(name, start);
+}
+
+/** Measurements::update of one measurement, int and float values, count based windows */
+static void benchMeasurements(Measurements &measurements) {
+  measurements.maxPeriod(Measurements::PM25, BENCH_PERIOD);
+  measurements.maxPeriod(Measurements::Temperature, BENCH_PERIOD);
+
+  heap.reset();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_UPDATES; i++) {
+    measurements.update(Measurements::PM25, i * 37 % 500);
+  }
+  report("Measurements::update int", start);
+
+  heap.reset();
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BENCH_UPDATES; i++) {
+    measurements.update(Measurements::Temperature, (i * 37 % 400) / 10.0f);
+  }
+  report("Measurements::update float", start);
+}
+
+int main() {
+  static AirGradient ag(ONE_INDOOR);
+  static Configuration config(Serial);
+  config.setAirGradient(&ag);
+  config.setConfigurationUpdatedCallback([]() {});
+  static Measurements measurements(config);
+  measurements.setAirGradient(&ag);
+
+  benchWindows<VectorWindow>("std::vector window");
+  benchWindows<RingWindow>("RingBuffer window");
+  benchMeasurements(measurements);
+  return 0;
+}
@@ -0,0 +1,266 @@
+/**
+ * Minimal Arduino core for the host tests, only what the library sources use
+ */
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define SERIAL_8N1 0
+#define F(x) x
+#define PROGMEM
+#define null nullptr
+
+class __FlashStringHelper;
+
+class String {
+public:
+  std::string s;
+
+  String() {}
+  String(const char *c) : s(c ? c : "") {}
+  String(const std::string &c) : s(c) {}
+  String(char c) : s(1, c) {}
+  String(int v, unsigned char base = 10) : s(format(base == 16 ? "%x" : "%d", v)) {}
+  String(unsigned int v, unsigned char base = 10) : s(format(base == 16 ? "%x" : "%u", v)) {}
+  String(long v, unsigned char base = 10) : s(format(base == 16 ? "%lx" : "%ld", v)) {}
+  String(unsigned long v, unsigned char base = 10) : s(format(base == 16 ? "%lx" : "%lu", v)) {}
+  String(float v, unsigned int decimals = 2) : s(format("%.*f", decimals, (double)v)) {}
+  String(double v, unsigned int decimals = 2) : s(format("%.*f", decimals, v)) {}
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  void clear() { s.clear(); }
+  bool reserve(unsigned int size) {
+    s.reserve(size);
+    return true;
+  }
+
+  String &operator+=(const String &o) {
+    s += o.s;
+    return *this;
+  }
+  String &operator+=(const char *o) {
+    s += o;
+    return *this;
+  }
+  String &operator+=(char o) {
+    s += o;
+    return *this;
+  }
+  String &operator+=(int o) {
+    s += std::to_string(o);
+    return *this;
+  }
+  bool concat(const String &o) {
+    s += o.s;
+    return true;
+  }
+  bool concat(const char *o, unsigned int n) {
+    s.append(o, n);
+    return true;
+  }
+  bool concat(char o) {
+    s += o;
+    return true;
+  }
+
+  bool operator==(const String &o) const { return s == o.s; }
+  bool operator==(const char *o) const { return s == o; }
+  bool operator!=(const String &o) const { return s != o.s; }
+  bool operator!=(const char *o) const { return s != o; }
+  bool operator<(const String &o) const { return s < o.s; }
+  bool equals(const String &o) const { return s == o.s; }
+  char operator[](unsigned int i) const { return s[i]; }
+  char &operator[](unsigned int i) { return s[i]; }
+  char charAt(unsigned int i) const { return s[i]; }
+
+  int toInt() const { return atoi(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+  int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+  int indexOf(const String &c, unsigned int from = 0) const { return position(s.find(c.s, from)); }
+  String substring(unsigned int from) const { return from < s.size() ? s.substr(from) : ""; }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < s.size() && from < to ? s.substr(from, to - from) : "";
+  }
+  bool startsWith(const String &p) const { return s.compare(0, p.s.size(), p.s) == 0; }
+  bool endsWith(const String &p) const {
+    return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0;
+  }
+  void replace(const String &from, const String &to) {
+    for (size_t pos = 0; !from.s.empty() && (pos = s.find(from.s, pos)) != std::string::npos;
+         pos += to.s.size()) {
+      s.replace(pos, from.s.size(), to.s);
+    }
+  }
+  void remove(unsigned int index) { s.erase(std::min<size_t>(index, s.size())); }
+  void remove(unsigned int index, unsigned int count) {
+    if (index < s.size()) {
+      s.erase(index, count);
+    }
+  }
+  void trim() {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    size_t end = s.find_last_not_of(" \t\r\n");
+    s = begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+  }
+  void toLowerCase() { std::transform(s.begin(), s.end(), s.begin(), ::tolower); }
+  void toUpperCase() { std::transform(s.begin(), s.end(), s.begin(), ::toupper); }
+  void toCharArray(char *buf, unsigned int size) const {
+    snprintf(buf, size, "%s", s.c_str());
+  }
+  void getBytes(unsigned char *buf, unsigned int size) const {
+    memcpy(buf, s.c_str(), std::min<size_t>(size, s.size() + 1));
+  }
+
+private:
+  static int position(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  static std::string format(const char *fmt, ...) {
+    char buf[64];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return buf;
+  }
+};
+
+inline String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+inline String operator+(const String &a, const char *b) { return String(a.s + b); }
+inline String operator+(const char *a, const String &b) { return String(a + b.s); }
+inline String operator+(const String &a, char b) { return String(a.s + b); }
+inline String operator+(const String &a, int b) { return a + String(b); }
+inline String operator+(const String &a, unsigned int b) { return a + String(b); }
+inline String operator+(const String &a, long b) { return a + String(b); }
+inline String operator+(const String &a, unsigned long b) { return a + String(b); }
+inline String operator+(const String &a, float b) { return a + String(b); }
+
+class Print;
+
+class Printable {
+public:
+  virtual ~Printable() {}
+  virtual size_t printTo(Print &p) const = 0;
+};
+
+/** Output is dropped, tests check values rather than logs */
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      write(buf[i]);
+    }
+    return size;
+  }
+  size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+  size_t write(const char *buf, size_t size) { return write((const uint8_t *)buf, size); }
+  size_t printf(const char *, ...) { return 0; }
+  size_t print(const String &) { return 0; }
+  size_t print(const char *) { return 0; }
+  size_t print(const Printable &) { return 0; }
+  size_t print(char) { return 0; }
+  size_t print(int, int = 10) { return 0; }
+  size_t print(unsigned int, int = 10) { return 0; }
+  size_t print(long, int = 10) { return 0; }
+  size_t print(unsigned long, int = 10) { return 0; }
+  size_t print(double, int = 2) { return 0; }
+  size_t println(const String &) { return 0; }
+  size_t println(const char *) { return 0; }
+  size_t println(const Printable &) { return 0; }
+  size_t println(char) { return 0; }
+  size_t println(int, int = 10) { return 0; }
+  size_t println(unsigned int, int = 10) { return 0; }
+  size_t println(long, int = 10) { return 0; }
+  size_t println(unsigned long, int = 10) { return 0; }
+  size_t println(double, int = 2) { return 0; }
+  size_t println() { return 0; }
+  virtual void flush() {}
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+  size_t write(uint8_t) override { return 1; }
+  using Print::write;
+  size_t readBytes(uint8_t *, size_t) { return 0; }
+  size_t readBytes(char *, size_t) { return 0; }
+  String readString() { return String(); }
+  void setTimeout(unsigned long) {}
+};
+
+class HardwareSerial : public Stream {
+public:
+  HardwareSerial(int = 0) {}
+  void begin(unsigned long, uint32_t = 0, int8_t = -1, int8_t = -1, bool = false) {}
+  void end() {}
+  operator bool() const { return true; }
+};
+extern HardwareSerial Serial, Serial0, Serial1;
+
+class EspClass {
+public:
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMaxAllocHeap() { return 0; }
+  void restart() {}
+  uint32_t getChipId() { return 0; }
+  uint64_t getEfuseMac() { return 0; }
+};
+extern EspClass ESP;
+
+/** Time of millis(), tests move it forward, see hostAdvanceMillis */
+extern unsigned long hostMillis;
+inline void hostAdvanceMillis(unsigned long ms) { hostMillis += ms; }
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+template <class T> T constrain(T x, T low, T high) { return x < low ? low : (x > high ? high : x); }
+using std::max;
+using std::min;
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO
+} esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason();
+
+#include "freertos/FreeRTOS.h"
+
+#endif /** _HOST_ARDUINO_H_ */
@@ -0,0 +1,163 @@
+/**
+ * In-memory flash of the host tests, with fault injection
+ *
+ * Files are byte vectors of hostFlash.files, tests read and damage them directly. Faults are
+ * counters of the operations to come, 0 is disabled: failOpen and failRead make the n-th open or
+ * read fail, failWrite makes the n-th write persist only the first half of its bytes. Power loss
+ * is a budget of bytes written, the write crossing it is cut and every write after fails until
+ * powerOn(), like a reset in the middle of a flash program.
+ */
+#ifndef _HOST_FS_H_
+#define _HOST_FS_H_
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+struct HostFlash {
+  std::map<std::string, std::vector<uint8_t>> files;
+  int failOpen = 0;
+  int failRead = 0;
+  int failWrite = 0;
+  long powerBudget = -1; // Bytes written before power is lost, -1 unlimited
+  bool powerLost = false;
+  unsigned long writes = 0; // Write calls, to size the power loss budget
+
+  void clear(void) {
+    files.clear();
+    failOpen = failRead = failWrite = 0;
+    powerOn();
+  }
+  void powerOffAfter(long bytes) {
+    powerBudget = bytes;
+    powerLost = false;
+  }
+  void powerOn(void) {
+    powerBudget = -1;
+    powerLost = false;
+  }
+  size_t usedBytes(void) const {
+    size_t used = 0;
+    for (auto &file : files) {
+      used += file.second.size();
+    }
+    return used;
+  }
+
+  /** True once when the counter reaches 0 */
+  static bool due(int &counter) { return counter > 0 && --counter == 0; }
+};
+extern HostFlash hostFlash;
+
+class File : public Stream {
+public:
+  File() {}
+  File(const std::string &path, size_t pos) : _path(path), _pos(pos), _open(true) {}
+
+  operator bool() const { return _open; }
+  bool isDirectory(void) { return false; }
+  void close(void) { _open = false; }
+  size_t size(void) { return data().size(); }
+  size_t position(void) { return _pos; }
+  bool seek(uint32_t pos) {
+    if (!_open || pos > data().size()) {
+      return false;
+    }
+    _pos = pos;
+    return true;
+  }
+
+  int available(void) override { return _open && _pos < data().size() ? data().size() - _pos : 0; }
+  int read(void) override {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+  int peek(void) override { return available() ? data()[_pos] : -1; }
+  size_t read(uint8_t *buf, size_t size) {
+    if (!_open || HostFlash::due(hostFlash.failRead)) {
+      return 0;
+    }
+    size_t n = std::min(size, (size_t)available());
+    memcpy(buf, data().data() + _pos, n);
+    _pos += n;
+    return n;
+  }
+  size_t readBytes(char *buf, size_t size) { return read((uint8_t *)buf, size); }
+  size_t readBytes(uint8_t *buf, size_t size) { return read(buf, size); }
+
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t *buf, size_t size) override {
+    if (!_open || hostFlash.powerLost) {
+      return 0;
+    }
+    hostFlash.writes++;
+    size_t n = size;
+    if (HostFlash::due(hostFlash.failWrite)) {
+      n = size / 2;
+    }
+    if (hostFlash.powerBudget >= 0) {
+      if ((long)n >= hostFlash.powerBudget) {
+        n = hostFlash.powerBudget;
+        hostFlash.powerLost = true;
+      }
+      hostFlash.powerBudget -= n;
+    }
+    std::vector<uint8_t> &file = data();
+    if (file.size() < _pos + n) {
+      file.resize(_pos + n);
+    }
+    memcpy(file.data() + _pos, buf, n);
+    _pos += n;
+    return n;
+  }
+  using Print::write;
+
+private:
+  std::string _path;
+  size_t _pos = 0;
+  bool _open = false;
+
+  std::vector<uint8_t> &data(void) { return hostFlash.files[_path]; }
+};
+
+class FS {
+public:
+  File open(const char *path, const char *mode = "r", bool create = false) {
+    if (HostFlash::due(hostFlash.failOpen)) {
+      return File();
+    }
+    std::string m = mode;
+    if (m == "r") {
+      return hostFlash.files.count(path) ? File(path, 0) : File();
+    }
+    if (hostFlash.powerLost) {
+      return File();
+    }
+    if (m == "w") {
+      hostFlash.files[path].clear();
+      return File(path, 0);
+    }
+    if (m == "a") {
+      return File(path, hostFlash.files[path].size());
+    }
+    return File();
+  }
+  File open(const String &path, const char *mode = "r", bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char *path) { return hostFlash.files.count(path) > 0; }
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path) { return !hostFlash.powerLost && hostFlash.files.erase(path) > 0; }
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to) {
+    if (hostFlash.powerLost || !hostFlash.files.count(from)) {
+      return false;
+    }
+    hostFlash.files[to] = hostFlash.files[from];
+    hostFlash.files.erase(from);
+    return true;
+  }
+};
+
+#endif /** _HOST_FS_H_ */
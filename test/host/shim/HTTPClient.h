@@ -0,0 +1,118 @@
+/**
+ * HTTPClient talking to an in-memory AirGradient server
+ *
+ * hostHttp answers the configuration GET with configBody, and 304 without a body when the
+ * request has If-None-Match equal to configEtag. POST bodies are kept in posts and answered with
+ * code. Tests read the counters to see what went over the network: connections opened (a TLS
+ * handshake on https), requests, and body bytes sent by the server. A connection stays open
+ * between requests if both sides keep it alive, closeIdle makes the server drop it silently like
+ * an idle timeout, the next request on it then fails.
+ */
+#ifndef _HOST_HTTP_CLIENT_H_
+#define _HOST_HTTP_CLIENT_H_
+
+#include "WiFiClient.h"
+#include <map>
+#include <vector>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+
+struct HostHttpServer {
+  int code = 200;           // Code of every answer, negative fails the request like no server
+  String configBody = "{}"; // Configuration of the device on the dashboard
+  String configEtag;        // ETag of configBody, empty if the server sends none
+  bool keepAlive = true;    // Connection left open after an answer
+  bool closeIdle = false;   // Open connection is dropped before the next request
+  std::vector<String> posts;
+
+  unsigned long connections = 0;
+  unsigned long requests = 0;
+  unsigned long notModified = 0;
+  unsigned long bodyBytes = 0;
+
+  void clear(void) { *this = HostHttpServer(); }
+};
+extern HostHttpServer hostHttp;
+
+class HTTPClient {
+public:
+  bool begin(WiFiClient &client, const String &uri) {
+    _ownsClient = false;
+    _client = &client;
+    _uri = uri;
+    _requestHeaders.clear();
+    _responseHeaders.clear();
+    _body = String();
+    return true;
+  }
+  /** https with a CA certificate: connection owned by HTTPClient, closed by end() */
+  bool begin(const String &uri, const char *) {
+    begin(_tlsClient, uri);
+    _ownsClient = true;
+    return true;
+  }
+  void end(void) {
+    if (_client && (_ownsClient || !(_reuse && hostHttp.keepAlive))) {
+      _client->stop();
+    }
+  }
+  void setReuse(bool reuse) { _reuse = reuse; }
+  void setTimeout(uint16_t) {}
+  void setConnectTimeout(int32_t) {}
+  void addHeader(const String &name, const String &value, bool = false, bool = true) {
+    _requestHeaders[name.s] = value;
+  }
+  void collectHeaders(const char *[], const size_t) {}
+  String header(const char *name) { return _responseHeaders[name]; }
+
+  int GET(void) { return request(false, String()); }
+  int POST(const String &body) { return request(true, body); }
+  String getString(void) { return _body; }
+
+private:
+  WiFiClient *_client = nullptr;
+  WiFiClient _tlsClient;
+  bool _ownsClient = false;
+  String _uri;
+  bool _reuse = false;
+  std::map<std::string, String> _requestHeaders;
+  std::map<std::string, String> _responseHeaders;
+  String _body;
+
+  int request(bool post, const String &body) {
+    if (_client->connected() && hostHttp.closeIdle) {
+      hostHttp.closeIdle = false;
+      _client->stop();
+      return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    if (hostHttp.code < 0) {
+      _client->stop();
+      return hostHttp.code;
+    }
+    if (!_client->connected()) {
+      _client->open = true;
+      hostHttp.connections++;
+    }
+    hostHttp.requests++;
+    if (post) {
+      hostHttp.posts.push_back(body);
+      return hostHttp.code;
+    }
+    if (hostHttp.code != 200) {
+      return hostHttp.code;
+    }
+    if (hostHttp.configEtag.length() > 0) {
+      _responseHeaders["ETag"] = hostHttp.configEtag;
+      if (_requestHeaders["If-None-Match"] == hostHttp.configEtag) {
+        hostHttp.notModified++;
+        return 304;
+      }
+    }
+    _body = hostHttp.configBody;
+    hostHttp.bodyBytes += _body.length();
+    return 200;
+  }
+};
+
+#endif /** _HOST_HTTP_CLIENT_H_ */
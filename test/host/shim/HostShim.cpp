@@ -0,0 +1,69 @@
+/**
+ * Definitions of the host shims: serial ports, time, flash, HTTP server and FreeRTOS on
+ * std::thread
+ */
+#include "Arduino.h"
+#include "HTTPClient.h"
+#include "SPIFFS.h"
+#include "WiFi.h"
+#include "Wire.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+HardwareSerial Serial, Serial0, Serial1;
+EspClass ESP;
+TwoWire Wire;
+WiFiClass WiFi;
+HostFlash hostFlash;
+HostHttpServer hostHttp;
+SPIFFSFS SPIFFS;
+unsigned long hostMillis = 0;
+
+unsigned long millis() { return hostMillis; }
+unsigned long micros() { return hostMillis * 1000; }
+void delay(unsigned long ms) { hostMillis += ms; }
+void delayMicroseconds(unsigned int) {}
+void yield() { std::this_thread::yield(); }
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return LOW; }
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+
+static BaseType_t take(SemaphoreHandle_t mutex, TickType_t ticks) {
+  std::recursive_timed_mutex *m = (std::recursive_timed_mutex *)mutex;
+  if (ticks == portMAX_DELAY) {
+    m->lock();
+    return pdTRUE;
+  }
+  return m->try_lock_for(std::chrono::milliseconds(ticks)) ? pdTRUE : pdFALSE;
+}
+
+static BaseType_t give(SemaphoreHandle_t mutex) {
+  ((std::recursive_timed_mutex *)mutex)->unlock();
+  return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new std::recursive_timed_mutex(); }
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return new std::recursive_timed_mutex(); }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) { return take(mutex, ticks); }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) { return give(mutex); }
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks) {
+  return take(mutex, ticks);
+}
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) { return give(mutex); }
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *, uint32_t, void *arg, int,
+                       TaskHandle_t *handle) {
+  std::thread(task, arg).detach();
+  if (handle) {
+    *handle = NULL;
+  }
+  return pdPASS;
+}
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+void vTaskDelete(TaskHandle_t) {}
+int64_t esp_timer_get_time() { return (int64_t)hostMillis * 1000; }
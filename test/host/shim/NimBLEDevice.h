@@ -0,0 +1,31 @@
+#ifndef _HOST_NIMBLE_DEVICE_H_
+#define _HOST_NIMBLE_DEVICE_H_
+
+class NimBLEScan {};
+class NimBLEScanResults {};
+class NimBLEAdvertisedDevice {};
+class NimBLEServer {};
+class NimBLEService {};
+class NimBLECharacteristic {};
+class NimBLEConnInfo {};
+
+class NimBLEScanCallbacks {
+public:
+  virtual ~NimBLEScanCallbacks() {}
+  virtual void onResult(const NimBLEAdvertisedDevice *) {}
+};
+
+class NimBLECharacteristicCallbacks {
+public:
+  virtual ~NimBLECharacteristicCallbacks() {}
+  virtual void onWrite(NimBLECharacteristic *, NimBLEConnInfo &) {}
+};
+
+class NimBLEServerCallbacks {
+public:
+  virtual ~NimBLEServerCallbacks() {}
+  virtual void onConnect(NimBLEServer *, NimBLEConnInfo &) {}
+  virtual void onDisconnect(NimBLEServer *, NimBLEConnInfo &, int) {}
+};
+
+#endif /** _HOST_NIMBLE_DEVICE_H_ */
@@ -0,0 +1,18 @@
+#ifndef _HOST_SPIFFS_H_
+#define _HOST_SPIFFS_H_
+
+#include "FS.h"
+
+class SPIFFSFS : public FS {
+public:
+  bool begin(bool formatOnFail = false) { return true; }
+  bool format(void) {
+    hostFlash.files.clear();
+    return true;
+  }
+  size_t totalBytes(void) { return 0x60000; }
+  size_t usedBytes(void) { return hostFlash.usedBytes(); }
+};
+extern SPIFFSFS SPIFFS;
+
+#endif /** _HOST_SPIFFS_H_ */
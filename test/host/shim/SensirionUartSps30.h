@@ -0,0 +1,6 @@
+#ifndef _HOST_SENSIRION_UART_SPS30_H_
+#define _HOST_SENSIRION_UART_SPS30_H_
+
+class SensirionUartSps30 {};
+
+#endif /** _HOST_SENSIRION_UART_SPS30_H_ */
@@ -0,0 +1,14 @@
+/**
+ * Sensor and display drivers that need their vendor libraries, the host tests only construct them
+ */
+#include "AgSatellites.h"
+#include "AirGradient.h"
+
+Display::Display(BoardType) {}
+LedBar::LedBar(BoardType) {}
+S8::S8(BoardType) {}
+SPS30::SPS30(BoardType) {}
+Sgp41::Sgp41(BoardType) {}
+AgSatellites::Satellite *AgSatellites::getSatellites() { return nullptr; }
+Sht::Sht(BoardType) {}
+Sht::~Sht() {}
@@ -0,0 +1,12 @@
+#ifndef _HOST_SOFTWARE_SERIAL_H_
+#define _HOST_SOFTWARE_SERIAL_H_
+
+#include <Arduino.h>
+
+class SoftwareSerial : public Stream {
+public:
+  SoftwareSerial(int, int) {}
+  void begin(unsigned long) {}
+};
+
+#endif /** _HOST_SOFTWARE_SERIAL_H_ */
@@ -0,0 +1,12 @@
+#ifndef _HOST_WIFI_H_
+#define _HOST_WIFI_H_
+
+#include <Arduino.h>
+
+class WiFiClass {
+public:
+  String macAddress() { return "84:fc:e6:01:23:45"; }
+};
+extern WiFiClass WiFi;
+
+#endif /** _HOST_WIFI_H_ */
@@ -0,0 +1,16 @@
+#ifndef _HOST_WIFI_CLIENT_H_
+#define _HOST_WIFI_CLIENT_H_
+
+#include <Arduino.h>
+
+/** Connection to the HTTP server of HTTPClient.h, opened by HTTPClient on a request */
+class WiFiClient : public Stream {
+public:
+  bool open = false;
+
+  virtual ~WiFiClient() {}
+  bool connected(void) { return open; }
+  void stop(void) { open = false; }
+};
+
+#endif /** _HOST_WIFI_CLIENT_H_ */
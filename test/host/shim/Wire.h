@@ -0,0 +1,16 @@
+#ifndef _HOST_WIRE_H_
+#define _HOST_WIRE_H_
+
+#include <Arduino.h>
+
+class TwoWire : public Stream {
+public:
+  void begin(int = 0, int = 0, uint32_t = 0) {}
+  void beginTransmission(uint8_t) {}
+  uint8_t endTransmission(bool = true) { return 0; }
+  uint8_t requestFrom(uint8_t, uint8_t, uint8_t = 1) { return 0; }
+  void setClock(uint32_t) {}
+};
+extern TwoWire Wire;
+
+#endif /** _HOST_WIRE_H_ */
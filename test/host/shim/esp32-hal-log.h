@@ -0,0 +1,9 @@
+#ifndef _HOST_ESP32_HAL_LOG_H_
+#define _HOST_ESP32_HAL_LOG_H_
+
+#define log_d(...)
+#define log_i(...)
+#define log_w(...)
+#define log_e(...)
+
+#endif /** _HOST_ESP32_HAL_LOG_H_ */
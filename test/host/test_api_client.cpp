@@ -0,0 +1,195 @@
+/**
+ * AgApiClient against the in-memory server of HTTPClient.h: configuration fetched again only
+ * when it changed on the dashboard, an unchanged body not parsed again, and requests sent on the
+ * connection left open by the previous one
+ */
+#include "AgApiClient.h"
+#include "TestCheck.h"
+#include <chrono>
+
+/** Configuration of an indoor monitor as sent by the dashboard */
+static const char *const DASHBOARD_CONFIG =
+    "{\"country\":\"DE\",\"pmStandard\":\"ugm3\",\"ledBarMode\":\"co2\",\"abcDays\":9,"
+    "\"tvocLearningOffset\":12,\"noxLearningOffset\":12,\"mqttBrokerUrl\":\"\","
+    "\"temperatureUnit\":\"c\",\"configurationControl\":\"both\",\"postDataToAirGradient\":true,"
+    "\"ledBarBrightness\":100,\"displayBrightness\":100,\"offlineMode\":false,"
+    "\"monitorDisplayCompensatedValues\":false,\"model\":\"I-9PSL\","
+    "\"corrections\":{\"pm02\":{\"correctionAlgorithm\":\"none\",\"slr\":{}}},"
+    "\"co2CalibrationRequested\":true,\"ledBarTestRequested\":true}";
+
+static AirGradient ag(ONE_INDOOR);
+static Configuration config(Serial);
+static AgApiClient api(Serial, config);
+
+/** Mean time of a fetch in microseconds, the server answering the same each time */
+static double fetchTime(int fetches) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < fetches; i++) {
+    CHECK(api.fetchServerConfiguration());
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / fetches;
+}
+
+/** Server sending an ETag: configuration body only sent when it changed */
+static void conditionalFetch(void) {
+  hostHttp.configBody = DASHBOARD_CONFIG;
+  hostHttp.configEtag = "\"1\"";
+  CHECK(api.fetchServerConfiguration());
+  CHECK(config.getCountry() == "DE");
+  CHECK(config.getCO2CalibrationAbcDays() == 9);
+  CHECK(config.isCo2CalibrationRequested());
+  CHECK(config.isLedBarTestRequested());
+  unsigned long bodyBytes = hostHttp.bodyBytes;
+  CHECK(bodyBytes == hostHttp.configBody.length());
+
+  // Unchanged: 304 without body, nothing applied again
+  double notModifiedTime = fetchTime(100);
+  CHECK(hostHttp.notModified == 100);
+  CHECK(hostHttp.bodyBytes == bodyBytes);
+  CHECK(!config.isCo2CalibrationRequested());
+  // https: HTTPClient opens a TLS connection for every request
+  CHECK(hostHttp.connections == hostHttp.requests);
+
+  // Changed on the dashboard
+  hostHttp.configBody.replace("\"abcDays\":9", "\"abcDays\":8");
+  hostHttp.configEtag = "\"2\"";
+  CHECK(api.fetchServerConfiguration());
+  CHECK(config.getCO2CalibrationAbcDays() == 8);
+  CHECK(hostHttp.notModified == 100);
+
+  // Local change: configuration isn't the one of the server anymore, full body applied again
+  CHECK(config.parse("{\"abcDays\":3}", true));
+  CHECK(api.fetchServerConfiguration());
+  CHECK(config.getCO2CalibrationAbcDays() == 8);
+  bodyBytes = hostHttp.bodyBytes;
+  config.setOfflineMode(false);
+  CHECK(api.fetchServerConfiguration());
+  CHECK(hostHttp.bodyBytes == bodyBytes + hostHttp.configBody.length());
+  CHECK(hostHttp.notModified == 100);
+  CHECK(api.fetchServerConfiguration());
+  CHECK(hostHttp.notModified == 101);
+
+  // Invalid body is not remembered, its ETag neither
+  String valid = hostHttp.configBody;
+  hostHttp.configBody = "{\"ledBarMode\":\"x\"}";
+  hostHttp.configEtag = "\"3\"";
+  CHECK(!api.fetchServerConfiguration());
+  CHECK(!api.fetchServerConfiguration());
+  CHECK(hostHttp.notModified == 101);
+  hostHttp.configBody = valid;
+  CHECK(api.fetchServerConfiguration());
+  CHECK(config.getCO2CalibrationAbcDays() == 8);
+  CHECK(api.fetchServerConfiguration());
+  CHECK(hostHttp.notModified == 102);
+
+  // Full body of every fetch, validators dropped by a local change each time
+  bodyBytes = hostHttp.bodyBytes;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 100; i++) {
+    config.setOfflineMode(false);
+    CHECK(api.fetchServerConfiguration());
+  }
+  auto end = std::chrono::steady_clock::now();
+  double fullTime = std::chrono::duration<double, std::micro>(end - start).count() / 100;
+  printf("fetch: %.1f us and %lu body bytes if changed, %.1f us and 0 bytes if not modified\n",
+         fullTime, (hostHttp.bodyBytes - bodyBytes) / 100, notModifiedTime);
+}
+
+/** Server without ETag: same body every fetch, acknowledged without parsing it */
+static void unchangedBody(void) {
+  hostHttp.configBody = DASHBOARD_CONFIG;
+  hostHttp.configEtag = "";
+  CHECK(api.fetchServerConfiguration());
+  CHECK(config.isCo2CalibrationRequested());
+  CHECK(config.isLedBarTestRequested());
+  double sameTime = fetchTime(100);
+  CHECK(!config.isCo2CalibrationRequested());
+  CHECK(!config.isLedBarTestRequested());
+  CHECK(hostHttp.notModified == 0);
+
+  // Body alternating between two configurations, each parsed
+  String other = hostHttp.configBody;
+  other.replace("\"abcDays\":9", "\"abcDays\":7");
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < 100; i++) {
+    hostHttp.configBody = i % 2 ? String(DASHBOARD_CONFIG) : other;
+    CHECK(api.fetchServerConfiguration());
+    CHECK(config.getCO2CalibrationAbcDays() == (i % 2 ? 9 : 7));
+  }
+  auto end = std::chrono::steady_clock::now();
+  double parseTime = std::chrono::duration<double, std::micro>(end - start).count() / 100;
+  printf("fetch without ETag: %.1f us if changed, %.1f us if unchanged\n", parseTime, sameTime);
+
+  // Another API root forgets the validators of the previous one
+  hostHttp.configEtag = "\"4\"";
+  CHECK(api.fetchServerConfiguration());
+  api.setApiRoot("http://localhost");
+  unsigned long notModified = hostHttp.notModified;
+  CHECK(api.fetchServerConfiguration());
+  CHECK(hostHttp.notModified == notModified);
+}
+
+/**
+ * Posts and fetches share the connection left open by the previous tests, a new one is opened
+ * only when it was closed
+ */
+static void connectionReuse(void) {
+  uint32_t connections = api.getConnections();
+  uint32_t reuses = api.getConnectionReuses();
+  for (int i = 0; i < 60; i++) {
+    CHECK(api.postToServer("{}"));
+    if (i % 10 == 0) {
+      CHECK(api.fetchServerConfiguration());
+    }
+  }
+  CHECK(hostHttp.connections == 0);
+  CHECK(api.getConnections() == connections);
+  CHECK(api.getConnectionReuses() == reuses + 66);
+  CHECK(hostHttp.posts.size() == 60);
+
+  // Server dropped the idle connection: request sent again on a new one
+  hostHttp.closeIdle = true;
+  CHECK(api.postToServer("{}"));
+  CHECK(hostHttp.connections == 1);
+  CHECK(hostHttp.posts.size() == 61);
+
+  // Error answer closes the connection, response might not be fully read
+  hostHttp.code = 500;
+  CHECK(!api.postToServer("{}"));
+  CHECK(api.isPostToServerFailed());
+  hostHttp.code = 200;
+  CHECK(api.postToServer("{}"));
+  CHECK(hostHttp.connections == 2);
+
+  // No server on a new connection: not sent again
+  hostHttp.code = HTTPC_ERROR_CONNECTION_REFUSED;
+  unsigned long requests = hostHttp.requests;
+  CHECK(!api.postToServer("{}"));
+  CHECK(hostHttp.requests == requests);
+  hostHttp.code = 200;
+
+  // Server closing every connection after its answer
+  hostHttp.keepAlive = false;
+  connections = api.getConnections();
+  for (int i = 0; i < 5; i++) {
+    CHECK(api.postToServer("{}"));
+  }
+  CHECK(api.getConnections() == connections + 5);
+  printf("connections: %u opened, %u reused\n", api.getConnections(), api.getConnectionReuses());
+}
+
+int main() {
+  config.setAirGradient(&ag);
+  config.setConfigurationUpdatedCallback([]() {});
+  config.begin();
+  api.setAirGradient(&ag);
+  api.begin();
+
+  conditionalFetch();
+  hostHttp.clear();
+  unchangedBody();
+  hostHttp.clear();
+  connectionReuse();
+  return testResult();
+}
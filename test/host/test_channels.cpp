@@ -0,0 +1,167 @@
+/**
+ * Channel count: built once per MEASUREMENT_CHANNELS (1, 2 and 4), every channel keeps its own
+ * moving average and payload fields, and PMS fusion of 1 to 4 channels, PMSFusion<1> included
+ * where there is no pair of channels to compare
+ */
+#include "AgConfigure.h"
+#include "AgValue.h"
+#include "Main/PMSFusion.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <random>
+#include <string>
+
+static std::mt19937 rng(15);
+
+static float noise(int spread) { return (int)(rng() % (spread + 1)); }
+
+/** Single channel passes through: always healthy, full confidence, combined is the value */
+static void fusionSingleChannel(void) {
+  PMSFusion<1> fusion;
+  float values[1];
+  bool valid[1] = {true};
+  for (int s = 0; s < 1000; s++) {
+    values[0] = s % 100 == 0 ? 7 : 10 + noise(50);
+    valid[0] = s % 13 != 0;
+    fusion.update(values, valid);
+    const PMSFusion<1>::Status &status = fusion.status();
+    CHECK(status.health[0] == PMSFusionHealth::HealthOk);
+    CHECK(status.weight[0] == 1);
+    CHECK(status.divergence == 0);
+    CHECK(status.confidence == (valid[0] ? 1 : 0));
+    CHECK(status.combine(values, valid) == values[0]);
+  }
+}
+
+/**
+ * One of four channels reading low, stuck or noisy: it becomes faulty and is left out of the
+ * combined value, every other channel stays healthy
+ */
+static void fusionFourChannels(int fault) {
+  PMSFusion<4> fusion;
+  int faultySamples = 0;
+  int wrongHealth = 0;
+  for (int s = 0; s < 4000; s++) {
+    float base = 30 + 20 * sinf(s / 50.0f);
+    float values[4];
+    bool valid[4];
+    for (int c = 0; c < 4; c++) {
+      values[c] = (int)(base + noise(2));
+      valid[c] = c != 1 || s % 7 != 0;
+    }
+    if (s > 500) {
+      if (fault == 0) {
+        values[2] = (int)(values[2] * 0.2f);
+      } else if (fault == 1) {
+        values[2] = 80;
+      } else {
+        values[2] = (int)(base + noise(120));
+      }
+    }
+    fusion.update(values, valid);
+    if (s <= 1500) {
+      continue;
+    }
+
+    const PMSFusion<4>::Status &status = fusion.status();
+    if (status.health[2] == PMSFusionHealth::HealthFaulty) {
+      faultySamples++;
+      float expected = (values[0] + values[3] + (valid[1] ? values[1] : 0)) / (valid[1] ? 3 : 2);
+      CHECK(fabsf(status.combine(values, valid) - expected) < 0.01f);
+    }
+    for (int c = 0; c < 4; c++) {
+      if (c != 2 && status.health[c] != PMSFusionHealth::HealthOk) {
+        wrongHealth++;
+      }
+    }
+  }
+  printf("PMSFusion<4> fault %d: faulty %d of 2499 samples, %d wrong health\n", fault,
+         faultySamples, wrongHealth);
+  CHECK(faultySamples > 2000);
+  CHECK(wrongHealth == 0);
+}
+
+static Configuration config(Serial);
+static Measurements measurements(config);
+static AirGradient ag(OPEN_AIR_OUTDOOR);
+
+/** Every channel of the Measurements keeps its own average and payload fields */
+static void measurementChannels(void) {
+  config.setAirGradient(&ag);
+  config.setConfigurationUpdatedCallback([]() {});
+  measurements.setAirGradient(&ag);
+  config.hasSensorPMS1 = true;
+  config.hasSensorPMS2 = MEASUREMENT_CHANNELS > 1;
+  measurements.maxPeriod(Measurements::PM25, 10);
+  measurements.maxPeriod(Measurements::PM03_PC, 10);
+  measurements.maxPeriod(Measurements::Temperature, 10);
+  measurements.maxPeriod(Measurements::CO2, 10);
+
+  for (int s = 0; s < 10; s++) {
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      measurements.update(Measurements::PM25, 10 * ch + s % 2, ch);
+      measurements.update(Measurements::PM03_PC, 1000 * ch, ch);
+      measurements.update(Measurements::Temperature, 20.0f + ch, ch);
+    }
+    measurements.update(Measurements::CO2, 400 + s);
+    measurements.fusePMS();
+    measurements.publish();
+  }
+
+  Measurements::Measures mc = measurements.getMeasures();
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    CHECK(measurements.getAverage(Measurements::PM25, ch) == 10 * ch + 0.5f);
+    CHECK(mc.pm_25[ch - 1] == 10 * ch + 0.5f);
+    CHECK(mc.pm_03_pc[ch - 1] == 1000 * ch);
+    CHECK(mc.temperature[ch - 1] == 20.0f + ch);
+  }
+  // Single channel measurement ignores the channel
+  CHECK(mc.co2 == 404.5f);
+  CHECK(measurements.getAverage(Measurements::CO2, MEASUREMENT_CHANNELS) == 404.5f);
+
+  // Binary payload of every channel decodes to the CSV payload
+  char csv[512];
+  size_t length = Measurements::encodeMeasuresPayload(180, &mc, 1, true, csv, sizeof(csv));
+  uint8_t binary[256];
+  size_t binaryLength =
+      Measurements::encodeMeasuresBinaryPayload(180, &mc, 1, true, binary, sizeof(binary));
+  char decoded[512];
+  CHECK(Measurements::decodeMeasuresBinaryPayload(binary, binaryLength, decoded,
+                                                  sizeof(decoded)) == length);
+  CHECK(std::string(csv) == decoded);
+
+  // Last channel stuck away from the others, faulty with more than one channel and left out of
+  // the measures
+  for (int s = 0; s < 3000; s++) {
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      int value = ch == MEASUREMENT_CHANNELS && s > 100 ? 80 : 20 + s % 7;
+      measurements.update(Measurements::PM25, value, ch);
+    }
+    measurements.fusePMS();
+    measurements.publish();
+  }
+  Measurements::Snapshot snapshot;
+  measurements.snapshot(snapshot);
+  mc = measurements.getMeasures();
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    PMSFusionHealth::Health health = snapshot.pmsFusion.health[ch - 1];
+    printf("channel %d: %s\n", ch, Measurements::Fusion::healthName(health));
+    if (ch == MEASUREMENT_CHANNELS && MEASUREMENT_CHANNELS > 1) {
+      CHECK(health == PMSFusionHealth::HealthFaulty);
+      CHECK(mc.pm_25[ch - 1] == utils::getInvalidPmValue());
+    } else {
+      CHECK(health == PMSFusionHealth::HealthOk);
+      CHECK(utils::isValidPm(mc.pm_25[ch - 1]));
+    }
+  }
+}
+
+int main() {
+  printf("MEASUREMENT_CHANNELS %d\n", MEASUREMENT_CHANNELS);
+  fusionSingleChannel();
+  for (int fault = 0; fault < 3; fault++) {
+    fusionFourChannels(fault);
+  }
+  measurementChannels();
+  return testResult();
+}
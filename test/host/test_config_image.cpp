@@ -0,0 +1,230 @@
+/**
+ * Configuration images: a save cut by a power loss, half written or damaged afterwards never
+ * loads garbage, the previous image is loaded instead. Images are loaded from their values, JSON
+ * is parsed once the configuration is changed or exported. Images of another format, or of
+ * another Values layout, are loaded from their JSON and saved again
+ */
+#include "AgConfigure.h"
+#include "AgValue.h"
+#include "FS.h"
+#include "Main/utils.h"
+#include "TestCheck.h"
+#include <random>
+#include <string>
+
+#define IMAGE_A "/AgConfigure_Config_A.bin"
+#define IMAGE_B "/AgConfigure_Config_B.bin"
+#define LEGACY_JSON "/AgConfigure_Configuration.json"
+// ConfigImageHeader offsets
+#define HEADER_FORMAT 4
+#define HEADER_SEQUENCE 8
+#define HEADER_CRC 16
+#define HEADER_SIZE 20
+
+extern JSONVar jconfig;
+
+static std::mt19937 rng(19);
+static AirGradient ag(ONE_INDOOR);
+
+/** Device boot: configuration loaded from flash */
+struct Boot {
+  Configuration config;
+  Boot() : config(Serial) {
+    // Globals start over on a new boot
+    jconfig = JSONVar();
+    config.setAirGradient(&ag);
+    config.setConfigurationUpdatedCallback([]() {});
+    config.begin();
+  }
+};
+
+/** Image with the highest sequence number */
+static const char *newestImage(void) {
+  const char *newest = nullptr;
+  uint32_t newestSequence = 0;
+  for (const char *name : {IMAGE_A, IMAGE_B}) {
+    if (hostFlash.files.count(name) && hostFlash.files[name].size() >= HEADER_SIZE) {
+      uint32_t sequence;
+      memcpy(&sequence, &hostFlash.files[name][HEADER_SEQUENCE], sizeof(sequence));
+      if (newest == nullptr || (int32_t)(sequence - newestSequence) > 0) {
+        newest = name;
+        newestSequence = sequence;
+      }
+    }
+  }
+  return newest;
+}
+
+static uint16_t formatOf(const char *name) {
+  uint16_t format;
+  memcpy(&format, &hostFlash.files[name][HEADER_FORMAT], sizeof(format));
+  return format;
+}
+
+/** Rewrite the format of an image and its CRC, as saved by another firmware */
+static void setFormat(const char *name, uint16_t format) {
+  std::vector<uint8_t> &image = hostFlash.files[name];
+  memcpy(&image[HEADER_FORMAT], &format, sizeof(format));
+  uint32_t crc = utils::crc32(image.data(), HEADER_CRC);
+  crc = utils::crc32(image.data() + HEADER_SIZE, image.size() - HEADER_SIZE, crc);
+  memcpy(&image[HEADER_CRC], &crc, sizeof(crc));
+}
+
+static void freshAndLegacy(void) {
+  // Fresh device saves the default configuration as an image
+  {
+    Boot boot;
+    CHECK(boot.config.getCountry() == "TH");
+    CHECK(hostFlash.files.count(IMAGE_A) || hostFlash.files.count(IMAGE_B));
+    CHECK(!hostFlash.files.count(LEGACY_JSON));
+  }
+
+  // Configuration saved as JSON by a previous firmware is moved to an image
+  hostFlash.clear();
+  std::string json;
+  {
+    Boot boot;
+    CHECK(boot.config.parse("{\"country\":\"US\",\"abcDays\":30,"
+                            "\"measurementFilters\":{\"pm02\":\"median\"},"
+                            "\"reportingDeadbands\":{\"pm02\":{\"absolute\":2,\"relative\":0.1}},"
+                            "\"corrections\":{\"pm02\":{\"correctionAlgorithm\":\"custom\","
+                            "\"slr\":{\"intercept\":1.5,\"scalingFactor\":0.8,"
+                            "\"useEpa2021\":true}}}}",
+                            true));
+    json = boot.config.toString().c_str();
+  }
+  hostFlash.clear();
+  hostFlash.files[LEGACY_JSON] = std::vector<uint8_t>(json.begin(), json.end());
+  Configuration::Values values;
+  String imageJson;
+  {
+    Boot boot;
+    CHECK(boot.config.getCountry() == "US");
+    CHECK(boot.config.getCO2CalibrationAbcDays() == 30);
+    CHECK(!hostFlash.files.count(LEGACY_JSON));
+    values = boot.config.values();
+    imageJson = boot.config.toString();
+  }
+
+  // Image boot gives the same values and nested configuration, JSON isn't parsed
+  Boot boot;
+  CHECK(JSON.typeof_(jconfig) == "undefined");
+  CHECK(boot.config.toString() == imageJson);
+  Configuration::Values loaded = boot.config.values();
+  CHECK(memcmp(&loaded, &values, sizeof(values)) == 0);
+  CHECK(boot.config.getMeasurementFilter(Measurements::PM25) == MEASUREMENT_FILTER_MEDIAN);
+  CHECK(boot.config.getMeasurementFilter(Measurements::PM10) == MEASUREMENT_FILTER_MEAN);
+  Configuration::PMCorrection pmCorrection = boot.config.getPMCorrection();
+  CHECK(pmCorrection.algorithm == COR_ALGO_PM_SLR_CUSTOM && pmCorrection.intercept == 1.5f);
+  CHECK(pmCorrection.scalingFactor == 0.8f && pmCorrection.useEPA);
+  CHECK(boot.config.getTempCorrection().algorithm == COR_ALGO_TEMP_HUM_NONE);
+  Configuration::ReportingDeadband deadband = boot.config.getReportingDeadband(Measurements::PM25);
+  CHECK(deadband.absolute == 2 && deadband.relative == 0.1f);
+  // Not configured: default of the measurement
+  deadband = boot.config.getReportingDeadband(Measurements::CO2);
+  CHECK(deadband.absolute == Measurements::descriptor(Measurements::CO2).deadband);
+  CHECK(deadband.relative == 0);
+  CHECK(JSON.typeof_(jconfig) == "undefined");
+
+  // Parsed on first export with the model, or change
+  CHECK(boot.config.toString(FW_MODE_I_9PSL).indexOf("\"model\":\"I-9PSL\"") >= 0);
+  CHECK(JSON.typeof_(jconfig) == "object");
+  boot.config.setPostToAirGradient(false);
+  boot.config.setPostToAirGradient(true);
+  loaded = boot.config.values();
+  CHECK(memcmp(&loaded, &values, sizeof(values)) == 0);
+}
+
+/**
+ * Every save is cut by a power loss at a random byte, half written, damaged once written or
+ * intact. Next boot loads the new value if the image is intact, the previous one otherwise
+ */
+static void tornWrites(void) {
+  int previousLoaded = 0;
+  for (int i = 0; i < 400; i++) {
+    int mode = i % 4;
+    int days;
+    {
+      Boot boot;
+      days = boot.config.getCO2CalibrationAbcDays();
+      char json[32];
+      snprintf(json, sizeof(json), "{\"abcDays\":%d}", days + 1);
+      CHECK(boot.config.parse(json, true));
+
+      const char *newest = newestImage();
+      size_t imageSize = hostFlash.files[newest].size();
+      if (mode == 0) {
+        hostFlash.powerOffAfter(rng() % imageSize);
+      } else if (mode == 1) {
+        hostFlash.failWrite = 1 + rng() % 3;
+      }
+      boot.config.flush();
+      hostFlash.powerOn();
+      hostFlash.failWrite = 0;
+
+      // Bit flip in the image just written
+      const char *written = newestImage();
+      if (mode == 2 && written != newest) {
+        std::vector<uint8_t> &image = hostFlash.files[written];
+        image[rng() % image.size()] ^= 1 << (rng() % 8);
+      }
+    }
+
+    Boot boot;
+    int loaded = boot.config.getCO2CalibrationAbcDays();
+    CHECK(boot.config.getCountry() == "US");
+    if (mode == 3) {
+      CHECK(loaded == days + 1);
+    } else {
+      CHECK(loaded == days || loaded == days + 1);
+      previousLoaded += loaded == days;
+    }
+  }
+  printf("torn writes: previous image loaded %d times of 300\n", previousLoaded);
+  CHECK(previousLoaded > 200);
+}
+
+static void formats(void) {
+  // Failed parse rolls back to the saved configuration
+  {
+    Boot boot;
+    int days = boot.config.getCO2CalibrationAbcDays();
+    CHECK(!boot.config.parse("{\"abcDays\":3,\"ledBarMode\":\"x\"}", true));
+    CHECK(boot.config.getCO2CalibrationAbcDays() == days);
+  }
+
+  // Image of another format or Values layout is loaded from its JSON and saved in this format
+  {
+    Boot boot;
+    CHECK(boot.config.parse("{\"abcDays\":5}", true));
+    boot.config.flush();
+  }
+  const char *newest = newestImage();
+  uint16_t format = formatOf(newest);
+  setFormat(newest, format + 1);
+  {
+    Boot boot;
+    CHECK(boot.config.getCO2CalibrationAbcDays() == 5);
+    CHECK(boot.config.getCountry() == "US");
+    boot.config.flush();
+  }
+  CHECK(newestImage() != newest);
+  CHECK(formatOf(newestImage()) == format);
+  {
+    Boot boot;
+    CHECK(boot.config.getCO2CalibrationAbcDays() == 5);
+  }
+
+  // Both images destroyed: default configuration
+  hostFlash.files[IMAGE_A].assign(10, 0);
+  hostFlash.files[IMAGE_B].clear();
+  Boot boot;
+  CHECK(boot.config.getCountry() == "TH");
+}
+
+int main() {
+  freshAndLegacy();
+  tornWrites();
+  formats();
+  return testResult();
+}
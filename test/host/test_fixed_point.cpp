@@ -0,0 +1,129 @@
+/**
+ * Fixed point correction kernels: results stay within 0.1 ug/m3 (or degree, or percent) of the
+ * float kernels over the sensor ranges, pm25ToAQI is exact, and out of range inputs give the
+ * float results
+ */
+#include "FixedPointKernels.h"
+#include "PMS/PMS.h"
+#include "PMS/PMS5003TBase.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <limits>
+
+#define KERNEL_TOLERANCE 0.1f
+
+static PMSBase pms;
+static PMS5003TBase pms5003t;
+
+/** SLR parameters of the correction algorithms and custom ones */
+static const float SCALING_FACTORS[] = {0.0111f, 0.02f, 0.02838f, 0.03525f, 0.5f, 1.0f, 2.5f};
+static const float INTERCEPTS[] = {-10.0f, -1.5f, 0.0f, 1.0f, 2.5f};
+
+/** Worst deviation of a kernel, every sample over the tolerance is a failure */
+struct Deviation {
+  const char *kernel;
+  double worst = 0;
+  float at = 0;
+  long samples = 0;
+
+  explicit Deviation(const char *kernel) : kernel(kernel) {}
+
+  void check(float fixed, float reference, float input) {
+    double deviation = fabs((double)fixed - (double)reference);
+    samples++;
+    if (deviation > worst) {
+      worst = deviation;
+      at = input;
+    }
+    CHECK(deviation <= KERNEL_TOLERANCE);
+  }
+
+  void print(void) const {
+    printf("%-24s %9ld samples, worst deviation %.6f at %g\n", kernel, samples, worst, at);
+  }
+};
+
+static bool same(float a, float b) { return a == b || (std::isnan(a) && std::isnan(b)); }
+
+int main() {
+  Deviation compensate("compensate");
+  for (int humidity = -10; humidity <= 110; humidity += 5) {
+    for (int pm25 = -1000; pm25 <= 200000; pm25++) {
+      float value = pm25 / 100.0f;
+      compensate.check(FixedPointKernels::compensate(value, humidity),
+                       pms.compensate(value, humidity), value);
+    }
+  }
+  for (int pm25 = 2000; pm25 < 10000; pm25++) {
+    compensate.check(FixedPointKernels::compensate(pm25, 50), pms.compensate(pm25, 50), pm25);
+  }
+  compensate.print();
+
+  Deviation slr("slrCorrection");
+  Deviation by003Count("slrCorrectionBy003Count");
+  Deviation byPm25Raw("slrCorrectionByPm25Raw");
+  for (float factor : SCALING_FACTORS) {
+    for (float intercept : INTERCEPTS) {
+      for (int count = 0; count <= 65535; count++) {
+        float pm25 = count / 65.535f;
+        float low = factor * count + intercept;
+        // Branch switch at 31 ug/m3 is a step, a rounding difference picks the other side
+        if (fabsf(low - 31) > 1e-3f) {
+          slr.check(FixedPointKernels::slrCorrection(pm25, count, factor, intercept),
+                    pms.slrCorrection(pm25, count, factor, intercept), count);
+        }
+        by003Count.check(FixedPointKernels::slrCorrectionBy003Count(count, factor, intercept),
+                         pms.slrCorrectionBy003Count(count, factor, intercept), count);
+      }
+      for (int pm25 = 0; pm25 <= 10000; pm25++) {
+        float value = pm25 / 10.0f;
+        byPm25Raw.check(FixedPointKernels::slrCorrectionByPm25Raw(value, factor, intercept),
+                        pms.slrCorrectionByPm25Raw(value, factor, intercept), value);
+      }
+    }
+  }
+  slr.print();
+  by003Count.print();
+  byPm25Raw.print();
+
+  Deviation temp("compensateTemp");
+  Deviation hum("compensateHum");
+  for (int value = -4000; value <= 10000; value++) {
+    float input = value / 100.0f;
+    temp.check(FixedPointKernels::compensateTemp(input), pms5003t.compensateTemp(input), input);
+  }
+  for (int value = -1000; value <= 11000; value++) {
+    float input = value / 100.0f;
+    hum.check(FixedPointKernels::compensateHum(input), pms5003t.compensateHum(input), input);
+  }
+  temp.print();
+  hum.print();
+
+  // Integer breakpoints, so every value is exact
+  long aqiMismatches = 0;
+  for (int pm02 = -100; pm02 <= 70000; pm02++) {
+    if (FixedPointKernels::pm25ToAQI(pm02) != pms.pm25ToAQI(pm02)) {
+      aqiMismatches++;
+    }
+  }
+  printf("%-24s %9d samples, %ld mismatches\n", "pm25ToAQI", 70101, aqiMismatches);
+  CHECK(aqiMismatches == 0);
+
+  // Out of the fixed point range, the float kernels are used
+  const float outOfRange[] = {std::numeric_limits<float>::quiet_NaN(),
+                              std::numeric_limits<float>::infinity(),
+                              -std::numeric_limits<float>::infinity(), -1e6f, 1e7f};
+  for (float value : outOfRange) {
+    CHECK(same(FixedPointKernels::compensate(value, 50), pms.compensate(value, 50)));
+    CHECK(same(FixedPointKernels::slrCorrectionBy003Count(value, 0.02f, 1),
+               pms.slrCorrectionBy003Count(value, 0.02f, 1)));
+    CHECK(same(FixedPointKernels::slrCorrectionByPm25Raw(value, 0.02f, 1),
+               pms.slrCorrectionByPm25Raw(value, 0.02f, 1)));
+    CHECK(same(FixedPointKernels::compensateTemp(value), pms5003t.compensateTemp(value)));
+    CHECK(same(FixedPointKernels::compensateHum(value), pms5003t.compensateHum(value)));
+  }
+  CHECK(same(FixedPointKernels::slrCorrectionBy003Count(100, 100, 1),
+             pms.slrCorrectionBy003Count(100, 100, 1)));
+
+  return testResult();
+}
@@ -0,0 +1,183 @@
+/**
+ * Moving average time windows: sized to the configured span out of the sample pool, and the
+ * channels of a measurement sharing one clock give the same time weighted average as each
+ * channel keeping the time of every value
+ */
+#include "AgConfigure.h"
+#include "AgValue.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <deque>
+#include <random>
+
+#define WINDOW 12000
+#define INTERVAL 2000
+#define CAPACITY (WINDOW / INTERVAL + 1)
+
+static std::mt19937 rng(16);
+static Configuration config(Serial);
+static Measurements measurements(config);
+static AirGradient ag(OPEN_AIR_OUTDOOR);
+
+/** Window of one channel as each value keeping its own time and round */
+struct ReferenceChannel {
+  struct Sample {
+    int value;
+    uint32_t time;
+    uint32_t round;
+  };
+  std::deque<Sample> samples;
+  float avg = utils::getInvalidPmValue();
+  int roundExpired = 0; // Values expired because their round was forgotten, before their time
+
+  float average(void) const {
+    if (samples.size() < 2 || samples.back().time == samples.front().time) {
+      float sum = 0;
+      for (const Sample &sample : samples) {
+        sum += sample.value;
+      }
+      return sum / samples.size();
+    }
+    float area = 0;
+    for (size_t i = 1; i < samples.size(); i++) {
+      area += (samples[i - 1].value + samples[i].value) * 0.5f *
+              (samples[i].time - samples[i - 1].time);
+    }
+    return area / (samples.back().time - samples.front().time);
+  }
+
+  /** Same rules as Measurements::updateMovingAverage in mean filter mode */
+  void update(int value, uint32_t now, uint32_t round, uint32_t newestRound) {
+    bool expired = false;
+    while (!samples.empty() && (newestRound - samples.front().round >= CAPACITY ||
+                                now - samples.front().time >= WINDOW)) {
+      roundExpired += now - samples.front().time < WINDOW;
+      samples.pop_front();
+      expired = true;
+    }
+    if (value == utils::getInvalidPmValue()) {
+      if (samples.empty()) {
+        avg = utils::getInvalidPmValue();
+      } else if (expired && avg != utils::getInvalidPmValue()) {
+        avg = average();
+      }
+      return;
+    }
+    while (samples.size() >= CAPACITY) {
+      samples.pop_front();
+    }
+    samples.push_back({value, now, round});
+    avg = average();
+  }
+};
+
+static bool near(float a, float b) { return fabsf(a - b) <= 0.001f * (1 + fabsf(b)); }
+
+/**
+ * Both PM channels updated together every interval with jitter, gaps and invalid reads. A round
+ * is every update with a valid value on any channel
+ */
+static void sharedClock(void) {
+  measurements.averagingWindow(Measurements::PM25, WINDOW, INTERVAL);
+  ReferenceChannel reference[MEASUREMENT_CHANNELS];
+  uint32_t round = 0;
+  int mismatches = 0;
+
+  for (int s = 0; s < 20000; s++) {
+    hostAdvanceMillis(rng() % 50 == 0 ? 20000 : 1400 + rng() % 1300);
+    uint32_t now = millis();
+    bool newRound = true;
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+      // Last channel fails for long stretches, its values expire by round or by time
+      bool failing = ch == MEASUREMENT_CHANNELS && (s / 40) % 3 == 0 ? rng() % 8 != 0
+                                                                       : rng() % 10 == 0;
+      int value = failing ? (int)utils::getInvalidPmValue() : (int)(rng() % 500);
+      // Values expire before the value of this channel starts a new round
+      uint32_t newest = round;
+      if (!failing && newRound) {
+        round++;
+        newRound = false;
+      }
+      ReferenceChannel &channel = reference[ch - 1];
+      channel.update(value, now, round, newest);
+      measurements.update(Measurements::PM25, value, ch);
+
+      float average = measurements.getAverage(Measurements::PM25, ch);
+      Measurements::Statistics statistics = measurements.getStatistics(Measurements::PM25, ch);
+      if (!near(average, channel.avg) || statistics.count != (int)channel.samples.size()) {
+        if (mismatches++ < 5) {
+          printf("step %d channel %d: average %.3f expected %.3f, %d values expected %zu\n", s, ch,
+                 average, channel.avg, statistics.count, channel.samples.size());
+        }
+      }
+    }
+  }
+  int roundExpired = 0;
+  for (const ReferenceChannel &channel : reference) {
+    roundExpired += channel.roundExpired;
+  }
+  printf("shared clock: %d mismatches, %d values expired by round\n", mismatches, roundExpired);
+  CHECK(mismatches == 0);
+  CHECK(roundExpired > 0);
+}
+
+/**
+ * Windows of OneOpenAir, 12 s over the update interval of each sensor, all fit in the sample pool:
+ * every channel keeps the values of the whole window
+ */
+static void oneOpenAirWindows(void) {
+  const Measurements::MeasurementType tvoc[] = {Measurements::TVOC, Measurements::TVOCRaw,
+                                                Measurements::NOx, Measurements::NOxRaw};
+  const Measurements::MeasurementType pms[] = {
+      Measurements::PM25,    Measurements::PM01,    Measurements::PM10,    Measurements::PM25_SP,
+      Measurements::PM01_SP, Measurements::PM10_SP, Measurements::PM03_PC, Measurements::PM05_PC,
+      Measurements::PM01_PC, Measurements::PM25_PC, Measurements::PM5_PC,  Measurements::PM10_PC};
+  measurements.averagingWindow(Measurements::CO2, WINDOW, 4000);
+  for (Measurements::MeasurementType type : tvoc) {
+    measurements.averagingWindow(type, WINDOW, 1000);
+  }
+  for (Measurements::MeasurementType type : pms) {
+    measurements.averagingWindow(type, WINDOW, 2000);
+  }
+  measurements.averagingWindow(Measurements::Temperature, WINDOW, 2000);
+  measurements.averagingWindow(Measurements::Humidity, WINDOW, 2000);
+
+  for (int s = 0; s < 120; s++) {
+    hostAdvanceMillis(1000);
+    for (Measurements::MeasurementType type : tvoc) {
+      measurements.update(type, 100 + s);
+    }
+    if (s % 4 == 0) {
+      measurements.update(Measurements::CO2, 400 + s);
+    }
+    for (int ch = 1; ch <= MEASUREMENT_CHANNELS && s % 2 == 0; ch++) {
+      for (Measurements::MeasurementType type : pms) {
+        measurements.update(type, 10 * ch + s, ch);
+      }
+      measurements.update(Measurements::Temperature, 20.0f + ch, ch);
+      measurements.update(Measurements::Humidity, 50.0f + ch, ch);
+    }
+  }
+
+  // Values younger than the window: 11 seconds of TVOC, 10 of PM, 8 of CO2, and the newest
+  CHECK(measurements.getStatistics(Measurements::NOxRaw).count == 12);
+  CHECK(measurements.getStatistics(Measurements::CO2).count == 3);
+  for (int ch = 1; ch <= MEASUREMENT_CHANNELS; ch++) {
+    for (Measurements::MeasurementType type : pms) {
+      CHECK(measurements.getStatistics(type, ch).count == 6);
+    }
+    CHECK(measurements.getStatistics(Measurements::Humidity, ch).count == 6);
+    CHECK(near(measurements.getAverage(Measurements::PM10_PC, ch), 10 * ch + 113));
+  }
+  printf("Measurements %zu bytes, sample pool %d bytes\n", sizeof(Measurements),
+         MEASUREMENT_SAMPLE_POOL);
+}
+
+int main() {
+  config.setAirGradient(&ag);
+  config.setConfigurationUpdatedCallback([]() {});
+  measurements.setAirGradient(&ag);
+  sharedClock();
+  oneOpenAirWindows();
+  return testResult();
+}
@@ -0,0 +1,146 @@
+/**
+ * Measurements JSON payload: toJson(char*, size) parses to the same JSON as the JSONVar builders
+ * it replaced, see JsonVarPayload.cpp, on an indoor monitor and on a dual PMS outdoor monitor.
+ * Indoor payloads are the same text, outdoor ones write "channels" after the fused values
+ */
+#include "JsonVarPayload.h"
+#include "TestCheck.h"
+#include <random>
+
+static std::mt19937 rng(4);
+static Configuration config(Serial);
+static Measurements measurements(config);
+
+/** Same JSON value, object members in any order */
+static bool sameJson(JSONVar a, JSONVar b) {
+  String type = JSON.typeof_(a);
+  if (type != JSON.typeof_(b)) {
+    return false;
+  }
+  if (type == "number") {
+    return (double)a == (double)b;
+  }
+  if (type == "string") {
+    return String((const char *)a) == (const char *)b;
+  }
+  if (type == "boolean") {
+    return (bool)a == (bool)b;
+  }
+  if (type != "object") {
+    return JSON.stringify(a) == JSON.stringify(b);
+  }
+  // JSONVar::keys() crash on object without member
+  bool emptyA = JSON.stringify(a) == "{}";
+  bool emptyB = JSON.stringify(b) == "{}";
+  if (emptyA || emptyB) {
+    return emptyA == emptyB;
+  }
+  JSONVar keys = a.keys();
+  if (keys.length() != b.keys().length()) {
+    return false;
+  }
+  for (int i = 0; i < keys.length(); i++) {
+    const char *key = keys[i];
+    if (!b.hasOwnProperty(key) || !sameJson(a[key], b[key])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Every measurement channel updated, about one value in eight invalid */
+static void updateAll(void) {
+  for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+    const Measurements::MeasurementDescriptor &desc =
+        Measurements::descriptor((Measurements::MeasurementType)i);
+    for (int ch = 1; ch <= desc.channels; ch++) {
+      if (desc.isFloat) {
+        float value = rng() % 8 ? (rng() % 6000) / 100.0f - 10 : desc.invalidValue;
+        measurements.update(desc.type, value, ch);
+      } else {
+        int value = rng() % 8 ? (int)(rng() % 3000) : (int)desc.invalidValue;
+        measurements.update(desc.type, value, ch);
+      }
+    }
+  }
+  measurements.fusePMS();
+  measurements.publish();
+}
+
+/** Corrections and window statistics changed now and then, so every payload branch is taken */
+static void updateConfig(int round) {
+  static const char *const configs[] = {
+      "{\"windowStatistics\":false,\"corrections\":{\"pm02\":{\"correctionAlgorithm\":\"none\","
+      "\"slr\":{}},\"atmp\":{\"correctionAlgorithm\":\"none\",\"slr\":{}}}}",
+      "{\"windowStatistics\":true,\"corrections\":{\"pm02\":{\"correctionAlgorithm\":"
+      "\"epa_2021\",\"slr\":{}},\"atmp\":{\"correctionAlgorithm\":\"ag_pms5003t_2024\","
+      "\"slr\":{}}}}",
+      "{\"windowStatistics\":true,\"corrections\":{\"pm02\":{\"correctionAlgorithm\":\"custom\","
+      "\"slr\":{\"intercept\":1.5,\"scalingFactor\":0.8,\"useEpa2021\":true}}}}",
+  };
+  CHECK(config.parse(configs[round % 3], true));
+}
+
+/** Payloads of rounds of updates, local server and cloud, against the JSONVar builders */
+static void comparePayloads(AirGradient &ag, AgFirmwareMode fwMode, const char *name) {
+  measurements.setAirGradient(&ag);
+  config.setAirGradient(&ag);
+  JsonVarPayload reference;
+  reference.resetReason = ESP_RST_SW;
+  measurements.setResetReason(ESP_RST_SW);
+
+  int mismatches = 0;
+  int sameText = 0;
+  int payloads = 0;
+  static char buf[4096];
+  for (int round = 0; round < 300; round++) {
+    if (round % 50 == 0) {
+      updateConfig(round / 50);
+    }
+    reference.bootCount = round;
+    measurements.setBootCount(round);
+    updateAll();
+
+    for (bool localServer : {false, true}) {
+      int rssi = -(int)(rng() % 100);
+      size_t length = measurements.toJson(buf, sizeof(buf), localServer, fwMode, rssi);
+      CHECK(length > 0 && length == strlen(buf));
+      String expected = reference.toString(measurements, ag, config, localServer, fwMode, rssi);
+      JSONVar written = JSON.parse(buf);
+      CHECK(JSON.typeof_(written) == "object");
+      if (!sameJson(written, JSON.parse(expected))) {
+        if (mismatches++ < 3) {
+          printf("%s round %d:\n  toJson  %s\n  JSONVar %s\n", name, round, buf,
+                 expected.c_str());
+        }
+      }
+      sameText += expected == buf;
+      payloads++;
+    }
+  }
+  printf("%s: %d of %d payloads differ, %d the same text\n", name, mismatches, payloads,
+         sameText);
+  CHECK(mismatches == 0);
+  if (ag.isOne()) {
+    CHECK(sameText == payloads);
+  }
+}
+
+int main() {
+  config.setConfigurationUpdatedCallback([]() {});
+
+  AirGradient indoor(ONE_INDOOR);
+  config.hasSensorS8 = true;
+  config.hasSensorSGP = true;
+  config.hasSensorSHT = true;
+  config.hasSensorPMS1 = true;
+  config.hasSensorPMS2 = false;
+  comparePayloads(indoor, FW_MODE_I_9PSL, "indoor");
+
+  AirGradient outdoor(OPEN_AIR_OUTDOOR);
+  config.hasSensorS8 = false;
+  config.hasSensorSHT = false;
+  config.hasSensorPMS2 = true;
+  comparePayloads(outdoor, FW_MODE_O_1PPT, "dual PMS outdoor");
+  return testResult();
+}
@@ -0,0 +1,273 @@
+/**
+ * WiFi measures outbox of OneOpenAir on the host flash: payloads come out in order and intact
+ * across reboots, a power loss or a half written record never loses a payload the outbox
+ * acknowledged, only payloads already posted can be sent again. Payloads come back with the shape
+ * they were saved with, samples read together as a JSON array
+ */
+#include "FS.h"
+#include "Libraries/Arduino_JSON/src/Arduino_JSON.h"
+#include "MeasuresOutbox.h"
+#include "TestCheck.h"
+#include <deque>
+#include <random>
+
+static std::mt19937 rng(23);
+
+/** Payload of id, its size and content only depend on id */
+static std::string payloadOf(int id) {
+  std::string payload = "{\"id\":" + std::to_string(id) + ",\"pad\":\"";
+  payload.append(100 + (id * 7919) % 500, 'a' + id % 26);
+  return payload + "\"}";
+}
+
+/** Runs of objects and samples, like a batch size changed while payloads wait */
+static MeasuresOutbox::Shape shapeOf(int id) {
+  return (id / 10) % 3 == 0 ? MeasuresOutbox::Object : MeasuresOutbox::Sample;
+}
+
+static bool push(MeasuresOutbox &outbox, int id) {
+  std::string payload = payloadOf(id);
+  return outbox.push(payload.c_str(), payload.length(), shapeOf(id));
+}
+
+/** Id of the oldest payload, -1 if empty. Its content and shape must be the ones pushed */
+static int peekOne(MeasuresOutbox &outbox) {
+  String payload;
+  MeasuresOutbox::Shape shape;
+  if (outbox.peek(payload, 1, shape) != 1) {
+    return -1;
+  }
+  int id = atoi(payload.c_str() + 6);
+  CHECK(payload == payloadOf(id).c_str());
+  CHECK(shape == shapeOf(id));
+  return id;
+}
+
+/**
+ * Payloads the outbox acknowledged, in order, compared with what it gives back. Payloads can be
+ * skipped only when the outbox counted them as dropped. A payload whose push failed might still
+ * come out, power was lost after it was written
+ */
+struct Delivery {
+  std::deque<int> expected;
+  int lastSent = -1;
+  int lost = 0;
+  int resent = 0;
+
+  void sent(int id, bool dropped) {
+    if (id <= lastSent) {
+      resent++;
+      return;
+    }
+    while (!expected.empty() && expected.front() < id) {
+      expected.pop_front();
+      lost += !dropped;
+    }
+    if (!expected.empty() && expected.front() == id) {
+      expected.pop_front();
+    }
+    lastSent = id;
+  }
+};
+
+static void fifo(void) {
+  {
+    MeasuresOutbox outbox(Serial);
+    CHECK(outbox.begin());
+    CHECK(outbox.size() == 0);
+    for (int id = 0; id < 10; id++) {
+      CHECK(push(outbox, id));
+    }
+    CHECK(peekOne(outbox) == 0);
+    outbox.pop(1);
+    CHECK(peekOne(outbox) == 1);
+    outbox.pop(1);
+  }
+
+  // Reboot keeps the payloads not popped
+  MeasuresOutbox outbox(Serial);
+  CHECK(outbox.begin());
+  CHECK(outbox.size() == 8);
+  for (int id = 2; id < 10; id++) {
+    CHECK(peekOne(outbox) == id);
+    outbox.pop(1);
+  }
+  CHECK(outbox.size() == 0);
+  CHECK(peekOne(outbox) == -1);
+  CHECK(hostFlash.files.empty());
+}
+
+/** Full ring drops its oldest segment, the rest stays in order */
+static void wrap(void) {
+  hostFlash.clear();
+  MeasuresOutbox outbox(Serial);
+  outbox.begin();
+  for (int id = 0; id < 200; id++) {
+    CHECK(push(outbox, id));
+  }
+  CHECK(outbox.size() + outbox.dropped() == 200);
+  CHECK(hostFlash.usedBytes() <= MEASURES_OUTBOX_SEGMENTS * MEASURES_OUTBOX_SEGMENT_SIZE);
+  printf("wrap: %u of 200 payloads dropped, %zu bytes of flash\n", outbox.dropped(),
+         hostFlash.usedBytes());
+  int last = -1;
+  for (int id; (id = peekOne(outbox)) >= 0; outbox.pop(1)) {
+    CHECK(id > last);
+    last = id;
+  }
+  CHECK(last == 199);
+}
+
+/**
+ * Boots cut by a power loss at a random byte of flash writes, or with a write persisting only
+ * half of its bytes
+ */
+static void powerLoss(bool halfWrites) {
+  hostFlash.clear();
+  Delivery delivery;
+  int next = 0;
+  int losses = 0;
+  for (int boot = 0; boot < 5000; boot++) {
+    MeasuresOutbox outbox(Serial);
+    outbox.begin();
+    if (halfWrites) {
+      hostFlash.failWrite = 1 + rng() % 60;
+    } else {
+      hostFlash.powerOffAfter(rng() % 8000);
+    }
+    for (int step = 0; step < 40; step++) {
+      uint32_t dropped = outbox.dropped();
+      if (rng() % 3 == 0) {
+        // A payload is acknowledged if it was saved before power is lost, a half written record
+        // is saved again in a new segment
+        bool saved = push(outbox, next);
+        if (saved && !hostFlash.powerLost) {
+          delivery.expected.push_back(next);
+        }
+        next++;
+      } else {
+        int id = peekOne(outbox);
+        if (id >= 0) {
+          delivery.sent(id, outbox.dropped() != dropped);
+          outbox.pop(1);
+        }
+      }
+      if (hostFlash.powerLost || (halfWrites && hostFlash.failWrite == 0)) {
+        losses++;
+        break;
+      }
+    }
+    hostFlash.powerOn();
+    hostFlash.failWrite = 0;
+  }
+
+  // Whatever is left comes out after the last boot
+  MeasuresOutbox outbox(Serial);
+  outbox.begin();
+  for (int id; (id = peekOne(outbox)) >= 0; outbox.pop(1)) {
+    delivery.sent(id, false);
+  }
+  printf("%s: %d faults, %d acknowledged payloads lost, %d resent\n",
+         halfWrites ? "half writes" : "power loss", losses, delivery.lost, delivery.resent);
+  CHECK(losses > 1000);
+  CHECK(delivery.lost == 0);
+  CHECK(delivery.expected.empty());
+}
+
+/** Files damaged between boots: broken records are dropped, the others still come out in order */
+static void damage(void) {
+  hostFlash.clear();
+  int next = 0;
+  int damaged = 0;
+  for (int boot = 0; boot < 3000; boot++) {
+    MeasuresOutbox outbox(Serial);
+    outbox.begin();
+    int last = -1;
+    for (int step = 0; step < 30; step++) {
+      if (rng() % 3) {
+        push(outbox, next++);
+      } else {
+        int id = peekOne(outbox);
+        if (id >= 0) {
+          CHECK(id > last);
+          last = id;
+          outbox.pop(1);
+        }
+      }
+    }
+    if (!hostFlash.files.empty() && rng() % 2) {
+      auto file = hostFlash.files.begin();
+      std::advance(file, rng() % hostFlash.files.size());
+      std::vector<uint8_t> &bytes = file->second;
+      if (!bytes.empty()) {
+        if (rng() % 2) {
+          bytes.resize(rng() % bytes.size());
+        } else {
+          bytes[rng() % bytes.size()] ^= 0x5a;
+        }
+        damaged++;
+      }
+    }
+  }
+  printf("damage: %d files damaged\n", damaged);
+}
+
+/**
+ * Payloads read together: one object, or consecutive samples as a JSON array up to the next
+ * object. Posts sometimes fail or the device reboots, the payloads not popped are read again
+ */
+static void batches(void) {
+  hostFlash.clear();
+  MeasuresOutbox *outbox = new MeasuresOutbox(Serial);
+  outbox->begin();
+  int next = 0;
+  int expected = 0;
+  for (int i = 0; i < 3000; i++) {
+    if (i % 50 == 49) {
+      delete outbox;
+      outbox = new MeasuresOutbox(Serial);
+      outbox->begin();
+    }
+    uint32_t dropped = outbox->dropped();
+    for (int k = rng() % 7; k > 0; k--) {
+      push(*outbox, next++);
+    }
+    String batch = "[";
+    MeasuresOutbox::Shape shape;
+    int max = 1 + rng() % 15;
+    int count = outbox->peek(batch, max, shape);
+    batch += "]";
+    int first = expected;
+    if (count > 0) {
+      JSONVar array = JSON.parse(batch);
+      CHECK(JSON.typeof_(array) == "array" && array.length() == count);
+      first = (int)array[0]["id"];
+      CHECK(first == expected || (first > expected && outbox->dropped() != dropped));
+      for (int j = 1; j < count; j++) {
+        CHECK((int)array[j]["id"] == first + j);
+      }
+      CHECK(shape == shapeOf(first) && shapeOf(first + count - 1) == shape);
+      if (shape == MeasuresOutbox::Object) {
+        CHECK(count == 1);
+      } else {
+        // Samples stop at the maximum, the next object or the newest payload
+        CHECK(count == max || shapeOf(first + count) == MeasuresOutbox::Object ||
+              first + count == next);
+      }
+    }
+    int popped = rng() % 4 ? count : rng() % (count + 1);
+    outbox->pop(popped);
+    expected = first + popped;
+  }
+  printf("batches: %u payloads left, %u dropped\n", outbox->size(), outbox->dropped());
+  delete outbox;
+}
+
+int main() {
+  fifo();
+  wrap();
+  powerLoss(false);
+  powerLoss(true);
+  damage();
+  batches();
+  return testResult();
+}
@@ -0,0 +1,122 @@
+/**
+ * Cellular measures payloads: the binary payload decoded by the reference decoder gives back the
+ * CSV payload of the same batch, from Measures and from PackedMeasures
+ */
+#include "AgValue.h"
+#include "Main/utils.h"
+#include "TestCheck.h"
+#include <random>
+#include <vector>
+
+static std::mt19937 rng(6);
+
+static float uniform(float low, float high, int resolution) {
+  int steps = (int)((high - low) * resolution);
+  return low + (int)(rng() % (steps + 1)) / (float)resolution;
+}
+
+static bool chance(int n) { return rng() % n == 0; }
+
+/** Measures of a monitor, about one in ten values invalid */
+static Measurements::Measures randomMeasures(void) {
+  Measurements::Measures mc;
+  memset(&mc, 0, sizeof(mc));
+  for (int ch = 0; ch < MEASUREMENT_CHANNELS; ch++) {
+    mc.temperature[ch] = chance(10) ? utils::getInvalidTemperature() : uniform(-40, 85, 100);
+    mc.humidity[ch] = chance(10) ? utils::getInvalidHumidity() : uniform(0, 100, 100);
+    float *pm[] = {mc.pm_01, mc.pm_25, mc.pm_10, mc.pm_01_sp, mc.pm_25_sp, mc.pm_10_sp};
+    for (float *value : pm) {
+      value[ch] = chance(10) ? utils::getInvalidPmValue() : uniform(0, 1000, 10);
+    }
+    float *counts[] = {mc.pm_03_pc, mc.pm_05_pc, mc.pm_01_pc,
+                       mc.pm_25_pc, mc.pm_5_pc,  mc.pm_10_pc};
+    for (float *value : counts) {
+      value[ch] = chance(10) ? utils::getInvalidPmValue() : uniform(0, 65000, 1);
+    }
+  }
+  mc.co2 = chance(10) ? utils::getInvalidCO2() : uniform(300, 10000, 1);
+  mc.tvoc = chance(10) ? utils::getInvalidVOC() : uniform(0, 500, 1);
+  mc.tvoc_raw = chance(10) ? utils::getInvalidVOC() : uniform(0, 50000, 1);
+  mc.nox = chance(10) ? utils::getInvalidNOx() : uniform(1, 500, 1);
+  mc.nox_raw = chance(10) ? utils::getInvalidNOx() : uniform(0, 50000, 1);
+  mc.signal = chance(5) ? 99 : -(int)(rng() % 120) - 1;
+  return mc;
+}
+
+static std::string csvPayload(const Measurements::Measures *mcs, int count, bool extended) {
+  size_t length = Measurements::encodeMeasuresPayload(180, mcs, count, extended, NULL, 0);
+  std::string csv(length, '\0');
+  CHECK(Measurements::encodeMeasuresPayload(180, mcs, count, extended, &csv[0], length + 1) ==
+        length);
+  return csv;
+}
+
+static std::vector<uint8_t> binaryPayload(const Measurements::Measures *mcs, int count,
+                                          bool extended) {
+  size_t length = Measurements::encodeMeasuresBinaryPayload(180, mcs, count, extended, NULL, 0);
+  std::vector<uint8_t> binary(length);
+  CHECK(Measurements::encodeMeasuresBinaryPayload(180, mcs, count, extended, binary.data(),
+                                                  length) == length);
+  return binary;
+}
+
+static std::string decode(const std::vector<uint8_t> &binary) {
+  size_t length = Measurements::decodeMeasuresBinaryPayload(binary.data(), binary.size(), NULL, 0);
+  std::string csv(length, '\0');
+  CHECK(Measurements::decodeMeasuresBinaryPayload(binary.data(), binary.size(), &csv[0],
+                                                  length + 1) == length);
+  return csv;
+}
+
+int main() {
+  size_t csvBytes = 0;
+  size_t binaryBytes = 0;
+  for (int batch = 0; batch < 5000; batch++) {
+    Measurements::Measures mcs[20];
+    Measurements::PackedMeasures packed[20];
+    int count = 1 + rng() % 20;
+    for (int i = 0; i < count; i++) {
+      // Successive cycles are often close, like a real batch
+      mcs[i] = i > 0 && chance(2) ? mcs[i - 1] : randomMeasures();
+      CHECK(Measurements::packMeasures(mcs[i], packed[i]));
+    }
+
+    for (int extended = 0; extended < 2; extended++) {
+      std::string csv = csvPayload(mcs, count, extended);
+      std::vector<uint8_t> binary = binaryPayload(mcs, count, extended);
+      CHECK(decode(binary) == csv);
+      csvBytes += csv.size();
+      binaryBytes += binary.size();
+
+      // Queued cycles give the same payloads
+      char packedCsv[4096];
+      Measurements::encodeMeasuresPayload(180, packed, count, extended, packedCsv,
+                                          sizeof(packedCsv));
+      CHECK(csv == packedCsv);
+      uint8_t packedBinary[2048];
+      size_t length = Measurements::encodeMeasuresBinaryPayload(
+          180, packed, count, extended, packedBinary, sizeof(packedBinary));
+      CHECK(length == binary.size() && memcmp(packedBinary, binary.data(), length) == 0);
+
+      // Short buffer is truncated like snprintf, length is still the full one
+      char shortCsv[16];
+      CHECK(Measurements::decodeMeasuresBinaryPayload(binary.data(), binary.size(), shortCsv,
+                                                      sizeof(shortCsv)) == csv.size());
+      CHECK(csv.compare(0, sizeof(shortCsv) - 1, shortCsv) == 0);
+
+      // Truncated payload is rejected, never read past its end
+      std::vector<uint8_t> truncated(binary.begin(), binary.begin() + rng() % binary.size());
+      CHECK(Measurements::decodeMeasuresBinaryPayload(truncated.data(), truncated.size(), NULL,
+                                                      0) == 0);
+    }
+  }
+
+  // Unknown schema version is rejected
+  Measurements::Measures mc = randomMeasures();
+  std::vector<uint8_t> binary = binaryPayload(&mc, 1, false);
+  binary[0] ^= 0x80;
+  CHECK(Measurements::decodeMeasuresBinaryPayload(binary.data(), binary.size(), NULL, 0) == 0);
+
+  printf("CSV %zu bytes, binary %zu bytes\n", csvBytes, binaryBytes);
+  return testResult();
+}
@@ -0,0 +1,116 @@
+/**
+ * Dual PMS fusion: replay the dual channel traces of traces/ and check the faulty channel is
+ * flagged, the healthy one never is, and the fused PM2.5 is closer to the reference than the
+ * plain average of the channels
+ */
+#include "Main/PMSFusion.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+struct TraceCase {
+  const char *file;
+  int faultyChannel; // 0 if both channels are healthy
+  int faultStart;    // Sample the fault starts from
+  int maxDetection;  // Samples after faultStart the channel must be faulty by
+};
+
+static const TraceCase TRACES[] = {
+    {"pms_healthy.csv", 0, 0, 0},
+    {"pms_degrading.csv", 2, 2000, 6000},
+    {"pms_stuck.csv", 1, 2000, 2000},
+    {"pms_noisy.csv", 1, 2000, 200},
+};
+
+/** Parse one "reference,channel 1,channel 2" line, "-" is a failed read */
+static bool parseSample(char *line, float &reference, float values[2], bool valid[2]) {
+  char *field = strtok(line, ",\n");
+  if (field == nullptr) {
+    return false;
+  }
+  reference = atof(field);
+  for (int i = 0; i < 2; i++) {
+    field = strtok(nullptr, ",\n");
+    if (field == nullptr) {
+      return false;
+    }
+    valid[i] = strcmp(field, "-") != 0;
+    values[i] = valid[i] ? atof(field) : 0;
+  }
+  return true;
+}
+
+static void replay(const TraceCase &trace) {
+  std::string path = std::string(TRACES_DIR) + "/" + trace.file;
+  FILE *file = fopen(path.c_str(), "r");
+  CHECK(file != nullptr);
+  if (file == nullptr) {
+    return;
+  }
+
+  PMSFusion<2> fusion;
+  int samples = 0;
+  int detected = -1;
+  int falseFaulty = 0;
+  double fusedError = 0;
+  double averageError = 0;
+  int compared = 0;
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#') {
+      continue;
+    }
+    float reference;
+    float values[2];
+    bool valid[2];
+    CHECK(parseSample(line, reference, values, valid));
+    fusion.update(values, valid);
+    const PMSFusion<2>::Status &status = fusion.status();
+
+    for (int ch = 1; ch <= 2; ch++) {
+      if (status.health[ch - 1] != PMSFusionHealth::HealthFaulty) {
+        continue;
+      }
+      if (ch != trace.faultyChannel || samples < trace.faultStart) {
+        falseFaulty++;
+      } else if (detected < 0) {
+        detected = samples - trace.faultStart;
+      }
+    }
+
+    // Once the fault is established, fused value should follow the healthy channel
+    if (trace.faultyChannel && valid[0] && valid[1] &&
+        samples >= trace.faultStart + trace.maxDetection) {
+      fusedError += fabs(status.combine(values, valid) - reference);
+      averageError += fabs((values[0] + values[1]) / 2 - reference);
+      compared++;
+    }
+    samples++;
+  }
+  fclose(file);
+
+  printf("%s: %d samples, faulty after %d, false faulty %d", trace.file, samples, detected,
+         falseFaulty);
+  if (compared) {
+    printf(", fused MAE %.2f vs average %.2f", fusedError / compared, averageError / compared);
+  }
+  printf("\n");
+
+  CHECK(samples > trace.faultStart);
+  CHECK(falseFaulty == 0);
+  if (trace.faultyChannel) {
+    CHECK(detected >= 0 && detected <= trace.maxDetection);
+    CHECK(compared > 0 && fusedError < averageError);
+  } else {
+    CHECK(fusion.status().confidence > 0.9f);
+  }
+}
+
+int main() {
+  for (const TraceCase &trace : TRACES) {
+    replay(trace);
+  }
+  return testResult();
+}
@@ -0,0 +1,107 @@
+/**
+ * Measurements snapshot: readers on other threads always copy a whole published snapshot while
+ * the writer keeps updating and publishing, and never wait for it
+ */
+#include "AgConfigure.h"
+#include "AgValue.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define READERS 3
+#define PUBLISHES 20000
+
+static Configuration config(Serial);
+static Measurements measurements(config);
+static std::atomic<bool> done(false);
+
+/** Every channel of every measurement is given this value on the publish of version */
+static int valueOfVersion(uint32_t version) { return 1 + version % 50; }
+
+static void writer(uint32_t initial) {
+  for (uint32_t version = initial + 1; version <= initial + PUBLISHES; version++) {
+    int value = valueOfVersion(version);
+    for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+      const Measurements::MeasurementDescriptor &desc =
+          Measurements::descriptor((Measurements::MeasurementType)i);
+      for (int ch = 1; ch <= desc.channels; ch++) {
+        if (desc.isFloat) {
+          measurements.update(desc.type, (float)value, ch);
+        } else {
+          measurements.update(desc.type, value, ch);
+        }
+      }
+    }
+    measurements.publish();
+  }
+  done = true;
+}
+
+struct ReaderResult {
+  long copies = 0;
+  long torn = 0;
+  long backward = 0;
+  uint32_t lastVersion = 0;
+};
+
+static void reader(ReaderResult *result, uint32_t initialVersion) {
+  Measurements::Snapshot snapshot;
+  uint32_t previous = 0;
+  while (!done) {
+    measurements.snapshot(snapshot);
+    result->copies++;
+    if (snapshot.version < previous) {
+      result->backward++;
+    }
+    previous = snapshot.version;
+    if (snapshot.version == initialVersion) {
+      continue;
+    }
+
+    // A copy mixing two publishes has latest values of two versions
+    int expected = valueOfVersion(snapshot.version);
+    for (int i = 0; i < Measurements::_MEASUREMENT_TYPE_MAX; i++) {
+      const Measurements::MeasurementDescriptor &desc =
+          Measurements::descriptor((Measurements::MeasurementType)i);
+      for (int ch = 1; ch <= desc.channels; ch++) {
+        if (Measurements::valueOf(snapshot.latest, desc.type, ch) != expected) {
+          result->torn++;
+          ch = desc.channels;
+          i = Measurements::_MEASUREMENT_TYPE_MAX;
+        }
+      }
+    }
+  }
+  result->lastVersion = previous;
+}
+
+int main() {
+  // Constructor publishes the first, empty, snapshot
+  Measurements::Snapshot initial;
+  measurements.snapshot(initial);
+
+  ReaderResult results[READERS];
+  std::vector<std::thread> readers;
+  for (int i = 0; i < READERS; i++) {
+    readers.push_back(std::thread(reader, &results[i], initial.version));
+  }
+  std::thread write(writer, initial.version);
+  write.join();
+  for (std::thread &thread : readers) {
+    thread.join();
+  }
+
+  Measurements::Snapshot last;
+  measurements.snapshot(last);
+  CHECK(last.version == initial.version + PUBLISHES);
+  for (int i = 0; i < READERS; i++) {
+    printf("reader %d: %ld copies, %ld torn, last version %u\n", i + 1, results[i].copies,
+           results[i].torn, results[i].lastVersion);
+    CHECK(results[i].copies > 0);
+    CHECK(results[i].torn == 0);
+    CHECK(results[i].backward == 0);
+  }
+  return testResult();
+}